@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include "Arena.h"
+
+Arena::Arena()
+{
+  blockUsed = BLOCK_SIZE;
+}
+
+Arena::~Arena()
+{
+  clear();
+}
+
+const char* Arena::copy(const char* str)
+{
+  size_t n = strlen(str) + 1;
+
+  // a string never spans two blocks
+  if (blockUsed + n > BLOCK_SIZE) {
+    blocks.push_back((char*) malloc(BLOCK_SIZE));
+    blockUsed = 0;
+  }
+
+  char* p = blocks.back() + blockUsed;
+  memcpy(p, str, n);
+  blockUsed += n;
+  return p;
+}
+
+void* Arena::allocate(size_t n)
+{
+  // round the start up to a multiple of the largest alignment
+  size_t start = (blockUsed + sizeof(double) - 1) & ~(sizeof(double) - 1);
+
+  if (start + n > BLOCK_SIZE) {
+    blocks.push_back((char*) malloc(BLOCK_SIZE));
+    start = 0;
+  }
+
+  blockUsed = start + n;
+  return blocks.back() + start;
+}
+
+void Arena::clear()
+{
+  for (unsigned i = 0; i < blocks.size(); i++) free(blocks[i]);
+  blocks.clear();
+  blockUsed = BLOCK_SIZE;
+}
+
+size_t Arena::size() const
+{
+  return blocks.size() * BLOCK_SIZE;
+}
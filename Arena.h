@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Copies strings into large blocks of memory that are freed all at once.
+ * Strings that are stored together stay next to each other in memory,
+ * and no string is freed on its own. Other objects may be placed in the
+ * blocks with allocate().
+ */
+class Arena {
+ public:
+  static const size_t BLOCK_SIZE = 64 * 1024;
+
+  Arena();
+  ~Arena();
+
+  /**
+   * copy a string into the arena.
+   * @param str[IN] a string shorter than BLOCK_SIZE
+   * @return the copy, valid until clear() or the arena is destroyed
+   */
+  const char* copy(const char* str);
+
+  /**
+   * reserve memory in the arena, aligned for any type.
+   * @param n[IN] the number of bytes, smaller than BLOCK_SIZE
+   * @return the memory, valid until clear() or the arena is destroyed
+   */
+  void* allocate(size_t n);
+
+  /**
+   * free every string in the arena.
+   */
+  void clear();
+
+  /**
+   * @return the bytes of memory held by the arena
+   */
+  size_t size() const;
+
+ private:
+  Arena(const Arena&);             // not copyable: owns the blocks
+  Arena& operator=(const Arena&);
+
+  std::vector<char*> blocks;  // the blocks, the last one is being filled
+  size_t blockUsed;           // bytes used in the last block
+};
+
+#endif // ARENA_H
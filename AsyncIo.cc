@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "AsyncIo.h"
+#include "ThreadPool.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAS_IO_URING
+#endif
+#endif
+
+AsyncIo::Backend AsyncIo::defaultBackend = AsyncIo::URING_BACKEND;
+
+// the I/O threads of THREAD_BACKEND, started the first time they are used
+static ThreadPool     ioThreads;
+static pthread_once_t ioThreadsOnce = PTHREAD_ONCE_INIT;
+
+static void startIoThreads()
+{
+  ioThreads.start(AsyncIo::IO_THREADS);
+}
+
+// once an io_uring could not be set up, the others use the threads
+static bool uringFailed = false;
+
+// the AsyncIo of each thread, destroyed by the key when the thread exits
+static __thread AsyncIo* threadIo = NULL;
+static pthread_key_t     threadIoKey;
+static pthread_once_t    threadIoOnce = PTHREAD_ONCE_INIT;
+
+AsyncIo::AsyncIo()
+{
+  backend = defaultBackend;
+  inFlight = 0;
+  unsubmitted = 0;
+  ringFd = -1;
+  sqRing = cqRing = sqes = cqes = NULL;
+  sqSize = cqSize = sqesSize = 0;
+  sqTail = sqMask = sqArray = NULL;
+  cqHead = cqTail = cqMask = NULL;
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&ready, NULL);
+}
+
+AsyncIo::~AsyncIo()
+{
+  Request* r;
+
+  // the buffers of the reads in flight must not be written after this
+  while (inFlight > 0 && complete(r) == 0);
+
+  closeRing();
+  pthread_cond_destroy(&ready);
+  pthread_mutex_destroy(&lock);
+}
+
+static void destroyThreadIo(void* arg)
+{
+  delete (AsyncIo*) arg;
+}
+
+static void createThreadIoKey()
+{
+  pthread_key_create(&threadIoKey, destroyThreadIo);
+}
+
+AsyncIo& AsyncIo::forThread()
+{
+  if (threadIo == NULL) {
+    pthread_once(&threadIoOnce, createThreadIoKey);
+    threadIo = new AsyncIo;
+    pthread_setspecific(threadIoKey, threadIo);
+  }
+  return *threadIo;
+}
+
+void AsyncIo::setBackend(Backend b)
+{
+  defaultBackend = b;
+}
+
+const char* AsyncIo::backendName(Backend b)
+{
+  return (b == URING_BACKEND) ? "uring" : "threads";
+}
+
+void AsyncIo::openRing()
+{
+#ifdef HAS_IO_URING
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof(p));
+  if (!__atomic_load_n(&uringFailed, __ATOMIC_RELAXED)) {
+    ringFd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &p);
+  }
+  if (ringFd >= 0) {
+    // the two rings share one mapping when the kernel allows it
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (single && cqSize > sqSize) sqSize = cqSize;
+    sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    sqRing = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) sqRing = NULL;
+    if (single) {
+      cqRing = sqRing;
+    } else {
+      cqRing = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+      if (cqRing == MAP_FAILED) cqRing = NULL;
+    }
+    sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) sqes = NULL;
+
+    if (sqRing != NULL && cqRing != NULL && sqes != NULL) {
+      char* sq = (char*) sqRing;
+      char* cq = (char*) cqRing;
+      sqTail = (unsigned*) (sq + p.sq_off.tail);
+      sqMask = (unsigned*) (sq + p.sq_off.ring_mask);
+      sqArray = (unsigned*) (sq + p.sq_off.array);
+      cqHead = (unsigned*) (cq + p.cq_off.head);
+      cqTail = (unsigned*) (cq + p.cq_off.tail);
+      cqMask = (unsigned*) (cq + p.cq_off.ring_mask);
+      cqes = cq + p.cq_off.cqes;
+      return;
+    }
+    closeRing();
+  }
+  __atomic_store_n(&uringFailed, true, __ATOMIC_RELAXED);
+#endif
+  backend = THREAD_BACKEND;
+}
+
+void AsyncIo::closeRing()
+{
+#ifdef HAS_IO_URING
+  if (sqes != NULL) munmap(sqes, sqesSize);
+  if (cqRing != NULL && cqRing != sqRing) munmap(cqRing, cqSize);
+  if (sqRing != NULL) munmap(sqRing, sqSize);
+  if (ringFd >= 0) ::close(ringFd);
+#endif
+  sqRing = cqRing = sqes = NULL;
+  ringFd = -1;
+}
+
+RC AsyncIo::read(Request* r)
+{
+  if (inFlight >= QUEUE_DEPTH) return RC_INVALID_PARAMETER;
+  if (backend == URING_BACKEND && ringFd < 0) openRing();
+
+  r->owner = this;
+  r->result = 0;
+  inFlight++;
+
+#ifdef HAS_IO_URING
+  if (backend == URING_BACKEND) {
+    // only this thread moves the tail, and the kernel takes the entries
+    // up to it when complete() enters it. the ring holds QUEUE_DEPTH
+    // entries, so there is always a free one.
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*) sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = r->fd;
+    sqe->off = r->offset;
+    sqe->addr = (unsigned long) r->iov;
+    sqe->len = r->iovcnt;
+    sqe->user_data = (unsigned long) r;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    unsubmitted++;
+    return 0;
+  }
+#endif
+
+#ifdef RWF_NOWAIT
+  // a read of pages that are all in the kernel's page cache is done at
+  // once, without passing it to a thread
+  ssize_t total = 0;
+  for (int i = 0; i < r->iovcnt; i++) total += r->iov[i].iov_len;
+  if (::preadv2(r->fd, r->iov, r->iovcnt, r->offset, RWF_NOWAIT) == total) {
+    r->result = total;
+    finish(r);
+    return 0;
+  }
+#endif
+
+  // without I/O threads, the read is done before read() returns
+  pthread_once(&ioThreadsOnce, startIoThreads);
+  if (ioThreads.submit(readTask, r) < 0) readTask(r);
+  return 0;
+}
+
+RC AsyncIo::complete(Request*& r)
+{
+  if (inFlight == 0) return RC_END_OF_TREE;
+
+#ifdef HAS_IO_URING
+  if (backend == URING_BACKEND) {
+    for (;;) {
+      // the reads taken back from the kernel are done already
+      pthread_mutex_lock(&lock);
+      bool taken = !done.empty();
+      pthread_mutex_unlock(&lock);
+      if (taken) break;
+
+      unsigned head = *cqHead;
+      if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqe = (struct io_uring_cqe*) cqes + (head & *cqMask);
+        r = (Request*) (unsigned long) cqe->user_data;
+        r->result = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        inFlight--;
+        return 0;
+      }
+
+      // pass the new reads to the kernel and wait for one of them
+      int n = syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+
+        // the buffers of the reads must not be given back while the
+        // kernel may still write them, so the reads it does not take
+        // are done here. those it took can only be waited for.
+        if (unsubmitted > 0) {
+          readUnsubmitted();
+          continue;
+        }
+        return RC_FILE_READ_FAILED;
+      }
+      unsubmitted -= n;
+    }
+  }
+#endif
+
+  pthread_mutex_lock(&lock);
+  while (done.empty()) pthread_cond_wait(&ready, &lock);
+  r = done.front();
+  done.pop_front();
+  pthread_mutex_unlock(&lock);
+
+  inFlight--;
+  return 0;
+}
+
+void AsyncIo::readUnsubmitted()
+{
+#ifdef HAS_IO_URING
+  // the kernel takes the entries in order, so those it has not taken
+  // are the last ones, and the tail is moved back over them
+  unsigned tail = *sqTail;
+  for (int i = unsubmitted; i > 0; i--) {
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*) sqes + ((tail - i) & *sqMask);
+    Request* r = (Request*) (unsigned long) sqe->user_data;
+    ssize_t n = ::preadv(r->fd, r->iov, r->iovcnt, r->offset);
+    r->result = (n < 0) ? -errno : n;
+    finish(r);
+  }
+  __atomic_store_n(sqTail, tail - unsubmitted, __ATOMIC_RELEASE);
+  unsubmitted = 0;
+#endif
+}
+
+void AsyncIo::finish(Request* r)
+{
+  pthread_mutex_lock(&lock);
+  done.push_back(r);
+  pthread_cond_signal(&ready);
+  pthread_mutex_unlock(&lock);
+}
+
+void AsyncIo::readTask(void* arg)
+{
+  Request* r = (Request*) arg;
+
+  ssize_t n = ::preadv(r->fd, r->iov, r->iovcnt, r->offset);
+  r->result = (n < 0) ? -errno : n;
+  r->owner->finish(r);
+}
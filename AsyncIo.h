@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <deque>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include "Bruinbase.h"
+
+/**
+ * Reads that are in flight together. A thread starts reads with read()
+ * and takes them back with complete() as they finish, in the order the
+ * disk returns them rather than the order they were started in.
+ * The reads go through an io_uring of the Linux kernel, set up on the
+ * first read; they are passed to the kernel in one call when complete()
+ * is called. Where io_uring cannot be used, or after setBackend(
+ * THREAD_BACKEND), a pool of I/O threads shared by the process issues
+ * them with preadv() instead; a read whose data is already in the
+ * kernel's page cache is then done by read() itself.
+ * An AsyncIo belongs to one thread. It waits for its reads in flight
+ * when it is destroyed. forThread() keeps one for each thread, so that
+ * the ring is set up once per thread rather than once per scan.
+ */
+class AsyncIo {
+ public:
+  /**
+   * the ways the reads are issued
+   */
+  enum Backend { URING_BACKEND, THREAD_BACKEND };
+
+  static const int QUEUE_DEPTH = 32;  // the most reads in flight at once
+  static const int IO_THREADS = 8;    // the threads of THREAD_BACKEND
+
+  /**
+   * a read of up to two buffers from a file
+   */
+  struct Request {
+    int          fd;      // the file to read
+    off_t        offset;  // where the read starts in the file
+    struct iovec iov[2];  // the buffers to read into
+    int          iovcnt;  // the number of buffers, 1 or 2
+    void*        data;    // for the caller
+    ssize_t      result;  // set when complete: the bytes read, or -errno
+    AsyncIo*     owner;   // set by read()
+  };
+
+  AsyncIo();
+  ~AsyncIo();
+
+  /**
+   * start a read. at most QUEUE_DEPTH reads may be in flight.
+   * @param r[IN] the read; it must stay in place until it is complete
+   * @return error code. 0 if no error, RC_INVALID_PARAMETER if
+   *         QUEUE_DEPTH reads are in flight
+   */
+  RC read(Request* r);
+
+  /**
+   * wait for a read to finish. reads that the kernel refuses to take are
+   * done by preadv() instead, so that every read started is completed.
+   * @param r[OUT] the read that finished, with its result set
+   * @return error code. 0 if no error, RC_END_OF_TREE if no read is in
+   *         flight, RC_FILE_READ_FAILED if the kernel cannot be waited
+   *         for; the reads it took are still in flight then
+   */
+  RC complete(Request*& r);
+
+  /**
+   * @return the number of reads in flight
+   */
+  int pending() const { return inFlight; }
+
+  /**
+   * @return the backend of the reads, which is THREAD_BACKEND once the
+   *         io_uring could not be set up
+   */
+  Backend getBackend() const { return backend; }
+
+  /**
+   * @return the AsyncIo of the calling thread, created on its first use
+   *         with the backend set then and destroyed when the thread exits.
+   *         a caller must complete all the reads it started before it
+   *         returns.
+   */
+  static AsyncIo& forThread();
+
+  /**
+   * set the backend of the AsyncIo created from now on. URING_BACKEND,
+   * the default, falls back to THREAD_BACKEND where io_uring cannot be
+   * used.
+   * @param b[IN] the backend
+   */
+  static void setBackend(Backend b);
+
+  /**
+   * @param b[IN] a backend
+   * @return the name of the backend: "uring" or "threads"
+   */
+  static const char* backendName(Backend b);
+
+ private:
+  AsyncIo(const AsyncIo&);             // not copyable: owns the ring
+  AsyncIo& operator=(const AsyncIo&);
+
+  /**
+   * set up the io_uring, or fall back to the threads if it fails.
+   */
+  void openRing();
+
+  /**
+   * unmap and close the io_uring.
+   */
+  void closeRing();
+
+  /**
+   * take back the reads that were not passed to the kernel and do them
+   * with preadv(), queuing them as done.
+   */
+  void readUnsubmitted();
+
+  /**
+   * queue a read as done and wake the thread waiting for it.
+   * @param r[IN] the read
+   */
+  void finish(Request* r);
+
+  /**
+   * the task of an I/O thread: read a request and queue it as done.
+   * @param arg[IN] the request
+   */
+  static void readTask(void* arg);
+
+  Backend backend;      // the backend of the reads
+  int     inFlight;     // the reads started and not taken back
+  int     unsubmitted;  // the reads not yet passed to the kernel
+
+  // the io_uring, when backend is URING_BACKEND and ringFd >= 0
+  int       ringFd;
+  void*     sqRing;     // the mapped submission ring
+  size_t    sqSize;
+  void*     cqRing;     // the mapped completion ring; sqRing if shared
+  size_t    cqSize;
+  void*     sqes;       // the mapped submission entries
+  size_t    sqesSize;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void*     cqes;
+
+  // the reads done by the I/O threads, or by readUnsubmitted()
+  std::deque<Request*> done;
+  pthread_mutex_t lock;  // protects done
+  pthread_cond_t  ready; // signaled when a read is done
+
+  static Backend defaultBackend;  // the backend of a new AsyncIo
+};
+
+#endif // ASYNCIO_H
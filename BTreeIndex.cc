@@ -7,8 +7,12 @@
  * @date 3/24/2008
  */
  
+#include <cstring>
+#include <climits>
+#include <algorithm>
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
+#include "SkipList.h"
 
 using namespace std;
 
@@ -19,6 +23,99 @@ BTreeIndex::BTreeIndex()
 {
     rootPid = -1;
     treeHeight = 0;
+    indexedEnd.pid = indexedEnd.sid = 0;
+    loading = false;
+    pf.setKind(PageFile::INDEX_FILE);
+
+    pthread_rwlock_init(&rootLatch, NULL);
+    pthread_mutex_init(&smoLock, NULL);
+    pthread_mutex_init(&latchesLock, NULL);
+
+    nextPid = 0;
+    lsm = false;
+    mem = new SkipList;
+    imm = NULL;
+    compactorRunning = false;
+    pthread_mutex_init(&allocLock, NULL);
+    pthread_rwlock_init(&lsmLatch, NULL);
+    pthread_mutex_init(&flushLock, NULL);
+    pthread_mutex_init(&compactLock, NULL);
+    pthread_mutex_init(&compactorLock, NULL);
+    pthread_cond_init(&compactorCond, NULL);
+}
+
+/*
+ * BTreeIndex destructor
+ */
+BTreeIndex::~BTreeIndex()
+{
+    stopCompactor();
+    delete mem;
+    delete imm;
+
+    pthread_cond_destroy(&compactorCond);
+    pthread_mutex_destroy(&compactorLock);
+    pthread_mutex_destroy(&compactLock);
+    pthread_mutex_destroy(&flushLock);
+    pthread_rwlock_destroy(&lsmLatch);
+    pthread_mutex_destroy(&allocLock);
+
+    for (size_t i = 0; i < latches.size(); i++) {
+        pthread_rwlock_destroy(latches[i]);
+        delete latches[i];
+    }
+
+    pthread_mutex_destroy(&latchesLock);
+    pthread_mutex_destroy(&smoLock);
+    pthread_rwlock_destroy(&rootLatch);
+}
+
+/*
+ * Return the latch of the node stored at page pid.
+ * @param pid[IN] the PageId of the node
+ * @return the reader/writer latch of the node
+ */
+pthread_rwlock_t* BTreeIndex::latch(PageId pid)
+{
+    pthread_rwlock_t* l;
+
+    pthread_mutex_lock(&latchesLock);
+
+    // Latches are created on first use; the file only grows
+    while ((int) latches.size() <= pid) {
+        l = new pthread_rwlock_t;
+        pthread_rwlock_init(l, NULL);
+        latches.push_back(l);
+    }
+    l = latches[pid];
+
+    pthread_mutex_unlock(&latchesLock);
+    return l;
+}
+
+/*
+ * Release all latches in held.
+ * @param held[IN/OUT] the latches held by the caller; emptied
+ */
+void BTreeIndex::releaseLatches(vector<pthread_rwlock_t*>& held)
+{
+    for (size_t i = 0; i < held.size(); i++)
+        pthread_rwlock_unlock(held[i]);
+    held.clear();
+}
+
+/*
+ * Release all latches in held except the last one, which belongs to a
+ * node that will absorb any change made below it.
+ * @param held[IN/OUT] the latches held by the caller, top-down
+ */
+void BTreeIndex::releaseAncestors(vector<pthread_rwlock_t*>& held)
+{
+    pthread_rwlock_t* last = held.back();
+
+    held.pop_back();
+    releaseLatches(held);
+    held.push_back(last);
 }
 
 /*
@@ -30,38 +127,67 @@ BTreeIndex::BTreeIndex()
  */
 RC BTreeIndex::open(const string& indexname, char mode)
 {
-    /* Another way to open an index file:
-     * 
-     * Use RecordId (size ~ 8 bytes) instead of data[PageFile::PAGE_SIZE]
-     * (PAGE_SIZE ~ 1024 bytes) as shown in BTreeIndex::close() --> this
-     * might save some memory
-     */
-
     RC rc;
     // Open index file
     if ((rc = pf.open(indexname, mode)) != 0)
        return rc;
 
-    // Load root Pid and the tree height
-    char data[PageFile::PAGE_SIZE];
-    if (pf.endPid() == 0) {   // empty file
+    // Load root Pid, the tree height and the end of the table indexed
+    // from the metadata of the last commit. Nodes written after it are
+    // not reachable from that root unless they were updated in place.
+    char data[PageFile::META_SIZE];
+    Meta meta;
+    int size = pf.readMeta(data);
+    memset(&meta, 0, sizeof(Meta));
+    if (size == sizeof(Meta)) {
+        memcpy(&meta, data, size);
+    } else {
         // Empty tree
-        rootPid = -1;
-        treeHeight = 0;
+        meta.rootPid = -1;
+        meta.treeHeight = 0;
+        meta.indexedEnd.pid = meta.indexedEnd.sid = 0;
+        meta.loading = 0;
+    }
+    rootPid = meta.rootPid;
+    treeHeight = meta.treeHeight;
+    indexedEnd = meta.indexedEnd;
+    loading = (meta.loading != 0);
 
-        // Put a placeholder for rootPid and treeHeight
-        if ((rc = pf.write(0, data)) != 0) {
-            return rc;
-        }
-    } else {
-        // Try to read previously stored data
-        if ((rc = pf.read(0, data)) != 0) {
+    // Put a placeholder at page 0, so that no node has PageId 0, which
+    // ends the chain of leaf nodes
+    if (pf.endPid() == 0) {
+        char page[PageFile::PAGE_SIZE];
+        memset(page, 0, PageFile::PAGE_SIZE);
+        if ((rc = pf.write(0, page)) != 0) {
             return rc;
         }
+    }
+    nextPid = pf.endPid();
+    freePages.clear();
+    pendingFree.clear();
+    retired.clear();
 
-        // Assign rootPid and treeHeight
-        rootPid = *((PageId *) data);
-        treeHeight = *((int *) (data + sizeof(PageId)));
+    // A log-structured index starts with an empty memtable; what the one
+    // before held is added again from the log of the table
+    delete mem;
+    delete imm;
+    mem = new SkipList;
+    imm = NULL;
+    lsm = (meta.lsm != 0);
+    if (meta.runCount < 0 || meta.runCount > MAX_RUNS)
+        meta.runCount = 0;
+    runs.assign(meta.runs, meta.runs + meta.runCount);
+    if (lsm) {
+        if ((rc = findFreePages()) != 0)
+            return rc;
+        if (mode == 'w' || mode == 'W')
+            startCompactor();
+    } else if ((mode == 'w' || mode == 'W') && !loading) {
+        // The trees replaced before the index was closed, and the nodes
+        // written after the last commit, are free. A tree that a LOAD
+        // left half updated is rebuilt instead.
+        if ((rc = findFreePages()) != 0)
+            return rc;
     }
 
     return 0;
@@ -73,20 +199,131 @@ RC BTreeIndex::open(const string& indexname, char mode)
  */
 RC BTreeIndex::close()
 {
-    // Prepare root Pid and the tree height
-    char dataToStore[PageFile::PAGE_SIZE];
-    *((PageId *) dataToStore) = rootPid;
-    *((int *) (dataToStore + sizeof(PageId))) = treeHeight;
+    char data[PageFile::META_SIZE];
+    Meta meta;
+    RC   rc = 0;
+
+    // The memtable of a log-structured index is written to a run and
+    // committed with the other runs
+    if (lsm) {
+        stopCompactor();
+        rc = flushMemtable(true);
+    }
+
+    // Commit root Pid and the tree height if they changed
+    getMeta(meta);
+    if (rc == 0 && (pf.readMeta(data) != sizeof(Meta) || memcmp(&meta, data, sizeof(Meta)) != 0))
+        rc = pf.commit(&meta, sizeof(Meta));
+
+    lsm = false;
+    runs.clear();
+
+    RC ret = pf.close();
+    return (rc != 0) ? rc : ret;
+}
+
+/*
+ * Return the height of the tree, which is the number of nodes read by
+ * locate() to reach a leaf node.
+ * @return the height of the tree. 0 if the tree is empty
+ */
+int BTreeIndex::getTreeHeight()
+{
+    // A lookup descends every run of a log-structured index
+    if (lsm) {
+        int height = 0;
+        pthread_rwlock_rdlock(&lsmLatch);
+        for (size_t i = 0; i < runs.size(); i++)
+            height += runs[i].treeHeight;
+        pthread_rwlock_unlock(&lsmLatch);
+        return height;
+    }
+
+    pthread_rwlock_rdlock(&rootLatch);
+    int height = treeHeight;
+    pthread_rwlock_unlock(&rootLatch);
+    return height;
+}
+
+/*
+ * Write all dirty index pages back to the disk.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::flush()
+{
+    return pf.flush();
+}
+
+/*
+ * Commit the index as it is, with the end of the table it covers and
+ * the loading flag of the last commit.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::sync()
+{
+    return commit(indexedEnd, loading);
+}
+
+/*
+ * Force all index pages to stable storage, then commit root Pid, the tree
+ * height, the end of the table the index covers and the loading flag.
+ * @param end[IN] the end RecordId of the table indexed
+ * @param loading[IN] whether a LOAD is about to update the nodes in place
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::commit(const RecordId& end, bool loading)
+{
+    Meta meta;
+    RC   rc;
+    vector<PageId> released;
+
+    // The entries of the memtable of a log-structured index are covered
+    // by the commit, so they are written first. The pages of the runs
+    // merged away, and of the trees released, before the root and the
+    // runs are read for the commit become free once it is on the disk.
+    if (lsm && (rc = flushMemtable(true)) != 0)
+        return rc;
+    pthread_mutex_lock(&allocLock);
+    released.swap(pendingFree);
+    pthread_mutex_unlock(&allocLock);
 
-    /* Another way to do this:
-     * 
-    RecordId dataToStore = { rootPid, treeHeight };
-     */
+    getMeta(meta);
+    meta.indexedEnd = end;
+    meta.loading = loading ? 1 : 0;
+    rc = pf.commit(&meta, sizeof(Meta));
 
-    // Store data
-    pf.write(0, dataToStore);
+    pthread_mutex_lock(&allocLock);
+    vector<PageId>& to = (rc == 0) ? freePages : pendingFree;
+    to.insert(to.end(), released.begin(), released.end());
+    pthread_mutex_unlock(&allocLock);
+    if (rc != 0)
+        return rc;
+
+    indexedEnd = end;
+    this->loading = loading;
+    return 0;
+}
+
+/*
+ * Fill the metadata of the index as it is now.
+ * @param meta[OUT] the metadata
+ */
+void BTreeIndex::getMeta(Meta& meta)
+{
+    memset(&meta, 0, sizeof(Meta));
+    pthread_rwlock_rdlock(&rootLatch);
+    meta.rootPid = rootPid;
+    meta.treeHeight = treeHeight;
+    pthread_rwlock_unlock(&rootLatch);
+    meta.indexedEnd = indexedEnd;
+    meta.loading = loading ? 1 : 0;
 
-    return pf.close();
+    pthread_rwlock_rdlock(&lsmLatch);
+    meta.lsm = lsm ? 1 : 0;
+    meta.runCount = runs.size();
+    for (size_t i = 0; i < runs.size(); i++)
+        meta.runs[i] = runs[i];
+    pthread_rwlock_unlock(&lsmLatch);
 }
 
 /*
@@ -105,14 +342,15 @@ RC BTreeIndex::insertAtRoot(int key, const RecordId& rid)
     if ((rc = root.insert(key, rid)) != 0)
         return rc;
 
-    // Update private vars
-    rootPid = pf.endPid();
-    treeHeight = 1;
-
     // Write node (contents)
-    if ((rc = root.write(rootPid, pf)) != 0)
+    PageId pid = newPage();
+    if ((rc = root.write(pid, pf)) != 0)
         return rc;
 
+    // Update private vars
+    rootPid = pid;
+    treeHeight = 1;
+
     return 0;
 }
 
@@ -123,19 +361,27 @@ RC BTreeIndex::insertAtRoot(int key, const RecordId& rid)
  * @param rid[IN] the RecordId for the record being inserted into the index
  * @param pid[IN] pid of the node where the search should begin
  * @param newNodeKey[OUT] the first key of the newly inserted node in case of an
- * overflow, otherwise -1
- * @param newNodePid[OUT] newly inserted node's pid in case of an overflow
+ * overflow
+ * @param newNodePid[OUT] newly inserted node's pid in case of an overflow,
+ * otherwise -1
+ * @param held[IN/OUT] exclusive latches held on the path, ending with pid's
  * @return error code. 0 if no error
  */
 RC BTreeIndex::insertAtLeafNode(int key, const RecordId& rid, PageId pid,
-                                int& newNodeKey, PageId& newNodePid)
+                                int& newNodeKey, PageId& newNodePid,
+                                vector<pthread_rwlock_t*>& held)
 {
     RC rc;
-    newNodeKey = -1;
+    newNodePid = -1;
     BTLeafNode node;
 
     // Read the content of the node from pid in pf
-    node.read(pid, pf);
+    if ((rc = node.read(pid, pf)) != 0)
+        return rc;
+
+    // Without a split nothing above this node changes
+    if (node.getKeyCount() < node.getMaxKeyCount())
+        releaseAncestors(held);
 
     // Insert data into the node
     rc = node.insert(key, rid);
@@ -143,18 +389,24 @@ RC BTreeIndex::insertAtLeafNode(int key, const RecordId& rid, PageId pid,
     if (rc == RC_NODE_FULL) {
         // Insert data into a new node
         BTLeafNode newNode;
-        if ((node.insertAndSplit(key, rid, newNode, newNodeKey)) != 0)
+        if ((rc = node.insertAndSplit(key, rid, newNode, newNodeKey)) != 0)
             return rc;
 
-        newNodePid = pf.endPid();   // new node's future pid
+        newNodePid = newPage();     // new node's pid
 
         // Update node pointers
-        newNode.setNextNodePtr(node.getNextNodePtr());
+        PageId nextPid = node.getNextNodePtr();
+        newNode.setNextNodePtr(nextPid);
+        newNode.setPrevNodePtr(pid);
         node.setNextNodePtr(newNodePid);
 
         // Write node [contents]
         if ((rc = newNode.write(newNodePid, pf)) != 0)
             return rc;
+
+        // The new node now precedes the next node
+        if (nextPid > 0 && (rc = setPrevLeaf(nextPid, newNodePid)) != 0)
+            return rc;
     } else if (rc != 0) {
         return rc;
     }
@@ -174,12 +426,15 @@ RC BTreeIndex::insertAtLeafNode(int key, const RecordId& rid, PageId pid,
  * @param pid[IN] pid of the node where the search should begin
  * @param height[IN] the height of the pid node (e.g. root has height 1)
  * @param newNodeKey[OUT] the first key of the newly inserted node in case of an
- * overflow, otherwise -1
- * @param newNodePid[OUT] newly inserted node's pid in case of an overflow
+ * overflow
+ * @param newNodePid[OUT] newly inserted node's pid in case of an overflow,
+ * otherwise -1
+ * @param held[IN/OUT] exclusive latches held on the path, ending with pid's
  * @return error code. 0 if no error
  */
 RC BTreeIndex::insertAtNonLeafNode(int key, const RecordId& rid, PageId pid, int height,
-                                   int& newNodeKey, PageId& newNodePid)
+                                   int& newNodeKey, PageId& newNodePid,
+                                   vector<pthread_rwlock_t*>& held)
 {
     RC rc;
     int childIndex;
@@ -187,32 +442,40 @@ RC BTreeIndex::insertAtNonLeafNode(int key, const RecordId& rid, PageId pid, int
     BTNonLeafNode node;
 
     // Read the content of the node from pid in pf and obtain child's pid
-    node.read(pid, pf);
+    if ((rc = node.read(pid, pf)) != 0)
+        return rc;
     node.locateChildPtr(key, childIndex);
     node.readEntry(childIndex, childPid);
 
+    // A node with room for one more key absorbs a split of its child
+    if (node.getKeyCount() < node.getMaxKeyCount())
+        releaseAncestors(held);
+
+    pthread_rwlock_wrlock(latch(childPid));
+    held.push_back(latch(childPid));
+
     // Check if we reached the leaf node
     if (height + 1 == treeHeight) {
-        if ((rc = insertAtLeafNode(key, rid, childPid, newNodeKey, newNodePid)) != 0)
+        if ((rc = insertAtLeafNode(key, rid, childPid, newNodeKey, newNodePid, held)) != 0)
             return rc;
     } else {
-        if ((rc = insertAtNonLeafNode(key, rid, childPid, height + 1, newNodeKey, newNodePid)) != 0)
+        if ((rc = insertAtNonLeafNode(key, rid, childPid, height + 1, newNodeKey, newNodePid, held)) != 0)
             return rc;
     }
 
     // Check for overflows down the tree
-    if (newNodeKey != -1) {
+    if (newNodePid != -1) {
         // Try to insert new node's information into the current node
         rc = node.insert(newNodeKey, newNodePid);
         if (rc == 0) {
-            newNodeKey = -1;
+            newNodePid = -1;
         } else if (rc == RC_NODE_FULL) {
             // Insert data into a new node
             BTNonLeafNode newNode;
-            if ((node.insertAndSplit(newNodeKey, newNodePid, newNode, newNodeKey)) != 0)
+            if ((rc = node.insertAndSplit(newNodeKey, newNodePid, newNode, newNodeKey)) != 0)
                 return rc;
 
-            newNodePid = pf.endPid();   // new node's future pid
+            newNodePid = newPage();     // new node's pid
 
             // Write node [contents]
             if ((rc = newNode.write(newNodePid, pf)) != 0)
@@ -237,134 +500,2105 @@ RC BTreeIndex::insertAtNonLeafNode(int key, const RecordId& rid, PageId pid, int
  */
 RC BTreeIndex::insert(int key, const RecordId& rid)
 {
-    // Add a root node if the tree is empty
-    if (treeHeight == 0) {
-        return insertAtRoot(key, rid);
+    RC rc;
+
+    if (lsm)
+        return put(key, rid, false);
+
+    // Most inserts fit into their leaf and latch nothing else exclusively
+    if ((rc = insertOptimistic(key, rid)) != RC_NODE_FULL)
+        return rc;
+
+    // Otherwise redo the insert, splitting nodes on the way back up
+    pthread_mutex_lock(&smoLock);
+    rc = insertPessimistic(key, rid);
+    pthread_mutex_unlock(&smoLock);
+
+    return rc;
+}
+
+/*
+ * Build the index from (key, RecordId) pairs in ascending key order.
+ * @param next[IN] the function that returns the pairs
+ * @param arg[IN] the first argument of next()
+ * @return error code. 0 if no error, RC_INVALID_FILE_MODE if the index
+ *         is not empty
+ */
+RC BTreeIndex::bulkLoad(EntrySource next, void* arg)
+{
+    RC rc;
+    PageId root;
+    int height, count;
+
+    // A log-structured index takes the pairs as its first run
+    if (lsm) {
+        pthread_rwlock_rdlock(&lsmLatch);
+        bool empty = runs.empty() && mem->size() == 0 && imm == NULL;
+        pthread_rwlock_unlock(&lsmLatch);
+        return empty ? merge(next, arg) : RC_INVALID_FILE_MODE;
     }
 
+    pthread_mutex_lock(&smoLock);
+    if (getTreeHeight() != 0) {
+        rc = RC_INVALID_FILE_MODE;
+    } else if ((rc = build(next, arg, root, height, count)) == 0 && count > 0) {
+        pthread_rwlock_wrlock(&rootLatch);
+        rootPid = root;
+        treeHeight = height;
+        pthread_rwlock_unlock(&rootLatch);
+    }
+    pthread_mutex_unlock(&smoLock);
+
+    return rc;
+}
+
+/*
+ * The state of merge() on a B+tree: the pairs still to add, and the copies
+ * of the leaf nodes they go to. A full copy is only written once the next
+ * one has entries, and the last one once the leaf node after it is known.
+ */
+struct PathMerge {
+    BTreeIndex::EntrySource next;     // the pairs to add
+    void*       arg;
+    RC          nextRc;     // 0 if key and rid hold the next pair to add
+    int         key;
+    RecordId    rid;
+    BTLeafNode  leaves[2];
+    BTLeafNode* prev;       // the full copy before cur, not yet written, or NULL
+    BTLeafNode* cur;        // the copy being filled, NULL if there is none
+    PageId      prevPid;
+    PageId      curPid;
+    PageId      oldNext;    // the next sibling of the leaf node that cur replaces
+    vector<PageId> replaced;                  // the nodes of the old tree that were copied
+    vector<pair<PageId, PageId> > nextLinks;  // leaf nodes kept and their new next siblings
+    vector<pair<PageId, PageId> > prevLinks;  // leaf nodes kept and their new previous siblings
+};
+
+// return the pairs of a merge into an empty tree, for build()
+static RC pathEntry(void* arg, int& key, RecordId& rid)
+{
+    PathMerge* m = (PathMerge*) arg;
+
+    if (m->nextRc != 0)
+        return m->nextRc;
+    key = m->key;
+    rid = m->rid;
+    m->nextRc = m->next(m->arg, m->key, m->rid);
+    return 0;
+}
+
+/*
+ * Add sorted pairs by copying the paths from the root to the leaf nodes
+ * they go to, and make the new root the index in one step.
+ * @param next[IN] the function that returns the new pairs
+ * @param arg[IN] the first argument of next()
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::merge(EntrySource next, void* arg)
+{
+    PathMerge* m;
+    PageId root;
+    int height, count;
     RC rc;
-    int newNodeKey;
-    PageId newNodePid;
-    if (treeHeight == 1) {
-        if ((rc = insertAtLeafNode(key, rid, rootPid, newNodeKey, newNodePid)) != 0)
+
+    // A log-structured index adds the pairs as a new run, after the
+    // memtable is written out so that the runs stay in the order of
+    // their pairs; the runs are merged later in the background
+    if (lsm) {
+        Run run;
+        if ((rc = flushMemtable(true)) != 0)
             return rc;
+        pthread_mutex_lock(&flushLock);
+        if ((rc = makeRoom()) == 0 &&
+            (rc = build(next, arg, run.rootPid, run.treeHeight, run.count)) == 0 && run.count > 0) {
+            pthread_rwlock_wrlock(&lsmLatch);
+            runs.push_back(run);
+            pthread_rwlock_unlock(&lsmLatch);
+            wakeCompactor();
+        }
+        pthread_mutex_unlock(&flushLock);
+        return rc;
+    }
+
+    m = new PathMerge;
+    m->next = next;
+    m->arg = arg;
+    m->prev = m->cur = NULL;
+    m->prevPid = m->curPid = m->oldNext = 0;
+    m->nextRc = next(arg, m->key, m->rid);
+
+    pthread_mutex_lock(&smoLock);
+    pthread_rwlock_rdlock(&rootLatch);
+    root = rootPid;
+    height = treeHeight;
+    pthread_rwlock_unlock(&rootLatch);
+
+    vector<pair<int, PageId> > level;
+    if (m->nextRc != 0) {
+        rc = (m->nextRc == RC_END_OF_TREE) ? 0 : m->nextRc;
+    } else if (height == 0) {
+        rc = build(pathEntry, m, root, height, count);
+        if (rc == 0 && count > 0)
+            level.push_back(make_pair(0, root));
     } else {
-        if ((rc = insertAtNonLeafNode(key, rid, rootPid, 1, newNodeKey, newNodePid)) != 0)
-            return rc;
+        rc = mergeNode(*m, root, height, false, 0, level);
+        if (rc == 0 && m->cur != NULL)
+            rc = finishLeaf(*m, m->oldNext);
+        if (rc == 0 && m->nextRc != RC_END_OF_TREE)
+            rc = m->nextRc;
+
+        // A root that was split gets new levels on top
+        while (rc == 0 && level.size() > 1) {
+            vector<pair<int, PageId> > parents;
+            rc = writeParents(level, parents);
+            level.swap(parents);
+            height++;
+        }
+
+        // The leaf nodes next to the copies point to them only once every
+        // copy is written, so that scans crossing over find them whole
+        for (size_t i = 0; rc == 0 && i < m->nextLinks.size(); i++)
+            rc = setNextLeaf(m->nextLinks[i].first, m->nextLinks[i].second);
+        for (size_t i = 0; rc == 0 && i < m->prevLinks.size(); i++)
+            rc = setPrevLeaf(m->prevLinks[i].first, m->prevLinks[i].second);
     }
 
-    // Check for overflows down the tree
-    if (newNodeKey != -1) {
-        // Insert data into a new node
-        BTNonLeafNode root;
-        root.initializeRoot(rootPid, newNodeKey, newNodePid);
+    if (rc == 0 && !level.empty()) {
+        pthread_rwlock_wrlock(&rootLatch);
+        rootPid = level[0].second;
+        treeHeight = height;
+        pthread_rwlock_unlock(&rootLatch);
 
-        // Update private variables
-        rootPid = pf.endPid();   // new root's future pid
-        treeHeight += 1;
+        // Scans that started on the old tree may still read the copied
+        // nodes, so they are kept until releasePages()
+        pthread_mutex_lock(&allocLock);
+        retired.insert(retired.end(), m->replaced.begin(), m->replaced.end());
+        pthread_mutex_unlock(&allocLock);
+    }
+    pthread_mutex_unlock(&smoLock);
+    delete m;
 
-        // Write node [contents]
-        if ((rc = root.write(rootPid, pf)) != 0)
+    return rc;
+}
+
+/*
+ * Copy a node with the pairs of merge() below hi added to its subtree.
+ * @param m[IN/OUT] the state of the merge
+ * @param pid[IN] the node to copy
+ * @param height[IN] the height of the node (e.g. a leaf node has height 1)
+ * @param bounded[IN] whether hi bounds the keys of the subtree
+ * @param hi[IN] the key of the subtree after this one
+ * @param out[OUT] the first key and PageId of each copy are appended
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::mergeNode(PathMerge& m, PageId pid, int height, bool bounded, int hi,
+                         vector<pair<int, PageId> >& out)
+{
+    RC rc;
+    BTNonLeafNode node;
+    vector<pair<int, PageId> > children;
+
+    if (height == 1)
+        return mergeLeaf(m, pid, bounded, hi, out);
+
+    if ((rc = node.read(pid, pf)) != 0)
+        return rc;
+    m.replaced.push_back(pid);
+
+    // A child gets the pairs below the key of the child after it, like
+    // locateChildPtr() finds it. The children that get none are kept.
+    int count = node.getKeyCount();
+    for (int eid = -1; eid < count; eid++) {
+        PageId child;
+        int key = 0, childHi = hi;
+        bool childBounded = bounded;
+
+        node.readEntry(eid, child);
+        if (eid >= 0)
+            node.readKey(eid, key);
+        if (eid + 1 < count) {
+            node.readKey(eid + 1, childHi);
+            childBounded = true;
+        }
+
+        if (m.nextRc != 0 || (childBounded && m.key >= childHi)) {
+            children.push_back(make_pair(key, child));
+            continue;
+        }
+        size_t first = children.size();
+        if ((rc = mergeNode(m, child, height - 1, childBounded, childHi, children)) != 0)
             return rc;
+        children[first].first = key;    // the first copy keeps the key of the child
     }
 
-    return 0;
-}   
+    return writeParents(children, out);
+}
 
 /*
- * Find the leaf-node index entry whose key value is larger than or 
- * equal to searchKey, and output the location of the entry in IndexCursor.
- * IndexCursor is a "pointer" to a B+tree leaf-node entry consisting of
- * the PageId of the node and the SlotID of the index entry.
- * Note that, for range queries, we need to scan the B+tree leaf nodes.
- * For example, if the query is "key > 1000", we should scan the leaf
- * nodes starting with the key value 1000. For this reason,
- * it is better to return the location of the leaf node entry 
- * for a given searchKey, instead of returning the RecordId
- * associated with the searchKey directly.
- * Once the location of the index entry is identified and returned 
- * from this function, you should call readForward() to retrieve the
- * actual (key, rid) pair from the index.
- * @param key[IN] the key to find.
- * @param cursor[OUT] the cursor pointing to the first index entry
- *                    with the key value.
- * @return error code. 0 if no error.
+ * Copy a leaf node with the pairs of merge() below hi added to it.
+ * @param m[IN/OUT] the state of the merge
+ * @param pid[IN] the leaf node to copy
+ * @param bounded[IN] whether hi bounds the keys of the leaf node
+ * @param hi[IN] the key of the leaf node after this one
+ * @param out[OUT] the first key and PageId of each copy are appended
+ * @return error code. 0 if no error
  */
-RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
+RC BTreeIndex::mergeLeaf(PathMerge& m, PageId pid, bool bounded, int hi,
+                         vector<pair<int, PageId> >& out)
 {
-    // Start searching for data from the root node
-    PageId pid = rootPid;
-    
-    if (treeHeight <= 0)
-        return RC_NO_SUCH_RECORD;
+    RC rc;
+    BTLeafNode old;
+    int key, eid = 0;
+    RecordId rid;
 
-    // Traverse the tree until reaching a Non-Leaf node
-    for (int i = 0, eid; i < treeHeight - 1; i++) {
-        BTNonLeafNode node;
+    if ((rc = old.read(pid, pf)) != 0)
+        return rc;
+    m.replaced.push_back(pid);
 
-        // Read the content of the node from pid in pf
-        node.read(pid, pf);
+    // The copies follow those of the leaf node before, if it was copied
+    // as well; otherwise the leaf node before is pointed to them
+    PageId firstPid = newPage();
+    PageId prevPid = old.getPrevNodePtr();
+    if (m.cur != NULL && m.oldNext == pid) {
+        prevPid = m.curPid;
+        if ((rc = finishLeaf(m, firstPid)) != 0)
+            return rc;
+    } else {
+        if (m.cur != NULL && (rc = finishLeaf(m, m.oldNext)) != 0)
+            return rc;
+        if (prevPid > 0)
+            m.nextLinks.push_back(make_pair(prevPid, firstPid));
+    }
+    m.cur = &m.leaves[0];
+    memset(m.cur->getBuffer(), 0, PageFile::PAGE_SIZE);
+    m.cur->setPrevNodePtr(prevPid);
+    m.curPid = firstPid;
+    m.prev = NULL;
+    m.oldNext = old.getNextNodePtr();
 
-        // Obtain next node's pid
-        node.locateChildPtr(searchKey, eid);
-        node.readEntry(eid, pid);
+    // Fill the copies with the entries of the leaf node and the pairs
+    // below hi in key order, the entries first among equal keys
+    for (;;) {
+        bool fromOld = eid < old.getKeyCount();
+        bool fromNew = m.nextRc == 0 && (!bounded || m.key < hi);
+
+        if (fromOld)
+            old.readEntry(eid, key, rid);
+        if (fromNew && (!fromOld || m.key < key)) {
+            key = m.key;
+            rid = m.rid;
+            m.nextRc = m.next(m.arg, m.key, m.rid);
+        } else if (fromOld) {
+            eid++;
+        } else {
+            break;
+        }
+
+        if (m.cur->getKeyCount() == m.cur->getMaxKeyCount()) {
+            if (m.prev != NULL && (rc = m.prev->write(m.prevPid, pf)) != 0)
+                return rc;
+
+            PageId nextPid = newPage();
+            m.cur->setNextNodePtr(nextPid);
+            m.prev = m.cur;
+            m.prevPid = m.curPid;
+            m.cur = (m.cur == &m.leaves[0]) ? &m.leaves[1] : &m.leaves[0];
+            memset(m.cur->getBuffer(), 0, PageFile::PAGE_SIZE);
+            m.cur->setPrevNodePtr(m.prevPid);
+            m.curPid = nextPid;
+        }
+        if (m.cur->getKeyCount() == 0)
+            out.push_back(make_pair(key, m.curPid));
+        if ((rc = m.cur->insert(key, rid)) != 0)
+            return rc;
     }
 
-    BTLeafNode node;
+    // The last copy takes entries from the one before if it is too small
+    if (m.prev != NULL && m.cur->getKeyCount() < m.cur->getMinKeyCount()) {
+        if ((rc = m.prev->redistribute(*m.cur, out.back().first)) != 0)
+            return rc;
+    }
+    if (m.prev != NULL && (rc = m.prev->write(m.prevPid, pf)) != 0)
+        return rc;
+    m.prev = NULL;
 
-    // Read node data
-    node.read(pid, pf);
- 
-    // Set cursor's pid and eid
-    memset(&(cursor.pageBuf), 0, sizeof(PageFile::PAGE_SIZE));
-    cursor.pid = pid;
-    cursor.bufferPid = -1;
-    node.locate(searchKey, cursor.eid);
+    return 0;
+}
+
+/*
+ * Write the last leaf node that merge() copied.
+ * @param m[IN/OUT] the state of the merge
+ * @param nextPid[IN] the PageId of the next leaf node, 0 if none
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::finishLeaf(PathMerge& m, PageId nextPid)
+{
+    RC rc;
+
+    m.cur->setNextNodePtr(nextPid);
+    if ((rc = m.cur->write(m.curPid, pf)) != 0)
+        return rc;
+
+    // A leaf node of the old tree that is kept points back to the copy
+    if (nextPid > 0 && nextPid == m.oldNext)
+        m.prevLinks.push_back(make_pair(nextPid, m.curPid));
+    m.cur = NULL;
 
     return 0;
 }
 
 /*
- * Read the (key, rid) pair at the location specified by the index cursor,
- * and move foward the cursor to the next entry.
- * @param cursor[IN/OUT] the cursor pointing to a leaf-node index entry in the b+tree
- * @param key[OUT] the key stored at the index cursor location.
- * @param rid[OUT] the RecordId stored at the index cursor location.
+ * Let newPage() reuse the pages of the nodes that merge() replaced.
+ */
+void BTreeIndex::releasePages()
+{
+    char data[PageFile::META_SIZE];
+    Meta committed;
+
+    // Unless the last commit has the tree of the index, it has one of the
+    // trees replaced since, whose pages stay as they are until the next
+    // commit
+    if (pf.readMeta(data) > 0)
+        memcpy(&committed, data, sizeof(Meta));
+    else
+        committed.rootPid = -1;
+    pthread_rwlock_rdlock(&rootLatch);
+    bool current = (committed.rootPid == rootPid);
+    pthread_rwlock_unlock(&rootLatch);
+
+    pthread_mutex_lock(&allocLock);
+    vector<PageId>& to = current ? freePages : pendingFree;
+    to.insert(to.end(), retired.begin(), retired.end());
+    retired.clear();
+    pthread_mutex_unlock(&allocLock);
+}
+
+/*
+ * Write the nodes of a tree of sorted (key, RecordId) pairs to pages that
+ * no tree uses. The caller makes it the index, or a run of it.
+ * @param next[IN] the function that returns the pairs
+ * @param arg[IN] the first argument of next()
+ * @param root[OUT] the PageId of the root node, -1 if there are no pairs
+ * @param height[OUT] the height of the tree, 0 if there are no pairs
+ * @param count[OUT] the number of pairs
  * @return error code. 0 if no error
  */
-RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
+RC BTreeIndex::build(EntrySource next, void* arg, PageId& root, int& height, int& count)
 {
-    BTLeafNode node;
-    // Read the content of the node from pid in pf
-    if (cursor.pid <= 0 || cursor.pid >= pf.endPid())
-        return RC_INVALID_CURSOR;
+    RC rc;
+    int key;
+    RecordId rid;
+    BTLeafNode leaves[2];
+    BTLeafNode* prev = NULL;              // the full leaf before cur, not yet written
+    BTLeafNode* cur = &leaves[0];         // the leaf being filled
+    PageId prevPid = 0, curPid = 0;
+    vector<pair<int, PageId> > level;     // the first key and PageId of each node
 
-    if (cursor.bufferPid == cursor.pid)
-    {
-        memcpy(node.getBuffer(), cursor.pageBuf, PageFile::PAGE_SIZE);
+    root = -1;
+    height = count = 0;
+
+    // Fill the leaf nodes in order. A full leaf is only written once the
+    // next one has entries, so that its next node pointer is known.
+    while ((rc = next(arg, key, rid)) == 0) {
+        if (count == 0) {
+            curPid = newPage();
+        } else if (cur->getKeyCount() == cur->getMaxKeyCount()) {
+            if (prev != NULL && (rc = prev->write(prevPid, pf)) != 0)
+                goto exit_bulk;
+
+            PageId nextPid = newPage();
+            cur->setNextNodePtr(nextPid);
+            prev = cur;
+            prevPid = curPid;
+            cur = (cur == &leaves[0]) ? &leaves[1] : &leaves[0];
+            memset(cur->getBuffer(), 0, PageFile::PAGE_SIZE);
+            cur->setPrevNodePtr(prevPid);
+            curPid = nextPid;
+        }
+        if (cur->getKeyCount() == 0) {
+            level.push_back(make_pair(key, curPid));
+        }
+        if ((rc = cur->insert(key, rid)) != 0)
+            goto exit_bulk;
+        count++;
     }
-    else
-    {
-        cursor.bufferPid = cursor.pid;
-        node.read(cursor.pid, pf);
-        memcpy(cursor.pageBuf, node.getBuffer(), PageFile::PAGE_SIZE);
+    if (rc != RC_END_OF_TREE)
+        goto exit_bulk;
+    if (count == 0) {
+        rc = 0;
+        goto exit_bulk;
     }
-    // Read the (key, rid) pair from eid entry
-    node.readEntry(cursor.eid, key, rid);
 
-    // Check cursor
-    if (cursor.pid <= 0 || cursor.pid >= pf.endPid())
-        return RC_INVALID_CURSOR;
+    // The last leaf takes entries from the one before if it is too small
+    if (prev != NULL && cur->getKeyCount() < cur->getMinKeyCount()) {
+        if ((rc = prev->redistribute(*cur, level.back().first)) != 0)
+            goto exit_bulk;
+    }
+    if (prev != NULL && (rc = prev->write(prevPid, pf)) != 0)
+        goto exit_bulk;
+    if ((rc = cur->write(curPid, pf)) != 0)
+        goto exit_bulk;
 
-    // Move the cursor forward
-    cursor.eid++;
-    if (cursor.eid >= node.getKeyCount()) // End of node
-    {
-      // Move to the next node
-      cursor.pid = node.getNextNodePtr();
-      // Reset cursor
-      cursor.eid = 0;
+    // Build the nonleaf levels until one node is left: the root
+    height = 1;
+    while (level.size() > 1) {
+        vector<pair<int, PageId> > parents;
+        if ((rc = writeParents(level, parents)) != 0)
+            goto exit_bulk;
+        level.swap(parents);
+        height++;
+    }
+    root = level[0].second;
+    rc = 0;
+
+    exit_bulk:
+    return rc;
+}
+
+/*
+ * Write the nonleaf nodes of one level of a tree built bottom-up.
+ * @param children[IN] the first key and PageId of each node below
+ * @param parents[OUT] the first key and PageId of each node written
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::writeParents(const vector<pair<int, PageId> >& children,
+                            vector<pair<int, PageId> >& parents)
+{
+    RC rc;
+    BTNonLeafNode node;
+    int fanout = node.getMaxKeyCount() + 1;
+    int minChildren = node.getMinKeyCount() + 1;
+    size_t n = children.size();
+
+    for (size_t first = 0; first < n; ) {
+        size_t count = min((size_t) fanout, n - first);
+
+        // Leave the last node enough children
+        size_t rest = n - first - count;
+        if (rest > 0 && rest < (size_t) minChildren)
+            count = (n - first) / 2;
+
+        node.initializeRoot(children[first].second, children[first + 1].first, children[first + 1].second);
+        for (size_t i = first + 2; i < first + count; i++) {
+            if ((rc = node.insert(children[i].first, children[i].second)) != 0)
+                return rc;
+        }
+        PageId pid = newPage();
+        if ((rc = node.write(pid, pf)) != 0)
+            return rc;
+
+        parents.push_back(make_pair(children[first].first, pid));
+        first += count;
+    }
+
+    return 0;
+}
+
+/*
+ * Return a page that no tree uses: a page freed by a compaction that was
+ * committed since, or else one after the end of the file.
+ * @return the PageId of the page
+ */
+PageId BTreeIndex::newPage()
+{
+    PageId pid;
+
+    pthread_mutex_lock(&allocLock);
+    if (!freePages.empty()) {
+        pid = freePages.back();
+        freePages.pop_back();
+    } else {
+        // Pages may be handed out before they are written
+        pid = max(nextPid, pf.endPid());
+        nextPid = pid + 1;
+    }
+    pthread_mutex_unlock(&allocLock);
+
+    return pid;
+}
+
+/*
+ * Insert (key, RecordId) pair if it fits into its leaf node.
+ * @param key[IN] the key for the value inserted into the index
+ * @param rid[IN] the RecordId for the record being inserted into the index
+ * @return error code. 0 if no error, RC_NODE_FULL if the tree has to
+ *         be restructured
+ */
+RC BTreeIndex::insertOptimistic(int key, const RecordId& rid)
+{
+    RC rc;
+    PageId pid;
+    int height;
+    BTLeafNode node;
+
+    // An empty tree needs a root node
+    if (latchLeaf(key, false, true, pid, height) != 0)
+        return RC_NODE_FULL;
+
+    if ((rc = node.read(pid, pf)) == 0) {
+        // insert() leaves the node untouched when it is full
+        if ((rc = node.insert(key, rid)) == 0)
+            rc = node.write(pid, pf);
+    }
+
+    pthread_rwlock_unlock(latch(pid));
+    return rc;
+}
+
+/*
+ * Insert (key, RecordId) pair, splitting nodes as needed.
+ * The caller must hold smoLock.
+ * @param key[IN] the key for the value inserted into the index
+ * @param rid[IN] the RecordId for the record being inserted into the index
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::insertPessimistic(int key, const RecordId& rid)
+{
+    RC rc;
+    int newNodeKey;
+    PageId newNodePid;
+    vector<pthread_rwlock_t*> held;
+
+    // Latch the root pointer; it is released together with the root node
+    // unless the root may split
+    pthread_rwlock_wrlock(&rootLatch);
+    held.push_back(&rootLatch);
+
+    // Add a root node if the tree is empty
+    if (treeHeight == 0) {
+        rc = insertAtRoot(key, rid);
+        releaseLatches(held);
+        return rc;
+    }
+
+    pthread_rwlock_wrlock(latch(rootPid));
+    held.push_back(latch(rootPid));
+
+    if (treeHeight == 1) {
+        rc = insertAtLeafNode(key, rid, rootPid, newNodeKey, newNodePid, held);
+    } else {
+        rc = insertAtNonLeafNode(key, rid, rootPid, 1, newNodeKey, newNodePid, held);
+    }
+
+    // Check for overflows down the tree
+    if (rc == 0 && newNodePid != -1) {
+        // Insert data into a new node
+        BTNonLeafNode root;
+        root.initializeRoot(rootPid, newNodeKey, newNodePid);
+
+        // Write node [contents]
+        PageId pid = newPage();     // new root's pid
+        if ((rc = root.write(pid, pf)) == 0) {
+            // Update private variables
+            rootPid = pid;
+            treeHeight += 1;
+        }
+    }
+
+    releaseLatches(held);
+    return rc;
+}   
+
+/*
+ * Remove (key, RecordId) pair from the index.
+ * Nodes that fall below half full borrow entries from, or are merged
+ * with, a sibling, so the leaf chain stays dense.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+ *         is not in the index
+ */
+RC BTreeIndex::remove(int key, const RecordId& rid)
+{
+    RC rc;
+
+    // A log-structured index records the removal, which hides the pair
+    // in the runs before it
+    if (lsm)
+        return put(key, rid, true);
+
+    // Most removals leave their leaf at least half full
+    if ((rc = removeOptimistic(key, rid)) != RC_NODE_FULL)
+        return rc;
+
+    pthread_mutex_lock(&smoLock);
+    rc = removePessimistic(key, rid);
+    pthread_mutex_unlock(&smoLock);
+
+    return rc;
+}
+
+/*
+ * Remove (key, RecordId) pair if its leaf node stays at least half full.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair is
+ *         not in the index, RC_NODE_FULL if the tree has to be restructured
+ */
+RC BTreeIndex::removeOptimistic(int key, const RecordId& rid)
+{
+    RC rc;
+    PageId pid;
+    int height, eid, curKey = 0;
+    RecordId curRid;
+    BTLeafNode node;
+
+    if ((rc = latchLeaf(key, true, true, pid, height)) != 0)
+        return rc;
+
+    if ((rc = node.read(pid, pf)) != 0) {
+        pthread_rwlock_unlock(latch(pid));
+        return rc;
+    }
+
+    // Look for the pair among the duplicates of key in this leaf
+    if (node.locate(key, eid) != 0)
+        eid = node.getKeyCount();
+    for (; eid < node.getKeyCount(); eid++) {
+        node.readEntry(eid, curKey, curRid);
+        if (curKey != key || curRid == rid)
+            break;
+    }
+
+    if (eid < node.getKeyCount() && curKey == key) {
+        if (height == 1 || node.getKeyCount() > node.getMinKeyCount()) {
+            node.remove(eid);
+            rc = node.write(pid, pf);
+        } else {
+            rc = RC_NODE_FULL;      // the leaf would underflow
+        }
+    } else if (eid < node.getKeyCount() || node.getNextNodePtr() == 0) {
+        rc = RC_NO_SUCH_RECORD;
+    } else {
+        rc = RC_NODE_FULL;          // duplicates may continue in the next leaf
+    }
+
+    pthread_rwlock_unlock(latch(pid));
+    return rc;
+}
+
+/*
+ * Remove (key, RecordId) pair, rebalancing nodes as needed.
+ * Since duplicates of key may have to be looked for in several subtrees,
+ * the whole path from the root stays latched until the removal is done.
+ * The caller must hold smoLock.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+ *         is not in the index
+ */
+RC BTreeIndex::removePessimistic(int key, const RecordId& rid)
+{
+    RC rc;
+    bool underflow;
+
+    pthread_rwlock_wrlock(&rootLatch);
+    if (treeHeight <= 0) {
+        pthread_rwlock_unlock(&rootLatch);
+        return RC_NO_SUCH_RECORD;
+    }
+
+    pthread_rwlock_t* rootNodeLatch = latch(rootPid);
+    pthread_rwlock_wrlock(rootNodeLatch);
+
+    rc = removeAtNode(key, rid, rootPid, 1, underflow);
+
+    // Shrink the tree when the root is a non-leaf node with a single child
+    if (rc == 0 && treeHeight > 1) {
+        BTNonLeafNode root;
+        if ((rc = root.read(rootPid, pf)) == 0 && root.getKeyCount() == 0) {
+            root.readEntry(-1, rootPid);
+            treeHeight -= 1;
+        }
+    }
+
+    pthread_rwlock_unlock(rootNodeLatch);
+    pthread_rwlock_unlock(&rootLatch);
+    return rc;
+}
+
+/*
+ * Recursively remove a (key, RecordId) pair from the subtree rooted at pid.
+ * The caller must hold the exclusive latch of pid.
+ * @warning This function should not be called directly.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @param pid[IN] pid of the node where the search should begin
+ * @param height[IN] the height of the pid node (e.g. root has height 1)
+ * @param underflow[OUT] true if the node holds fewer keys than its minimum
+ * after the removal
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+ *         is not in the subtree
+ */
+RC BTreeIndex::removeAtNode(int key, const RecordId& rid, PageId pid, int height,
+                            bool& underflow)
+{
+    RC rc;
+    underflow = false;
+
+    // Check if we reached the leaf node
+    if (height == treeHeight) {
+        BTLeafNode node;
+        int eid, curKey;
+        RecordId curRid;
+
+        if ((rc = node.read(pid, pf)) != 0)
+            return rc;
+
+        if (node.locate(key, eid) != 0)
+            return RC_NO_SUCH_RECORD;
+
+        for (; node.readEntry(eid, curKey, curRid) == 0 && curKey == key; eid++) {
+            if (curRid == rid) {
+                node.remove(eid);
+                underflow = node.getKeyCount() < node.getMinKeyCount();
+                return node.write(pid, pf);
+            }
+        }
+
+        return RC_NO_SUCH_RECORD;
+    }
+
+    BTNonLeafNode node;
+    int first, last;
+    PageId childPid;
+    bool childUnderflow;
+
+    if ((rc = node.read(pid, pf)) != 0)
+        return rc;
+
+    // Duplicates of key may be spread over several children
+    node.locateLowerChildPtr(key, first);
+    node.locateChildPtr(key, last);
+
+    for (int i = first; i <= last; i++) {
+        node.readEntry(i, childPid);
+
+        // The child is released before rebalancing, which latches siblings
+        // left to right like scans do. No other writer can reach the child
+        // while this node is latched.
+        pthread_rwlock_t* childLatch = latch(childPid);
+        pthread_rwlock_wrlock(childLatch);
+        rc = removeAtNode(key, rid, childPid, height + 1, childUnderflow);
+        pthread_rwlock_unlock(childLatch);
+        if (rc == RC_NO_SUCH_RECORD)
+            continue;
+        if (rc != 0)
+            return rc;
+
+        if (childUnderflow) {
+            if ((rc = rebalanceChild(node, i, height)) != 0)
+                return rc;
+            underflow = node.getKeyCount() < node.getMinKeyCount();
+            return node.write(pid, pf);
+        }
+        return 0;
+    }
+
+    return RC_NO_SUCH_RECORD;
+}
+
+/*
+ * Fix an underflowing child of a non-leaf node by borrowing entries from
+ * a sibling or by merging it with a sibling.
+ * @warning This function should not be called directly.
+ * @param node[IN/OUT] the parent node
+ * @param childIndex[IN] the index of the underflowing child in node
+ * @param height[IN] the height of the parent node
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::rebalanceChild(BTNonLeafNode& node, int childIndex, int height)
+{
+    RC rc;
+    int left, right, midKey;
+    PageId leftPid, rightPid;
+
+    // Pair the child with its right sibling, or its left one if it is the last
+    if (childIndex + 1 < node.getKeyCount()) {
+        left = childIndex;
+    } else if (childIndex >= 0) {
+        left = childIndex - 1;
+    } else {
+        return 0;   // the only child; nothing to balance with
+    }
+    right = left + 1;
+
+    node.readEntry(left, leftPid);
+    node.readEntry(right, rightPid);
+    node.readKey(right, midKey);
+
+    pthread_rwlock_t* leftLatch = latch(leftPid);
+    pthread_rwlock_t* rightLatch = latch(rightPid);
+    pthread_rwlock_wrlock(leftLatch);
+    pthread_rwlock_wrlock(rightLatch);
+
+    if (height + 1 == treeHeight) {
+        BTLeafNode leftNode, rightNode;
+        if ((rc = leftNode.read(leftPid, pf)) == 0 &&
+            (rc = rightNode.read(rightPid, pf)) == 0) {
+            if (leftNode.merge(rightNode) == 0) {
+                // The right node is unlinked from the leaf chain and abandoned
+                node.remove(right);
+                PageId nextPid = leftNode.getNextNodePtr();
+                if (nextPid > 0)
+                    rc = setPrevLeaf(nextPid, leftPid);
+            } else {
+                leftNode.redistribute(rightNode, midKey);
+                node.setKey(right, midKey);
+                rc = rightNode.write(rightPid, pf);
+            }
+            if (rc == 0)
+                rc = leftNode.write(leftPid, pf);
+        }
+    } else {
+        BTNonLeafNode leftNode, rightNode;
+        if ((rc = leftNode.read(leftPid, pf)) == 0 &&
+            (rc = rightNode.read(rightPid, pf)) == 0) {
+            if (leftNode.merge(midKey, rightNode) == 0) {
+                node.remove(right);
+            } else {
+                leftNode.redistribute(midKey, rightNode, midKey);
+                node.setKey(right, midKey);
+                rc = rightNode.write(rightPid, pf);
+            }
+            if (rc == 0)
+                rc = leftNode.write(leftPid, pf);
+        }
+    }
+
+    pthread_rwlock_unlock(rightLatch);
+    pthread_rwlock_unlock(leftLatch);
+    return rc;
+}
+
+/*
+ * Descend from the root to the leaf node that may contain searchKey
+ * with shared latches and return with the leaf node latched.
+ * @param searchKey[IN] the key to look for
+ * @param lowest[IN] go to the leftmost leaf that may contain searchKey
+ * (the first duplicate) instead of the rightmost one
+ * @param exclusive[IN] latch the leaf node exclusively
+ * @param pid[OUT] the PageId of the leaf node
+ * @param height[OUT] the height of the tree during the descent
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the tree is empty
+ */
+RC BTreeIndex::latchLeaf(int searchKey, bool lowest, bool exclusive, PageId& pid, int& height)
+{
+    RC rc;
+    pthread_rwlock_t* current;
+
+    // Start searching for data from the root node
+    pthread_rwlock_rdlock(&rootLatch);
+    if (treeHeight <= 0) {
+        pthread_rwlock_unlock(&rootLatch);
+        return RC_NO_SUCH_RECORD;
+    }
+    pid = rootPid;
+    height = treeHeight;
+
+    current = latch(pid);
+    if (exclusive && height == 1)
+        pthread_rwlock_wrlock(current);
+    else
+        pthread_rwlock_rdlock(current);
+    pthread_rwlock_unlock(&rootLatch);
+
+    // Traverse the tree until reaching a leaf node, latching each child
+    // before releasing its parent
+    for (int i = 1, eid; i < height; i++) {
+        BTNonLeafNode node;
+        PageId childPid;
+
+        // Read the content of the node from pid in pf
+        if ((rc = node.read(pid, pf)) != 0) {
+            pthread_rwlock_unlock(current);
+            return rc;
+        }
+
+        // Obtain next node's pid; duplicates of searchKey may start
+        // left of a separator equal to it
+        if (lowest)
+            node.locateLowerChildPtr(searchKey, eid);
+        else
+            node.locateChildPtr(searchKey, eid);
+        node.readEntry(eid, childPid);
+
+        pthread_rwlock_t* child = latch(childPid);
+        if (exclusive && i + 1 == height)
+            pthread_rwlock_wrlock(child);
+        else
+            pthread_rwlock_rdlock(child);
+        pthread_rwlock_unlock(current);
+
+        current = child;
+        pid = childPid;
+    }
+
+    return 0;
+}
+
+/*
+ * Find the leaf-node index entry whose key value is larger than or 
+ * equal to searchKey, and output the location of the entry in IndexCursor.
+ * IndexCursor is a "pointer" to a B+tree leaf-node entry consisting of
+ * the PageId of the node and the SlotID of the index entry.
+ * Note that, for range queries, we need to scan the B+tree leaf nodes.
+ * For example, if the query is "key > 1000", we should scan the leaf
+ * nodes starting with the key value 1000. For this reason,
+ * it is better to return the location of the leaf node entry 
+ * for a given searchKey, instead of returning the RecordId
+ * associated with the searchKey directly.
+ * Once the location of the index entry is identified and returned 
+ * from this function, you should call readForward() to retrieve the
+ * actual (key, rid) pair from the index.
+ * @param key[IN] the key to find.
+ * @param cursor[OUT] the cursor pointing to the first index entry
+ *                    with the key value.
+ * @return error code. 0 if no error.
+ */
+RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
+{
+    RC rc;
+    PageId pid;
+    int height;
+    BTLeafNode node;
+
+    // The entries of a log-structured index are read on the first readForward()
+    if (lsm)
+        return startCursor(searchKey, cursor);
+
+    if ((rc = latchLeaf(searchKey, true, false, pid, height)) != 0)
+        return rc;
+
+    // Read node data; the cursor works on this copy from now on
+    rc = node.read(pid, pf);
+    pthread_rwlock_unlock(latch(pid));
+    if (rc != 0)
+        return rc;
+ 
+    // Set cursor's pid and eid
+    memcpy(cursor.pageBuf, node.getBuffer(), PageFile::PAGE_SIZE);
+    cursor.pid = pid;
+    cursor.bufferPid = pid;
+    cursor.searchKey = searchKey;
+    cursor.hasLast = false;
+    if (node.locate(searchKey, cursor.eid) != 0) {
+        // All keys in this node are smaller; continue at the next node
+        cursor.eid = node.getKeyCount();
+    }
+
+    return 0;
+}
+
+/*
+ * Read the (key, rid) pair at the location specified by the index cursor,
+ * and move foward the cursor to the next entry.
+ * @param cursor[IN/OUT] the cursor pointing to a leaf-node index entry in the b+tree
+ * @param key[OUT] the key stored at the index cursor location.
+ * @param rid[OUT] the RecordId stored at the index cursor location.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
+{
+    RC rc;
+    BTLeafNode node;
+
+    if (lsm)
+        return readCursor(cursor, false, key, rid);
+
+    for (;;) {
+        // Check cursor
+        if (cursor.pid <= 0 || cursor.pid >= pf.endPid())
+            return RC_INVALID_CURSOR;
+
+        // Read the content of the node from pid in pf
+        if (cursor.bufferPid != cursor.pid && (rc = nextLeaf(cursor)) != 0)
+            return rc;
+        if (cursor.bufferPid != cursor.pid)
+            continue;       // the cursor was positioned again
+        memcpy(node.getBuffer(), cursor.pageBuf, PageFile::PAGE_SIZE);
+
+        if (cursor.eid < node.getKeyCount())
+            break;
+
+        // Node is exhausted (or emptied by removals); move to the next node
+        cursor.pid = node.getNextNodePtr();
+        cursor.eid = 0;
+    }
+
+    // Read the (key, rid) pair from eid entry
+    node.readEntry(cursor.eid, key, rid);
+    cursor.hasLast = true;
+    cursor.lastKey = key;
+    cursor.lastRid = rid;
+
+    // Move the cursor forward
+    cursor.eid++;
+    if (cursor.eid >= node.getKeyCount()) // End of node
+    {
+      // Move to the next node
+      cursor.pid = node.getNextNodePtr();
+      // Reset cursor
+      cursor.eid = 0;
+    }
+
+    return 0;
+}
+
+/*
+ * Find the position right after the last leaf-node index entry whose key
+ * is smaller than or equal to searchKey, for reading the index backward.
+ * @param searchKey[IN] the largest key to return
+ * @param cursor[OUT] the cursor to read backward with
+ * @return error code. 0 if no error.
+ */
+RC BTreeIndex::locateBackward(int searchKey, IndexCursor& cursor)
+{
+    RC rc;
+    PageId pid;
+    int height, eid, key;
+    RecordId rid;
+    BTLeafNode node;
+
+    if (lsm)
+        return startCursor(searchKey, cursor);
+
+    // Duplicates of searchKey end in the rightmost leaf that may hold it
+    if ((rc = latchLeaf(searchKey, false, false, pid, height)) != 0)
+        return rc;
+
+    rc = node.read(pid, pf);
+    pthread_rwlock_unlock(latch(pid));
+    if (rc != 0)
+        return rc;
+
+    memcpy(cursor.pageBuf, node.getBuffer(), PageFile::PAGE_SIZE);
+    cursor.pid = pid;
+    cursor.bufferPid = pid;
+    cursor.searchKey = searchKey;
+    cursor.hasLast = false;
+
+    // Count the entries up to searchKey
+    for (eid = node.getKeyCount(); eid > 0; eid--) {
+        node.readEntry(eid - 1, key, rid);
+        if (key <= searchKey)
+            break;
+    }
+    cursor.eid = eid;
+
+    return 0;
+}
+
+/*
+ * Read the (key, rid) pair right before the location specified by the
+ * index cursor, and move the cursor backward to it.
+ * @param cursor[IN/OUT] the cursor set up by locateBackward()
+ * @param key[OUT] the key stored before the cursor location.
+ * @param rid[OUT] the RecordId stored before the cursor location.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::readBackward(IndexCursor& cursor, int& key, RecordId& rid)
+{
+    RC rc;
+    BTLeafNode node;
+
+    if (lsm)
+        return readCursor(cursor, true, key, rid);
+
+    for (;;) {
+        // Check cursor
+        if (cursor.pid <= 0 || cursor.pid >= pf.endPid())
+            return RC_INVALID_CURSOR;
+
+        // Read the content of the node from pid in pf
+        if (cursor.bufferPid != cursor.pid && (rc = prevLeaf(cursor)) != 0)
+            return rc;
+        if (cursor.bufferPid != cursor.pid)
+            continue;       // the cursor was positioned again
+        memcpy(node.getBuffer(), cursor.pageBuf, PageFile::PAGE_SIZE);
+
+        if (cursor.eid > 0)
+            break;
+
+        // Node is exhausted; move to the previous node
+        cursor.pid = node.getPrevNodePtr();
+    }
+
+    // Move the cursor backward and read the (key, rid) pair there
+    cursor.eid--;
+    node.readEntry(cursor.eid, key, rid);
+    cursor.hasLast = true;
+    cursor.lastKey = key;
+    cursor.lastRid = rid;
+
+    return 0;
+}
+
+/*
+ * Point the previous node pointer of a leaf node to prevPid.
+ * The caller must hold the latches of the nodes to the left of it.
+ * @param pid[IN] the PageId of the leaf node
+ * @param prevPid[IN] the PageId of its new previous sibling
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::setPrevLeaf(PageId pid, PageId prevPid)
+{
+    RC rc;
+    BTLeafNode node;
+    pthread_rwlock_t* nodeLatch = latch(pid);
+
+    pthread_rwlock_wrlock(nodeLatch);
+    if ((rc = node.read(pid, pf)) == 0) {
+        node.setPrevNodePtr(prevPid);
+        rc = node.write(pid, pf);
+    }
+    pthread_rwlock_unlock(nodeLatch);
+
+    return rc;
+}
+
+/*
+ * Point the next node pointer of a leaf node to nextPid.
+ * @param pid[IN] the PageId of the leaf node
+ * @param nextPid[IN] the PageId of its new next sibling
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::setNextLeaf(PageId pid, PageId nextPid)
+{
+    RC rc;
+    BTLeafNode node;
+    pthread_rwlock_t* nodeLatch = latch(pid);
+
+    pthread_rwlock_wrlock(nodeLatch);
+    if ((rc = node.read(pid, pf)) == 0) {
+        node.setNextNodePtr(nextPid);
+        rc = node.write(pid, pf);
+    }
+    pthread_rwlock_unlock(nodeLatch);
+
+    return rc;
+}
+
+/*
+ * Move the cursor forward to the first entry whose key is larger than or
+ * equal to searchKey, staying in the buffered leaf node if it holds the entry.
+ * @param searchKey[IN] the key to find
+ * @param cursor[IN/OUT] a cursor set up by locate()
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::skipTo(int searchKey, IndexCursor& cursor)
+{
+    BTLeafNode node;
+    int eid, key;
+    RecordId rid;
+
+    // Skip the entries read ahead before searchKey, or all of them and
+    // the keys up to searchKey
+    if (lsm) {
+        while (cursor.entryPos < cursor.entries.size() && cursor.entries[cursor.entryPos].key < searchKey)
+            cursor.entryPos++;
+        if (cursor.entryPos == cursor.entries.size() && cursor.nextKey < searchKey) {
+            cursor.nextKey = searchKey;
+            cursor.readAhead = 1;
+        }
+        return 0;
+    }
+
+    // The cursor still points into the leaf node in its buffer
+    if (cursor.bufferPid == cursor.pid && cursor.pid > 0) {
+        memcpy(node.getBuffer(), cursor.pageBuf, PageFile::PAGE_SIZE);
+        int count = node.getKeyCount();
+
+        if (count > 0 && node.readEntry(count - 1, key, rid) == 0 && key >= searchKey &&
+            node.locate(searchKey, eid) == 0 && eid >= cursor.eid) {
+            // Nothing before eid was returned, so if the node changes
+            // the scan resumes at searchKey
+            cursor.eid = eid;
+            cursor.searchKey = searchKey;
+            cursor.hasLast = false;
+            return 0;
+        }
+    }
+
+    return locate(searchKey, cursor);
+}
+
+/*
+ * Move the cursor from the leaf node in its buffer to cursor.pid.
+ * The next-node pointer in the buffer is only followed if the buffered
+ * leaf node is unchanged. The leaf node stays latched until the next one
+ * is, so that no split, merge or redistribution can happen in between.
+ * @param cursor[IN/OUT] the cursor to move
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::nextLeaf(IndexCursor& cursor)
+{
+    RC rc;
+    char page[PageFile::PAGE_SIZE];
+    PageId prevPid = cursor.bufferPid;
+    pthread_rwlock_t* next;
+
+    // A cursor that was not set up by locate() has nothing to check
+    if (prevPid <= 0 || prevPid >= pf.endPid()) {
+        next = latch(cursor.pid);
+        pthread_rwlock_rdlock(next);
+        rc = pf.read(cursor.pid, cursor.pageBuf);
+        pthread_rwlock_unlock(next);
+        if (rc == 0)
+            cursor.bufferPid = cursor.pid;
+        return rc;
+    }
+
+    pthread_rwlock_t* prev = latch(prevPid);
+    pthread_rwlock_rdlock(prev);
+    if ((rc = pf.read(prevPid, page)) == 0 &&
+        memcmp(page, cursor.pageBuf, PageFile::PAGE_SIZE) == 0) {
+        next = latch(cursor.pid);
+        pthread_rwlock_rdlock(next);
+        pthread_rwlock_unlock(prev);
+
+        rc = pf.read(cursor.pid, cursor.pageBuf);
+        pthread_rwlock_unlock(next);
+        if (rc == 0)
+            cursor.bufferPid = cursor.pid;
+        return rc;
+    }
+    pthread_rwlock_unlock(prev);
+    if (rc != 0)
+        return rc;
+
+    // Entries were moved into or out of the leaf node behind the cursor
+    return relocate(cursor);
+}
+
+/*
+ * Move the cursor from the leaf node in its buffer to its previous
+ * sibling cursor.pid, positioned after the last entry. The previous node
+ * is latched before the buffered node is checked again, in the same
+ * left-to-right order that splits and merges use, so that no entries
+ * can move between the two nodes in between.
+ * @param cursor[IN/OUT] the cursor to move
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::prevLeaf(IndexCursor& cursor)
+{
+    RC rc;
+    char page[PageFile::PAGE_SIZE];
+    PageId nextPid = cursor.bufferPid;
+    BTLeafNode node;
+
+    pthread_rwlock_t* prev = latch(cursor.pid);
+    pthread_rwlock_rdlock(prev);
+    if ((rc = node.read(cursor.pid, pf)) != 0) {
+        pthread_rwlock_unlock(prev);
+        return rc;
+    }
+
+    if (node.getNextNodePtr() == nextPid) {
+        pthread_rwlock_t* next = latch(nextPid);
+        pthread_rwlock_rdlock(next);
+        rc = pf.read(nextPid, page);
+        pthread_rwlock_unlock(next);
+
+        if (rc == 0 && memcmp(page, cursor.pageBuf, PageFile::PAGE_SIZE) == 0) {
+            memcpy(cursor.pageBuf, node.getBuffer(), PageFile::PAGE_SIZE);
+            cursor.bufferPid = cursor.pid;
+            cursor.eid = node.getKeyCount();
+            pthread_rwlock_unlock(prev);
+            return 0;
+        }
+    }
+    pthread_rwlock_unlock(prev);
+    if (rc != 0)
+        return rc;
+
+    // The nodes were split, merged or changed behind the cursor
+    return relocateBackward(cursor);
+}
+
+/*
+ * Position the cursor right before the last entry it returned while
+ * reading backward, searching from the root.
+ * @param cursor[IN/OUT] the cursor to position
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::relocateBackward(IndexCursor& cursor)
+{
+    RC rc;
+    int key;
+    RecordId rid;
+    BTLeafNode node;
+
+    if (!cursor.hasLast)
+        return locateBackward(cursor.searchKey, cursor);
+
+    int lastKey = cursor.lastKey;
+    RecordId lastRid = cursor.lastRid;
+    if ((rc = locateBackward(lastKey, cursor)) != 0)
+        return rc;
+
+    // Skip the duplicates of the last key down to the last returned
+    // entry. if the entry is not in this node, the duplicates here were
+    // all returned before it.
+    memcpy(node.getBuffer(), cursor.pageBuf, PageFile::PAGE_SIZE);
+    int eid = cursor.eid;
+    for (int i = cursor.eid - 1; i >= 0; i--) {
+        node.readEntry(i, key, rid);
+        if (key != lastKey)
+            break;
+        eid = i;
+        if (rid == lastRid)
+            break;
+    }
+    cursor.eid = eid;
+
+    cursor.hasLast = true;
+    cursor.lastKey = lastKey;
+    cursor.lastRid = lastRid;
+
+    return 0;
+}
+
+/*
+ * Position the cursor right after the last entry it returned, searching
+ * from the root.
+ * @param cursor[IN/OUT] the cursor to position
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::relocate(IndexCursor& cursor)
+{
+    RC rc;
+    int key;
+    RecordId rid;
+    IndexCursor saved;
+
+    if (!cursor.hasLast)
+        return locate(cursor.searchKey, cursor);
+
+    int lastKey = cursor.lastKey;
+    RecordId lastRid = cursor.lastRid;
+    if ((rc = locate(lastKey, cursor)) != 0)
+        return rc;
+
+    // Skip the duplicates of the last key up to the last returned entry
+    for (;;) {
+        saved = cursor;
+        if (readForward(cursor, key, rid) != 0 || key != lastKey) {
+            cursor = saved;
+            break;
+        }
+        if (rid == lastRid)
+            break;
+    }
+
+    cursor.hasLast = true;
+    cursor.lastKey = lastKey;
+    cursor.lastRid = lastRid;
+
+    return 0;
+}
+
+/*
+ * The log-structured index. A removal is kept in the runs as its pair
+ * with the slot id of the RecordId stored as -1 - sid.
+ */
+
+// the entries of a key a fill of a cursor reads ahead at most
+static const size_t LSM_READ_AHEAD = 256;
+
+// the runs are merged while the older one is at most this many times
+// as large as the newer ones together
+static const int COMPACTION_RATIO = 1;
+
+static RecordId removedRid(const RecordId& rid)
+{
+    RecordId removed = { rid.pid, -1 - rid.sid };
+    return removed;
+}
+
+static RecordId storedRid(const RecordId& rid)
+{
+    return (rid.sid < 0) ? removedRid(rid) : rid;
+}
+
+/*
+ * A position in a run or in a memtable of a log-structured index, for
+ * reading their entries merged. No thread changes the nodes of a run,
+ * so they are read without latches.
+ */
+struct LsmSource {
+    int                   age;    // larger for newer sources
+    PageFile*             pf;
+    const SkipList*       list;   // the memtable, or NULL for a run
+    const SkipList::Node* entry;  // the current entry of the memtable
+    BTLeafNode            node;   // the current leaf node of the run
+    int                   eid;    // the current entry of node
+    bool                  valid;  // key and rid hold the current entry
+    int                   key;
+    RecordId              rid;    // with removals encoded
+};
+
+/*
+ * An entry of one key read from a source
+ */
+struct GroupEntry {
+    RecordId rid;  // with removals encoded
+    int      age;
+};
+
+// orders the entries of a key by RecordId, the newest first
+static bool newerFirst(const GroupEntry& a, const GroupEntry& b)
+{
+    RecordId ra = storedRid(a.rid), rb = storedRid(b.rid);
+    return ra < rb || (ra == rb && a.age > b.age);
+}
+
+static void setEntry(LsmSource& s, const SkipList::Node* entry)
+{
+    s.entry = entry;
+    s.valid = (entry != NULL);
+    if (s.valid) {
+        s.key = entry->key;
+        s.rid = entry->removed ? removedRid(entry->rid) : entry->rid;
+    }
+}
+
+// read the entry of a run at s.eid, moving to the next (or previous)
+// leaf node if s.eid is past the end of s.node
+static RC readRun(LsmSource& s, bool backward)
+{
+    RC rc;
+
+    while (backward ? s.eid < 0 : s.eid >= s.node.getKeyCount()) {
+        PageId pid = backward ? s.node.getPrevNodePtr() : s.node.getNextNodePtr();
+        if (pid <= 0) {
+            s.valid = false;
+            return 0;
+        }
+        if ((rc = s.node.read(pid, *s.pf)) != 0)
+            return rc;
+        s.eid = backward ? s.node.getKeyCount() - 1 : 0;
+    }
+
+    s.node.readEntry(s.eid, s.key, s.rid);
+    s.valid = true;
+    return 0;
+}
+
+// position a source at the first entry whose key is key or larger, or
+// reading backward, at the last one whose key is key or smaller. a run
+// is given by its root and height, a memtable by list.
+static RC openSource(LsmSource& s, PageFile& pf, int age, PageId root, int height,
+                     const SkipList* list, int key, bool backward)
+{
+    RC rc;
+    PageId pid = root;
+    RecordId rid;
+    int eid, k;
+
+    s.age = age;
+    s.pf = &pf;
+    s.list = list;
+    if (list != NULL) {
+        setEntry(s, backward ? list->seekLast(key) : list->seek(key));
+        return 0;
+    }
+
+    for (int i = 1; i < height; i++) {
+        BTNonLeafNode node;
+        if ((rc = node.read(pid, pf)) != 0)
+            return rc;
+        if (backward)
+            node.locateChildPtr(key, eid);
+        else
+            node.locateLowerChildPtr(key, eid);
+        node.readEntry(eid, pid);
+    }
+    if ((rc = s.node.read(pid, pf)) != 0)
+        return rc;
+
+    if (backward) {
+        for (s.eid = s.node.getKeyCount() - 1; s.eid >= 0; s.eid--) {
+            s.node.readEntry(s.eid, k, rid);
+            if (k <= key)
+                break;
+        }
+    } else if (s.node.locate(key, s.eid) != 0) {
+        s.eid = s.node.getKeyCount();
+    }
+    return readRun(s, backward);
+}
+
+// add the entries of key of a source to group, and move the source
+// past them
+static RC readGroup(LsmSource& s, int key, bool backward, vector<GroupEntry>& group)
+{
+    RC rc;
+    GroupEntry e;
+
+    e.age = s.age;
+    if (s.list != NULL) {
+        // a memtable is read forward from the first entry of the key
+        const SkipList::Node* n = backward ? s.list->seek(key) : s.entry;
+        for (; n != NULL && n->key == key; n = SkipList::next(n)) {
+            e.rid = n->removed ? removedRid(n->rid) : n->rid;
+            group.push_back(e);
+        }
+        if (backward)
+            n = (key > INT_MIN) ? s.list->seekLast(key - 1) : NULL;
+        setEntry(s, n);
+        return 0;
+    }
+
+    while (s.valid && s.key == key) {
+        e.rid = s.rid;
+        group.push_back(e);
+        s.eid += backward ? -1 : 1;
+        if ((rc = readRun(s, backward)) != 0)
+            return rc;
+    }
+    return 0;
+}
+
+/*
+ * Read the next key of the sources merged: the smallest key any of them
+ * is at, or the largest reading backward. Of the entries of a RecordId,
+ * the one of the newest source counts.
+ * @param sources[IN/OUT] the sources, moved past the key
+ * @param backward[IN] read the keys in descending order
+ * @param removals[IN] return the removals too, encoded
+ * @param key[OUT] the key
+ * @param rids[OUT] the RecordIds of the key in ascending order
+ * @param group[IN/OUT] scratch space
+ * @return error code. 0 if no error, RC_END_OF_TREE after the last key
+ */
+static RC nextGroup(vector<LsmSource>& sources, bool backward, bool removals,
+                    int& key, vector<RecordId>& rids, vector<GroupEntry>& group)
+{
+    RC rc;
+    bool found = false;
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i].valid && (!found || (backward ? sources[i].key > key : sources[i].key < key))) {
+            key = sources[i].key;
+            found = true;
+        }
+    }
+    if (!found)
+        return RC_END_OF_TREE;
+
+    group.clear();
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i].valid && sources[i].key == key &&
+            (rc = readGroup(sources[i], key, backward, group)) != 0)
+            return rc;
+    }
+
+    sort(group.begin(), group.end(), newerFirst);
+    rids.clear();
+    for (size_t i = 0; i < group.size(); i++) {
+        if (i > 0 && storedRid(group[i].rid) == storedRid(group[i - 1].rid))
+            continue;
+        if (group[i].rid.sid >= 0 || removals)
+            rids.push_back(group[i].rid);
+    }
+    return 0;
+}
+
+/*
+ * The pairs of a memtable written to a run, removals encoded
+ */
+static RC listEntry(void* arg, int& key, RecordId& rid)
+{
+    const SkipList::Node** n = (const SkipList::Node**) arg;
+
+    if (*n == NULL)
+        return RC_END_OF_TREE;
+    key = (*n)->key;
+    rid = (*n)->removed ? removedRid((*n)->rid) : (*n)->rid;
+    *n = SkipList::next(*n);
+    return 0;
+}
+
+/*
+ * The pairs of runs merged by compact()
+ */
+struct CompactSource {
+    vector<LsmSource>  sources;
+    bool               removals;  // keep the removals: older runs are left
+    vector<GroupEntry> group;
+    vector<RecordId>   rids;      // the pairs of key not returned yet
+    size_t             pos;
+    int                key;
+};
+
+static RC compactedEntry(void* arg, int& key, RecordId& rid)
+{
+    CompactSource* c = (CompactSource*) arg;
+    RC rc;
+
+    while (c->pos == c->rids.size()) {
+        if ((rc = nextGroup(c->sources, false, c->removals, c->key, c->rids, c->group)) != 0)
+            return rc;
+        c->pos = 0;
+    }
+    key = c->key;
+    rid = c->rids[c->pos++];
+    return 0;
+}
+
+/*
+ * Add a pair to the memtable, and write the memtable to a run if it is full.
+ * @param key[IN] the key of the pair
+ * @param rid[IN] the RecordId of the pair
+ * @param removed[IN] whether the pair is removed instead of inserted
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::put(int key, const RecordId& rid, bool removed)
+{
+    pthread_rwlock_wrlock(&lsmLatch);
+    mem->put(key, rid, removed);
+    bool full = (mem->size() >= MEMTABLE_SIZE);
+    pthread_rwlock_unlock(&lsmLatch);
+
+    return full ? flushMemtable(false) : 0;
+}
+
+/*
+ * Write the memtable to a new run. The memtable is set aside first, so
+ * that new pairs go to an empty one meanwhile, and lookups read it until
+ * its run takes its place.
+ * @param all[IN] write every entry added so far; otherwise only a full
+ *        memtable is written
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::flushMemtable(bool all)
+{
+    RC rc = 0;
+
+    pthread_mutex_lock(&flushLock);
+
+    // A memtable whose run could not be written is written first
+    for (int i = 0; i < 2 && rc == 0; i++) {
+        pthread_rwlock_wrlock(&lsmLatch);
+        if (imm == NULL && (all ? mem->size() > 0 : mem->size() >= MEMTABLE_SIZE)) {
+            imm = mem;
+            mem = new SkipList;
+        }
+        SkipList* list = imm;
+        pthread_rwlock_unlock(&lsmLatch);
+        if (list == NULL)
+            break;
+
+        Run run;
+        const SkipList::Node* first = list->seek(INT_MIN);
+        if ((rc = makeRoom()) != 0 ||
+            (rc = build(listEntry, &first, run.rootPid, run.treeHeight, run.count)) != 0)
+            break;
+
+        pthread_rwlock_wrlock(&lsmLatch);
+        if (run.count > 0)
+            runs.push_back(run);
+        imm = NULL;
+        pthread_rwlock_unlock(&lsmLatch);
+        delete list;
+        wakeCompactor();
+    }
+
+    pthread_mutex_unlock(&flushLock);
+    return rc;
+}
+
+/*
+ * Merge runs until there is room for one more run.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::makeRoom()
+{
+    RC rc = 0;
+    bool merged = true;
+
+    for (;;) {
+        pthread_rwlock_rdlock(&lsmLatch);
+        bool full = (runs.size() >= (size_t) MAX_RUNS);
+        pthread_rwlock_unlock(&lsmLatch);
+        if (!full || !merged || rc != 0)
+            break;
+        rc = compact(true, merged);
+    }
+
+    return rc;
+}
+
+/*
+ * Merge the newest runs into one. Going from the newest run to older
+ * ones, a run is merged as long as it is not larger than the newer runs
+ * together times COMPACTION_RATIO, so runs are merged about as often as
+ * their size doubles. Removals are dropped from a merge that takes the
+ * oldest run. The new run is written while the old ones are read, and
+ * takes their place in one step; their pages are free after the next
+ * commit.
+ * @param force[IN] merge the two newest runs if nothing else
+ * @param merged[OUT] whether runs were merged
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::compact(bool force, bool& merged)
+{
+    RC rc = 0;
+    vector<Run> snapshot;
+    vector<PageId> pages;
+    Run run;
+
+    merged = false;
+    pthread_mutex_lock(&compactLock);
+
+    // Runs are only added at the end meanwhile
+    pthread_rwlock_rdlock(&lsmLatch);
+    snapshot = runs;
+    pthread_rwlock_unlock(&lsmLatch);
+
+    size_t n = snapshot.size(), first = n;
+    if (n >= 2) {
+        long long newer = snapshot[n - 1].count;
+        for (first = n - 1; first > 0 && snapshot[first - 1].count <= COMPACTION_RATIO * newer; first--)
+            newer += snapshot[first - 1].count;
+        if (first == n - 1)
+            first = force ? n - 2 : n;
+    }
+
+    if (first < n) {
+        CompactSource* c = new CompactSource;
+        c->sources.resize(n - first);
+        c->removals = (first > 0);
+        c->pos = 0;
+        for (size_t i = first; i < n && rc == 0; i++) {
+            rc = openSource(c->sources[i - first], pf, i, snapshot[i].rootPid,
+                            snapshot[i].treeHeight, NULL, INT_MIN, false);
+        }
+        if (rc == 0)
+            rc = build(compactedEntry, c, run.rootPid, run.treeHeight, run.count);
+        for (size_t i = first; i < n && rc == 0; i++)
+            rc = runPages(snapshot[i], pages);
+        delete c;
+
+        if (rc == 0) {
+            pthread_rwlock_wrlock(&lsmLatch);
+            runs.erase(runs.begin() + first, runs.begin() + n);
+            if (run.count > 0)
+                runs.insert(runs.begin() + first, run);
+            pthread_rwlock_unlock(&lsmLatch);
+
+            pthread_mutex_lock(&allocLock);
+            pendingFree.insert(pendingFree.end(), pages.begin(), pages.end());
+            pthread_mutex_unlock(&allocLock);
+            merged = true;
+        }
+    }
+
+    pthread_mutex_unlock(&compactLock);
+    return rc;
+}
+
+/*
+ * The background thread that merges runs whenever one is added.
+ * @param arg[IN] the index
+ */
+void* BTreeIndex::compactor(void* arg)
+{
+    BTreeIndex* index = (BTreeIndex*) arg;
+    bool merged;
+
+    pthread_mutex_lock(&index->compactorLock);
+    while (!index->compactorStop) {
+        if (!index->compactorWake) {
+            pthread_cond_wait(&index->compactorCond, &index->compactorLock);
+            continue;
+        }
+        index->compactorWake = false;
+        pthread_mutex_unlock(&index->compactorLock);
+
+        // A merge that fails is tried again after the next run is added
+        while (index->compact(false, merged) == 0 && merged)
+            ;
+
+        pthread_mutex_lock(&index->compactorLock);
+    }
+    pthread_mutex_unlock(&index->compactorLock);
+
+    return NULL;
+}
+
+/*
+ * Start the compactor thread. Without it, runs are only merged when
+ * there are MAX_RUNS of them.
+ */
+void BTreeIndex::startCompactor()
+{
+    pthread_mutex_lock(&compactorLock);
+    if (!compactorRunning) {
+        compactorStop = false;
+        compactorWake = true;
+        compactorRunning = (pthread_create(&compactorThread, NULL, compactor, this) == 0);
+    }
+    pthread_mutex_unlock(&compactorLock);
+}
+
+/*
+ * Stop the compactor thread after the merge it is running.
+ */
+void BTreeIndex::stopCompactor()
+{
+    pthread_mutex_lock(&compactorLock);
+    bool running = compactorRunning;
+    compactorStop = true;
+    pthread_cond_signal(&compactorCond);
+    pthread_mutex_unlock(&compactorLock);
+
+    if (running) {
+        pthread_join(compactorThread, NULL);
+        compactorRunning = false;
+    }
+}
+
+/*
+ * Wake up the compactor thread to look at the runs.
+ */
+void BTreeIndex::wakeCompactor()
+{
+    pthread_mutex_lock(&compactorLock);
+    compactorWake = true;
+    pthread_cond_signal(&compactorCond);
+    pthread_mutex_unlock(&compactorLock);
+}
+
+/*
+ * Collect the pages of the nodes of a run.
+ * @param run[IN] the run
+ * @param pages[IN/OUT] the pages are added here
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::runPages(const Run& run, vector<PageId>& pages)
+{
+    RC rc;
+    vector<PageId> level, children;
+    PageId child;
+
+    if (run.treeHeight <= 0)
+        return 0;
+
+    level.push_back(run.rootPid);
+    for (int height = run.treeHeight; height > 1; height--) {
+        children.clear();
+        for (size_t i = 0; i < level.size(); i++) {
+            BTNonLeafNode node;
+            if ((rc = node.read(level[i], pf)) != 0)
+                return rc;
+            for (int eid = -1; eid < node.getKeyCount(); eid++) {
+                node.readEntry(eid, child);
+                children.push_back(child);
+            }
+        }
+        pages.insert(pages.end(), level.begin(), level.end());
+        level.swap(children);
+    }
+    pages.insert(pages.end(), level.begin(), level.end());
+
+    return 0;
+}
+
+/*
+ * Find the pages that neither the tree nor a run uses: those of runs
+ * merged away, of nodes written after the last commit and of nodes
+ * replaced by merge().
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::findFreePages()
+{
+    RC rc;
+    vector<PageId> pages;
+    PageId end = pf.endPid();
+
+    if (!lsm) {
+        Run tree = { rootPid, treeHeight, 0 };
+        if ((rc = runPages(tree, pages)) != 0)
+            return rc;
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        if ((rc = runPages(runs[i], pages)) != 0)
+            return rc;
+    }
+
+    vector<bool> used(end, false);
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (pages[i] > 0 && pages[i] < end)
+            used[pages[i]] = true;
+    }
+
+    // Scans may still read the nodes that merge() replaced
+    pthread_mutex_lock(&allocLock);
+    for (size_t i = 0; i < retired.size(); i++) {
+        if (retired[i] > 0 && retired[i] < end)
+            used[retired[i]] = true;
+    }
+    freePages.clear();
+    pendingFree.clear();
+    for (PageId pid = end - 1; pid > 0; pid--) {
+        if (!used[pid])
+            freePages.push_back(pid);
+    }
+    nextPid = max(nextPid, end);
+    pthread_mutex_unlock(&allocLock);
+
+    return 0;
+}
+
+/*
+ * Make the index log-structured. The tree of the index becomes its
+ * oldest run as it is.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::makeLogStructured()
+{
+    RC rc;
+    IndexCursor cursor;
+    Run run;
+    int key;
+    RecordId rid;
+
+    if (lsm)
+        return 0;
+
+    run.rootPid = rootPid;
+    run.treeHeight = treeHeight;
+    run.count = 0;
+    if (treeHeight > 0 && (rc = locate(INT_MIN, cursor)) == 0) {
+        while (readForward(cursor, key, rid) == 0)
+            run.count++;
+    }
+
+    pthread_rwlock_wrlock(&lsmLatch);
+    runs.clear();
+    if (run.count > 0)
+        runs.push_back(run);
+    lsm = true;
+    pthread_rwlock_unlock(&lsmLatch);
+
+    pthread_rwlock_wrlock(&rootLatch);
+    rootPid = -1;
+    treeHeight = 0;
+    pthread_rwlock_unlock(&rootLatch);
+
+    if ((rc = findFreePages()) != 0)
+        return rc;
+    startCompactor();
+    return 0;
+}
+
+/*
+ * Read the entries of the keys from cursor.nextKey on (down from it,
+ * reading backward) of the memtables and the runs merged into the cursor.
+ * The memtables and runs are latched until the fill is done, so it sees
+ * all of them at one time.
+ * @param cursor[IN/OUT] the cursor
+ * @param backward[IN] read the keys in descending order
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::fillCursor(IndexCursor& cursor, bool backward)
+{
+    RC rc = 0;
+    vector<LsmSource> sources;
+    vector<GroupEntry> group;
+    vector<RecordId> rids;
+    IndexEntry entry;
+    int key;
+
+    cursor.entries.clear();
+    cursor.entryPos = 0;
+
+    pthread_rwlock_rdlock(&lsmLatch);
+    int age = runs.size();
+    sources.resize(runs.size() + (imm != NULL ? 2 : 1));
+    for (size_t i = 0; i < runs.size() && rc == 0; i++) {
+        rc = openSource(sources[i], pf, i, runs[i].rootPid, runs[i].treeHeight, NULL,
+                        cursor.nextKey, backward);
+    }
+    if (imm != NULL) {
+        openSource(sources[age], pf, age, -1, 0, imm, cursor.nextKey, backward);
+        age++;
+    }
+    openSource(sources[age], pf, age, -1, 0, mem, cursor.nextKey, backward);
+
+    while (rc == 0 && cursor.entries.size() < cursor.readAhead) {
+        if ((rc = nextGroup(sources, backward, false, key, rids, group)) != 0) {
+            if (rc == RC_END_OF_TREE) {
+                cursor.exhausted = true;
+                rc = 0;
+            }
+            break;
+        }
+        entry.key = key;
+        for (size_t i = 0; i < rids.size(); i++) {
+            entry.rid = rids[backward ? rids.size() - 1 - i : i];
+            cursor.entries.push_back(entry);
+        }
+        if (key == (backward ? INT_MIN : INT_MAX)) {
+            cursor.exhausted = true;
+            break;
+        }
+        cursor.nextKey = backward ? key - 1 : key + 1;
+    }
+    pthread_rwlock_unlock(&lsmLatch);
+
+    // Scans read more ahead the longer they go on
+    cursor.readAhead = min(2 * cursor.readAhead, LSM_READ_AHEAD);
+    return rc;
+}
+
+/*
+ * Set up a cursor of a log-structured index to read from searchKey on, or
+ * backward down from it.
+ * @param searchKey[IN] the first key to read
+ * @param cursor[OUT] the cursor
+ * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the index is empty
+ */
+RC BTreeIndex::startCursor(int searchKey, IndexCursor& cursor)
+{
+    pthread_rwlock_rdlock(&lsmLatch);
+    bool empty = runs.empty() && imm == NULL && mem->size() == 0;
+    pthread_rwlock_unlock(&lsmLatch);
+
+    cursor.entries.clear();
+    cursor.entryPos = 0;
+    cursor.nextKey = searchKey;
+    cursor.exhausted = false;
+    cursor.readAhead = 1;
+    return empty ? RC_NO_SUCH_RECORD : 0;
+}
+
+/*
+ * Return the next entry of a cursor of a log-structured index, reading
+ * the entries of the next keys if those read ahead are used up.
+ * @param cursor[IN/OUT] the cursor
+ * @param backward[IN] read the keys in descending order
+ * @param key[OUT] the key of the entry
+ * @param rid[OUT] the RecordId of the entry
+ * @return error code. 0 if no error, RC_INVALID_CURSOR after the last entry
+ */
+RC BTreeIndex::readCursor(IndexCursor& cursor, bool backward, int& key, RecordId& rid)
+{
+    RC rc;
+
+    if (cursor.entryPos == cursor.entries.size()) {
+        if (cursor.exhausted)
+            return RC_INVALID_CURSOR;
+        if ((rc = fillCursor(cursor, backward)) != 0)
+            return rc;
+        if (cursor.entries.empty())
+            return RC_INVALID_CURSOR;
     }
 
+    key = cursor.entries[cursor.entryPos].key;
+    rid = cursor.entries[cursor.entryPos].rid;
+    cursor.entryPos++;
     return 0;
 }
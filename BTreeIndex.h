@@ -10,9 +10,24 @@
 #ifndef BTREEINDEX_H
 #define BTREEINDEX_H
 
+#include <vector>
+#include <utility>
+#include <pthread.h>
 #include "Bruinbase.h"
 #include "PageFile.h"
 #include "RecordFile.h"
+
+class BTNonLeafNode;
+class SkipList;
+struct PathMerge;
+
+/**
+ * A (key, RecordId) pair of the index.
+ */
+typedef struct {
+  int      key;
+  RecordId rid;
+} IndexEntry;
              
 /**
  * The data structure to point to a particular entry at a b+tree leaf node.
@@ -26,18 +41,50 @@ typedef struct {
   // The entry number inside the node
   int     eid;  
   
+  // A copy of the leaf node the cursor last read
   char    pageBuf[PageFile::PAGE_SIZE];
   
+  // PageId of the leaf node in pageBuf
   PageId  bufferPid;  
+
+  // The following remember where the scan is, so that it can be resumed
+  // when another thread changes the leaf node behind the cursor
+  int      searchKey;  // the key passed to locate()
+  bool     hasLast;    // readForward() returned an entry since locate()
+  int      lastKey;    // the last key returned by readForward()
+  RecordId lastRid;    // the last RecordId returned by readForward()
+
+  // A log-structured index reads the entries of whole keys ahead into
+  // entries; the fields above are not used then
+  std::vector<IndexEntry> entries;  // the entries read ahead, in the order returned
+  size_t   entryPos;   // the next entry of entries to return
+  int      nextKey;    // the key to read ahead from once entries is used up
+  bool     exhausted;  // no entry is left after those in entries
+  size_t   readAhead;  // the entries the next read ahead returns at least
 } IndexCursor;
 
 /**
  * Implements a B-Tree index for bruinbase.
  * 
+ * Any number of threads may call insert(), remove(), locate() and
+ * readForward() on the same index at the same time. Every node page has a
+ * reader/writer latch. Lookups and scans descend with shared latches,
+ * latching a child before they release its parent (latch crabbing).
+ * Inserts and removals that change a single leaf latch only that leaf
+ * exclusively. Operations that split, merge or redistribute nodes are run
+ * one at a time and latch exclusively the part of the path they modify.
+ *
+ * An index may instead be log-structured (makeLogStructured()). Inserts
+ * and removals then go to an in-memory memtable, which is written out as
+ * an immutable sorted run, a tree built like bulkLoad() does, once it is
+ * full. A background thread merges runs of similar size into one, and
+ * lookups and scans read the memtable and all runs merged. Nothing is
+ * written in place, at the cost of reading several runs per lookup.
  */
 class BTreeIndex {
  public:
   BTreeIndex();
+  ~BTreeIndex();
 
   /**
    * Open the index file in read or write mode.
@@ -62,6 +109,126 @@ class BTreeIndex {
    */
   RC insert(int key, const RecordId& rid);
 
+  /**
+   * A source of the (key, RecordId) pairs of bulkLoad(), in ascending
+   * key order.
+   * @return error code. 0 if no error, RC_END_OF_TREE after the last pair
+   */
+  typedef RC (*EntrySource)(void* arg, int& key, RecordId& rid);
+
+  /**
+   * Build the index from sorted (key, RecordId) pairs. The leaf nodes are
+   * filled one after the other and written in key order, and each level
+   * of nonleaf nodes is then built on top of the one below, so no node
+   * is ever split. The index must be empty.
+   * @param next[IN] the function that returns the pairs
+   * @param arg[IN] the first argument of next()
+   * @return error code. 0 if no error, RC_INVALID_FILE_MODE if the index
+   *         is not empty
+   */
+  RC bulkLoad(EntrySource next, void* arg);
+
+  /**
+   * Add sorted (key, RecordId) pairs by copying the leaf nodes they go to,
+   * and the nodes on the paths from the root to them, to pages that no
+   * tree uses (copy on write), and making the new root the index in one
+   * step when it is done. The subtrees that no pair goes to are shared
+   * with the old tree. Only the sibling pointers of the leaf nodes next
+   * to the copied ones are changed in place, so lookups and scans that
+   * run meanwhile, or started on the old tree, read its entries as they
+   * were, along with some of the new pairs; a crash before the next
+   * commit leaves the old tree. The replaced pages are reused after
+   * releasePages(). No other thread may insert or remove entries during
+   * the merge. Among equal keys, the entries of the index come first.
+   * @param next[IN] the function that returns the new pairs
+   * @param arg[IN] the first argument of next()
+   * @return error code. 0 if no error
+   */
+  RC merge(EntrySource next, void* arg);
+
+  /**
+   * Let newPage() reuse the pages of the nodes that merge() replaced. No
+   * cursor set up before the last merge may be used after this. The pages
+   * of a tree that the last commit still refers to are reused after the
+   * next commit.
+   */
+  void releasePages();
+
+  /**
+   * Make the index log-structured. The entries of the index become its
+   * oldest run; the file keeps the mode from the next commit on. No other
+   * thread may use the index meanwhile.
+   * @return error code. 0 if no error
+   */
+  RC makeLogStructured();
+
+  /**
+   * @return whether the index is log-structured
+   */
+  bool isLogStructured() const { return lsm; }
+
+  /**
+   * The entries a log-structured index keeps in memory before it writes
+   * them to a new run.
+   */
+  static const int MEMTABLE_SIZE = 32768;
+
+  /**
+   * Remove (key, RecordId) pair from the index.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+   *         is not in the index. a log-structured index only records the
+   *         removal and does not look for the pair.
+   */
+  RC remove(int key, const RecordId& rid);
+
+  /**
+   * Write all dirty index pages back to the disk. rootPid and treeHeight
+   * reach the file with the next commit.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * Commit the index, keeping the end of the table and the loading flag
+   * of the last commit.
+   * @return error code. 0 if no error
+   */
+  RC sync();
+
+  /**
+   * Force all index pages to stable storage, then commit rootPid,
+   * treeHeight and the end of the table covered by the index. When the
+   * index is opened again, it is the tree of the last commit; close()
+   * commits as well. A log-structured index first writes its memtable
+   * to a run, and commits the list of its runs.
+   * @param end[IN] the end RecordId of the table file: the index has an
+   *        entry for every tuple before it
+   * @param loading[IN] whether a LOAD is about to update the nodes in
+   *        place, so that the tree of this commit may not outlive a crash
+   * @return error code. 0 if no error
+   */
+  RC commit(const RecordId& end, bool loading);
+
+  /**
+   * @return the end RecordId of the table at the last commit
+   */
+  RecordId getIndexedEnd() const { return indexedEnd; }
+
+  /**
+   * @return whether the last commit was made with the loading flag
+   */
+  bool isLoading() const { return loading; }
+
+  /**
+   * Return the height of the tree, which is the number of nodes read by
+   * locate() to reach a leaf node. For a log-structured index, these are
+   * the nodes read in all runs.
+   * @return the height of the tree. 0 if the tree is empty
+   */
+  int getTreeHeight();
+
   /**
    * Find the leaf-node index entry whose key value is larger than or
    * equal to searchKey and output its location (i.e., the page id of the node
@@ -93,8 +260,334 @@ class BTreeIndex {
    * @return error code. 0 if no error
    */
   RC readForward(IndexCursor& cursor, int& key, RecordId& rid);
+
+  /**
+   * Find the position right after the last leaf-node index entry whose
+   * key is smaller than or equal to searchKey. Reading the index
+   * backward from there with readBackward() returns the entries in
+   * descending key order.
+   * @param searchKey[IN] the largest key to return
+   * @param cursor[OUT] the cursor to read backward with
+   * @return error code. 0 if no error.
+   */
+  RC locateBackward(int searchKey, IndexCursor& cursor);
+
+  /**
+   * Read the (key, rid) pair right before the location specified by the
+   * index cursor, and move the cursor backward to it.
+   * @param cursor[IN/OUT] the cursor set up by locateBackward()
+   * @param key[OUT] the key stored before the cursor location
+   * @param rid[OUT] the RecordId stored before the cursor location
+   * @return error code. 0 if no error
+   */
+  RC readBackward(IndexCursor& cursor, int& key, RecordId& rid);
+
+  /**
+   * Move the cursor forward to the first entry whose key is larger than
+   * or equal to searchKey. If that entry is in the leaf node the cursor
+   * is on, the cursor only moves inside the node; otherwise the entry is
+   * searched from the root like locate() does.
+   * Used to jump over the gaps between the key ranges of one scan.
+   * @param searchKey[IN] the key to find. it must be larger than every
+   * key readForward() returned since the cursor was set up
+   * @param cursor[IN/OUT] a cursor set up by locate()
+   * @return error code. 0 if no error
+   */
+  RC skipTo(int searchKey, IndexCursor& cursor);
   
  private:
+  BTreeIndex(const BTreeIndex&);             // not copyable: owns the latches
+  BTreeIndex& operator=(const BTreeIndex&);
+
+  /*
+   * Return the latch of the node stored at page pid.
+   * @param pid[IN] the PageId of the node
+   * @return the reader/writer latch of the node
+   */
+  pthread_rwlock_t* latch(PageId pid);
+
+  /*
+   * Release all latches in held.
+   * @param held[IN/OUT] the latches held by the caller; emptied
+   */
+  static void releaseLatches(std::vector<pthread_rwlock_t*>& held);
+
+  /*
+   * Release all latches in held except the last one, which belongs to a
+   * node that will absorb any change made below it.
+   * @param held[IN/OUT] the latches held by the caller, top-down
+   */
+  static void releaseAncestors(std::vector<pthread_rwlock_t*>& held);
+
+  /*
+   * Descend from the root to the leaf node that may contain searchKey
+   * with shared latches and return with the leaf node latched.
+   * @param searchKey[IN] the key to look for
+   * @param lowest[IN] go to the leftmost leaf that may contain searchKey
+   * (the first duplicate) instead of the rightmost one
+   * @param exclusive[IN] latch the leaf node exclusively
+   * @param pid[OUT] the PageId of the leaf node
+   * @param height[OUT] the height of the tree during the descent
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the tree is empty
+   */
+  RC latchLeaf(int searchKey, bool lowest, bool exclusive, PageId& pid, int& height);
+
+  /*
+   * Move the cursor from the leaf node in its buffer to cursor.pid.
+   * If the buffered leaf node was changed since it was read, the cursor
+   * is positioned again with relocate().
+   * @param cursor[IN/OUT] the cursor to move
+   * @return error code. 0 if no error
+   */
+  RC nextLeaf(IndexCursor& cursor);
+
+  /*
+   * Move the cursor from the leaf node in its buffer to its previous
+   * sibling cursor.pid. If the buffered leaf node or the link between the
+   * two nodes changed, the cursor is positioned with relocateBackward().
+   * @param cursor[IN/OUT] the cursor to move
+   * @return error code. 0 if no error
+   */
+  RC prevLeaf(IndexCursor& cursor);
+
+  /*
+   * Position the cursor right before the last entry it returned while
+   * reading backward, searching from the root.
+   * @param cursor[IN/OUT] the cursor to position
+   * @return error code. 0 if no error
+   */
+  RC relocateBackward(IndexCursor& cursor);
+
+  /*
+   * Point the previous node pointer of a leaf node to prevPid, latching
+   * the node exclusively.
+   * @param pid[IN] the PageId of the leaf node
+   * @param prevPid[IN] the PageId of its new previous sibling
+   * @return error code. 0 if no error
+   */
+  RC setPrevLeaf(PageId pid, PageId prevPid);
+
+  /*
+   * Point the next node pointer of a leaf node to nextPid, latching
+   * the node exclusively.
+   * @param pid[IN] the PageId of the leaf node
+   * @param nextPid[IN] the PageId of its new next sibling
+   * @return error code. 0 if no error
+   */
+  RC setNextLeaf(PageId pid, PageId nextPid);
+
+  /*
+   * Position the cursor right after the last entry it returned, searching
+   * from the root.
+   * @param cursor[IN/OUT] the cursor to position
+   * @return error code. 0 if no error
+   */
+  RC relocate(IndexCursor& cursor);
+
+  /*
+   * Write the nodes of a tree of sorted (key, RecordId) pairs to pages
+   * that no tree uses. The caller makes it the index, or a run of it.
+   * @param next[IN] the function that returns the pairs
+   * @param arg[IN] the first argument of next()
+   * @param root[OUT] the PageId of the root node, -1 if there are no pairs
+   * @param height[OUT] the height of the tree, 0 if there are no pairs
+   * @param count[OUT] the number of pairs
+   * @return error code. 0 if no error
+   */
+  RC build(EntrySource next, void* arg, PageId& root, int& height, int& count);
+
+  /*
+   * Write the nonleaf nodes of one level of a tree built bottom-up,
+   * filling each with as many of the nodes below as fit.
+   * @param children[IN] the first key and PageId of each node below, at
+   *                     least two
+   * @param parents[OUT] the first key and PageId of each node written
+   * @return error code. 0 if no error
+   */
+  RC writeParents(const std::vector<std::pair<int, PageId> >& children,
+                  std::vector<std::pair<int, PageId> >& parents);
+
+  /*
+   * Copy a node with the pairs of merge() below hi added to its subtree.
+   * The subtrees of its children that no pair goes to are kept.
+   * @param m[IN/OUT] the state of the merge
+   * @param pid[IN] the node to copy
+   * @param height[IN] the height of the node (e.g. a leaf node has height 1)
+   * @param bounded[IN] whether hi bounds the keys of the subtree
+   * @param hi[IN] the key of the subtree after this one
+   * @param out[OUT] the first key and PageId of each copy are appended
+   * @return error code. 0 if no error
+   */
+  RC mergeNode(PathMerge& m, PageId pid, int height, bool bounded, int hi,
+               std::vector<std::pair<int, PageId> >& out);
+
+  /*
+   * Copy a leaf node with the pairs of merge() below hi added to it, into
+   * as many leaf nodes as they take.
+   * @param m[IN/OUT] the state of the merge
+   * @param pid[IN] the leaf node to copy
+   * @param bounded[IN] whether hi bounds the keys of the leaf node
+   * @param hi[IN] the key of the leaf node after this one
+   * @param out[OUT] the first key and PageId of each copy are appended
+   * @return error code. 0 if no error
+   */
+  RC mergeLeaf(PathMerge& m, PageId pid, bool bounded, int hi,
+               std::vector<std::pair<int, PageId> >& out);
+
+  /*
+   * Write the last leaf node that merge() copied, now that the leaf
+   * node after it is known.
+   * @param m[IN/OUT] the state of the merge
+   * @param nextPid[IN] the PageId of the next leaf node, 0 if none
+   * @return error code. 0 if no error
+   */
+  RC finishLeaf(PathMerge& m, PageId nextPid);
+
+  /*
+   * Return a page that no tree uses: a page freed by a compaction that
+   * was committed since, or else one after the end of the file.
+   * @return the PageId of the page
+   */
+  PageId newPage();
+
+  /// A sorted run of a log-structured index: a tree built by build()
+  struct Run {
+      PageId rootPid;
+      int    treeHeight;
+      int    count;       // the number of entries, removals included
+  };
+
+  /// The most runs a log-structured index keeps
+  static const int MAX_RUNS = 16;
+
+  /*
+   * Add a pair to the memtable of a log-structured index, and write the
+   * memtable to a run if it is full.
+   * @param key[IN] the key of the pair
+   * @param rid[IN] the RecordId of the pair
+   * @param removed[IN] whether the pair is removed instead of inserted
+   * @return error code. 0 if no error
+   */
+  RC put(int key, const RecordId& rid, bool removed);
+
+  /*
+   * Write the memtable of a log-structured index to a new run.
+   * @param all[IN] write every entry added so far; otherwise only a full
+   *        memtable is written
+   * @return error code. 0 if no error
+   */
+  RC flushMemtable(bool all);
+
+  /*
+   * Merge runs until a log-structured index has room for one more run.
+   * @return error code. 0 if no error
+   */
+  RC makeRoom();
+
+  /*
+   * Merge the newest runs of a log-structured index into one, when each
+   * of them is not much larger than the newer ones together (or, with
+   * force, the two newest runs at least).
+   * @param force[IN] merge runs even if their sizes differ
+   * @param merged[OUT] whether runs were merged
+   * @return error code. 0 if no error
+   */
+  RC compact(bool force, bool& merged);
+
+  /*
+   * The background thread that merges the runs of a log-structured index.
+   * @param arg[IN] the index
+   */
+  static void* compactor(void* arg);
+
+  /*
+   * Start, stop and wake up the compactor thread.
+   */
+  void startCompactor();
+  void stopCompactor();
+  void wakeCompactor();
+
+  /*
+   * Collect the pages of the nodes of a run.
+   * @param run[IN] the run
+   * @param pages[IN/OUT] the pages are added here
+   * @return error code. 0 if no error
+   */
+  RC runPages(const Run& run, std::vector<PageId>& pages);
+
+  /*
+   * Find the pages that neither the tree nor a run of a log-structured
+   * index uses, and make them free.
+   * @return error code. 0 if no error
+   */
+  RC findFreePages();
+
+  /*
+   * Set up a cursor of a log-structured index to read from searchKey on,
+   * or backward down from it.
+   * @param searchKey[IN] the first key to read
+   * @param cursor[OUT] the cursor
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the index is empty
+   */
+  RC startCursor(int searchKey, IndexCursor& cursor);
+
+  /*
+   * Return the next entry of a cursor of a log-structured index.
+   * @param cursor[IN/OUT] the cursor
+   * @param backward[IN] read the keys in descending order
+   * @param key[OUT] the key of the entry
+   * @param rid[OUT] the RecordId of the entry
+   * @return error code. 0 if no error, RC_INVALID_CURSOR after the last entry
+   */
+  RC readCursor(IndexCursor& cursor, bool backward, int& key, RecordId& rid);
+
+  /*
+   * Read the entries of the keys from cursor.nextKey on (down from it,
+   * reading backward) of the memtables and the runs of a log-structured
+   * index, merged, into the cursor.
+   * @param cursor[IN/OUT] the cursor
+   * @param backward[IN] read the keys in descending order
+   * @return error code. 0 if no error
+   */
+  RC fillCursor(IndexCursor& cursor, bool backward);
+
+  /*
+   * Insert (key, RecordId) pair if it fits into its leaf node.
+   * @param key[IN] the key for the value inserted into the index
+   * @param rid[IN] the RecordId for the record being inserted into the index
+   * @return error code. 0 if no error, RC_NODE_FULL if the tree has to
+   *         be restructured
+   */
+  RC insertOptimistic(int key, const RecordId& rid);
+
+  /*
+   * Insert (key, RecordId) pair, splitting nodes as needed.
+   * The caller must hold smoLock.
+   * @param key[IN] the key for the value inserted into the index
+   * @param rid[IN] the RecordId for the record being inserted into the index
+   * @return error code. 0 if no error
+   */
+  RC insertPessimistic(int key, const RecordId& rid);
+
+  /*
+   * Remove (key, RecordId) pair if its leaf node stays at least half full.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair is
+   *         not in the index, RC_NODE_FULL if the tree has to be restructured
+   */
+  RC removeOptimistic(int key, const RecordId& rid);
+
+  /*
+   * Remove (key, RecordId) pair, rebalancing nodes as needed.
+   * The caller must hold smoLock.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+   *         is not in the index
+   */
+  RC removePessimistic(int key, const RecordId& rid);
+
   /*
    * Insert (key, RecordId) pair at the root level.
    * @warning This function should not be called directly.
@@ -111,12 +604,15 @@ class BTreeIndex {
    * @param rid[IN] the RecordId for the record being inserted into the index
    * @param pid[IN] pid of the node where the search should begin
    * @param newNodeKey[OUT] the first key of the newly inserted node in case of an
-   * overflow, otherwise -1
-   * @param newNodePid[OUT] newly inserted node's pid in case of an overflow
+   * overflow
+   * @param newNodePid[OUT] newly inserted node's pid in case of an overflow,
+   * otherwise -1
+   * @param held[IN/OUT] exclusive latches held on the path, ending with pid's
    * @return error code. 0 if no error
    */
   RC insertAtLeafNode(int key, const RecordId& rid, PageId pid,
-                      int& newNodeKey, PageId& newNodePid);
+                      int& newNodeKey, PageId& newNodePid,
+                      std::vector<pthread_rwlock_t*>& held);
 
   /*
    * Recursively insert a (key, RecordId) pair into the index.
@@ -126,12 +622,42 @@ class BTreeIndex {
    * @param pid[IN] pid of the node where the search should begin
    * @param height[IN] the height of the pid node (e.g. root has height 1)
    * @param newNodeKey[OUT] the first key of the newly inserted node in case of an
-   * overflow, otherwise -1
-   * @param newNodePid[OUT] newly inserted node's pid in case of an overflow
+   * overflow
+   * @param newNodePid[OUT] newly inserted node's pid in case of an overflow,
+   * otherwise -1
+   * @param held[IN/OUT] exclusive latches held on the path, ending with pid's
    * @return error code. 0 if no error
    */
   RC insertAtNonLeafNode(int key, const RecordId& rid, PageId pid, int height,
-                         int& newNodeKey, PageId& newNodePid);
+                         int& newNodeKey, PageId& newNodePid,
+                         std::vector<pthread_rwlock_t*>& held);
+
+  /*
+   * Recursively remove a (key, RecordId) pair from the subtree rooted at pid.
+   * The caller must hold the exclusive latch of pid.
+   * @warning This function should not be called directly.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @param pid[IN] pid of the node where the search should begin
+   * @param height[IN] the height of the pid node (e.g. root has height 1)
+   * @param underflow[OUT] true if the node holds fewer keys than its minimum
+   * after the removal
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the pair
+   *         is not in the subtree
+   */
+  RC removeAtNode(int key, const RecordId& rid, PageId pid, int height,
+                  bool& underflow);
+
+  /*
+   * Fix an underflowing child of a non-leaf node by borrowing entries from
+   * a sibling or by merging it with a sibling.
+   * @warning This function should not be called directly.
+   * @param node[IN/OUT] the parent node
+   * @param childIndex[IN] the index of the underflowing child in node
+   * @param height[IN] the height of the parent node
+   * @return error code. 0 if no error
+   */
+  RC rebalanceChild(BTNonLeafNode& node, int childIndex, int height);
 
   PageFile pf;         /// the PageFile used to store the actual b+tree in disk
 
@@ -141,6 +667,53 @@ class BTreeIndex {
   /// this class is destructed. Make sure to store the values of the two 
   /// variables in disk, so that they can be reconstructed when the index
   /// is opened again later.
+
+  RecordId indexedEnd; /// the end of the table at the last commit
+  bool     loading;    /// the loading flag of the last commit
+
+  /// The metadata of the index file, written by commit().
+  struct Meta {
+      PageId   rootPid;
+      int      treeHeight;
+      RecordId indexedEnd;
+      int      loading;
+      int      lsm;                /// whether the index is log-structured
+      int      runCount;
+      Run      runs[MAX_RUNS];     /// the runs, oldest first
+  };
+
+  /**
+   * Fill the metadata of the index as it is now.
+   * @param meta[OUT] the metadata
+   */
+  void getMeta(Meta& meta);
+
+  pthread_rwlock_t rootLatch;   /// protects rootPid and treeHeight
+  pthread_mutex_t  smoLock;     /// serializes splits, merges and redistributions
+
+  std::vector<pthread_rwlock_t*> latches;  /// node latches indexed by PageId
+  pthread_mutex_t  latchesLock; /// protects the latches vector
+
+  pthread_mutex_t  allocLock;   /// protects the following four
+  PageId           nextPid;     /// the first page after those newPage() returned
+  std::vector<PageId> freePages;    /// pages that no committed run uses
+  std::vector<PageId> pendingFree;  /// pages of merged runs, free after the next commit
+  std::vector<PageId> retired;      /// pages of replaced trees, free after releasePages()
+
+  bool             lsm;         /// whether the index is log-structured
+  std::vector<Run> runs;        /// the runs, oldest first
+  SkipList*        mem;         /// the memtable that new pairs go to
+  SkipList*        imm;         /// the memtable being written to a run, or NULL
+  pthread_rwlock_t lsmLatch;    /// protects runs, mem and imm
+  pthread_mutex_t  flushLock;   /// serializes the writes of the memtable
+  pthread_mutex_t  compactLock; /// serializes the merges of runs
+
+  pthread_t        compactorThread;
+  bool             compactorRunning;
+  bool             compactorWake;    /// a run was added since the compactor looked
+  bool             compactorStop;
+  pthread_mutex_t  compactorLock;    /// protects the three flags above
+  pthread_cond_t   compactorCond;
 };
 
 #endif /* BTREEINDEX_H */
@@ -5,7 +5,15 @@
 #include <iostream>
 #include <sstream>
 #include <cstdio>
+#include <cstring>
 #include <set>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 static void generateTestFileRecordFile(std::string filename,
                                        RecordFile& rf, 
@@ -16,6 +24,61 @@ static void generateEmptyTestIndexFile(std::string filename,
                                        
 static void print_index(BTreeIndex& index, RecordFile& rf,int startKey);
 
+// shared state of the threads of the concurrency test
+struct StressArg {
+    BTreeIndex*   index;
+    int           id;          // thread number
+    int           threads;     // number of writer threads
+    int           range;       // keys are in [0, range)
+    volatile int* writersLeft; // writer threads that are still running
+    int           errors;      // failed checks seen by the thread
+};
+
+static void* stressWriter(void* arg);
+static void* stressReader(void* arg);
+
+// the pairs of the bulk load test: every key in [0, range) twice
+struct BulkArg {
+    int next;   // the next pair to return
+    int range;
+};
+
+static RC bulkSource(void* arg, int& key, RecordId& rid);
+
+// the pairs of a merge from a list sorted by key
+struct ListArg {
+    std::vector<IndexEntry> entries;
+    size_t next;  // the next pair to return
+};
+
+static RC listSource(void* arg, int& key, RecordId& rid);
+
+// the key of the i-th insert of the crash test, scattered over the tree
+static int crashKey(int i) { return (int) ((long long) i * 7919 % 100003); }
+
+// shared state of the threads of the small cache test
+struct CacheArg {
+    PageFile* pf;
+    int       id;       // thread number; the thread owns pages id + k * threads
+    int       threads;
+    int       pages;    // the pages of each thread
+    int       rounds;   // the times each page is written
+    int       errors;   // failed checks seen by the thread
+};
+
+static void* cacheWorker(void* arg);
+
+// fill a page of the small cache test with what round wrote to pid
+static void fillPage(int* page, int pid, int round);
+
+// whether a page holds what some round wrote to pid, or zeros. the
+// round is returned, 0 for zeros, -1 for anything else.
+static int pageRound(const int* page, int pid);
+
+static void crashWriter(const char* filename, int out);
+static void* threadIo(void* arg);
+static void checkpointWriter(const char* table, const char* index, int out);
+
 int main( int argc, const char* argv[] )
 {
     int test = argc > 1 ? atoi(argv[1]) : 0;
@@ -106,7 +169,715 @@ int main( int argc, const char* argv[] )
             }
             ASSERT(0 == bt_index.close());
         } break;
+        case 2: {
+            std::cout << "Delete Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int range = 8192;
+            std::vector<int> keys;
+            for (int i = 0; i < range; ++i)
+            {
+                keys.push_back(i - range / 2);   // includes 0 and negatives
+            }
+            std::random_shuffle(keys.begin(), keys.end());
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                RecordId rid = { keys[i], 0 };
+                ASSERT(0 == bt_index.insert(keys[i], rid));
+            }
+
+            // remove two out of three keys, in random order
+            std::random_shuffle(keys.begin(), keys.end());
+            std::set<int> remaining;
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                RecordId rid = { keys[i], 0 };
+                if (keys[i] % 3 == 0)
+                {
+                    remaining.insert(keys[i]);
+                    continue;
+                }
+                LOOP_ASSERT(keys[i], 0 == bt_index.remove(keys[i], rid));
+                LOOP_ASSERT(keys[i], 0 != bt_index.remove(keys[i], rid));
+            }
+
+            // the scan returns exactly the remaining keys, in order
+            IndexCursor cursor;
+            int key;
+            RecordId rid;
+            std::set<int>::iterator it = remaining.begin();
+            ASSERT(0 == bt_index.locate(-range, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                ASSERT(it != remaining.end());
+                if (it == remaining.end()) break;
+                LOOP2_ASSERT(key, *it, key == *it);
+                LOOP2_ASSERT(key, rid.pid, key == rid.pid);
+                ++it;
+            }
+            ASSERT(it == remaining.end());
+
+            // and backward, in reverse order, over the relinked leaves
+            std::set<int>::reverse_iterator rit = remaining.rbegin();
+            ASSERT(0 == bt_index.locateBackward(range, cursor));
+            while (0 == bt_index.readBackward(cursor, key, rid))
+            {
+                ASSERT(rit != remaining.rend());
+                if (rit == remaining.rend()) break;
+                LOOP2_ASSERT(key, *rit, key == *rit);
+                ++rit;
+            }
+            ASSERT(rit == remaining.rend());
+
+            // point lookups still work after merges and redistributions
+            ASSERT(0 == bt_index.locate(0, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            ASSERT(0 == key);
+
+            // remove the rest; the tree collapses to an empty leaf
+            for (it = remaining.begin(); it != remaining.end(); ++it)
+            {
+                RecordId rid = { *it, 0 };
+                LOOP_ASSERT(*it, 0 == bt_index.remove(*it, rid));
+            }
+            ASSERT(0 == bt_index.locate(0, cursor));
+            ASSERT(0 != bt_index.readForward(cursor, key, rid));
+            ASSERT(0 == bt_index.close());
+        } break;
         
+        case 3: {
+            // Concurrency Test
+            // writers insert (and remove some of) disjoint key sets while
+            // readers keep scanning; every scan must be sorted
+            std::cout << "Concurrency Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            const int WRITERS = 4, READERS = 4;
+            int range = 32768;
+            volatile int writersLeft = WRITERS;
+            pthread_t threads[WRITERS + READERS];
+            StressArg args[WRITERS + READERS];
+            for (int i = 0; i < WRITERS + READERS; ++i)
+            {
+                StressArg arg = { &bt_index, i, WRITERS, range, &writersLeft, 0 };
+                args[i] = arg;
+                ASSERT(0 == pthread_create(&threads[i], NULL,
+                                           i < WRITERS ? stressWriter : stressReader,
+                                           &args[i]));
+            }
+            for (int i = 0; i < WRITERS + READERS; ++i)
+            {
+                pthread_join(threads[i], NULL);
+                LOOP2_ASSERT(i, args[i].errors, 0 == args[i].errors);
+            }
+
+            // every third key was removed again
+            IndexCursor cursor;
+            int key, expected = 1;
+            RecordId rid;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, expected, key == expected);
+                LOOP2_ASSERT(key, rid.pid, key == rid.pid);
+                if (key != expected) break;
+                expected += (expected % 3 == 2) ? 2 : 1;
+            }
+            LOOP_ASSERT(expected, expected >= range);
+            ASSERT(0 == bt_index.close());
+        } break;
+
+        case 4: {
+            // Skip Test
+            // skipTo() jumps over gaps within a leaf and across leaves
+            std::cout << "Skip Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int range = 4096;
+            for (int i = 0; i < range; i += 2)
+            {
+                RecordId rid = { i, 0 };
+                ASSERT(0 == bt_index.insert(i, rid));
+            }
+
+            IndexCursor cursor;
+            int key;
+            RecordId rid;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            ASSERT(0 == key);
+
+            // a few keys ahead, in the same leaf node
+            ASSERT(0 == bt_index.skipTo(7, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            LOOP_ASSERT(key, 8 == key);
+
+            // in another leaf node
+            ASSERT(0 == bt_index.skipTo(3001, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            LOOP_ASSERT(key, 3002 == key);
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            LOOP_ASSERT(key, 3004 == key);
+
+            // beyond the last key
+            ASSERT(0 == bt_index.skipTo(range, cursor));
+            ASSERT(0 != bt_index.readForward(cursor, key, rid));
+            ASSERT(0 == bt_index.close());
+        } break;
+
+        case 5: {
+            // Bulk Load Test
+            // a tree built bottom-up from sorted pairs reads back in order
+            // and takes inserts and removes like any other
+            std::cout << "Bulk Load Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int range = 20000;
+            BulkArg arg = { 0, range };
+            ASSERT(0 == bt_index.bulkLoad(bulkSource, &arg));
+            ASSERT(bt_index.getTreeHeight() >= 3);
+            ASSERT(0 != bt_index.bulkLoad(bulkSource, &arg));
+
+            IndexCursor cursor;
+            int key, prevKey = -1, count = 0;
+            RecordId rid;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key >= prevKey && key == rid.pid);
+                prevKey = key;
+                count++;
+            }
+            LOOP_ASSERT(count, 2 * range == count);
+
+            count = 0;
+            prevKey = range;
+            ASSERT(0 == bt_index.locateBackward(range, cursor));
+            while (0 == bt_index.readBackward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key <= prevKey);
+                prevKey = key;
+                count++;
+            }
+            LOOP_ASSERT(count, 2 * range == count);
+
+            // a key found by a search from the root
+            ASSERT(0 == bt_index.locate(range - 1, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            LOOP_ASSERT(key, range - 1 == key);
+
+            for (int i = 0; i < range; i += 3)
+            {
+                RecordId r1 = { i, 0 }, r2 = { i, 1 };
+                ASSERT(0 == bt_index.remove(i, r1));
+                ASSERT(0 == bt_index.remove(i, r2));
+            }
+            for (int i = range; i < 2 * range; ++i)
+            {
+                RecordId r = { i, 0 };
+                ASSERT(0 == bt_index.insert(i, r));
+            }
+
+            count = 0;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP_ASSERT(key, key % 3 != 0 || key >= range);
+                count++;
+            }
+            LOOP_ASSERT(count, 2 * (range - (range + 2) / 3) + range == count);
+
+            // a merge copies the paths to the leaf nodes it adds pairs
+            // to; a cursor set up before it reads every entry of the old
+            // tree in order, and may go on into the new pairs
+            IndexCursor old;
+            int before = count;
+            prevKey = -1;
+            ASSERT(0 == bt_index.locate(0, old));
+            BulkArg more = { 4 * range, 5 * range / 2 };  // range pairs of keys from 2 * range up
+            ASSERT(0 == bt_index.merge(bulkSource, &more));
+
+            count = 0;
+            while (0 == bt_index.readForward(old, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key >= prevKey);
+                prevKey = key;
+                if (key < 2 * range) count++;
+            }
+            LOOP2_ASSERT(count, before, before == count);
+
+            count = 0;
+            prevKey = -1;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key >= prevKey);
+                prevKey = key;
+                count++;
+            }
+            LOOP2_ASSERT(count, before, before + range == count);
+
+            // the pages of the trees replaced by merges are reused once
+            // no cursor reads them, so the file stops growing
+            struct stat st;
+            RecordId end = { 0, 0 };
+            ASSERT(0 == bt_index.commit(end, false));
+            bt_index.releasePages();
+            BulkArg few = { 2 * 10 * range, 10 * range + 5 };
+            ASSERT(0 == bt_index.merge(bulkSource, &few));
+            ASSERT(0 == bt_index.commit(end, false));
+            bt_index.releasePages();
+            ASSERT(0 == stat("index_file.txt", &st));
+            off_t size = st.st_size;
+            for (int i = 1; i <= 6; ++i)
+            {
+                BulkArg more = { 2 * (10 * range + 5 * i), 10 * range + 5 * i + 5 };
+                ASSERT(0 == bt_index.merge(bulkSource, &more));
+                ASSERT(0 == bt_index.commit(end, false));
+                bt_index.releasePages();
+            }
+            ASSERT(0 == stat("index_file.txt", &st));
+            LOOP2_ASSERT(st.st_size, size, st.st_size <= size + size / 16);
+
+            count = 0;
+            prevKey = -1;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key >= prevKey && key == rid.pid);
+                prevKey = key;
+                count++;
+            }
+            LOOP2_ASSERT(count, before, before + range + 70 == count);
+            ASSERT(0 == bt_index.close());
+
+            // the pages no tree uses are found when the index is opened
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            BulkArg last = { 2 * 20 * range, 20 * range + 5 };
+            ASSERT(0 == bt_index.merge(bulkSource, &last));
+            ASSERT(0 == bt_index.close());
+            ASSERT(0 == stat("index_file.txt", &st));
+            LOOP2_ASSERT(st.st_size, size, st.st_size <= size + size / 16);
+
+            // pairs spread over the tree, and a run of equal keys that
+            // takes several leaf nodes, split the copies of the nodes
+            // they go to; scans both ways see every pair in order
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int total = 0, sevens = 0;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                total++;
+                if (key == 7777) sevens++;
+            }
+            ListArg spread;
+            spread.next = 0;
+            for (int i = 0; i < 20 * range; i += 997)
+            {
+                for (int j = 0; j < (i / 997 == 7 ? 300 : 1); j++)
+                {
+                    IndexEntry e = { i / 997 == 7 ? 7777 : i, { i / 997 == 7 ? 7777 : i, 2 + j } };
+                    spread.entries.push_back(e);
+                }
+            }
+            ASSERT(0 == bt_index.merge(listSource, &spread));
+
+            count = 0;
+            int newSevens = 0;
+            prevKey = -1;
+            ASSERT(0 == bt_index.locate(0, cursor));
+            while (0 == bt_index.readForward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key >= prevKey && key == rid.pid);
+                prevKey = key;
+                if (key == 7777) newSevens++;
+                count++;
+            }
+            LOOP2_ASSERT(count, total, total + (int) spread.entries.size() == count);
+            LOOP2_ASSERT(newSevens, sevens, sevens + 300 == newSevens);
+
+            count = 0;
+            prevKey = 30 * range;
+            ASSERT(0 == bt_index.locateBackward(30 * range, cursor));
+            while (0 == bt_index.readBackward(cursor, key, rid))
+            {
+                LOOP2_ASSERT(key, prevKey, key <= prevKey);
+                prevKey = key;
+                count++;
+            }
+            LOOP2_ASSERT(count, total, total + (int) spread.entries.size() == count);
+
+            ASSERT(0 == bt_index.locate(7777, cursor));
+            ASSERT(0 == bt_index.readForward(cursor, key, rid));
+            LOOP_ASSERT(key, 7777 == key);
+            ASSERT(0 == bt_index.close());
+        } break;
+
+        case 6: {
+            // Log-Structured Test
+            // inserts and removes go through the memtable into runs that
+            // are merged in the background; scans read them all merged,
+            // also after the index is opened again
+            std::cout << "Log-Structured Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int range = 3 * BTreeIndex::MEMTABLE_SIZE;
+            BulkArg arg = { 0, range };
+            ASSERT(0 == bt_index.bulkLoad(bulkSource, &arg));
+            ASSERT(0 == bt_index.makeLogStructured());
+            ASSERT(bt_index.isLogStructured());
+
+            // every key of [range, 2 * range) once, in a scattered order
+            int expected = 2 * range;
+            for (int i = 0; i < range; ++i)
+            {
+                int key = range + (int) ((long long) i * 7919 % range);
+                RecordId r = { key, 0 };
+                ASSERT(0 == bt_index.insert(key, r));
+                expected++;
+            }
+            for (int i = 0; i < 2 * range; i += 3)
+            {
+                RecordId r = { i, (i < range) ? 1 : 0 };
+                ASSERT(0 == bt_index.remove(i, r));
+                expected--;
+            }
+            RecordId back = { 0, 1 };
+            ASSERT(0 == bt_index.insert(0, back));
+            expected++;
+
+            for (int pass = 0; pass < 2; pass++)
+            {
+                IndexCursor cursor;
+                int key, prevKey = -1, count = 0;
+                RecordId rid, prevRid = { -1, -1 };
+                ASSERT(0 == bt_index.locate(0, cursor));
+                while (0 == bt_index.readForward(cursor, key, rid))
+                {
+                    LOOP2_ASSERT(key, prevKey, key > prevKey || (key == prevKey && rid > prevRid));
+                    LOOP2_ASSERT(key, rid.sid, key == rid.pid && (key % 3 != 0 || key == 0 || (key < range && rid.sid == 0)));
+                    prevKey = key;
+                    prevRid = rid;
+                    count++;
+                }
+                LOOP2_ASSERT(count, expected, expected == count);
+
+                count = 0;
+                prevKey = 2 * range;
+                ASSERT(0 == bt_index.locateBackward(2 * range, cursor));
+                while (0 == bt_index.readBackward(cursor, key, rid))
+                {
+                    LOOP2_ASSERT(key, prevKey, key <= prevKey);
+                    prevKey = key;
+                    count++;
+                }
+                LOOP2_ASSERT(count, expected, expected == count);
+
+                // the pairs of one key, and a jump over keys
+                ASSERT(0 == bt_index.locate(0, cursor));
+                ASSERT(0 == bt_index.readForward(cursor, key, rid));
+                LOOP2_ASSERT(key, rid.sid, 0 == key && 0 == rid.sid);
+                ASSERT(0 == bt_index.readForward(cursor, key, rid));
+                LOOP2_ASSERT(key, rid.sid, 0 == key && 1 == rid.sid);
+                ASSERT(0 == bt_index.skipTo(range + 1, cursor));
+                ASSERT(0 == bt_index.readForward(cursor, key, rid));
+                LOOP_ASSERT(key, range + 1 == key);
+                ASSERT(0 == bt_index.skipTo(2 * range, cursor));
+                ASSERT(0 != bt_index.readForward(cursor, key, rid));
+
+                // the memtable and the runs are committed, and read again
+                if (pass == 0)
+                {
+                    RecordId end = { 2 * range, 0 };
+                    ASSERT(0 == bt_index.commit(end, false));
+                    ASSERT(0 == bt_index.close());
+                    ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+                    ASSERT(bt_index.isLogStructured());
+                    ASSERT(bt_index.getTreeHeight() > 0);
+                }
+            }
+            ASSERT(0 == bt_index.close());
+        } break;
+        case 7: {
+            // Batch Read Test
+            // the records of the rids found in the index are read in
+            // batches, with both backends of the reads, and match those
+            // read one by one
+            std::cout << "Batch Read Test" << std::endl;
+            BTreeIndex bt_index;
+            generateEmptyTestIndexFile("index_file.txt", index_file);
+            ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+            int range = 4096;
+            RecordFile rf;
+            generateTestFileRecordFile("testRecordFile.txt", rf, range);
+            for (RecordId rid = { 0, 0 }; rid < rf.endRid(); ++rid)
+            {
+                int key;
+                std::string value;
+                ASSERT(0 == rf.read(rid, key, value));
+                ASSERT(0 == bt_index.insert(key, rid));
+                if (key % 5 == 0) ASSERT(0 == rf.remove(rid));
+            }
+            ASSERT(0 == rf.flush());
+
+            for (int b = 0; b < 2; b++)
+            {
+                AsyncIo::setBackend(b == 0 ? AsyncIo::URING_BACKEND : AsyncIo::THREAD_BACKEND);
+                AsyncIo io;
+                IndexCursor cursor;
+                std::vector<RecordId> rids;
+                int key, count = 0;
+                RecordId rid;
+                ASSERT(0 == bt_index.locate(1, cursor));
+                while (0 == bt_index.readForward(cursor, key, rid))
+                {
+                    rids.push_back(rid);
+                }
+                LOOP_ASSERT(rids.size(), range == (int) rids.size());
+
+                // scatter the rids over the pages of the file
+                std::vector<RecordId> batch;
+                for (int i = 0; i < range; i++)
+                {
+                    batch.push_back(rids[(long long) i * 7919 % range]);
+                }
+                for (int i = 0; i < range; i += 500)
+                {
+                    int n = std::min(500, range - i);
+                    std::vector<int> keys(n);
+                    std::vector<std::string> values(n);
+                    std::vector<RC> rcs(n);
+                    ASSERT(0 == rf.readBatch(io, &batch[i], n, &keys[0], &values[0], &rcs[0]));
+                    for (int j = 0; j < n; j++)
+                    {
+                        std::string value;
+                        RC rc = rf.read(batch[i + j], key, value);
+                        LOOP2_ASSERT(i + j, rcs[j], rc == rcs[j]);
+                        if (rc == 0)
+                        {
+                            LOOP2_ASSERT(key, keys[j], key == keys[j] && value == values[j]);
+                            count++;
+                        }
+                    }
+                    ASSERT(0 == io.pending());
+                }
+                LOOP_ASSERT(count, range - range / 5 == count);
+            }
+            AsyncIo::setBackend(AsyncIo::URING_BACKEND);
+
+            // each thread keeps one AsyncIo for its batches
+            AsyncIo* mine = &AsyncIo::forThread();
+            AsyncIo* other = NULL;
+            pthread_t thread;
+            ASSERT(mine == &AsyncIo::forThread());
+            ASSERT(0 == pthread_create(&thread, NULL, threadIo, &other));
+            ASSERT(0 == pthread_join(thread, NULL));
+            ASSERT(other != NULL && other != mine);
+            for (int i = 0; i < 3; i++)
+            {
+                std::vector<RecordId> rids;
+                for (RecordId rid = { i, 0 }; rid < rf.endRid(); rid.pid += 7) rids.push_back(rid);
+                std::vector<int> keys(rids.size());
+                std::vector<std::string> values(rids.size());
+                std::vector<RC> rcs(rids.size());
+                ASSERT(0 == rf.readBatch(*mine, &rids[0], rids.size(), &keys[0], &values[0], &rcs[0]));
+                ASSERT(0 == mine->pending());
+            }
+            ASSERT(0 == rf.close());
+            ASSERT(0 == bt_index.close());
+        } break;
+
+        case 8: {
+            // Crash Test
+            // a process that inserts and commits now and then is killed in
+            // the middle; the index opened again holds exactly the pairs
+            // of its last commit, in order
+            std::cout << "Crash Test" << std::endl;
+            for (int round = 0; round < 3; round++)
+            {
+                generateEmptyTestIndexFile("index_file.txt", index_file);
+                unlink("index_file.txt.jnl");
+                int fds[2];
+                ASSERT(0 == pipe(fds));
+                pid_t child = fork();
+                if (child == 0)
+                {
+                    close(fds[0]);
+                    crashWriter("index_file.txt", fds[1]);
+                    _exit(0);
+                }
+                close(fds[1]);
+
+                // kill the writer some way into the commits after the first
+                int committed, commits = 0;
+                while (commits < 4 + 3 * round &&
+                       read(fds[0], &committed, sizeof(committed)) == sizeof(committed))
+                {
+                    commits++;
+                }
+                usleep(1000 * (round + 1));
+                kill(child, SIGKILL);
+                waitpid(child, NULL, 0);
+                close(fds[0]);
+
+                // the last record of the journal may be torn
+                FILE* jnl = fopen("index_file.txt.jnl", "r+");
+                if (jnl != NULL)
+                {
+                    fseek(jnl, 0, SEEK_END);
+                    long size = ftell(jnl);
+                    if (size > 100) ASSERT(0 == ftruncate(fileno(jnl), size - 100));
+                    fclose(jnl);
+                }
+
+                BTreeIndex bt_index;
+                ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+                int end = bt_index.getIndexedEnd().pid;
+                LOOP2_ASSERT(end, committed, end >= committed);
+
+                IndexCursor cursor;
+                int key, prevKey = -1, count = 0;
+                RecordId rid;
+                std::vector<bool> seen(end, false);
+                ASSERT(0 == bt_index.locate(0, cursor));
+                while (0 == bt_index.readForward(cursor, key, rid))
+                {
+                    LOOP2_ASSERT(key, prevKey, key >= prevKey);
+                    LOOP2_ASSERT(rid.pid, end, rid.pid >= 0 && rid.pid < end);
+                    if (rid.pid < 0 || rid.pid >= end) continue;
+                    LOOP2_ASSERT(key, rid.pid, key == crashKey(rid.pid) && !seen[rid.pid]);
+                    seen[rid.pid] = true;
+                    prevKey = key;
+                    count++;
+                }
+                LOOP2_ASSERT(count, end, count == end);
+
+                // the index takes inserts again
+                RecordId more = { end, 0 };
+                ASSERT(0 == bt_index.insert(crashKey(end), more));
+                ASSERT(0 == bt_index.close());
+            }
+        } break;
+
+        case 9: {
+            // Checkpoint Crash Test
+            // a process that appends tuples to a table and their keys to
+            // its index, with checkpoints in between, is killed in the
+            // middle; the index holds one pair for each tuple it covers
+            std::cout << "Checkpoint Crash Test" << std::endl;
+            for (int round = 0; round < 3; round++)
+            {
+                unlink("testRecordFile.txt");
+                unlink("testRecordFile.txt.jnl");
+                generateEmptyTestIndexFile("index_file.txt", index_file);
+                unlink("index_file.txt.jnl");
+                int fds[2];
+                ASSERT(0 == pipe(fds));
+                pid_t child = fork();
+                if (child == 0)
+                {
+                    close(fds[0]);
+                    checkpointWriter("testRecordFile.txt", "index_file.txt", fds[1]);
+                    _exit(0);
+                }
+                close(fds[1]);
+
+                int committed, commits = 0;
+                while (commits < 3 + 2 * round &&
+                       read(fds[0], &committed, sizeof(committed)) == sizeof(committed))
+                {
+                    commits++;
+                }
+                usleep(2000 * (round + 1));
+                kill(child, SIGKILL);
+                waitpid(child, NULL, 0);
+                close(fds[0]);
+
+                RecordFile rf;
+                BTreeIndex bt_index;
+                ASSERT(0 == rf.open("testRecordFile.txt", 'w'));
+                ASSERT(0 == bt_index.open("index_file.txt", 'w'));
+                RecordId end = bt_index.getIndexedEnd();
+                ASSERT(end <= rf.endRid());
+
+                int tuples = 0, key;
+                std::string value;
+                for (RecordId rid = { 0, 0 }; rid < end; ++rid)
+                {
+                    LOOP2_ASSERT(rid.pid, rid.sid, 0 == rf.read(rid, key, value));
+                    tuples++;
+                }
+                LOOP2_ASSERT(tuples, committed, tuples >= committed);
+
+                IndexCursor cursor;
+                int count = 0;
+                RecordId rid;
+                std::set<std::pair<int, int> > seen;
+                ASSERT(0 == bt_index.locate(0, cursor));
+                while (0 == bt_index.readForward(cursor, key, rid))
+                {
+                    int tupleKey;
+                    LOOP2_ASSERT(rid.pid, rid.sid, rid < end);
+                    LOOP2_ASSERT(rid.pid, rid.sid, seen.insert(std::make_pair(rid.pid, rid.sid)).second);
+                    ASSERT(0 == rf.read(rid, tupleKey, value));
+                    LOOP2_ASSERT(key, tupleKey, key == tupleKey);
+                    count++;
+                }
+                LOOP2_ASSERT(count, tuples, count == tuples);
+                ASSERT(0 == rf.close());
+                ASSERT(0 == bt_index.close());
+            }
+        } break;
+
+        case 10: {
+            // Small Cache Test
+            // threads that write and read back pages of their own, and
+            // read the pages of the others, through a cache with fewer
+            // pages than threads, see whole pages and their own last
+            // writes, and the file ends up with the last round of each
+            std::cout << "Small Cache Test" << std::endl;
+            const int THREADS = 8, PAGES = 16, ROUNDS = 100;
+            ASSERT(0 == PageFile::setCacheSize(3));
+            ASSERT(3 == PageFile::getCacheSize());
+            unlink("cache_file.txt");
+            PageFile pf;
+            ASSERT(0 == pf.open("cache_file.txt", 'w'));
+            int page[PageFile::PAGE_SIZE / sizeof(int)];
+            fillPage(page, 0, 0);
+            ASSERT(0 == pf.write(0, page));
+            ASSERT(RC_INVALID_FILE_MODE == PageFile::setCacheSize(5));
+
+            pthread_t threads[THREADS];
+            CacheArg args[THREADS];
+            for (int i = 0; i < THREADS; ++i)
+            {
+                CacheArg arg = { &pf, i, THREADS, PAGES, ROUNDS, 0 };
+                args[i] = arg;
+                ASSERT(0 == pthread_create(&threads[i], NULL, cacheWorker, &args[i]));
+            }
+            for (int i = 0; i < THREADS; ++i)
+            {
+                pthread_join(threads[i], NULL);
+                LOOP2_ASSERT(i, args[i].errors, 0 == args[i].errors);
+            }
+            ASSERT(0 == pf.close());
+
+            ASSERT(0 == pf.open("cache_file.txt", 'r'));
+            ASSERT(pf.endPid() == THREADS * PAGES);
+            for (int pid = 0; pid < THREADS * PAGES; ++pid)
+            {
+                ASSERT(0 == pf.read(pid, page));
+                LOOP2_ASSERT(pid, pageRound(page, pid), ROUNDS == pageRound(page, pid));
+            }
+            ASSERT(0 == pf.close());
+            ASSERT(0 == PageFile::setCacheSize(PageFile::DEFAULT_CACHE_SIZE));
+        } break;
+
         default: {
             std::cerr << "WARNING: CASE `" << test << "' NOT FOUND." << std::endl;
             testStatus = -1;
@@ -136,6 +907,95 @@ static void generateEmptyTestIndexFile(std::string filename,
     pf.open(filename, 'W');
 }
 
+static void* stressWriter(void* arg)
+{
+    StressArg* a = (StressArg*) arg;
+    unsigned seed = a->id;
+    std::vector<int> keys;
+
+    for (int key = a->id; key < a->range; key += a->threads)
+    {
+        keys.push_back(key);
+    }
+    for (size_t i = keys.size(); i > 1; --i)
+    {
+        std::swap(keys[i - 1], keys[rand_r(&seed) % i]);
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        RecordId rid = { keys[i], 0 };
+        if (0 != a->index->insert(keys[i], rid)) a->errors++;
+    }
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        RecordId rid = { keys[i], 0 };
+        if (keys[i] % 3 == 0 && 0 != a->index->remove(keys[i], rid)) a->errors++;
+    }
+
+    __sync_fetch_and_sub(a->writersLeft, 1);
+    return NULL;
+}
+
+static void* stressReader(void* arg)
+{
+    StressArg* a = (StressArg*) arg;
+    unsigned seed = a->id;
+
+    while (__sync_fetch_and_add(a->writersLeft, 0) > 0)
+    {
+        IndexCursor cursor;
+        int key, prevKey = -1;
+        RecordId rid;
+
+        // alternate between forward and backward scans
+        if (rand_r(&seed) % 2 == 0)
+        {
+            if (0 != a->index->locate(rand_r(&seed) % a->range, cursor)) continue;
+            for (int i = 0; i < 500 && 0 == a->index->readForward(cursor, key, rid); ++i)
+            {
+                if (key <= prevKey || key != rid.pid) a->errors++;
+                prevKey = key;
+            }
+        }
+        else
+        {
+            prevKey = a->range;
+            if (0 != a->index->locateBackward(rand_r(&seed) % a->range, cursor)) continue;
+            for (int i = 0; i < 500 && 0 == a->index->readBackward(cursor, key, rid); ++i)
+            {
+                if (key >= prevKey || key != rid.pid) a->errors++;
+                prevKey = key;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static RC bulkSource(void* arg, int& key, RecordId& rid)
+{
+    BulkArg* a = (BulkArg*) arg;
+
+    if (a->next >= 2 * a->range) return RC_END_OF_TREE;
+    key = a->next / 2;
+    rid.pid = key;
+    rid.sid = a->next % 2;
+    a->next++;
+    return 0;
+}
+
+static RC listSource(void* arg, int& key, RecordId& rid)
+{
+    ListArg* a = (ListArg*) arg;
+
+    if (a->next >= a->entries.size()) return RC_END_OF_TREE;
+    key = a->entries[a->next].key;
+    rid = a->entries[a->next].rid;
+    a->next++;
+    return 0;
+}
+
 static void print_index(BTreeIndex& index, RecordFile& rf,int startKey)
 {
     IndexCursor cursor;
@@ -154,3 +1014,105 @@ static void print_index(BTreeIndex& index, RecordFile& rf,int startKey)
     }
     printf("\n\n");
 }
+
+// insert pairs into an index until killed, committing every so often and
+// telling the parent how many pairs each commit covers
+static void crashWriter(const char* filename, int out)
+{
+    BTreeIndex bt_index;
+    if (bt_index.open(filename, 'w') != 0) return;
+    for (int i = 0; ; i++)
+    {
+        if (i > 0 && i % 1000 == 0)
+        {
+            RecordId end = { i, 0 };
+            if (bt_index.commit(end, false) != 0) return;
+            if (write(out, &i, sizeof(i)) != sizeof(i)) return;
+        }
+        RecordId rid = { i, 0 };
+        if (bt_index.insert(crashKey(i), rid) != 0) return;
+    }
+}
+
+// append tuples to a table and their keys to its index until killed,
+// checkpointing both the way the engine does: the table is forced before
+// the index commits the end of the table it covers
+static void checkpointWriter(const char* table, const char* index, int out)
+{
+    RecordFile rf;
+    BTreeIndex bt_index;
+    if (rf.open(table, 'w') != 0 || bt_index.open(index, 'w') != 0) return;
+    for (int i = 0; ; i++)
+    {
+        if (i > 0 && i % 1000 == 0)
+        {
+            if (rf.sync() != 0 || bt_index.commit(rf.endRid(), false) != 0) return;
+            if (write(out, &i, sizeof(i)) != sizeof(i)) return;
+        }
+        RecordId rid;
+        if (rf.append(crashKey(i), "value", rid) != 0) return;
+        if (bt_index.insert(crashKey(i), rid) != 0) return;
+    }
+}
+
+static void* cacheWorker(void* arg)
+{
+    CacheArg* a = (CacheArg*) arg;
+    unsigned seed = a->id;
+    int page[PageFile::PAGE_SIZE / sizeof(int)];
+
+    for (int round = 1; round <= a->rounds; ++round)
+    {
+        for (int k = 0; k < a->pages; ++k)
+        {
+            int pid = a->id + k * a->threads;
+            fillPage(page, pid, round);
+            if (0 != a->pf->write(pid, page)) a->errors++;
+        }
+        for (int k = 0; k < a->pages; ++k)
+        {
+            int pid = a->id + k * a->threads;
+            if (0 != a->pf->read(pid, page) || round != pageRound(page, pid)) a->errors++;
+
+            // the first pages of every thread are read by all of them,
+            // often while another thread reads them in. a page of
+            // another thread may not be written yet.
+            int other = rand_r(&seed) % (2 * a->threads);
+            RC rc = a->pf->read(other, page);
+            if (rc == RC_INVALID_PID) continue;
+            if (rc != 0 || pageRound(page, other) < 0) a->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+static void fillPage(int* page, int pid, int round)
+{
+    page[0] = pid;
+    page[1] = round;
+    for (size_t i = 2; i < PageFile::PAGE_SIZE / sizeof(int); ++i)
+    {
+        page[i] = pid * 31 + round + i;
+    }
+}
+
+static int pageRound(const int* page, int pid)
+{
+    int expected[PageFile::PAGE_SIZE / sizeof(int)];
+
+    if (page[0] == 0 && page[1] == 0)
+    {
+        memset(expected, 0, sizeof(expected));
+        return memcmp(page, expected, sizeof(expected)) == 0 ? 0 : -1;
+    }
+    fillPage(expected, pid, page[1]);
+    return memcmp(page, expected, sizeof(expected)) == 0 ? page[1] : -1;
+}
+
+// note the AsyncIo of a thread
+static void* threadIo(void* arg)
+{
+    *(AsyncIo**) arg = &AsyncIo::forThread();
+    return NULL;
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+#include <strings.h>
 #include "BTreeNode.h"
 using namespace std;
 
@@ -6,7 +8,7 @@ using namespace std;
  * Clears the buffer and computes maxKeyCount.
  */
 BTLeafNode::BTLeafNode()
-  : maxKeyCount((PageFile::PAGE_SIZE - sizeof(PageId)) / (sizeof(NodeEntry)))
+  : maxKeyCount((PageFile::PAGE_SIZE - sizeof(NodeHeader)) / (sizeof(NodeEntry)))
 {
   bzero(buffer, PageFile::PAGE_SIZE);
 }
@@ -21,7 +23,7 @@ RC BTLeafNode::read(PageId pid, const PageFile& pf)
 {
   return pf.read(pid, buffer);
 }
-    
+
 /*
  * Write the content of the node to the page pid in the PageFile pf.
  * @param pid[IN] the PageId to write to
@@ -39,14 +41,25 @@ RC BTLeafNode::write(PageId pid, PageFile& pf)
  */
 int BTLeafNode::getKeyCount()
 {
-  NodeEntry *ne = (NodeEntry *) buffer;
+  return header()->keyCount;
+}
 
-  int count;
-  for (count = 0; (ne->key != 0) && (count < maxKeyCount); count++, ne++) {
-    ;
-  }
+/*
+ * Return the maximum number of keys the node can hold.
+ * @return the capacity of the node
+ */
+int BTLeafNode::getMaxKeyCount()
+{
+  return maxKeyCount;
+}
 
-  return count;
+/*
+ * Return the minimum number of keys a non-root node should hold.
+ * @return the underflow threshold of the node
+ */
+int BTLeafNode::getMinKeyCount()
+{
+  return maxKeyCount / 2;
 }
 
 /*
@@ -58,29 +71,23 @@ int BTLeafNode::getKeyCount()
 RC BTLeafNode::insert(int key, const RecordId& rid)
 {
   int nodeId = 0;
-  NodeEntry* newEntry = NULL;
-  NodeEntry* curEntry = (NodeEntry *) buffer + getKeyCount();
+  int total = getKeyCount();
 
-  if (getKeyCount() >= maxKeyCount)
+  if (total >= maxKeyCount)
     return RC_NODE_FULL;
 
   // Use the end of the node if can't locate an appropriate entry
-  if (locate(key, nodeId)) {
-    newEntry = curEntry;
-  } else {
-    newEntry = (NodeEntry *) buffer + nodeId;
-
-    // Shift node entries to the right
-    while (curEntry != newEntry) {
-      NodeEntry* nextEntry = curEntry - 1;
-      *curEntry = *nextEntry;
-      curEntry = nextEntry;
-    }
-  }
+  if (locate(key, nodeId))
+    nodeId = total;
+
+  // Shift node entries to the right
+  NodeEntry* newEntry = entries() + nodeId;
+  memmove(newEntry + 1, newEntry, (total - nodeId) * sizeof(NodeEntry));
 
   // Insert data
   newEntry->key = key;
   newEntry->rid = rid;
+  header()->keyCount++;
 
   return 0;
 }
@@ -95,40 +102,113 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
  * @param siblingKey[OUT] the first key in the sibling node after split.
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTLeafNode::insertAndSplit(int key, const RecordId& rid, 
+RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
                               BTLeafNode& sibling, int& siblingKey)
 {
-  RC rc = 0;
   int index = 0;
   int total = getKeyCount();
   int half = (total + 1) / 2;
 
-  rc = locate(key, index);
-  if (rc == RC_END_OF_TREE)
+  if (sibling.getKeyCount() != 0)
+    return RC_INVALID_CURSOR;
+
+  if (locate(key, index))
     index = total;
-  else if (rc != 0)
-    return rc;
 
-  NodeEntry ne = { key, rid }; // new entry
+  // Move the upper half of the entries to the sibling
+  NodeEntry* src = entries() + half;
+  memcpy(sibling.entries(), src, (total - half) * sizeof(NodeEntry));
+  sibling.header()->keyCount = total - half;
+  header()->keyCount = half;
 
-  for (NodeEntry* cur = (NodeEntry *) buffer + index; index < half; cur++, index++) {
-    NodeEntry tmp = *cur;
-    *cur = ne;
-    ne = tmp;
-  }
- 
-  if (index == half)
-    siblingKey = ne.key;
+  // Insert the new entry into the half it belongs to
+  if (index < half)
+    insert(key, rid);
   else
-    siblingKey = ((NodeEntry *) buffer + half)->key;
+    sibling.insert(key, rid);
+
+  siblingKey = sibling.entries()->key;
 
-  sibling.insert(ne.key, ne.rid);
+  return 0;
+}
+
+/*
+ * Remove the eid entry from the node.
+ * The entries after eid are shifted to keep the node sorted and packed.
+ * @param eid[IN] the entry number to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::remove(int eid)
+{
+  int total = getKeyCount();
+
+  if (eid < 0 || eid >= total)
+    return RC_INVALID_CURSOR;
 
-  for (NodeEntry* cur = (NodeEntry *) buffer + half; half < total; cur++, half++) {
-    sibling.insert(cur->key, cur->rid);
-    cur->key = 0;
+  // Shift node entries to the left
+  NodeEntry* cur = entries() + eid;
+  memmove(cur, cur + 1, (total - eid - 1) * sizeof(NodeEntry));
+  header()->keyCount--;
+
+  return 0;
+}
+
+/*
+ * Move all entries of the right sibling to the end of this node.
+ * This node also takes over the next node pointer of the sibling;
+ * the caller must point the previous node pointer of that node here.
+ * @param sibling[IN] the right sibling of this node
+ * @return 0 if successful. Return an error code if the entries do not fit.
+ */
+RC BTLeafNode::merge(BTLeafNode& sibling)
+{
+  int total = getKeyCount();
+  int count = sibling.getKeyCount();
+
+  if (total + count > maxKeyCount)
+    return RC_NODE_FULL;
+
+  memcpy(entries() + total, sibling.entries(), count * sizeof(NodeEntry));
+  header()->keyCount = total + count;
+  setNextNodePtr(sibling.getNextNodePtr());
+
+  return 0;
+}
+
+/*
+ * Move entries between this node and its right sibling so that
+ * both nodes hold (about) the same number of entries.
+ * @param sibling[IN] the right sibling of this node
+ * @param siblingKey[OUT] the first key in the sibling node afterwards.
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::redistribute(BTLeafNode& sibling, int& siblingKey)
+{
+  int total = getKeyCount();
+  int count = sibling.getKeyCount();
+  int half = (total + count + 1) / 2;
+
+  if (total + count == 0)
+    return RC_NO_SUCH_RECORD;
+
+  if (total > half) {
+    // Move our last entries to the front of the sibling
+    int move = total - half;
+    memmove(sibling.entries() + move, sibling.entries(), count * sizeof(NodeEntry));
+    memcpy(sibling.entries(), entries() + half, move * sizeof(NodeEntry));
+    header()->keyCount = half;
+    sibling.header()->keyCount = count + move;
+  } else if (total < half) {
+    // Move the first entries of the sibling to our end
+    int move = half - total;
+    memcpy(entries() + total, sibling.entries(), move * sizeof(NodeEntry));
+    memmove(sibling.entries(), sibling.entries() + move, (count - move) * sizeof(NodeEntry));
+    header()->keyCount = half;
+    sibling.header()->keyCount = count - move;
   }
 
+  siblingKey = sibling.entries()->key;
+
   return 0;
 }
 
@@ -142,12 +222,13 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
  */
 RC BTLeafNode::locate(int searchKey, int& eid)
 {
-  NodeEntry* ne = (NodeEntry *) buffer;
-  for (eid = 0; eid < getKeyCount() && ne->key < searchKey; eid++, ne++) {
+  int total = getKeyCount();
+  NodeEntry* ne = entries();
+  for (eid = 0; eid < total && ne->key < searchKey; eid++, ne++) {
     ;
   }
 
-  if (eid == getKeyCount()) {
+  if (eid == total) {
     eid = -1;
     return RC_END_OF_TREE;
   }
@@ -167,7 +248,7 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
   if (eid < 0 || eid >= getKeyCount())
     return RC_INVALID_CURSOR;
 
-  NodeEntry* ne = (NodeEntry *) buffer + eid;
+  NodeEntry* ne = entries() + eid;
   key = ne->key;
   rid = ne->rid;
   return 0;
@@ -175,23 +256,41 @@ RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
 
 /*
  * Return the pid of the next sibling node.
- * @return the PageId of the next sibling node 
+ * @return the PageId of the next sibling node
  */
 PageId BTLeafNode::getNextNodePtr()
 {
-  PageId* pid = (PageId *) (buffer + PageFile::PAGE_SIZE) - 1;
-  return *pid;
+  return header()->nextPid;
 }
 
 /*
  * Set the pid of the next sibling node.
- * @param pid[IN] the PageId of the next sibling node 
+ * @param pid[IN] the PageId of the next sibling node
  * @return 0 if successful. Return an error code if there is an error.
  */
 RC BTLeafNode::setNextNodePtr(PageId pid)
 {
-  PageId* ptr = (PageId *) (buffer + PageFile::PAGE_SIZE) - 1;
-  *ptr = pid;
+  header()->nextPid = pid;
+  return 0;
+}
+
+/*
+ * Return the pid of the previous sibling node.
+ * @return the PageId of the previous sibling node
+ */
+PageId BTLeafNode::getPrevNodePtr()
+{
+  return header()->prevPid;
+}
+
+/*
+ * Set the pid of the previous sibling node.
+ * @param pid[IN] the PageId of the previous sibling node
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::setPrevNodePtr(PageId pid)
+{
+  header()->prevPid = pid;
   return 0;
 }
 
@@ -200,9 +299,9 @@ RC BTLeafNode::setNextNodePtr(PageId pid)
  * Computes maxKeyCount.
  */
 BTNonLeafNode::BTNonLeafNode()
-  : maxKeyCount((PageFile::PAGE_SIZE - sizeof(PageId)) / (sizeof(NodeEntry)))
+  : maxKeyCount((PageFile::PAGE_SIZE - sizeof(NodeHeader)) / (sizeof(NodeEntry)))
 {
-  ;
+  bzero(buffer, PageFile::PAGE_SIZE);
 }
 
 /*
@@ -215,7 +314,7 @@ RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
 {
   return pf.read(pid, buffer);
 }
-    
+
 /*
  * Write the content of the node to the page pid in the PageFile pf.
  * @param pid[IN] the PageId to write to
@@ -233,16 +332,26 @@ RC BTNonLeafNode::write(PageId pid, PageFile& pf)
  */
 int BTNonLeafNode::getKeyCount()
 {
-  NodeEntry *ne = (NodeEntry *) buffer;
-
-  int count;
-  for (count = 0; (ne->key != 0) && (count < maxKeyCount); count++, ne++) {
-    ;
-  }
+  return header()->keyCount;
+}
 
-  return count;
+/*
+ * Return the maximum number of keys the node can hold.
+ * @return the capacity of the node
+ */
+int BTNonLeafNode::getMaxKeyCount()
+{
+  return maxKeyCount;
 }
 
+/*
+ * Return the minimum number of keys a non-root node should hold.
+ * @return the underflow threshold of the node
+ */
+int BTNonLeafNode::getMinKeyCount()
+{
+  return maxKeyCount / 2;
+}
 
 /*
  * Insert a (key, pid) pair to the node.
@@ -253,29 +362,22 @@ int BTNonLeafNode::getKeyCount()
 RC BTNonLeafNode::insert(int key, PageId pid)
 {
   int nodeId = 0;
-  NodeEntry* newEntry = NULL;
-  NodeEntry* curEntry = (NodeEntry *) buffer + getKeyCount();
+  int total = getKeyCount();
 
-  if (getKeyCount() >= maxKeyCount)
+  if (total >= maxKeyCount)
     return RC_NODE_FULL;
 
-  // Use beginning of the node if can't locate an appropriate entry
-  if (locateChildPtr(key, nodeId)) {
-    newEntry = (NodeEntry *) buffer;
-  } else {
-    newEntry = (NodeEntry *) buffer + nodeId + 1;
-  }
+  // The new entry goes right after the last key <= key
+  locateChildPtr(key, nodeId);
+  NodeEntry* newEntry = entries() + nodeId + 1;
 
   // Shift node entries to the right
-  while (curEntry != newEntry) {
-    NodeEntry* nextEntry = curEntry - 1;
-    *curEntry = *nextEntry;
-    curEntry = nextEntry;
-  }
+  memmove(newEntry + 1, newEntry, (total - nodeId - 1) * sizeof(NodeEntry));
 
   // Insert data
   newEntry->key = key;
   newEntry->pid = pid;
+  header()->keyCount++;
 
   return 0;
 }
@@ -292,44 +394,28 @@ RC BTNonLeafNode::insert(int key, PageId pid)
  */
 RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey)
 {
-  RC rc = 0;
   int index = 0;
   int total = getKeyCount();
-  int half = (total + 1) / 2;
-
-  rc = locateChildPtr(key, index);
-  if (rc == RC_END_OF_TREE)
-    index = total;
-  else if (rc != 0)
-    return rc;
 
+  // Build the full sequence of total + 1 entries in a scratch array
+  NodeEntry all[PageFile::PAGE_SIZE / sizeof(NodeEntry) + 1];
+  locateChildPtr(key, index);
   index++;
-  NodeEntry ne = { key, pid }; // new entry
+  memcpy(all, entries(), index * sizeof(NodeEntry));
+  all[index].key = key;
+  all[index].pid = pid;
+  memcpy(all + index + 1, entries() + index, (total - index) * sizeof(NodeEntry));
 
-  for (NodeEntry* cur = (NodeEntry *) buffer + index; index < half; cur++, index++) {
-    NodeEntry tmp = *cur;
-    *cur = ne;
-    ne = tmp;
-  }
- 
-  if (index != half) {
-    NodeEntry* cur = (NodeEntry *) buffer + half;
-    NodeEntry tmp = *cur;
-    *cur = ne;
-    ne = tmp;
-  }
-
-  midKey = ne.key;
+  // Keep the first half, push the middle key up, move the rest to sibling
+  int half = (total + 1) / 2;
+  memcpy(entries(), all, half * sizeof(NodeEntry));
+  header()->keyCount = half;
 
-  NodeEntry* cur = (NodeEntry *)buffer + half;
-  sibling.initializeRoot(ne.pid, cur->key, cur->pid);
-  cur->key = 0;
-  half++;
+  midKey = all[half].key;
 
-  for (NodeEntry* cur = (NodeEntry *) buffer + half; half < total; cur++, half++) {
-    sibling.insert(cur->key, cur->pid);
-    cur->key = 0;
-  }
+  sibling.header()->firstPid = all[half].pid;
+  memcpy(sibling.entries(), all + half + 1, (total - half) * sizeof(NodeEntry));
+  sibling.header()->keyCount = total - half;
 
   return 0;
 }
@@ -344,13 +430,27 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
 RC BTNonLeafNode::locateChildPtr(int searchKey, int& eid)
 {
   eid = getKeyCount() - 1;
-  NodeEntry* ne = (NodeEntry *) buffer + eid;
-  for (eid; eid >= 0 && ne->key > searchKey; eid--, ne--) {
+  NodeEntry* ne = entries() + eid;
+  for (; eid >= 0 && ne->key > searchKey; eid--, ne--) {
     ;
   }
 
-  if (eid == -1) {
-    return RC_END_OF_TREE;
+  return 0;
+}
+
+/*
+ * Given the searchKey, find the leftmost child-node pointer whose
+ * subtree may contain an entry with that key.
+ * @param searchKey[IN] the searchKey that is being looked up.
+ * @param eid[OUT] the index of the child node to follow (-1 for the first child).
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::locateLowerChildPtr(int searchKey, int& eid)
+{
+  eid = getKeyCount() - 1;
+  NodeEntry* ne = entries() + eid;
+  for (; eid >= 0 && ne->key >= searchKey; eid--, ne--) {
+    ;
   }
 
   return 0;
@@ -364,17 +464,123 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, int& eid)
  */
 RC BTNonLeafNode::readEntry(int eid, PageId& pid)
 {
-  if (eid >= getKeyCount())
+  if (eid < -1 || eid >= getKeyCount())
     return RC_INVALID_CURSOR;
 
   if (eid < 0) {
-    PageId *ptr = (PageId *) (buffer + PageFile::PAGE_SIZE - sizeof(PageId));
-    pid = *ptr;
+    pid = header()->firstPid;
   } else {
-    NodeEntry* ne = (NodeEntry *) buffer + eid;
-    pid = ne->pid;
+    pid = entries()[eid].pid;
   }
- 
+
+  return 0;
+}
+
+/*
+ * Read the key from the eid entry.
+ * @param eid[IN] the entry number to read the key from
+ * @param key[OUT] the key from the slot
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::readKey(int eid, int& key)
+{
+  if (eid < 0 || eid >= getKeyCount())
+    return RC_INVALID_CURSOR;
+
+  key = entries()[eid].key;
+  return 0;
+}
+
+/*
+ * Replace the key of the eid entry.
+ * @param eid[IN] the entry number to update
+ * @param key[IN] the new key
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::setKey(int eid, int key)
+{
+  if (eid < 0 || eid >= getKeyCount())
+    return RC_INVALID_CURSOR;
+
+  entries()[eid].key = key;
+  return 0;
+}
+
+/*
+ * Remove the eid entry (the key and the child pointer right of it).
+ * @param eid[IN] the entry number to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::remove(int eid)
+{
+  int total = getKeyCount();
+
+  if (eid < 0 || eid >= total)
+    return RC_INVALID_CURSOR;
+
+  NodeEntry* cur = entries() + eid;
+  memmove(cur, cur + 1, (total - eid - 1) * sizeof(NodeEntry));
+  header()->keyCount--;
+
+  return 0;
+}
+
+/*
+ * Move all children of the right sibling to the end of this node.
+ * @param midKey[IN] the separator key between this node and the sibling
+ * @param sibling[IN] the right sibling of this node
+ * @return 0 if successful. Return an error code if the entries do not fit.
+ */
+RC BTNonLeafNode::merge(int midKey, BTNonLeafNode& sibling)
+{
+  int total = getKeyCount();
+  int count = sibling.getKeyCount();
+
+  if (total + 1 + count > maxKeyCount)
+    return RC_NODE_FULL;
+
+  // The separator becomes the key in front of the sibling's first child
+  NodeEntry* ne = entries() + total;
+  ne->key = midKey;
+  ne->pid = sibling.header()->firstPid;
+  memcpy(ne + 1, sibling.entries(), count * sizeof(NodeEntry));
+  header()->keyCount = total + 1 + count;
+
+  return 0;
+}
+
+/*
+ * Move entries between this node and its right sibling (rotating them
+ * through the parent separator) so that both nodes are about equally full.
+ * @param midKey[IN] the separator key between this node and the sibling
+ * @param sibling[IN] the right sibling of this node
+ * @param newMidKey[OUT] the separator key to store in the parent afterwards
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::redistribute(int midKey, BTNonLeafNode& sibling, int& newMidKey)
+{
+  int total = getKeyCount();
+  int count = sibling.getKeyCount();
+
+  // Lay out both nodes and the separator as one sequence of entries
+  NodeEntry all[2 * (PageFile::PAGE_SIZE / sizeof(NodeEntry)) + 1];
+  memcpy(all, entries(), total * sizeof(NodeEntry));
+  all[total].key = midKey;
+  all[total].pid = sibling.header()->firstPid;
+  memcpy(all + total + 1, sibling.entries(), count * sizeof(NodeEntry));
+
+  // Split it again in the middle, pushing the middle key up
+  int n = total + 1 + count;
+  int half = n / 2;
+  memcpy(entries(), all, half * sizeof(NodeEntry));
+  header()->keyCount = half;
+
+  newMidKey = all[half].key;
+
+  sibling.header()->firstPid = all[half].pid;
+  memcpy(sibling.entries(), all + half + 1, (n - half - 1) * sizeof(NodeEntry));
+  sibling.header()->keyCount = n - half - 1;
+
   return 0;
 }
 
@@ -389,11 +595,10 @@ RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
 {
   bzero(buffer, PageFile::PAGE_SIZE);
 
-  NodeEntry root = { key, pid2 };
-  *((NodeEntry *) buffer) = root;
-
-  PageId *ptr1 = (PageId *) (buffer + PageFile::PAGE_SIZE - sizeof(PageId));
-  *ptr1 = pid1;
+  header()->firstPid = pid1;
+  header()->keyCount = 1;
+  entries()->key = key;
+  entries()->pid = pid2;
 
   return 0;
 }
@@ -46,6 +46,32 @@ class BTLeafNode {
     */
     RC insertAndSplit(int key, const RecordId& rid, BTLeafNode& sibling, int& siblingKey);
 
+   /**
+    * Remove the eid entry from the node.
+    * The entries after eid are shifted to keep the node sorted and packed.
+    * @param eid[IN] the entry number to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Move all entries of the right sibling to the end of this node.
+    * This node also takes over the next node pointer of the sibling;
+    * the caller must point the previous node pointer of that node here.
+    * @param sibling[IN] the right sibling of this node
+    * @return 0 if successful. Return an error code if the entries do not fit.
+    */
+    RC merge(BTLeafNode& sibling);
+
+   /**
+    * Move entries between this node and its right sibling so that
+    * both nodes hold (about) the same number of entries.
+    * @param sibling[IN] the right sibling of this node
+    * @param siblingKey[OUT] the first key in the sibling node afterwards.
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC redistribute(BTLeafNode& sibling, int& siblingKey);
+
    /**
     * Find the index entry whose key value is larger than or equal to searchKey
     * and output the eid (entry id) whose key value &gt;= searchKey.
@@ -79,11 +105,36 @@ class BTLeafNode {
     */
     RC setNextNodePtr(PageId pid);
 
+   /**
+    * Return the pid of the previous sibling node.
+    * @return the PageId of the previous sibling node 
+    */
+    PageId getPrevNodePtr();
+
+   /**
+    * Set the previous sibling node PageId.
+    * @param pid[IN] the PageId of the previous sibling node 
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC setPrevNodePtr(PageId pid);
+
    /**
     * Return the number of keys stored in the node.
     * @return the number of keys in the node
     */
     int getKeyCount();
+
+   /**
+    * Return the maximum number of keys the node can hold.
+    * @return the capacity of the node
+    */
+    int getMaxKeyCount();
+
+   /**
+    * Return the minimum number of keys a non-root node should hold.
+    * @return the underflow threshold of the node
+    */
+    int getMinKeyCount();
  
    /**
     * Read the content of the node from the page pid in the PageFile pf.
@@ -113,6 +164,15 @@ class BTLeafNode {
     */
     char buffer[PageFile::PAGE_SIZE];
 
+   /**
+    * The header stored at the beginning of the page.
+    */
+    struct NodeHeader {
+      int    keyCount;  // the number of entries in the node
+      PageId nextPid;   // the next sibling node (0 for the last node)
+      PageId prevPid;   // the previous sibling node (0 for the first node)
+    };
+
    /**
     * A structure representing an entry of a leaf node.
     */
@@ -121,6 +181,12 @@ class BTLeafNode {
       RecordId rid;
     };
 
+   /**
+    * Pointers to the header and the first entry inside buffer.
+    */
+    NodeHeader* header() { return (NodeHeader *) buffer; }
+    NodeEntry*  entries() { return (NodeEntry *) (buffer + sizeof(NodeHeader)); }
+
    /**
     * The maximum number of keys that can be stored in a node.
     */
@@ -164,13 +230,24 @@ class BTNonLeafNode {
 
    /**
     * Given the searchKey, find the child-node pointer to follow and
-    * output it in pid.
+    * output its index (-1 for the first child).
     * Remember that the keys inside a B+tree node are sorted.
     * @param searchKey[IN] the searchKey that is being looked up.
-    * @param pid[OUT] the pointer to the child node to follow.
+    * @param eid[OUT] the index of the child node to follow.
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC locateChildPtr(int searchKey, PageId& pid);
+    RC locateChildPtr(int searchKey, int& eid);
+
+   /**
+    * Given the searchKey, find the leftmost child-node pointer whose
+    * subtree may contain an entry with that key.
+    * Unlike locateChildPtr(), separators equal to searchKey are not followed,
+    * so all duplicates of searchKey are to the right of the returned child.
+    * @param searchKey[IN] the searchKey that is being looked up.
+    * @param eid[OUT] the index of the child node to follow (-1 for the first child).
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC locateLowerChildPtr(int searchKey, int& eid);
 
    /**
     * Read the pid from the eid entry.
@@ -180,6 +257,49 @@ class BTNonLeafNode {
     */
     RC readEntry(int eid, PageId& pid);
 
+   /**
+    * Read the key from the eid entry.
+    * @param eid[IN] the entry number to read the key from
+    * @param key[OUT] the key from the slot
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC readKey(int eid, int& key);
+
+   /**
+    * Replace the key of the eid entry.
+    * @param eid[IN] the entry number to update
+    * @param key[IN] the new key
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC setKey(int eid, int key);
+
+   /**
+    * Remove the eid entry (the key and the child pointer right of it).
+    * @param eid[IN] the entry number to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Move all children of the right sibling to the end of this node.
+    * midKey, the separator of the two nodes in the parent, is pulled down
+    * in front of the first child of the sibling.
+    * @param midKey[IN] the separator key between this node and the sibling
+    * @param sibling[IN] the right sibling of this node
+    * @return 0 if successful. Return an error code if the entries do not fit.
+    */
+    RC merge(int midKey, BTNonLeafNode& sibling);
+
+   /**
+    * Move entries between this node and its right sibling (rotating them
+    * through the parent separator) so that both nodes are about equally full.
+    * @param midKey[IN] the separator key between this node and the sibling
+    * @param sibling[IN] the right sibling of this node
+    * @param newMidKey[OUT] the separator key to store in the parent afterwards
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC redistribute(int midKey, BTNonLeafNode& sibling, int& newMidKey);
+
    /**
     * Initialize the root node with (pid1, key, pid2).
     * @param pid1[IN] the first PageId to insert
@@ -195,6 +315,18 @@ class BTNonLeafNode {
     */
     int getKeyCount();
 
+   /**
+    * Return the maximum number of keys the node can hold.
+    * @return the capacity of the node
+    */
+    int getMaxKeyCount();
+
+   /**
+    * Return the minimum number of keys a non-root node should hold.
+    * @return the underflow threshold of the node
+    */
+    int getMinKeyCount();
+
    /**
     * Read the content of the node from the page pid in the PageFile pf.
     * @param pid[IN] the PageId to read
@@ -218,14 +350,29 @@ class BTNonLeafNode {
     */
     char buffer[PageFile::PAGE_SIZE];
 
+   /**
+    * The header stored at the beginning of the page.
+    */
+    struct NodeHeader {
+      int    keyCount;  // the number of keys in the node
+      PageId firstPid;  // the child pointer left of the first key
+    };
+
    /**
     * A structure representing an entry of a non-leaf node.
+    * pid points to the child right of key.
     */
     struct NodeEntry {
       int key;
       PageId pid;
     };
 
+   /**
+    * Pointers to the header and the first entry inside buffer.
+    */
+    NodeHeader* header() { return (NodeHeader *) buffer; }
+    NodeEntry*  entries() { return (NodeEntry *) (buffer + sizeof(NodeHeader)); }
+
    /**
     * The maximum number of keys that can be stored in a node.
     */
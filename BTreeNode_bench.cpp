@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The microbenchmark of the primitives of the B+tree nodes. Each primitive
+ * runs on nodes filled to a quarter, half, three quarters and all of their
+ * capacity, with search and insert keys drawn from several distributions,
+ * and the time of an operation is printed in nanoseconds.
+ *
+ *   BTreeNodeBench [-n operations] [-r rounds] [-s seed]
+ *
+ * The node holds the keys 0, 2, 4, ... and the operations use odd keys, so
+ * that every key falls between two entries:
+ *   uniform     keys drawn uniformly over the node
+ *   sequential  keys in increasing order, starting over at the end
+ *   zipf        keys near the start of the node drawn more often (skew 0.99)
+ * insert and insertAndSplit copy a prepared node before each operation;
+ * the time of the copy alone is measured and subtracted.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "Bruinbase.h"
+#include "BTreeNode.h"
+#include "IoStats.h"
+
+using std::vector;
+
+enum KeyDistribution { UNIFORM_KEYS, SEQUENTIAL_KEYS, ZIPF_KEYS };
+static const char* DISTRIBUTION_NAMES[] = { "uniform", "sequential", "zipf" };
+static const int DISTRIBUTIONS = 3;
+
+static const double ZIPF_THETA = 0.99;
+
+// the fill levels of the nodes, in percent of their capacity
+static const int FILLS[] = { 25, 50, 75, 100 };
+
+// the results of the operations are added here, so that they are not
+// optimized away
+static volatile long long sink;
+
+/**
+ * the random numbers of the benchmark (splitmix64)
+ */
+struct Random {
+  unsigned long long state;
+
+  unsigned long long next()
+  {
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // a number in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// the keys of n operations on a node of count keys
+static void makeKeys(KeyDistribution dist, int count, int n, Random& random, vector<int>& keys)
+{
+  // the probabilities of the ranks of a Zipfian distribution
+  vector<double> cumulative;
+  if (dist == ZIPF_KEYS) {
+    double sum = 0;
+    for (int i = 0; i <= count; i++) cumulative.push_back(sum += pow(i + 1.0, -ZIPF_THETA));
+    for (int i = 0; i <= count; i++) cumulative[i] /= sum;
+  }
+
+  keys.resize(n);
+  for (int i = 0; i < n; i++) {
+    int slot;  // the entry that the key falls before, count for after the last
+    switch (dist) {
+    case UNIFORM_KEYS: slot = (int) (random.uniform() * (count + 1)); break;
+    case SEQUENTIAL_KEYS: slot = i % (count + 1); break;
+    default:
+      slot = std::lower_bound(cumulative.begin(), cumulative.end(), random.uniform()) - cumulative.begin();
+      if (slot > count) slot = count;
+      break;
+    }
+    keys[i] = 2 * slot - 1;
+  }
+}
+
+// a leaf with the keys 0, 2, ..., 2 * (count - 1)
+static void fillLeaf(BTLeafNode& node, int count)
+{
+  for (int i = 0; i < count; i++) {
+    RecordId rid = { i, 0 };
+    node.insert(2 * i, rid);
+  }
+}
+
+// a non-leaf with the keys 0, 2, ..., 2 * (count - 1)
+static void fillNonLeaf(BTNonLeafNode& node, int count)
+{
+  node.initializeRoot(0, 0, 1);
+  for (int i = 1; i < count; i++) node.insert(2 * i, i + 1);
+}
+
+// the time of the copies of a node that insert and insertAndSplit make
+// before each operation
+static long long timeCopy(BTLeafNode& from, const vector<int>& keys)
+{
+  BTLeafNode node, sibling;
+  long long start = IoStats::now();
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    memcpy(node.getBuffer(), from.getBuffer(), PageFile::PAGE_SIZE);
+    memset(sibling.getBuffer(), 0, PageFile::PAGE_SIZE);
+    sink += node.getBuffer()[i % PageFile::PAGE_SIZE] + sibling.getBuffer()[0];
+  }
+  return IoStats::now() - start;
+}
+
+// the time of the operations of a primitive on a node of count keys
+static long long timeOperations(const char* primitive, int count, const vector<int>& keys)
+{
+  BTLeafNode    leaf, sibling;
+  BTNonLeafNode nonLeaf;
+  RecordId      rid = { 0, 0 };
+  long long     start, elapsed;
+  long long     total = 0;
+  int           eid, siblingKey;
+
+  fillLeaf(leaf, count);
+  fillNonLeaf(nonLeaf, count);
+
+  if (strcmp(primitive, "BTLeafNode::locate") == 0) {
+    start = IoStats::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+      leaf.locate(keys[i], eid);
+      total += eid;
+    }
+    elapsed = IoStats::now() - start;
+  } else if (strcmp(primitive, "BTLeafNode::getKeyCount") == 0) {
+    start = IoStats::now();
+    for (size_t i = 0; i < keys.size(); i++) total += leaf.getKeyCount();
+    elapsed = IoStats::now() - start;
+  } else if (strcmp(primitive, "BTNonLeafNode::locateChildPtr") == 0) {
+    start = IoStats::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+      nonLeaf.locateChildPtr(keys[i], eid);
+      total += eid;
+    }
+    elapsed = IoStats::now() - start;
+  } else {
+    // insert into a node with room for the key, or split a full one
+    bool split = strcmp(primitive, "BTLeafNode::insertAndSplit") == 0;
+    BTLeafNode from;
+    fillLeaf(from, split ? from.getMaxKeyCount() : count - 1);
+
+    start = IoStats::now();
+    for (size_t i = 0; i < keys.size(); i++) {
+      memcpy(leaf.getBuffer(), from.getBuffer(), PageFile::PAGE_SIZE);
+      memset(sibling.getBuffer(), 0, PageFile::PAGE_SIZE);
+      if (split) {
+        leaf.insertAndSplit(keys[i], rid, sibling, siblingKey);
+        total += siblingKey;
+      } else {
+        total += leaf.insert(keys[i], rid);
+      }
+    }
+    elapsed = IoStats::now() - start - timeCopy(from, keys);
+  }
+
+  sink += total;
+  return elapsed;
+}
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "usage: %s [-n operations] [-r rounds] [-s seed]\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* PRIMITIVES[] = {
+    "BTLeafNode::locate", "BTLeafNode::insert", "BTLeafNode::insertAndSplit",
+    "BTLeafNode::getKeyCount", "BTNonLeafNode::locateChildPtr"
+  };
+  int operations = 1 << 20;
+  int rounds = 5;
+  unsigned long long seed = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:s:")) != -1) {
+    switch (opt) {
+    case 'n': operations = atoi(optarg); break;
+    case 'r': rounds = atoi(optarg); break;
+    case 's': seed = strtoull(optarg, NULL, 10); break;
+    default: usage(argv[0]); return 1;
+    }
+  }
+  if (operations < 1 || rounds < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  BTLeafNode    leaf;
+  BTNonLeafNode nonLeaf;
+  printf("# %d operations, best of %d rounds; leaf capacity %d, non-leaf capacity %d\n",
+         operations, rounds, leaf.getMaxKeyCount(), nonLeaf.getMaxKeyCount());
+  printf("%-30s %5s %-10s %10s\n", "primitive", "fill", "keys", "ns/op");
+
+  for (unsigned p = 0; p < sizeof(PRIMITIVES) / sizeof(PRIMITIVES[0]); p++) {
+    bool split = strcmp(PRIMITIVES[p], "BTLeafNode::insertAndSplit") == 0;
+    bool nonLeafNode = strncmp(PRIMITIVES[p], "BTNonLeafNode", 13) == 0;
+    int  capacity = nonLeafNode ? nonLeaf.getMaxKeyCount() : leaf.getMaxKeyCount();
+
+    for (unsigned f = 0; f < sizeof(FILLS) / sizeof(FILLS[0]); f++) {
+      // a node is split only when it is full
+      if (split && FILLS[f] != 100) continue;
+      int count = capacity * FILLS[f] / 100;
+
+      for (int d = 0; d < DISTRIBUTIONS; d++) {
+        Random random = { seed };
+        vector<int> keys;
+        long long best = -1;
+
+        makeKeys((KeyDistribution) d, count, operations, random, keys);
+        for (int r = 0; r < rounds; r++) {
+          long long nanos = timeOperations(PRIMITIVES[p], count, keys);
+          if (best < 0 || nanos < best) best = nanos;
+        }
+        printf("%-30s %4d%% %-10s %10.2f\n", PRIMITIVES[p], FILLS[f],
+               DISTRIBUTION_NAMES[d], (double) best / operations);
+      }
+    }
+  }
+
+  return 0;
+}
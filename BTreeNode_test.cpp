@@ -49,12 +49,13 @@ int main( int argc, const char* argv[] )
                     rid.sid = j;
                     ASSERT(0 == rf.read(rid, key, value));
                     if (     bt->getKeyCount() != 0 && 
-                        0 == bt->getKeyCount() % 85)
+                        0 == bt->getKeyCount() % 84)
                     {
                         LeafNodes.push_back(new BTLeafNode);
                         BTLeafNode *sibling = *(LeafNodes.end() - 1);
                         ASSERT(0 == bt->insertAndSplit(count/2, rid, *sibling, key));
-                        ASSERT(sibling->getKeyCount() ==  bt->getKeyCount())
+                        ASSERT(sibling->getKeyCount() + bt->getKeyCount() == 85)
+                        ASSERT(abs(sibling->getKeyCount() - bt->getKeyCount()) <= 1)
                         bt = sibling;
                         ASSERT(bt->insert(key + 1, rid) == 0);   
                     }
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include "BloomFilter.h"
+#include "PageFile.h"
+
+using std::string;
+
+// odd multipliers that pick the bit set in each word of a block
+static const unsigned SALT[BloomFilter::BLOCK_WORDS] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+// the words of the filters on each page of the file. page 0 holds the
+// number of blocks and the end record id.
+static const int WORDS_PER_PAGE = PageFile::PAGE_SIZE / sizeof(unsigned);
+
+// the words by which the filters may have to be moved to start on a
+// 64-byte boundary
+static const int ALIGN_WORDS = 64 / sizeof(unsigned);
+
+BloomFilter::BloomFilter()
+{
+  blocks = 0;
+  filters = NULL;
+  saved.pid = 0;
+  saved.sid = 0;
+  dirty = false;
+}
+
+void BloomFilter::create(long long tuples)
+{
+  if (tuples < 1) tuples = 1;
+  long long bits = tuples * BITS_PER_TUPLE;
+
+  blocks = (bits + BLOCK_BITS - 1) / BLOCK_BITS;
+  words.assign(2 * (size_t) blocks * BLOCK_WORDS + ALIGN_WORDS, 0);
+  filters = &words[0];
+  while ((unsigned long) filters % 64 != 0) filters++;
+
+  saved.pid = 0;
+  saved.sid = 0;
+  dirty = true;
+}
+
+void BloomFilter::clear()
+{
+  blocks = 0;
+  words.clear();
+  filters = NULL;
+  dirty = false;
+}
+
+unsigned long long BloomFilter::hashKey(int key)
+{
+  // the finalizer of splitmix64: every bit of the key changes about half
+  // of the bits of the hash
+  unsigned long long h = (unsigned) key + 0x9e3779b97f4a7c15ULL;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+unsigned long long BloomFilter::hashValue(const char* value)
+{
+  // FNV-1a over the characters that are stored, then mixed like a key
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  for (int i = 0; value[i] != 0 && i < RecordFile::MAX_VALUE_LENGTH - 1; i++) {
+    h = (h ^ (unsigned char) value[i]) * 0x100000001b3ULL;
+  }
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+void BloomFilter::set(unsigned* filter, unsigned long long hash)
+{
+  // the high half of the hash picks the block, the low half the bits
+  unsigned* block = filter + ((hash >> 32) * blocks >> 32) * BLOCK_WORDS;
+  unsigned  x = (unsigned) hash;
+
+  for (int i = 0; i < BLOCK_WORDS; i++) {
+    unsigned bit = 1U << ((x * SALT[i]) >> 27);
+    if ((__atomic_load_n(&block[i], __ATOMIC_RELAXED) & bit) == 0) {
+      __atomic_fetch_or(&block[i], bit, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+bool BloomFilter::test(const unsigned* filter, unsigned long long hash) const
+{
+  const unsigned* block = filter + ((hash >> 32) * blocks >> 32) * BLOCK_WORDS;
+  unsigned        x = (unsigned) hash;
+
+  for (int i = 0; i < BLOCK_WORDS; i++) {
+    unsigned bit = 1U << ((x * SALT[i]) >> 27);
+    if ((__atomic_load_n(&block[i], __ATOMIC_RELAXED) & bit) == 0) return false;
+  }
+  return true;
+}
+
+void BloomFilter::add(int key, const string& value)
+{
+  addHashes(hashKey(key), hashValue(value.c_str()));
+}
+
+void BloomFilter::addHashes(unsigned long long keyHash, unsigned long long valueHash)
+{
+  if (blocks == 0) return;
+
+  set(filters, keyHash);
+  set(filters + (size_t) blocks * BLOCK_WORDS, valueHash);
+  dirty = true;
+}
+
+bool BloomFilter::mayContainKey(int key) const
+{
+  if (blocks == 0) return true;
+  return test(filters, hashKey(key));
+}
+
+bool BloomFilter::mayContainValue(const char* value) const
+{
+  if (blocks == 0) return true;
+  return test(filters + (size_t) blocks * BLOCK_WORDS, hashValue(value));
+}
+
+RC BloomFilter::load(const string& filename, RecordId& end)
+{
+  PageFile pf;
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+  int      header[3];
+
+  clear();
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+
+  if (pf.endPid() == 0) rc = RC_INVALID_FILE_FORMAT;
+  else rc = pf.read(0, page);
+  if (rc < 0) {
+    pf.close();
+    return rc;
+  }
+
+  // the header: the blocks of each filter and the end record id
+  memcpy(header, page, sizeof(header));
+  size_t total = 2 * (size_t) (unsigned) header[0] * BLOCK_WORDS;
+  PageId pages = (total + WORDS_PER_PAGE - 1) / WORDS_PER_PAGE;
+  if (header[0] <= 0 || pf.endPid() < 1 + pages) {
+    pf.close();
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  blocks = header[0];
+  words.assign(total + ALIGN_WORDS, 0);
+  filters = &words[0];
+  while ((unsigned long) filters % 64 != 0) filters++;
+
+  for (PageId pid = 0; pid < pages; pid++) {
+    if ((rc = pf.read(1 + pid, page)) < 0) {
+      clear();
+      pf.close();
+      return rc;
+    }
+    size_t first = (size_t) pid * WORDS_PER_PAGE;
+    size_t n = (total - first < (size_t) WORDS_PER_PAGE) ? total - first : WORDS_PER_PAGE;
+    memcpy(filters + first, page, n * sizeof(unsigned));
+  }
+
+  end.pid = header[1];
+  end.sid = header[2];
+  saved = end;
+  dirty = false;
+  return pf.close();
+}
+
+RC BloomFilter::save(const string& filename, const RecordId& end)
+{
+  PageFile pf;
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+  int      header[3];
+
+  if (blocks == 0) return RC_INVALID_FILE_MODE;
+  if (!dirty && end == saved) return 0;
+
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+
+  // an empty header makes the file invalid while the filters are written,
+  // and the filters reach the file before the header that says which
+  // records they hold
+  memset(page, 0, PageFile::PAGE_SIZE);
+  if ((rc = pf.write(0, page)) == 0) rc = pf.flush();
+
+  size_t total = 2 * (size_t) blocks * BLOCK_WORDS;
+  for (size_t first = 0; rc == 0 && first < total; first += WORDS_PER_PAGE) {
+    memset(page, 0, PageFile::PAGE_SIZE);
+    unsigned* out = (unsigned*) page;
+    for (size_t i = 0; i < (size_t) WORDS_PER_PAGE && first + i < total; i++) {
+      out[i] = __atomic_load_n(&filters[first + i], __ATOMIC_RELAXED);
+    }
+    rc = pf.write(1 + first / WORDS_PER_PAGE, page);
+  }
+  if (rc == 0) rc = pf.flush();
+
+  if (rc == 0) {
+    memset(page, 0, PageFile::PAGE_SIZE);
+    header[0] = blocks;
+    header[1] = end.pid;
+    header[2] = end.sid;
+    memcpy(page, header, sizeof(header));
+    rc = pf.write(0, page);
+  }
+
+  RC crc = pf.close();
+  if (rc == 0) rc = crc;
+  if (rc == 0) {
+    saved = end;
+    dirty = false;
+  }
+  return rc;
+}
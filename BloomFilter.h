@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+
+/**
+ * A pair of Bloom filters over the keys and the values of a table.
+ * Each filter is an array of 32-byte blocks, which never straddle a
+ * cache line. A key or value picks one block by its hash and sets one bit
+ * in each of the eight 32-bit words of the block, so a lookup reads a
+ * single cache line. A filter never rejects a key or value that was added
+ * to it, and rejects about 99% of the others while it holds no more
+ * tuples than it was created for.
+ * add() may be called while other threads look keys and values up.
+ */
+class BloomFilter {
+ public:
+  static const int BITS_PER_TUPLE = 10;   // the bits of each filter per tuple
+  static const int BLOCK_WORDS = 8;       // the 32-bit words of a block
+  static const int BLOCK_BITS = BLOCK_WORDS * 32;
+
+  BloomFilter();
+
+  /**
+   * create empty filters sized for a number of tuples.
+   * @param tuples[IN] the tuples the filters are expected to hold
+   */
+  void create(long long tuples);
+
+  /**
+   * drop the filters. a table without filters cannot reject anything.
+   */
+  void clear();
+
+  /**
+   * @return whether there are filters
+   */
+  bool isValid() const { return blocks > 0; }
+
+  /**
+   * @return the tuples the filters were created for
+   */
+  long long capacity() const { return (long long) blocks * BLOCK_BITS / BITS_PER_TUPLE; }
+
+  /**
+   * add the key and the value of a tuple. a value is hashed as the
+   * RecordFile stores it, cut to MAX_VALUE_LENGTH - 1 characters.
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   */
+  void add(int key, const std::string& value);
+
+  /**
+   * add a tuple by the hashes of its key and its value, which can be
+   * computed before the filters are created.
+   * @param keyHash[IN] hashKey() of the tuple key
+   * @param valueHash[IN] hashValue() of the tuple value
+   */
+  void addHashes(unsigned long long keyHash, unsigned long long valueHash);
+
+  /**
+   * @return the hash of a key in the filters
+   */
+  static unsigned long long hashKey(int key);
+
+  /**
+   * @return the hash of a value in the filters
+   */
+  static unsigned long long hashValue(const char* value);
+
+  /**
+   * @return false if no tuple with the key was added
+   */
+  bool mayContainKey(int key) const;
+
+  /**
+   * @return false if no tuple with the value was added
+   */
+  bool mayContainValue(const char* value) const;
+
+  /**
+   * read the filters from a file.
+   * @param filename[IN] the file written by save()
+   * @param end[OUT] the end record id of the table when the filters were
+   *                 saved: the filters hold every tuple before it
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename, RecordId& end);
+
+  /**
+   * write the filters to a file, if they changed since they were created,
+   * loaded or saved.
+   * @param filename[IN] the file to write
+   * @param end[IN] the end record id of the table. the filters must hold
+   *                every tuple before it.
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename, const RecordId& end);
+
+ private:
+  BloomFilter(const BloomFilter&);             // not copyable: large
+  BloomFilter& operator=(const BloomFilter&);
+
+  // set the bits of a hash in a filter
+  void set(unsigned* filter, unsigned long long hash);
+
+  // check the bits of a hash in a filter
+  bool test(const unsigned* filter, unsigned long long hash) const;
+
+  unsigned              blocks;  // the blocks of each filter
+  std::vector<unsigned> words;   // the memory of the filters
+  unsigned*             filters; // the key filter, then the value filter, in
+                                 // words from a 64-byte boundary
+  RecordId              saved;   // the end record id of the last load() or save()
+  bool                  dirty;   // a tuple was added since then
+};
+
+#endif // BLOOMFILTER_H
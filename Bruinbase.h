@@ -26,5 +26,10 @@ const int RC_INVALID_CURSOR      = -1011;
 const int RC_NO_SUCH_RECORD      = -1012;
 const int RC_END_OF_TREE         = -1013;
 const int RC_INVALID_ATTRIBUTE   = -1014;
+const int RC_THREAD_FAILED       = -1015;
+const int RC_SOCKET_FAILED       = -1016;
+const int RC_NO_SUCH_STATEMENT   = -1017;
+const int RC_INVALID_PARAMETER   = -1018;
+const int RC_CHECKSUM_FAILED     = -1019;
 
 #endif // BRUINBASE_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+#include "Catalog.h"
+#include "PageFile.h"
+
+using std::string;
+using std::map;
+
+// the first line of a catalog file
+static const char* CATALOG_HEADER = "# bruinbase catalog 1";
+
+// the longest table name kept in the catalog
+static const int MAX_NAME_LENGTH = 255;
+
+Catalog::Catalog()
+{
+  pthread_mutex_init(&lock, NULL);
+}
+
+Catalog::~Catalog()
+{
+  pthread_mutex_destroy(&lock);
+}
+
+RC Catalog::load(const string& filename)
+{
+  FILE* in;
+  char  line[512];
+  char  name[MAX_NAME_LENGTH + 1];
+  char  layout[8];
+  int   index;
+  Entry e;
+  map<string, Entry> read;
+
+  if ((in = fopen(filename.c_str(), "r")) == NULL) {
+    if (errno != ENOENT) return RC_FILE_OPEN_FAILED;
+  } else {
+    // a line that cannot be parsed is skipped: its table is looked up on
+    // the disk instead
+    if (fgets(line, sizeof(line), in) == NULL || strncmp(line, CATALOG_HEADER, strlen(CATALOG_HEADER)) != 0) {
+      fclose(in);
+      return RC_INVALID_FILE_FORMAT;
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (sscanf(line, "%255s %7s %d %d %d %d %lld %lld", name, layout, &index, &e.end.pid, &e.end.sid,
+                 &e.pageSize, &e.size, &e.mtime) != 8) continue;
+      if (strcmp(layout, "rows") != 0 && strcmp(layout, "columns") != 0) continue;
+      e.columns = (strcmp(layout, "columns") == 0);
+      e.hasIndex = (index != 0);
+      read[name] = e;
+    }
+    fclose(in);
+  }
+
+  pthread_mutex_lock(&lock);
+  entries.swap(read);
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+RC Catalog::save(const string& filename) const
+{
+  string tmp = filename + ".tmp";
+  FILE*  out;
+
+  // write a new file and rename it over the old one
+  if ((out = fopen(tmp.c_str(), "w")) == NULL) return RC_FILE_OPEN_FAILED;
+  fprintf(out, "%s\n", CATALOG_HEADER);
+  pthread_mutex_lock(&lock);
+  for (map<string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+    const Entry& e = it->second;
+    fprintf(out, "%s %s %d %d %d %d %lld %lld\n", it->first.c_str(), e.columns ? "columns" : "rows",
+            e.hasIndex ? 1 : 0, e.end.pid, e.end.sid, e.pageSize, e.size, e.mtime);
+  }
+  pthread_mutex_unlock(&lock);
+  if (ferror(out)) {
+    fclose(out);
+    ::remove(tmp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+  if (fclose(out) != 0 || rename(tmp.c_str(), filename.c_str()) < 0) {
+    ::remove(tmp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+
+  return 0;
+}
+
+bool Catalog::find(const string& table, Entry& e) const
+{
+  long long size, mtime;
+
+  pthread_mutex_lock(&lock);
+  map<string, Entry>::const_iterator it = entries.find(table);
+  bool found = (it != entries.end());
+  if (found) e = it->second;
+  pthread_mutex_unlock(&lock);
+
+  // one stat() of the table file checks the entry
+  return found && e.pageSize == PageFile::PAGE_SIZE &&
+         statTable(table, e.columns, size, mtime) == 0 && size == e.size && mtime == e.mtime;
+}
+
+RC Catalog::update(const string& table, bool columns, bool hasIndex, const RecordId& end)
+{
+  Entry e;
+  RC    rc;
+
+  if (table.size() > (size_t) MAX_NAME_LENGTH || table.find_first_of(" \t\n") != string::npos) {
+    return RC_INVALID_PARAMETER;
+  }
+  if ((rc = statTable(table, columns, e.size, e.mtime)) < 0) {
+    remove(table);
+    return rc;
+  }
+  e.columns = columns;
+  e.hasIndex = hasIndex;
+  e.end = end;
+  e.pageSize = PageFile::PAGE_SIZE;
+
+  pthread_mutex_lock(&lock);
+  entries[table] = e;
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+void Catalog::remove(const string& table)
+{
+  pthread_mutex_lock(&lock);
+  entries.erase(table);
+  pthread_mutex_unlock(&lock);
+}
+
+RC Catalog::statTable(const string& table, bool columns, long long& size, long long& mtime)
+{
+  struct stat statbuf;
+
+  if (stat((table + (columns ? ".key" : ".tbl")).c_str(), &statbuf) < 0) return RC_FILE_OPEN_FAILED;
+  size = statbuf.st_size;
+  mtime = (long long) statbuf.st_mtim.tv_sec * 1000000000LL + statbuf.st_mtim.tv_nsec;
+  return 0;
+}
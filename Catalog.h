@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <string>
+#include <map>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+
+/**
+ * The catalog of the tables: how each one was stored when it was last
+ * closed, so that opening it again does not have to probe for its files.
+ * An entry holds the size and modification time of the table file, the
+ * .tbl file or the .key file of a table stored by columns, and is only
+ * used while the file still has them; a table changed or removed since
+ * is looked up on the disk as if it had no entry.
+ * The catalog is kept in a text file of one line per table.
+ * All operations may be called by several threads at the same time.
+ */
+class Catalog {
+ public:
+  /**
+   * the entry of a table
+   */
+  struct Entry {
+    bool      columns;   // whether the table is stored by columns
+    bool      hasIndex;  // whether the table has an index
+    RecordId  end;       // the end record id of the table file
+    int       pageSize;  // the PageFile::PAGE_SIZE of the files
+    long long size;      // the size of the table file
+    long long mtime;     // the modification time of the table file, in nanoseconds
+  };
+
+  Catalog();
+  ~Catalog();
+
+  /**
+   * read the entries from a file, replacing those in memory. a file that
+   * does not exist gives an empty catalog.
+   * @param filename[IN] the file to read
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the entries to a file. the file is replaced at once, so a
+   * reader never sees half of it.
+   * @param filename[IN] the file to write
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+  /**
+   * look up the entry of a table whose table file has not changed since
+   * the entry was made.
+   * @param table[IN] the table name
+   * @param e[OUT] the entry
+   * @return whether there is such an entry
+   */
+  bool find(const std::string& table, Entry& e) const;
+
+  /**
+   * make the entry of a table from its table file as it is now.
+   * @param table[IN] the table name
+   * @param columns[IN] whether the table is stored by columns
+   * @param hasIndex[IN] whether the table has an index
+   * @param end[IN] the end record id of the table file
+   * @return error code. 0 if no error
+   */
+  RC update(const std::string& table, bool columns, bool hasIndex, const RecordId& end);
+
+  /**
+   * drop the entry of a table, if any.
+   * @param table[IN] the table name
+   */
+  void remove(const std::string& table);
+
+ private:
+  Catalog(const Catalog&);             // not copyable: owns the mutex
+  Catalog& operator=(const Catalog&);
+
+  // the size and modification time of the table file of a table
+  static RC statTable(const std::string& table, bool columns, long long& size, long long& mtime);
+
+  std::map<std::string, Entry> entries;
+  mutable pthread_mutex_t lock;  // protects entries
+};
+
+#endif // CATALOG_H
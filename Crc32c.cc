@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include "Crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define HAS_CRC32_INSTRUCTION
+#endif
+
+// the reflected Castagnoli polynomial
+static const unsigned POLYNOMIAL = 0x82F63B78;
+
+// the checksum of each byte value
+static unsigned table[256];
+
+static void makeTable()
+{
+  for (unsigned i = 0; i < 256; i++) {
+    unsigned c = i;
+    for (int k = 0; k < 8; k++) c = (c >> 1) ^ ((c & 1) ? POLYNOMIAL : 0);
+    table[i] = c;
+  }
+}
+
+static unsigned computeTable(const unsigned char* p, size_t size, unsigned crc)
+{
+  while (size-- > 0) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef HAS_CRC32_INSTRUCTION
+__attribute__((target("sse4.2")))
+static unsigned computeSse42(const unsigned char* p, size_t size, unsigned crc)
+{
+#ifdef __x86_64__
+  unsigned long long c = crc;
+  for (; size >= 8; p += 8, size -= 8) {
+    unsigned long long word;
+    memcpy(&word, p, sizeof(word));
+    c = _mm_crc32_u64(c, word);
+  }
+  crc = (unsigned) c;
+#endif
+  for (; size >= 4; p += 4, size -= 4) {
+    unsigned word;
+    memcpy(&word, p, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+  }
+  while (size-- > 0) crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+#endif
+
+// the implementation picked for this processor the first time
+typedef unsigned (*ComputeFunction)(const unsigned char*, size_t, unsigned);
+
+static ComputeFunction pick()
+{
+#ifdef HAS_CRC32_INSTRUCTION
+  if (__builtin_cpu_supports("sse4.2")) return computeSse42;
+#endif
+  makeTable();
+  return computeTable;
+}
+
+static const ComputeFunction implementation = pick();
+
+unsigned Crc32c::compute(const void* data, size_t size, unsigned crc)
+{
+  return ~implementation((const unsigned char*) data, size, ~crc);
+}
+
+bool Crc32c::isAccelerated()
+{
+  return implementation != computeTable;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+
+/**
+ * Computes CRC32C (the Castagnoli polynomial) checksums of pages and
+ * records. The crc32 instruction of SSE4.2 is used when the processor has
+ * it, and a table otherwise; both give the same checksums.
+ */
+class Crc32c {
+ public:
+  /**
+   * @param data[IN] the bytes to checksum
+   * @param size[IN] the number of bytes
+   * @param crc[IN] the checksum of the bytes before these, to checksum
+   * several pieces as one, 0 for none
+   * @return the checksum
+   */
+  static unsigned compute(const void* data, size_t size, unsigned crc = 0);
+
+  /**
+   * @return whether the checksums are computed by the processor
+   */
+  static bool isAccelerated();
+};
+
+#endif // CRC32C_H
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <unistd.h>
+#include "ExternalSort.h"
+
+using std::string;
+using std::vector;
+
+ExternalSort::ExternalSort(int attr, bool descending, int limit, size_t memory, ThreadPool* pool)
+{
+  this->attr = attr;
+  this->descending = descending;
+  this->limit = limit;
+  this->pool = pool;
+
+  // a buffer for each worker and one being filled
+  maxWriting = (pool != NULL) ? pool->size() : 0;
+  bufferSize = memory / (maxWriting + 1);
+
+  buffer = new Buffer;
+  buffer->sorter = this;
+  spilled = false;
+  writing = 0;
+  error = 0;
+  merging = false;
+  position = 0;
+  last = -1;
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&idle, NULL);
+}
+
+ExternalSort::~ExternalSort()
+{
+  // wait for the workers before freeing what they use
+  pthread_mutex_lock(&lock);
+  while (writing > 0) pthread_cond_wait(&idle, &lock);
+  pthread_mutex_unlock(&lock);
+
+  delete buffer;
+  for (unsigned i = 0; i < runs.size(); i++) {
+    runs[i]->pf.close();
+    delete runs[i];
+  }
+  pthread_cond_destroy(&idle);
+  pthread_mutex_destroy(&lock);
+}
+
+RC ExternalSort::add(int key, const string& value, const RecordId& rid)
+{
+  RC rc;
+
+  if (buffer->tuples.size() * sizeof(Tuple) + buffer->arena.size() >= bufferSize &&
+      !buffer->tuples.empty()) {
+    if ((rc = spill()) < 0) return rc;
+  }
+
+  Tuple t;
+  t.key = key;
+  t.rid = rid;
+  t.value = buffer->arena.copy(value.c_str());
+  buffer->tuples.push_back(t);
+
+  return 0;
+}
+
+RC ExternalSort::sort()
+{
+  RC rc;
+
+  if (!spilled) {
+    // everything fits in one buffer
+    sortBuffer(buffer);
+    if (limit >= 0 && buffer->tuples.size() > (size_t) limit) buffer->tuples.resize(limit);
+    return 0;
+  }
+
+  if (!buffer->tuples.empty() && (rc = spill()) < 0) return rc;
+
+  pthread_mutex_lock(&lock);
+  while (writing > 0) pthread_cond_wait(&idle, &lock);
+  rc = error;
+  pthread_mutex_unlock(&lock);
+  if (rc < 0) return rc;
+
+  if ((rc = mergeRuns()) < 0) return rc;
+  merging = true;
+  return openReaders(runs);
+}
+
+RC ExternalSort::next(int& key, const char*& value, RecordId& rid)
+{
+  RC rc;
+
+  if (!merging) {
+    if (position >= buffer->tuples.size()) return RC_END_OF_TREE;
+    const Tuple& t = buffer->tuples[position++];
+    key = t.key;
+    value = t.value;
+    rid = t.rid;
+    return 0;
+  }
+
+  // the tuple returned last is still in its reader until now
+  if (readers.empty()) return RC_END_OF_TREE;
+  if (last >= 0 && (rc = advance()) < 0) return rc;
+
+  last = tree[0];
+  const RunReader& r = readers[last];
+  if (r.done) return RC_END_OF_TREE;
+  key = r.key;
+  value = r.value;
+  rid = r.rid;
+  return 0;
+}
+
+int ExternalSort::compare(int akey, const char* avalue, const RecordId& arid,
+                          int bkey, const char* bvalue, const RecordId& brid) const
+{
+  int diff;
+
+  if (attr == 1) {
+    diff = (akey > bkey) - (akey < bkey);
+    if (diff == 0) diff = strcmp(avalue, bvalue);
+  } else {
+    diff = strcmp(avalue, bvalue);
+    if (diff == 0) diff = (akey > bkey) - (akey < bkey);
+  }
+  if (diff == 0) diff = (brid < arid) - (arid < brid);
+
+  return descending ? -diff : diff;
+}
+
+RC ExternalSort::spill()
+{
+  Buffer* full = buffer;
+  RC rc;
+
+  // each run keeps its file open, so once there are many of them they
+  // are merged into longer runs before any more are written
+  pthread_mutex_lock(&lock);
+  bool merge = runs.size() + writing >= (size_t) MAX_RUNS;
+  while (merge && writing > 0) pthread_cond_wait(&idle, &lock);
+  rc = error;
+  pthread_mutex_unlock(&lock);
+  if (rc < 0) return rc;
+  if (merge && runs.size() >= (size_t) MAX_FANIN) {
+    // the newest runs are the shortest. the longer run they make goes
+    // to the front, so that it is not merged again with the next ones.
+    vector<Run*> group(runs.end() - MAX_FANIN, runs.end());
+    runs.erase(runs.end() - MAX_FANIN, runs.end());
+
+    Run* out = NULL;
+    rc = mergeGroup(group, out);
+    if (out != NULL) runs.insert(runs.begin(), out);
+    if (rc < 0) return rc;
+  }
+
+  buffer = new Buffer;
+  buffer->sorter = this;
+  spilled = true;
+
+  // the worker counts its writes for the thread that sorts
+  full->counters = PageFile::getIoCounters();
+
+  // hand the buffer to a worker, waiting for one to finish if all are
+  // busy, so that no more than the memory budget is in use
+  pthread_mutex_lock(&lock);
+  while (maxWriting > 0 && writing >= maxWriting) pthread_cond_wait(&idle, &lock);
+  writing++;
+  pthread_mutex_unlock(&lock);
+  if (maxWriting > 0 && pool->submit(writeBuffer, full) == 0) return 0;
+
+  // no worker: write the run here
+  writeBuffer(full);
+
+  pthread_mutex_lock(&lock);
+  rc = error;
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+void ExternalSort::writeBuffer(void* arg)
+{
+  Buffer*       b = (Buffer*) arg;
+  ExternalSort* s = b->sorter;
+  Run*          run = NULL;
+  RunWriter     w;
+  RC            rc;
+
+  PageFile::IoCounters* counters = PageFile::getIoCounters();
+  PageFile::setIoCounters(b->counters);
+
+  s->sortBuffer(b);
+
+  size_t n = b->tuples.size();
+  if (s->limit >= 0 && n > (size_t) s->limit) n = s->limit;
+
+  if ((rc = createRun(run)) == 0) {
+    startRun(w, run);
+    for (size_t i = 0; rc == 0 && i < n; i++) {
+      const Tuple& t = b->tuples[i];
+      rc = writeTuple(w, t.key, t.rid, t.value);
+    }
+    if (rc == 0) rc = finishRun(w);
+  }
+  delete b;
+  PageFile::setIoCounters(counters);
+
+  pthread_mutex_lock(&s->lock);
+  if (rc == 0) s->runs.push_back(run);
+  else if (s->error == 0) s->error = rc;
+  s->writing--;
+  pthread_cond_broadcast(&s->idle);
+  pthread_mutex_unlock(&s->lock);
+
+  if (rc < 0 && run != NULL) {
+    run->pf.close();
+    delete run;
+  }
+}
+
+void ExternalSort::sortBuffer(Buffer* b) const
+{
+  Before before = { this };
+  vector<Tuple>& v = b->tuples;
+
+  if (limit >= 0 && (size_t) limit < v.size()) {
+    std::partial_sort(v.begin(), v.begin() + limit, v.end(), before);
+  } else {
+    std::sort(v.begin(), v.end(), before);
+  }
+}
+
+RC ExternalSort::createRun(Run*& run)
+{
+  const char* dir = getenv("TMPDIR");
+  string name = string(dir != NULL ? dir : "/tmp") + "/bruinbase-sort.XXXXXX";
+  vector<char> path(name.begin(), name.end());
+  RC rc;
+
+  path.push_back(0);
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) return RC_FILE_OPEN_FAILED;
+  ::close(fd);
+
+  // the file is removed as soon as it is open, so that it goes away
+  // with the run even if the process dies
+  run = new Run;
+  run->pages = 0;
+  run->pf.setStatsName("sort runs");
+  rc = run->pf.open(&path[0], 'w');
+  unlink(&path[0]);
+  if (rc < 0) {
+    delete run;
+    run = NULL;
+  }
+  return rc;
+}
+
+void ExternalSort::startRun(RunWriter& w, Run* run)
+{
+  w.run = run;
+  w.offset = sizeof(int);
+  *(int*) w.page = 0;
+}
+
+RC ExternalSort::writeTuple(RunWriter& w, int key, const RecordId& rid, const char* value)
+{
+  int length = strlen(value);
+  int header[4] = { key, rid.pid, rid.sid, length };
+  RC  rc;
+
+  if (w.offset + sizeof(header) + length > (size_t) PageFile::PAGE_SIZE) {
+    if ((rc = w.run->pf.write(w.run->pages++, w.page)) < 0) return rc;
+    w.offset = sizeof(int);
+    *(int*) w.page = 0;
+  }
+
+  memcpy(w.page + w.offset, header, sizeof(header));
+  memcpy(w.page + w.offset + sizeof(header), value, length);
+  w.offset += sizeof(header) + length;
+  ++*(int*) w.page;
+
+  return 0;
+}
+
+RC ExternalSort::finishRun(RunWriter& w)
+{
+  RC rc;
+
+  if (*(int*) w.page > 0 && (rc = w.run->pf.write(w.run->pages++, w.page)) < 0) return rc;
+  w.offset = sizeof(int);
+  *(int*) w.page = 0;
+  return 0;
+}
+
+RC ExternalSort::readTuple(RunReader& r)
+{
+  RC rc;
+
+  while (r.left == 0) {
+    if (r.pid + 1 >= r.run->pages) {
+      r.done = true;
+      return 0;
+    }
+    if ((rc = r.run->pf.read(++r.pid, r.page)) < 0) return rc;
+    r.left = *(int*) r.page;
+    r.offset = sizeof(int);
+  }
+
+  int header[4];
+  memcpy(header, r.page + r.offset, sizeof(header));
+  if (header[3] < 0 || header[3] > RecordFile::MAX_VALUE_LENGTH) return RC_INVALID_FILE_FORMAT;
+  r.key = header[0];
+  r.rid.pid = header[1];
+  r.rid.sid = header[2];
+  memcpy(r.value, r.page + r.offset + sizeof(header), header[3]);
+  r.value[header[3]] = 0;
+
+  r.offset += sizeof(header) + header[3];
+  r.left--;
+  return 0;
+}
+
+RC ExternalSort::openReaders(const vector<Run*>& from)
+{
+  RC rc;
+
+  readers.resize(from.size());
+  for (unsigned i = 0; i < from.size(); i++) {
+    RunReader& r = readers[i];
+    r.run = from[i];
+    r.pid = -1;
+    r.left = 0;
+    r.done = false;
+    if ((rc = readTuple(r)) < 0) return rc;
+  }
+
+  buildTree();
+  last = -1;
+  return 0;
+}
+
+void ExternalSort::buildTree()
+{
+  // the readers are the leaves k..2k-1 of a binary tree whose inner
+  // nodes 1..k-1 hold the loser of the match played there
+  tree.assign(std::max((size_t) 1, readers.size()), 0);
+  if (readers.size() > 1) tree[0] = buildTree(1);
+}
+
+int ExternalSort::buildTree(int node)
+{
+  int k = readers.size();
+
+  if (node >= k) return node - k;
+
+  int a = buildTree(2 * node);
+  int b = buildTree(2 * node + 1);
+  if (readerBefore(a, b)) {
+    tree[node] = b;
+    return a;
+  }
+  tree[node] = a;
+  return b;
+}
+
+RC ExternalSort::advance()
+{
+  int k = readers.size();
+  int winner = last;
+  RC  rc;
+
+  if ((rc = readTuple(readers[winner])) < 0) return rc;
+
+  // replay the matches on the path from the reader to the root. only the
+  // losers stored there can beat it.
+  for (int node = (winner + k) / 2; node > 0; node /= 2) {
+    if (readerBefore(tree[node], winner)) std::swap(tree[node], winner);
+  }
+  tree[0] = winner;
+  return 0;
+}
+
+bool ExternalSort::readerBefore(int a, int b) const
+{
+  const RunReader& ra = readers[a];
+  const RunReader& rb = readers[b];
+
+  if (ra.done) return false;
+  if (rb.done) return true;
+  return compare(ra.key, ra.value, ra.rid, rb.key, rb.value, rb.rid) < 0;
+}
+
+RC ExternalSort::mergeRuns()
+{
+  RC rc;
+
+  while (runs.size() > (size_t) MAX_FANIN) {
+    // merge the first runs into one at the end
+    vector<Run*> group(runs.begin(), runs.begin() + MAX_FANIN);
+    runs.erase(runs.begin(), runs.begin() + MAX_FANIN);
+
+    Run* out = NULL;
+    rc = mergeGroup(group, out);
+    if (out != NULL) runs.push_back(out);
+    if (rc < 0) return rc;
+  }
+
+  return 0;
+}
+
+RC ExternalSort::mergeGroup(const vector<Run*>& group, Run*& out)
+{
+  RunWriter w;
+  RC rc;
+
+  out = NULL;
+  if ((rc = createRun(out)) == 0 && (rc = openReaders(group)) == 0) {
+    int n = 0;
+    startRun(w, out);
+    for (last = tree[0]; rc == 0 && !readers[last].done; last = tree[0]) {
+      if (limit >= 0 && n++ >= limit) break;
+      const RunReader& r = readers[last];
+      if ((rc = writeTuple(w, r.key, r.rid, r.value)) == 0) rc = advance();
+    }
+    if (rc == 0) rc = finishRun(w);
+  }
+
+  for (unsigned i = 0; i < group.size(); i++) {
+    group[i]->pf.close();
+    delete group[i];
+  }
+  return rc;
+}
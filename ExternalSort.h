@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef EXTERNALSORT_H
+#define EXTERNALSORT_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include "RecordFile.h"
+#include "ThreadPool.h"
+#include "Arena.h"
+
+/**
+ * Sorts tuples that may not fit in memory.
+ * The tuples are collected in buffers of a bounded size. Each full buffer
+ * is sorted and written to a temporary PageFile as a sorted run, on the
+ * workers of a thread pool while the next buffer is being filled. The
+ * runs are then merged with a loser tree; when there are more runs than
+ * can be merged at once, groups of runs are first merged into longer runs,
+ * which also happens while tuples are added once MAX_RUNS runs are written.
+ * Tuples that all fit in one buffer are never written.
+ */
+class ExternalSort {
+ public:
+  /**
+   * @param attr[IN] the attribute to sort by (1: key, 2: value). ties are
+   *                 broken by the other attribute, then by RecordId.
+   * @param descending[IN] sort from the largest tuple down
+   * @param limit[IN] only the first limit tuples have to come out in
+   *                  order, -1 for all of them
+   * @param memory[IN] the bytes of all buffers together
+   * @param pool[IN] the workers that sort and write the runs, or NULL to
+   *                 do it in the calling thread
+   */
+  ExternalSort(int attr, bool descending, int limit, size_t memory, ThreadPool* pool);
+  ~ExternalSort();
+
+  /**
+   * add a tuple.
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   * @param rid[IN] the location of the tuple
+   * @return error code. 0 if no error
+   */
+  RC add(int key, const std::string& value, const RecordId& rid);
+
+  /**
+   * finish adding tuples and prepare reading them in order with next().
+   * @return error code. 0 if no error
+   */
+  RC sort();
+
+  /**
+   * read the next tuple in order.
+   * @param key[OUT] the tuple key
+   * @param value[OUT] the tuple value, valid until the next call
+   * @param rid[OUT] the location of the tuple
+   * @return error code. 0 if no error, RC_END_OF_TREE after the last tuple
+   */
+  RC next(int& key, const char*& value, RecordId& rid);
+
+ private:
+  ExternalSort(const ExternalSort&);             // not copyable: owns files
+  ExternalSort& operator=(const ExternalSort&);
+
+  /**
+   * a tuple in a buffer
+   */
+  struct Tuple {
+    int         key;
+    RecordId    rid;
+    const char* value;  // in the arena of the buffer
+  };
+
+  /**
+   * a buffer of tuples, sorted and written as a run once it is full
+   */
+  struct Buffer {
+    ExternalSort*      sorter;
+    std::vector<Tuple> tuples;
+    Arena              arena;
+    PageFile::IoCounters* counters;  // where the run writes are counted
+  };
+
+  /**
+   * a sorted run in a temporary file. each page starts with the number
+   * of tuples on it, followed by the tuples, none of which spans two pages.
+   */
+  struct Run {
+    PageFile pf;
+    PageId   pages;  // the number of pages written
+  };
+
+  /**
+   * the page of a run being filled
+   */
+  struct RunWriter {
+    Run* run;
+    char page[PageFile::PAGE_SIZE];
+    int  offset;   // the end of the tuples on the page
+  };
+
+  /**
+   * a cursor over a run, for merging
+   */
+  struct RunReader {
+    Run*     run;
+    PageId   pid;                 // the page in page
+    char     page[PageFile::PAGE_SIZE];
+    int      left;                // tuples on the page not read yet
+    int      offset;              // the offset of the next tuple on the page
+    bool     done;                // there are no more tuples
+    int      key;                 // the current tuple
+    RecordId rid;
+    char     value[RecordFile::MAX_VALUE_LENGTH + 1];
+  };
+
+  /**
+   * the runs that are merged at once. each one reads a page at a time.
+   */
+  static const int MAX_FANIN = 64;
+
+  /**
+   * the runs written before they are merged into longer ones, which
+   * bounds the files open at once
+   */
+  static const int MAX_RUNS = 4 * MAX_FANIN;
+
+  /**
+   * compare two tuples in the sort order.
+   * @return a negative number, zero or a positive number as a comes
+   *         before, together with or after b
+   */
+  int compare(int akey, const char* avalue, const RecordId& arid,
+              int bkey, const char* bvalue, const RecordId& brid) const;
+
+  /**
+   * orders tuples for std::sort()
+   */
+  struct Before {
+    const ExternalSort* sorter;
+    bool operator()(const Tuple& a, const Tuple& b) const {
+      return sorter->compare(a.key, a.value, a.rid, b.key, b.value, b.rid) < 0;
+    }
+  };
+
+  /**
+   * sort the full buffer and write it as a run, on a worker if there is
+   * one free; otherwise in this thread.
+   */
+  RC spill();
+
+  /**
+   * the task of a worker: write a buffer as a run and free it.
+   */
+  static void writeBuffer(void* arg);
+
+  /**
+   * sort the tuples of a buffer. only the first limit have to be in order.
+   */
+  void sortBuffer(Buffer* b) const;
+
+  /**
+   * create a temporary file for a run.
+   * @return error code. 0 if no error
+   */
+  static RC createRun(Run*& run);
+
+  /**
+   * start filling the first page of a run.
+   */
+  static void startRun(RunWriter& w, Run* run);
+
+  /**
+   * append a tuple to a run.
+   */
+  static RC writeTuple(RunWriter& w, int key, const RecordId& rid, const char* value);
+
+  /**
+   * write the page being filled, if it holds any tuple.
+   */
+  static RC finishRun(RunWriter& w);
+
+  /**
+   * read the next tuple of a run into the reader.
+   */
+  static RC readTuple(RunReader& r);
+
+  /**
+   * set up the loser tree over readers.
+   */
+  void buildTree();
+
+  /**
+   * the first tuple among the subtree of the loser tree at node, which
+   * stores the losers of the subtree on the way.
+   */
+  int buildTree(int node);
+
+  /**
+   * move the reader that produced the last tuple to its next tuple and
+   * play its way up the loser tree.
+   */
+  RC advance();
+
+  /**
+   * @return whether the current tuple of reader a comes before the one of b.
+   *         a reader without tuples comes after every other.
+   */
+  bool readerBefore(int a, int b) const;
+
+  /**
+   * merge groups of runs into longer runs until they can all be merged
+   * at once.
+   */
+  RC mergeRuns();
+
+  /**
+   * merge a group of runs into one and delete them.
+   * @param group[IN] the runs to merge
+   * @param out[OUT] the merged run, NULL if it could not be created
+   * @return error code. 0 if no error
+   */
+  RC mergeGroup(const std::vector<Run*>& group, Run*& out);
+
+  /**
+   * set up the readers and the loser tree over the given runs.
+   */
+  RC openReaders(const std::vector<Run*>& runs);
+
+  int         attr;        // the attribute to sort by
+  bool        descending;  // the sort order
+  int         limit;       // the tuples that have to be in order, -1 for all
+  size_t      bufferSize;  // the bytes of one buffer
+  ThreadPool* pool;        // the workers that write runs
+
+  Buffer*     buffer;      // the buffer being filled
+  bool        spilled;     // a buffer was written as a run
+
+  int               maxWriting; // the most buffers written by workers at once
+  pthread_mutex_t   lock;       // protects the fields below
+  pthread_cond_t    idle;       // signaled when a run is finished
+  int               writing;    // the buffers being written
+  std::vector<Run*> runs;       // the finished runs
+  RC                error;      // the first error of writing a run
+
+  bool                   merging;  // the tuples come from runs
+  unsigned               position; // the next tuple of buffer, when not merging
+  std::vector<RunReader> readers;  // the runs being merged
+  std::vector<int>       tree;     // the loser tree. tree[0] is the winner
+  int                    last;     // the reader of the last tuple returned, -1 if none
+};
+
+#endif // EXTERNALSORT_H
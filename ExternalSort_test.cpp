@@ -0,0 +1,191 @@
+#include <ExternalSort.h>
+#include <test_util.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+
+// a tuple added to a sort, kept to check what comes out
+struct SortTuple {
+    int         key;
+    std::string value;
+    RecordId    rid;
+};
+
+// the order of ExternalSort on key, ties broken by value, then RecordId
+static bool keyBefore(const SortTuple& a, const SortTuple& b);
+
+// the order of ExternalSort on value, ties broken by key, then RecordId
+static bool valueBefore(const SortTuple& a, const SortTuple& b);
+
+// add the tuples to a sorter, sort them and check that they come out in
+// the order of before(), reversed if descending. only the first limit
+// tuples are checked when limit >= 0.
+static void checkSort(ExternalSort& sorter, std::vector<SortTuple> tuples,
+                      bool (*before)(const SortTuple&, const SortTuple&),
+                      bool descending, int limit);
+
+static std::string testValue(int i);
+
+int main( int argc, const char* argv[] )
+{
+    int test = argc > 1 ? atoi(argv[1]) : 0;
+    switch (test)
+    {
+        case 0: {
+            // Spill Test
+            // a memory budget far below the size of the tuples writes
+            // sorted runs, with and without workers writing them
+            std::cout << "Spill Test" << std::endl;
+            int range = 100000;
+            size_t memory = 1024 * 1024;
+            std::vector<SortTuple> tuples;
+            srand(37);
+            for (int i = 0; i < range; i++)
+            {
+                SortTuple t = { rand() % range - range / 2, testValue(rand() % range), { i / 80, i % 80 } };
+                tuples.push_back(t);
+            }
+
+            ThreadPool pool;
+            ASSERT(0 == pool.start(4));
+            for (int p = 0; p < 2; p++)
+            {
+                long long writes = PageFile::getPageWriteCount();
+                {
+                    ExternalSort sorter(1, false, -1, memory, p ? &pool : NULL);
+                    checkSort(sorter, tuples, keyBefore, false, -1);
+                }
+                LOOP_ASSERT(p, PageFile::getPageWriteCount() > writes);
+                {
+                    ExternalSort sorter(2, true, -1, memory, p ? &pool : NULL);
+                    checkSort(sorter, tuples, valueBefore, true, -1);
+                }
+                {
+                    ExternalSort sorter(1, true, 1000, memory, p ? &pool : NULL);
+                    checkSort(sorter, tuples, keyBefore, true, 1000);
+                }
+            }
+            pool.stop();
+        } break;
+        case 1: {
+            // Empty Test
+            // a sort with no tuples, spilled or not, ends at once
+            std::cout << "Empty Test" << std::endl;
+            std::vector<SortTuple> tuples;
+            {
+                ExternalSort sorter(1, false, -1, 64 * 1024, NULL);
+                checkSort(sorter, tuples, keyBefore, false, -1);
+            }
+            {
+                ExternalSort sorter(2, true, 10, 0, NULL);
+                checkSort(sorter, tuples, valueBefore, true, 10);
+            }
+            {
+                // one tuple in a buffer too small for it
+                SortTuple t = { 5, testValue(5), { 0, 0 } };
+                tuples.push_back(t);
+                ExternalSort sorter(1, false, -1, 0, NULL);
+                checkSort(sorter, tuples, keyBefore, false, -1);
+            }
+        } break;
+        case 2: {
+            // Duplicate Key Test
+            // tuples that all have the same key are ordered by value and
+            // then by RecordId, across runs. a budget below one block of
+            // the arena makes a run of every tuple, more than the files
+            // that can be open, so runs are merged while tuples are added.
+            std::cout << "Duplicate Key Test" << std::endl;
+            int range = 5000;
+            struct rlimit files = { 1024, 1024 };
+            ASSERT(0 == setrlimit(RLIMIT_NOFILE, &files));
+            std::vector<SortTuple> tuples;
+            for (int i = 0; i < range; i++)
+            {
+                SortTuple t = { 7, testValue(i % 100), { (range - i) / 80, i % 80 } };
+                tuples.push_back(t);
+            }
+            {
+                ExternalSort sorter(1, false, -1, 32 * 1024, NULL);
+                checkSort(sorter, tuples, keyBefore, false, -1);
+            }
+            {
+                ExternalSort sorter(1, true, -1, 32 * 1024, NULL);
+                checkSort(sorter, tuples, keyBefore, true, -1);
+            }
+
+            // the same key and value everywhere: only the RecordIds differ
+            for (int i = 0; i < range; i++) tuples[i].value = "same";
+            {
+                ExternalSort sorter(2, false, -1, 32 * 1024, NULL);
+                checkSort(sorter, tuples, valueBefore, false, -1);
+            }
+        } break;
+        default: {
+            std::cerr << "WARNING: CASE `" << test << "' NOT FOUND." << std::endl;
+            testStatus = -1;
+      } break;
+    }
+    return testStatus;
+}
+
+static bool keyBefore(const SortTuple& a, const SortTuple& b)
+{
+    if (a.key != b.key) return a.key < b.key;
+    if (a.value != b.value) return a.value < b.value;
+    if (a.rid.pid != b.rid.pid) return a.rid.pid < b.rid.pid;
+    return a.rid.sid < b.rid.sid;
+}
+
+static bool valueBefore(const SortTuple& a, const SortTuple& b)
+{
+    if (a.value != b.value) return a.value < b.value;
+    if (a.key != b.key) return a.key < b.key;
+    if (a.rid.pid != b.rid.pid) return a.rid.pid < b.rid.pid;
+    return a.rid.sid < b.rid.sid;
+}
+
+static void checkSort(ExternalSort& sorter, std::vector<SortTuple> tuples,
+                      bool (*before)(const SortTuple&, const SortTuple&),
+                      bool descending, int limit)
+{
+    for (size_t i = 0; i < tuples.size(); i++)
+    {
+        ASSERT(0 == sorter.add(tuples[i].key, tuples[i].value, tuples[i].rid));
+    }
+    ASSERT(0 == sorter.sort());
+
+    std::sort(tuples.begin(), tuples.end(), before);
+    if (descending) std::reverse(tuples.begin(), tuples.end());
+    size_t check = (limit >= 0 && (size_t) limit < tuples.size()) ? limit : tuples.size();
+
+    int         key;
+    const char* value;
+    RecordId    rid;
+    size_t      count = 0;
+    RC          rc;
+    while ((rc = sorter.next(key, value, rid)) == 0)
+    {
+        if (count < check)
+        {
+            const SortTuple& t = tuples[count];
+            LOOP2_ASSERT(count, key, key == t.key);
+            LOOP2_ASSERT(count, value, t.value == value);
+            LOOP2_ASSERT(count, rid.pid, rid.pid == t.rid.pid && rid.sid == t.rid.sid);
+        }
+        count++;
+    }
+    ASSERT(rc == RC_END_OF_TREE);
+    LOOP2_ASSERT(count, check, count >= check && count <= tuples.size());
+}
+
+static std::string testValue(int i)
+{
+    std::ostringstream sout;
+    sout << "value " << i;
+    return sout.str();
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include "HashAggregate.h"
+#include "ExternalSort.h"
+
+using std::string;
+
+HashAggregate::HashAggregate(int group, int attr, size_t memory)
+{
+  init(group, attr, memory, 0);
+}
+
+HashAggregate::HashAggregate(int group, int attr, size_t memory, int level)
+{
+  init(group, attr, memory, level);
+}
+
+void HashAggregate::init(int group, int attr, size_t memory, int level)
+{
+  this->group = group;
+  this->attr = attr;
+  this->memory = memory;
+  this->level = level;
+
+  capacity = MIN_CAPACITY;
+  slots = (Entry*) calloc(capacity, sizeof(Entry));
+  used = 0;
+  for (int i = 0; i < PARTITIONS; i++) files[i] = NULL;
+}
+
+HashAggregate::~HashAggregate()
+{
+  free(slots);
+  for (int i = 0; i < PARTITIONS; i++) {
+    if (files[i] != NULL) fclose(files[i]);
+  }
+}
+
+RC HashAggregate::add(int key, const string& value)
+{
+  GroupAggregate agg = { 1, key, key, value.c_str() };
+  const char* v = (group == 2) ? value.c_str() : NULL;
+
+  return combine(hashOf(key, v), key, v, agg);
+}
+
+RC HashAggregate::merge(HashAggregate& other)
+{
+  RC rc;
+
+  for (int i = 0; i < other.capacity; i++) {
+    Entry& e = other.slots[i];
+    if (!e.used) continue;
+    if ((rc = combine(e.hash, e.key, e.value, e.agg)) < 0) return rc;
+  }
+  for (int i = 0; i < PARTITIONS; i++) {
+    if (other.files[i] == NULL) continue;
+    rewind(other.files[i]);
+    if ((rc = combineFile(other.files[i])) < 0) return rc;
+  }
+
+  return 0;
+}
+
+RC HashAggregate::finish(GroupVisitor visit, void* arg)
+{
+  RC rc;
+  bool spilled = false;
+
+  for (int i = 0; i < PARTITIONS; i++) {
+    if (files[i] != NULL) spilled = true;
+  }
+
+  if (!spilled) {
+    for (int i = 0; i < capacity; i++) {
+      Entry& e = slots[i];
+      if (e.used && !visit(arg, e.key, e.value, e.agg)) break;
+    }
+    return 0;
+  }
+
+  // a group may be partly in memory and partly in a spill file, so write
+  // out the rest and aggregate each partition on its own. a partition
+  // that is still too large spills again, on the next bits of the hash.
+  if ((rc = spill()) < 0) return rc;
+
+  for (int i = 0; i < PARTITIONS; i++) {
+    if (files[i] == NULL) continue;
+
+    HashAggregate part(group, attr, memory, level + 1);
+    rewind(files[i]);
+    if ((rc = part.combineFile(files[i])) < 0) return rc;
+    fclose(files[i]);
+    files[i] = NULL;
+
+    if ((rc = part.finish(visit, arg)) < 0) return rc;
+  }
+
+  return 0;
+}
+
+//
+// a group sorted by finishSorted() is a tuple of an ExternalSort whose
+// key or value is the group. the RecordId holds the number the aggregate
+// prints: the count of COUNT(*), the key of MIN/MAX(key) or the sum of
+// SUM/AVG(key). the other attribute holds the count of AVG(key) and,
+// when grouping by key, MIN/MAX(value).
+//
+struct GroupSort {
+  ExternalSort* sorter;
+  int           group;
+  int           attr;
+  RC            rc;      // the first error of adding a group
+  int           groups;  // the groups added
+};
+
+static bool sortGroup(void* arg, int key, const char* value, const GroupAggregate& agg)
+{
+  GroupSort* s = (GroupSort*) arg;
+  long long n = (s->attr == 4) ? agg.count : (s->attr == 5 || s->attr == 6) ? agg.key : agg.sum;
+  RecordId rid = { (PageId) (n >> 32), (int) (unsigned) n };
+  char buf[16];
+
+  s->groups++;
+  if (s->group == 1) {
+    if (s->attr == 8) snprintf(buf, sizeof(buf), "%d", agg.count);
+    const char* v = (s->attr == 8) ? buf : (agg.value != NULL ? agg.value : "");
+    s->rc = s->sorter->add(key, v, rid);
+  } else {
+    s->rc = s->sorter->add(s->attr == 8 ? agg.count : 0, value, rid);
+  }
+  return s->rc == 0;
+}
+
+RC HashAggregate::finishSorted(bool descending, int limit, size_t memory, ThreadPool* pool, GroupVisitor visit, void* arg, int& groups)
+{
+  ExternalSort sorter(group, descending, limit, memory, pool);
+  GroupSort state = { &sorter, group, attr, 0, 0 };
+  RC rc;
+
+  rc = finish(sortGroup, &state);
+  groups = state.groups;
+  if (rc < 0) return rc;
+  if (state.rc < 0) return state.rc;
+  if ((rc = sorter.sort()) < 0) return rc;
+
+  int         key;
+  const char* value;
+  RecordId    rid;
+  while ((rc = sorter.next(key, value, rid)) == 0) {
+    long long n = ((long long) rid.pid << 32) | (unsigned) rid.sid;
+    GroupAggregate agg;
+
+    // every group has a tuple, so the count only matters to COUNT(*)
+    // and AVG(key)
+    agg.count = 1;
+    if (attr == 4) agg.count = (int) n;
+    else if (attr == 8) agg.count = (group == 1) ? atoi(value) : key;
+    agg.sum = n;
+    agg.key = (int) n;
+    agg.value = value;
+
+    if (group == 1 && !visit(arg, key, NULL, agg)) return 0;
+    if (group == 2 && !visit(arg, 0, value, agg)) return 0;
+  }
+  return (rc == RC_END_OF_TREE) ? 0 : rc;
+}
+
+RC HashAggregate::combine(unsigned hash, int key, const char* value, const GroupAggregate& agg)
+{
+  RC rc;
+  Entry* e = find(hash, key, value);
+
+  if (!e->used) {
+    // a new group. make room first if the table is half full or the
+    // memory budget is used up.
+    size_t bytes = capacity * sizeof(Entry) + arena.size();
+    bool canSpill = used > 0 && (level + 1) * PARTITION_BITS <= 32;
+    if (used + 1 > capacity / 2) {
+      if (bytes + capacity * sizeof(Entry) <= memory || !canSpill) {
+        grow();
+      } else if ((rc = spill()) < 0) {
+        return rc;
+      }
+      e = find(hash, key, value);
+    } else if (bytes > memory && canSpill) {
+      if ((rc = spill()) < 0) return rc;
+      e = find(hash, key, value);
+    }
+
+    e->used = true;
+    e->hash = hash;
+    e->key = key;
+    e->value = (value != NULL) ? arena.copy(value) : NULL;
+    e->agg = agg;
+    e->agg.value = (attr == 9 || attr == 10) ? arena.copy(agg.value) : NULL;
+    used++;
+    return 0;
+  }
+
+  GroupAggregate& a = e->agg;
+  a.count += agg.count;
+  a.sum += agg.sum;
+  switch (attr) {
+  case 5:  // MIN(key)
+    if (agg.key < a.key) a.key = agg.key;
+    break;
+  case 6:  // MAX(key)
+    if (agg.key > a.key) a.key = agg.key;
+    break;
+  case 9:  // MIN(value)
+    if (strcmp(agg.value, a.value) < 0) a.value = arena.copy(agg.value);
+    break;
+  case 10: // MAX(value)
+    if (strcmp(agg.value, a.value) > 0) a.value = arena.copy(agg.value);
+    break;
+  }
+
+  return 0;
+}
+
+RC HashAggregate::combineFile(FILE* file)
+{
+  SpillRecord r;
+  char value[RecordFile::MAX_VALUE_LENGTH + 1];
+  char aggValue[RecordFile::MAX_VALUE_LENGTH + 1];
+  RC rc;
+
+  while (fread(&r, sizeof(r), 1, file) == 1) {
+    if (r.valueLength > RecordFile::MAX_VALUE_LENGTH || r.aggLength > RecordFile::MAX_VALUE_LENGTH) return RC_INVALID_FILE_FORMAT;
+    if (r.valueLength >= 0) {
+      if (fread(value, 1, r.valueLength, file) != (size_t) r.valueLength) return RC_FILE_READ_FAILED;
+      value[r.valueLength] = 0;
+    }
+    if (r.aggLength >= 0) {
+      if (fread(aggValue, 1, r.aggLength, file) != (size_t) r.aggLength) return RC_FILE_READ_FAILED;
+      aggValue[r.aggLength] = 0;
+    }
+
+    GroupAggregate agg = { r.count, r.sum, r.aggKey, r.aggLength >= 0 ? aggValue : NULL };
+    if ((rc = combine(r.hash, r.key, r.valueLength >= 0 ? value : NULL, agg)) < 0) return rc;
+  }
+  if (ferror(file)) return RC_FILE_READ_FAILED;
+
+  return 0;
+}
+
+HashAggregate::Entry* HashAggregate::find(unsigned hash, int key, const char* value)
+{
+  // linear probing: the slots of a cluster are next to each other in memory
+  unsigned mask = capacity - 1;
+  for (unsigned i = hash & mask; ; i = (i + 1) & mask) {
+    Entry* e = &slots[i];
+    if (!e->used) return e;
+    if (e->hash != hash) continue;
+    if (value == NULL ? e->key == key : strcmp(e->value, value) == 0) return e;
+  }
+}
+
+void HashAggregate::grow()
+{
+  Entry* old = slots;
+  int    oldCapacity = capacity;
+
+  capacity *= 2;
+  slots = (Entry*) calloc(capacity, sizeof(Entry));
+
+  // the strings stay where they are in the arena
+  for (int i = 0; i < oldCapacity; i++) {
+    if (!old[i].used) continue;
+    *find(old[i].hash, old[i].key, old[i].value) = old[i];
+  }
+  free(old);
+}
+
+RC HashAggregate::spill()
+{
+  for (int i = 0; i < capacity; i++) {
+    Entry& e = slots[i];
+    if (!e.used) continue;
+
+    int p = partitionOf(e.hash);
+    if (files[p] == NULL && (files[p] = tmpfile()) == NULL) return RC_FILE_OPEN_FAILED;
+
+    SpillRecord r;
+    memset(&r, 0, sizeof(r));
+    r.hash = e.hash;
+    r.key = e.key;
+    r.count = e.agg.count;
+    r.sum = e.agg.sum;
+    r.aggKey = e.agg.key;
+    r.valueLength = (e.value != NULL) ? strlen(e.value) : -1;
+    r.aggLength = (e.agg.value != NULL) ? strlen(e.agg.value) : -1;
+
+    if (fwrite(&r, sizeof(r), 1, files[p]) != 1) return RC_FILE_WRITE_FAILED;
+    if (r.valueLength > 0 && fwrite(e.value, 1, r.valueLength, files[p]) != (size_t) r.valueLength) return RC_FILE_WRITE_FAILED;
+    if (r.aggLength > 0 && fwrite(e.agg.value, 1, r.aggLength, files[p]) != (size_t) r.aggLength) return RC_FILE_WRITE_FAILED;
+  }
+
+  // start over with an empty table and arena
+  free(slots);
+  capacity = MIN_CAPACITY;
+  slots = (Entry*) calloc(capacity, sizeof(Entry));
+  used = 0;
+  arena.clear();
+
+  return 0;
+}
+
+unsigned HashAggregate::hashOf(int key, const char* value) const
+{
+  unsigned h;
+
+  if (value == NULL) {
+    h = (unsigned) key;
+  } else {
+    // FNV-1a over the bytes of the value
+    h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) value; *p; p++) {
+      h = (h ^ *p) * 16777619u;
+    }
+  }
+
+  // mix the bits so that both the low bits (the slot) and the high bits
+  // (the spill partition) depend on the whole key
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+int HashAggregate::partitionOf(unsigned hash) const
+{
+  // each level of spilling uses the next PARTITION_BITS bits from the top
+  return (hash >> (32 - PARTITION_BITS * (level + 1))) & (PARTITIONS - 1);
+}
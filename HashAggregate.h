@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef HASHAGGREGATE_H
+#define HASHAGGREGATE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "Arena.h"
+#include "ThreadPool.h"
+
+/**
+ * The running aggregate of a group of tuples.
+ */
+typedef struct {
+  int         count;  // the number of tuples
+  long long   sum;    // the sum of their keys
+  int         key;    // the smallest or largest key, for MIN/MAX(key)
+  const char* value;  // the smallest or largest value, for MIN/MAX(value)
+} GroupAggregate;
+
+/**
+ * Groups tuples by key or by value and aggregates each group.
+ * The groups are kept in an open-addressing hash table whose string keys
+ * live in an arena. When the table and the arena outgrow their memory
+ * budget, the partial aggregates are written to temporary files, one per
+ * hash partition, and each partition is aggregated on its own by finish().
+ */
+class HashAggregate {
+ public:
+  /**
+   * called by finish() for each group. key is the group key when grouping
+   * by key; value is the group value when grouping by value, NULL otherwise.
+   * returns false to stop.
+   */
+  typedef bool (*GroupVisitor)(void* arg, int key, const char* value, const GroupAggregate& agg);
+
+  /**
+   * @param group[IN] the attribute to group by (1: key, 2: value)
+   * @param attr[IN] the aggregate of each group, as in SqlEngine::select().
+   *                 MIN/MAX(value) are only kept when attr asks for them.
+   * @param memory[IN] the bytes of the hash table and the arena
+   */
+  HashAggregate(int group, int attr, size_t memory);
+  ~HashAggregate();
+
+  /**
+   * add a tuple to its group.
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   * @return error code. 0 if no error
+   */
+  RC add(int key, const std::string& value);
+
+  /**
+   * add the partial aggregates of another table, such as the one built
+   * by another thread over a different part of the same table.
+   * @param other[IN] a table with the same group and attr
+   * @return error code. 0 if no error
+   */
+  RC merge(HashAggregate& other);
+
+  /**
+   * pass every group to visit(). the groups come in no particular order.
+   * no tuples can be added afterwards.
+   * @param visit[IN] the function called for each group
+   * @param arg[IN] the first argument of visit()
+   * @return error code. 0 if no error
+   */
+  RC finish(GroupVisitor visit, void* arg);
+
+  /**
+   * pass every group to visit() in the order of the group attribute. the
+   * groups are sorted by an ExternalSort, so they need not fit in memory.
+   * no tuples can be added afterwards.
+   * @param descending[IN] start from the largest group
+   * @param limit[IN] only the first limit groups have to come in order,
+   *                  -1 for all of them
+   * @param memory[IN] the bytes of the buffers of the sort
+   * @param pool[IN] the workers of the sort, or NULL
+   * @param visit[IN] the function called for each group
+   * @param arg[IN] the first argument of visit()
+   * @param groups[OUT] the number of groups sorted
+   * @return error code. 0 if no error
+   */
+  RC finishSorted(bool descending, int limit, size_t memory, ThreadPool* pool, GroupVisitor visit, void* arg, int& groups);
+
+ private:
+  HashAggregate(const HashAggregate&);             // not copyable: owns files
+  HashAggregate& operator=(const HashAggregate&);
+
+  /**
+   * a slot of the hash table
+   */
+  struct Entry {
+    unsigned       hash;    // the hash of the group key
+    bool           used;    // whether the slot holds a group
+    int            key;     // the group key, when grouping by key
+    const char*    value;   // the group value in the arena, when grouping by value
+    GroupAggregate agg;     // the aggregate of the group
+  };
+
+  /**
+   * the fixed part of a partial aggregate in a spill file. it is followed
+   * by valueLength bytes of the group value and aggLength bytes of agg.value.
+   */
+  struct SpillRecord {
+    unsigned  hash;
+    int       key;
+    int       count;
+    long long sum;
+    int       aggKey;
+    int       valueLength;  // -1 when grouping by key
+    int       aggLength;    // -1 when there is no agg.value
+  };
+
+  static const int    PARTITION_BITS = 4;   // 16 spill partitions
+  static const int    PARTITIONS = 1 << PARTITION_BITS;
+  static const int    MIN_CAPACITY = 1024;  // slots of an empty table
+
+  /**
+   * the table of a spilled partition, which spills on the next bits of
+   * the hash
+   */
+  HashAggregate(int group, int attr, size_t memory, int level);
+  void init(int group, int attr, size_t memory, int level);
+
+  /**
+   * fold a partial aggregate into its group, adding the group if needed.
+   * the strings are copied into the arena.
+   */
+  RC combine(unsigned hash, int key, const char* value, const GroupAggregate& agg);
+
+  /**
+   * fold the partial aggregates of a spill file into the table.
+   */
+  RC combineFile(FILE* file);
+
+  /**
+   * find the slot of a group or the empty slot where it belongs.
+   */
+  Entry* find(unsigned hash, int key, const char* value);
+
+  /**
+   * double the number of slots.
+   */
+  void grow();
+
+  /**
+   * write the groups to the spill files of their partitions and empty
+   * the table and the arena.
+   */
+  RC spill();
+
+  /**
+   * @return the hash of a group key
+   */
+  unsigned hashOf(int key, const char* value) const;
+
+  /**
+   * @return the spill partition of a hash at this level
+   */
+  int partitionOf(unsigned hash) const;
+
+  int    group;     // the attribute to group by
+  int    attr;      // the aggregate of each group
+  size_t memory;    // the memory budget
+  int    level;     // the recursion depth of spilled partitions
+
+  Entry* slots;     // the hash table
+  int    capacity;  // the number of slots, a power of two
+  int    used;      // the number of groups in the table
+
+  Arena  arena;     // the group values and MIN/MAX(value) strings
+
+  FILE*  files[PARTITIONS];   // the spill files, NULL until first used
+};
+
+#endif // HASHAGGREGATE_H
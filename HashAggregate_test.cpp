@@ -0,0 +1,252 @@
+#include <HashAggregate.h>
+#include <test_util.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+// the groups passed to a visitor, in the order they came
+struct Groups {
+    std::vector<int>            keys;
+    std::vector<std::string>    values;
+    std::vector<GroupAggregate> aggs;
+    std::vector<std::string>    aggValues;  // the copies of agg.value
+};
+
+static bool collectGroup(void* arg, int key, const char* value, const GroupAggregate& agg);
+
+// the value of the tuples of group i
+static std::string groupValue(int i);
+
+int main( int argc, const char* argv[] )
+{
+    int test = argc > 1 ? atoi(argv[1]) : 0;
+    switch (test)
+    {
+        case 0: {
+            // Sorted Group Test
+            // the groups come out of finishSorted() in the order of the
+            // group attribute, with the aggregates they had, when the
+            // sort spills to disk
+            std::cout << "Sorted Group Test" << std::endl;
+            int groups = 5000;
+            size_t sortMemory = 64 * 1024;
+
+            // GROUP BY value ... ORDER BY value DESC, with COUNT(*)
+            {
+                HashAggregate agg(2, 4, 1024 * 1024);
+                std::map<std::string, int> counts;
+                for (int i = 0; i < 3 * groups; i++)
+                {
+                    std::string value = groupValue(i * 7 % groups);
+                    ASSERT(0 == agg.add(i, value));
+                    counts[value]++;
+                }
+                Groups g;
+                int sorted = 0;
+                ASSERT(0 == agg.finishSorted(true, -1, sortMemory, NULL, collectGroup, &g, sorted));
+                ASSERT(sorted == groups);
+                ASSERT(g.values.size() == (size_t) groups);
+                std::map<std::string, int>::reverse_iterator it = counts.rbegin();
+                for (size_t i = 0; i < g.values.size() && it != counts.rend(); i++, ++it)
+                {
+                    LOOP2_ASSERT(i, g.values[i], g.values[i] == it->first);
+                    LOOP2_ASSERT(i, g.aggs[i].count, g.aggs[i].count == it->second);
+                }
+            }
+
+            // GROUP BY value ... ORDER BY value, with AVG(key) of large
+            // keys and a limit
+            {
+                HashAggregate agg(2, 8, 1024 * 1024);
+                std::map<std::string, std::pair<int, long long> > avgs;
+                for (int i = 0; i < 3 * groups; i++)
+                {
+                    std::string value = groupValue(i % groups);
+                    int key = (i % 2) ? 2000000000 - i : -2000000000 + i;
+                    ASSERT(0 == agg.add(key, value));
+                    avgs[value].first++;
+                    avgs[value].second += key;
+                }
+                Groups g;
+                int sorted = 0;
+                ASSERT(0 == agg.finishSorted(false, 100, sortMemory, NULL, collectGroup, &g, sorted));
+                ASSERT(sorted == groups);
+                ASSERT(g.values.size() >= 100);
+                std::map<std::string, std::pair<int, long long> >::iterator it = avgs.begin();
+                for (size_t i = 0; i < 100 && i < g.values.size(); i++, ++it)
+                {
+                    LOOP2_ASSERT(i, g.values[i], g.values[i] == it->first);
+                    LOOP2_ASSERT(i, g.aggs[i].count, g.aggs[i].count == it->second.first);
+                    LOOP2_ASSERT(i, g.aggs[i].sum, g.aggs[i].sum == it->second.second);
+                }
+            }
+
+            // GROUP BY key ... ORDER BY key, with MAX(value)
+            {
+                HashAggregate agg(1, 10, 1024 * 1024);
+                std::map<int, std::string> maxs;
+                for (int i = 0; i < 3 * groups; i++)
+                {
+                    int key = (i % groups) * 13 - groups;
+                    std::string value = groupValue(i);
+                    ASSERT(0 == agg.add(key, value));
+                    if (maxs.count(key) == 0 || value > maxs[key]) maxs[key] = value;
+                }
+                Groups g;
+                int sorted = 0;
+                ASSERT(0 == agg.finishSorted(false, -1, sortMemory, NULL, collectGroup, &g, sorted));
+                ASSERT(g.keys.size() == (size_t) groups);
+                std::map<int, std::string>::iterator it = maxs.begin();
+                for (size_t i = 0; i < g.keys.size() && it != maxs.end(); i++, ++it)
+                {
+                    LOOP2_ASSERT(i, g.keys[i], g.keys[i] == it->first);
+                    LOOP2_ASSERT(i, g.aggValues[i], g.aggValues[i] == it->second);
+                }
+            }
+        } break;
+        case 1: {
+            // Spill Test
+            // groups far beyond the memory budget are spilled to the
+            // partition files, also by the tables merged into another,
+            // and each group still comes out once with all its tuples
+            std::cout << "Spill Test" << std::endl;
+            int groups = 40000;
+            size_t memory = 64 * 1024;
+            for (int group = 1; group <= 2; group++)
+            {
+                HashAggregate agg(group, 7, memory);
+                HashAggregate other(group, 7, memory);
+                std::map<std::string, std::pair<int, long long> > expected;
+                for (int i = 0; i < 4 * groups; i++)
+                {
+                    int key = (group == 1) ? i % groups : i;
+                    std::string value = groupValue(i % groups);
+                    ASSERT(0 == (i % 2 ? other : agg).add(key, value));
+                    std::string name = (group == 1) ? groupValue(key) : value;
+                    expected[name].first++;
+                    expected[name].second += key;
+                }
+                ASSERT(0 == agg.merge(other));
+                Groups g;
+                ASSERT(0 == agg.finish(collectGroup, &g));
+                LOOP2_ASSERT(group, g.aggs.size(), g.aggs.size() == (size_t) groups);
+                for (size_t i = 0; i < g.aggs.size(); i++)
+                {
+                    std::string name = (group == 1) ? groupValue(g.keys[i]) : g.values[i];
+                    std::map<std::string, std::pair<int, long long> >::iterator it = expected.find(name);
+                    LOOP2_ASSERT(i, name, it != expected.end());
+                    if (it == expected.end()) continue;
+                    LOOP2_ASSERT(i, name, g.aggs[i].count == it->second.first);
+                    LOOP2_ASSERT(i, name, g.aggs[i].sum == it->second.second);
+                    expected.erase(it);
+                }
+                LOOP2_ASSERT(group, expected.size(), expected.empty());
+            }
+        } break;
+        case 2: {
+            // Empty Test
+            // no tuples make no groups, sorted or not
+            std::cout << "Empty Test" << std::endl;
+            {
+                HashAggregate agg(1, 4, 64 * 1024);
+                Groups g;
+                ASSERT(0 == agg.finish(collectGroup, &g));
+                ASSERT(g.aggs.empty());
+            }
+            {
+                HashAggregate agg(2, 10, 64 * 1024);
+                Groups g;
+                int sorted = -1;
+                ASSERT(0 == agg.finishSorted(false, -1, 0, NULL, collectGroup, &g, sorted));
+                ASSERT(g.aggs.empty());
+                ASSERT(sorted == 0);
+            }
+        } break;
+        case 3: {
+            // Duplicate Key Test
+            // tuples that all have the same group make a single group,
+            // however small the memory budget
+            std::cout << "Duplicate Key Test" << std::endl;
+            int range = 100000;
+            for (int group = 1; group <= 2; group++)
+            {
+                HashAggregate agg(group, 9, 1024);
+                long long sum = 0;
+                for (int i = 0; i < range; i++)
+                {
+                    ASSERT(0 == agg.add(group == 1 ? 42 : i, group == 1 ? groupValue(i) : "same"));
+                    sum += (group == 1) ? 42 : i;
+                }
+                Groups g;
+                ASSERT(0 == agg.finish(collectGroup, &g));
+                LOOP2_ASSERT(group, g.aggs.size(), g.aggs.size() == 1);
+                if (g.aggs.size() != 1) continue;
+                ASSERT(g.aggs[0].count == range);
+                ASSERT(g.aggs[0].sum == sum);
+                if (group == 1)
+                {
+                    ASSERT(g.keys[0] == 42);
+                    ASSERT(g.aggValues[0] == groupValue(0));
+                }
+                else
+                {
+                    ASSERT(g.values[0] == "same");
+                    ASSERT(g.aggValues[0] == "same");
+                }
+            }
+        } break;
+        case 4: {
+            // Oversized Partition Test
+            // with a budget too small for even a few groups, every
+            // partition spills again on the next bits of the hash until
+            // none are left, and is then aggregated in memory
+            std::cout << "Oversized Partition Test" << std::endl;
+            int groups = 3000;
+            HashAggregate agg(1, 6, 1);
+            std::map<int, int> maxs;
+            for (int i = 0; i < 5 * groups; i++)
+            {
+                int key = i % groups * 101;
+                ASSERT(0 == agg.add(key, groupValue(i)));
+                maxs[key] = key;
+            }
+            Groups g;
+            int sorted = 0;
+            ASSERT(0 == agg.finishSorted(true, -1, 1024, NULL, collectGroup, &g, sorted));
+            ASSERT(sorted == groups);
+            ASSERT(g.keys.size() == (size_t) groups);
+            std::map<int, int>::reverse_iterator it = maxs.rbegin();
+            for (size_t i = 0; i < g.keys.size() && it != maxs.rend(); i++, ++it)
+            {
+                LOOP2_ASSERT(i, g.keys[i], g.keys[i] == it->first);
+                LOOP2_ASSERT(i, g.aggs[i].key, g.aggs[i].key == it->second);
+            }
+        } break;
+        default: {
+            std::cerr << "WARNING: CASE `" << test << "' NOT FOUND." << std::endl;
+            testStatus = -1;
+      } break;
+    }
+    return testStatus;
+}
+
+static bool collectGroup(void* arg, int key, const char* value, const GroupAggregate& agg)
+{
+    Groups* g = (Groups*) arg;
+
+    g->keys.push_back(key);
+    g->values.push_back(value != NULL ? value : "");
+    g->aggs.push_back(agg);
+    g->aggValues.push_back(agg.value != NULL ? agg.value : "");
+    return true;
+}
+
+static std::string groupValue(int i)
+{
+    std::ostringstream sout;
+    sout << "value " << i;
+    return sout.str();
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include "HashJoin.h"
+
+using std::string;
+
+HashJoin::HashJoin(int buildAttr, int probeAttr, size_t memory)
+{
+  init(buildAttr, probeAttr, memory, 0);
+}
+
+HashJoin::HashJoin(int buildAttr, int probeAttr, size_t memory, int level)
+{
+  init(buildAttr, probeAttr, memory, level);
+}
+
+void HashJoin::init(int buildAttr, int probeAttr, size_t memory, int level)
+{
+  this->buildAttr = buildAttr;
+  this->probeAttr = probeAttr;
+  this->memory = memory;
+  this->level = level;
+
+  buckets.assign(1024, -1);
+  partitioned = false;
+  for (int i = 0; i < PARTITIONS; i++) buildFiles[i] = probeFiles[i] = NULL;
+}
+
+HashJoin::~HashJoin()
+{
+  for (int i = 0; i < PARTITIONS; i++) {
+    if (buildFiles[i] != NULL) fclose(buildFiles[i]);
+    if (probeFiles[i] != NULL) fclose(probeFiles[i]);
+  }
+}
+
+RC HashJoin::build(int key, const string& value)
+{
+  RC rc;
+  unsigned hash = hashOf(buildAttr, key, value.c_str());
+
+  if (partitioned) return writeTuple(buildFiles[partitionOf(hash)], key, value.c_str());
+
+  // partition once the build side outgrows the memory budget. at the
+  // last level the hash has no bits left, so the tuples stay in memory.
+  size_t bytes = entries.size() * sizeof(Entry) + buckets.size() * sizeof(int) + arena.size();
+  if (bytes > memory && (level + 1) * PARTITION_BITS <= 32) {
+    if ((rc = partition()) < 0) return rc;
+    return writeTuple(buildFiles[partitionOf(hash)], key, value.c_str());
+  }
+
+  // keep about one entry per bucket
+  if (entries.size() >= buckets.size()) {
+    buckets.assign(buckets.size() * 2, -1);
+    unsigned mask = buckets.size() - 1;
+    for (unsigned i = 0; i < entries.size(); i++) {
+      entries[i].next = buckets[entries[i].hash & mask];
+      buckets[entries[i].hash & mask] = i;
+    }
+  }
+
+  Entry e;
+  unsigned b = hash & (buckets.size() - 1);
+  e.hash = hash;
+  e.next = buckets[b];
+  e.key = key;
+  e.value = arena.copy(value.c_str());
+  buckets[b] = entries.size();
+  entries.push_back(e);
+
+  return 0;
+}
+
+RC HashJoin::probe(int key, const string& value, JoinVisitor visit, void* arg, bool& more)
+{
+  unsigned hash = hashOf(probeAttr, key, value.c_str());
+
+  more = true;
+  if (partitioned) {
+    // a partition without build tuples joins nothing
+    int p = partitionOf(hash);
+    if (buildFiles[p] == NULL) return 0;
+    return writeTuple(probeFiles[p], key, value.c_str());
+  }
+
+  for (int i = buckets[hash & (buckets.size() - 1)]; i >= 0; i = entries[i].next) {
+    const Entry& e = entries[i];
+    if (e.hash != hash || !equal(e.key, e.value, key, value.c_str())) continue;
+    if (!(more = visit(arg, e.key, e.value, key, value.c_str()))) break;
+  }
+
+  return 0;
+}
+
+RC HashJoin::finish(JoinVisitor visit, void* arg)
+{
+  char value[RecordFile::MAX_VALUE_LENGTH + 1];
+  int  key;
+  bool more = true;
+  RC   rc;
+
+  if (!partitioned) return 0;
+
+  // the tuples of both sides that can join are in partitions with the
+  // same number. a partition with no probe tuples joins nothing.
+  for (int i = 0; more && i < PARTITIONS; i++) {
+    if (buildFiles[i] == NULL || probeFiles[i] == NULL) continue;
+
+    HashJoin part(buildAttr, probeAttr, memory, level + 1);
+    rewind(buildFiles[i]);
+    while ((rc = readTuple(buildFiles[i], key, value)) == 0) {
+      if ((rc = part.build(key, value)) < 0) return rc;
+    }
+    if (rc != RC_END_OF_TREE) return rc;
+
+    rewind(probeFiles[i]);
+    while (more && (rc = readTuple(probeFiles[i], key, value)) == 0) {
+      if ((rc = part.probe(key, value, visit, arg, more)) < 0) return rc;
+    }
+    if (rc < 0 && rc != RC_END_OF_TREE) return rc;
+
+    if (more && (rc = part.finish(visit, arg)) < 0) return rc;
+  }
+
+  return 0;
+}
+
+unsigned HashJoin::hashOf(int attr, int key, const char* value) const
+{
+  char     buf[16];
+  unsigned h;
+
+  if (buildAttr == 1 && probeAttr == 1) {
+    h = (unsigned) key;
+  } else {
+    // a key is compared with a value as a string
+    if (attr == 1) {
+      snprintf(buf, sizeof(buf), "%d", key);
+      value = buf;
+    }
+    h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) value; *p; p++) {
+      h = (h ^ *p) * 16777619u;
+    }
+  }
+
+  // mix the bits so that both the low bits (the bucket) and the high bits
+  // (the partition) depend on the whole attribute
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+bool HashJoin::equal(int buildKey, const char* buildValue, int probeKey, const char* probeValue) const
+{
+  char buf[16];
+
+  if (buildAttr == 1 && probeAttr == 1) return buildKey == probeKey;
+
+  if (buildAttr == 1) {
+    snprintf(buf, sizeof(buf), "%d", buildKey);
+    buildValue = buf;
+  } else if (probeAttr == 1) {
+    snprintf(buf, sizeof(buf), "%d", probeKey);
+    probeValue = buf;
+  }
+  return strcmp(buildValue, probeValue) == 0;
+}
+
+int HashJoin::partitionOf(unsigned hash) const
+{
+  // each level of partitioning uses the next PARTITION_BITS bits from the top
+  return (hash >> (32 - PARTITION_BITS * (level + 1))) & (PARTITIONS - 1);
+}
+
+RC HashJoin::partition()
+{
+  RC rc;
+
+  for (unsigned i = 0; i < entries.size(); i++) {
+    const Entry& e = entries[i];
+    if ((rc = writeTuple(buildFiles[partitionOf(e.hash)], e.key, e.value)) < 0) return rc;
+  }
+
+  std::vector<Entry>().swap(entries);
+  buckets.assign(1, -1);
+  arena.clear();
+  partitioned = true;
+
+  return 0;
+}
+
+RC HashJoin::writeTuple(FILE*& file, int key, const char* value)
+{
+  int length = strlen(value);
+
+  if (file == NULL && (file = tmpfile()) == NULL) return RC_FILE_OPEN_FAILED;
+
+  if (fwrite(&key, sizeof(int), 1, file) != 1) return RC_FILE_WRITE_FAILED;
+  if (fwrite(&length, sizeof(int), 1, file) != 1) return RC_FILE_WRITE_FAILED;
+  if (length > 0 && fwrite(value, 1, length, file) != (size_t) length) return RC_FILE_WRITE_FAILED;
+
+  return 0;
+}
+
+RC HashJoin::readTuple(FILE* file, int& key, char* value)
+{
+  int length;
+
+  if (fread(&key, sizeof(int), 1, file) != 1) return ferror(file) ? RC_FILE_READ_FAILED : RC_END_OF_TREE;
+  if (fread(&length, sizeof(int), 1, file) != 1) return RC_FILE_READ_FAILED;
+  if (length < 0 || length > RecordFile::MAX_VALUE_LENGTH) return RC_INVALID_FILE_FORMAT;
+  if (length > 0 && fread(value, 1, length, file) != (size_t) length) return RC_FILE_READ_FAILED;
+  value[length] = 0;
+
+  return 0;
+}
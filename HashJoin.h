@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef HASHJOIN_H
+#define HASHJOIN_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "Arena.h"
+
+/**
+ * Joins two sets of tuples on the equality of one attribute of each.
+ * The tuples of the build side are kept in a hash table on the join
+ * attribute, and each tuple of the probe side is looked up in it. When
+ * the build side does not fit in its memory budget, both sides are
+ * partitioned by hash into temporary files and each pair of partitions
+ * is joined on its own by finish() (Grace hash join).
+ */
+class HashJoin {
+ public:
+  /**
+   * called for each pair of joining tuples. returns false to stop.
+   */
+  typedef bool (*JoinVisitor)(void* arg, int buildKey, const char* buildValue, int probeKey, const char* probeValue);
+
+  /**
+   * a key joins a value if the value is the key written as a decimal
+   * integer, as in a WHERE condition on key.
+   * @param buildAttr[IN] the join attribute of the build side (1: key, 2: value)
+   * @param probeAttr[IN] the join attribute of the probe side (1: key, 2: value)
+   * @param memory[IN] the bytes of the hash table and the arena
+   */
+  HashJoin(int buildAttr, int probeAttr, size_t memory);
+  ~HashJoin();
+
+  /**
+   * add a tuple of the build side. all build tuples must be added before
+   * the first probe.
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   * @return error code. 0 if no error
+   */
+  RC build(int key, const std::string& value);
+
+  /**
+   * join a tuple of the probe side with the build tuples. when the build
+   * side was partitioned, the tuple is written to its partition and
+   * joined by finish().
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   * @param visit[IN] the function called for each pair
+   * @param arg[IN] the first argument of visit()
+   * @param more[OUT] set to false if visit() stops the join
+   * @return error code. 0 if no error
+   */
+  RC probe(int key, const std::string& value, JoinVisitor visit, void* arg, bool& more);
+
+  /**
+   * join the partitions written to temporary files, if any.
+   * @param visit[IN] the function called for each pair
+   * @param arg[IN] the first argument of visit()
+   * @return error code. 0 if no error
+   */
+  RC finish(JoinVisitor visit, void* arg);
+
+ private:
+  HashJoin(const HashJoin&);             // not copyable: owns files
+  HashJoin& operator=(const HashJoin&);
+
+  /**
+   * a build tuple in the hash table
+   */
+  struct Entry {
+    unsigned    hash;   // the hash of the join attribute
+    int         next;   // the next entry of the bucket, -1 at the end
+    int         key;    // the tuple key
+    const char* value;  // the tuple value in the arena
+  };
+
+  static const int PARTITION_BITS = 4;   // 16 partitions per side
+  static const int PARTITIONS = 1 << PARTITION_BITS;
+
+  /**
+   * the join of a pair of partitions, which partitions again on the next
+   * bits of the hash
+   */
+  HashJoin(int buildAttr, int probeAttr, size_t memory, int level);
+  void init(int buildAttr, int probeAttr, size_t memory, int level);
+
+  /**
+   * @return the hash of the join attribute of a tuple
+   */
+  unsigned hashOf(int attr, int key, const char* value) const;
+
+  /**
+   * check whether the join attributes of two tuples are equal.
+   */
+  bool equal(int buildKey, const char* buildValue, int probeKey, const char* probeValue) const;
+
+  /**
+   * @return the partition of a hash at this level
+   */
+  int partitionOf(unsigned hash) const;
+
+  /**
+   * move the build tuples from the hash table to the partition files.
+   */
+  RC partition();
+
+  /**
+   * append a tuple to a partition file, creating it if needed.
+   */
+  static RC writeTuple(FILE*& file, int key, const char* value);
+
+  /**
+   * read the next tuple of a partition file.
+   * @return error code. 0 if no error, RC_END_OF_TREE at the end
+   */
+  static RC readTuple(FILE* file, int& key, char* value);
+
+  int    buildAttr;   // the join attribute of the build side
+  int    probeAttr;   // the join attribute of the probe side
+  size_t memory;      // the memory budget
+  int    level;       // the recursion depth of partitions
+
+  std::vector<Entry> entries;  // the build tuples
+  std::vector<int>   buckets;  // the first entry of each bucket, -1 if none
+  Arena              arena;    // the values of the build tuples
+
+  bool   partitioned;                 // the build side is in the files
+  FILE*  buildFiles[PARTITIONS];      // the partitions of the build side
+  FILE*  probeFiles[PARTITIONS];      // the partitions of the probe side
+};
+
+#endif // HASHJOIN_H
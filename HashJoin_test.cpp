@@ -0,0 +1,143 @@
+#include <HashJoin.h>
+#include <test_util.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+// the pairs passed to a visitor
+struct JoinPairs {
+    long long pairs;    // the pairs seen
+    int       wrong;    // the pairs whose join attributes differ
+    int       buildAttr;
+    int       probeAttr;
+    std::map<int, int> byKey;  // the pairs of each build key
+};
+
+static bool countPair(void* arg, int buildKey, const char* buildValue, int probeKey, const char* probeValue);
+
+static std::string decimal(int i);
+
+int main( int argc, const char* argv[] )
+{
+    int test = argc > 1 ? atoi(argv[1]) : 0;
+    switch (test)
+    {
+        case 0: {
+            // Spill Test
+            // a build side far larger than the memory budget is
+            // partitioned to disk, and every pair still comes out once,
+            // on key = key and on key = value
+            std::cout << "Spill Test" << std::endl;
+            int range = 50000;
+            size_t memory = 64 * 1024;
+            for (int probeAttr = 1; probeAttr <= 2; probeAttr++)
+            {
+                HashJoin join(1, probeAttr, memory);
+                JoinPairs p = { 0, 0, 1, probeAttr };
+                bool more;
+                for (int i = 0; i < range; i++)
+                {
+                    ASSERT(0 == join.build(i * 2, decimal(i)));
+                }
+                for (int i = 0; i < 2 * range; i++)
+                {
+                    // every key below 2 * range is probed twice; the
+                    // even ones join once each time
+                    int key = i % range * 2 + i / range;
+                    ASSERT(0 == join.probe(key, decimal(key), countPair, &p, more));
+                    ASSERT(more);
+                }
+                ASSERT(0 == join.finish(countPair, &p));
+                LOOP2_ASSERT(probeAttr, p.pairs, p.pairs == range);
+                LOOP2_ASSERT(probeAttr, p.wrong, p.wrong == 0);
+                LOOP2_ASSERT(probeAttr, p.byKey.size(), p.byKey.size() == (size_t) range);
+            }
+        } break;
+        case 1: {
+            // Empty Test
+            // an empty side joins nothing, whether or not the other side
+            // was partitioned
+            std::cout << "Empty Test" << std::endl;
+            bool more;
+            {
+                HashJoin join(1, 1, 64 * 1024);
+                JoinPairs p = { 0, 0, 1, 1 };
+                for (int i = 0; i < 1000; i++)
+                {
+                    ASSERT(0 == join.probe(i, decimal(i), countPair, &p, more));
+                }
+                ASSERT(0 == join.finish(countPair, &p));
+                ASSERT(p.pairs == 0);
+            }
+            {
+                HashJoin join(2, 1, 1024);
+                JoinPairs p = { 0, 0, 2, 1 };
+                for (int i = 0; i < 10000; i++)
+                {
+                    ASSERT(0 == join.build(i, decimal(i)));
+                }
+                ASSERT(0 == join.finish(countPair, &p));
+                ASSERT(p.pairs == 0);
+            }
+            {
+                HashJoin join(1, 1, 1024);
+                JoinPairs p = { 0, 0, 1, 1 };
+                ASSERT(0 == join.finish(countPair, &p));
+                ASSERT(p.pairs == 0);
+            }
+        } break;
+        case 2: {
+            // Oversized Partition Test
+            // build tuples that all have the same key fall in the same
+            // partition at every level, which must end up joined in
+            // memory rather than partitioned forever
+            std::cout << "Oversized Partition Test" << std::endl;
+            int builds = 5000;
+            int probes = 40;
+            HashJoin join(1, 2, 4 * 1024);
+            JoinPairs p = { 0, 0, 1, 2 };
+            bool more;
+            for (int i = 0; i < builds; i++)
+            {
+                ASSERT(0 == join.build(i % 7 == 0 ? 8 : 5, decimal(i)));
+            }
+            for (int i = 0; i < probes; i++)
+            {
+                ASSERT(0 == join.probe(i, decimal(i % 2 == 0 ? 5 : 6), countPair, &p, more));
+            }
+            ASSERT(0 == join.finish(countPair, &p));
+            int fives = builds - (builds + 6) / 7;
+            LOOP2_ASSERT(p.pairs, fives, p.pairs == (long long) fives * probes / 2);
+            ASSERT(p.wrong == 0);
+            ASSERT(p.byKey.size() == 1 && p.byKey[5] == fives * probes / 2);
+        } break;
+        default: {
+            std::cerr << "WARNING: CASE `" << test << "' NOT FOUND." << std::endl;
+            testStatus = -1;
+      } break;
+    }
+    return testStatus;
+}
+
+static bool countPair(void* arg, int buildKey, const char* buildValue, int probeKey, const char* probeValue)
+{
+    JoinPairs* p = (JoinPairs*) arg;
+    std::string b = (p->buildAttr == 1) ? decimal(buildKey) : buildValue;
+    std::string q = (p->probeAttr == 1) ? decimal(probeKey) : probeValue;
+
+    p->pairs++;
+    if (b != q) p->wrong++;
+    p->byKey[buildKey]++;
+    return true;
+}
+
+static std::string decimal(int i)
+{
+    std::ostringstream sout;
+    sout << i;
+    return sout.str();
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <cmath>
+#include "HyperLogLog.h"
+
+HyperLogLog::HyperLogLog()
+{
+  clear();
+}
+
+void HyperLogLog::clear()
+{
+  memset(reg, 0, sizeof(reg));
+}
+
+void HyperLogLog::add(unsigned long long hash)
+{
+  unsigned index = hash >> (64 - BITS);
+
+  // the bit below the remaining ones stops the count of leading zeros
+  unsigned long long rest = (hash << BITS) | (1ULL << (BITS - 1));
+  unsigned char rank = __builtin_clzll(rest) + 1;
+
+  if (rank > reg[index]) reg[index] = rank;
+}
+
+long long HyperLogLog::estimate() const
+{
+  double sum = 0;
+  int    zeros = 0;
+
+  for (int i = 0; i < REGISTERS; i++) {
+    sum += ldexp(1.0, -reg[i]);
+    if (reg[i] == 0) zeros++;
+  }
+
+  double m = REGISTERS;
+  double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+  // few items leave registers empty, which are counted more exactly
+  if (e <= 2.5 * m && zeros > 0) e = m * log(m / zeros);
+
+  return (long long) (e + 0.5);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+/**
+ * Estimates the number of distinct items among the ones added, in a fixed
+ * amount of memory. Each item is added by a 64-bit hash. The first bits
+ * of the hash pick a register, which keeps the longest run of leading
+ * zeros seen in the rest of the hash. The estimate is off by about 1.6%.
+ */
+class HyperLogLog {
+ public:
+  static const int BITS = 12;              // the hash bits that pick a register
+  static const int REGISTERS = 1 << BITS;
+
+  HyperLogLog();
+
+  /**
+   * forget the items added so far.
+   */
+  void clear();
+
+  /**
+   * add an item.
+   * @param hash[IN] a hash of the item whose bits are all equally likely
+   */
+  void add(unsigned long long hash);
+
+  /**
+   * @return the estimated number of distinct items added
+   */
+  long long estimate() const;
+
+ private:
+  unsigned char reg[REGISTERS];
+};
+
+#endif // HYPERLOGLOG_H
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <time.h>
+#include "IoStats.h"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+
+// the counters of all files by subsystem and name
+static map<pair<string, string>, IoStats*> files;
+static pthread_mutex_t filesLock = PTHREAD_MUTEX_INITIALIZER;
+
+// the thread started by startDump()
+static pthread_t       dumpThread;
+static pthread_mutex_t dumpLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  dumpWake = PTHREAD_COND_INITIALIZER;
+static bool            dumping = false;   // the thread is running
+static bool            stopping = false;  // stopDump() asks it to end
+static string          dumpFile;
+static int             dumpSeconds;
+
+// the names of the operations in the Prometheus output
+static const char* OP_NAMES[IoStats::OPS] = { "read", "write", "sync" };
+
+// the counters in the Prometheus output, by their offset in Counters
+struct Metric {
+  const char* name;
+  const char* help;
+  long long IoStats::Counters::* counter;
+};
+
+static const Metric METRICS[] = {
+  { "bruinbase_page_reads_total", "Pages read, from the page cache or the disk.", &IoStats::Counters::reads },
+  { "bruinbase_page_cache_hits_total", "Pages read from the page cache.", &IoStats::Counters::hits },
+  { "bruinbase_page_evictions_total", "Pages evicted from the page cache.", &IoStats::Counters::evictions },
+  { "bruinbase_page_writes_total", "Pages written, to the page cache or the disk.", &IoStats::Counters::writes },
+  { "bruinbase_disk_reads_total", "Reads that went to the disk.", &IoStats::Counters::diskReads },
+  { "bruinbase_disk_writes_total", "Writes that went to the disk.", &IoStats::Counters::diskWrites },
+  { "bruinbase_disk_read_bytes_total", "Bytes read from the disk.", &IoStats::Counters::bytesRead },
+  { "bruinbase_disk_written_bytes_total", "Bytes written to the disk.", &IoStats::Counters::bytesWritten },
+  { "bruinbase_syncs_total", "Calls of fsync() and fdatasync().", &IoStats::Counters::syncs },
+};
+
+IoStats::IoStats(const string& name, const string& subsystem)
+{
+  this->name = name;
+  this->subsystem = subsystem;
+  memset(&counters, 0, sizeof(counters));
+}
+
+IoStats* IoStats::get(const string& name, const string& subsystem)
+{
+  IoStats* s;
+
+  pthread_mutex_lock(&filesLock);
+  IoStats*& entry = files[make_pair(subsystem, name)];
+  if (entry == NULL) entry = new IoStats(name, subsystem);
+  s = entry;
+  pthread_mutex_unlock(&filesLock);
+
+  return s;
+}
+
+void IoStats::getAll(vector<IoStats*>& all)
+{
+  all.clear();
+  pthread_mutex_lock(&filesLock);
+  for (map<pair<string, string>, IoStats*>::iterator it = files.begin(); it != files.end(); ++it) {
+    all.push_back(it->second);
+  }
+  pthread_mutex_unlock(&filesLock);
+}
+
+void IoStats::read(Counters& c) const
+{
+  const long long* from = (const long long*) &counters;
+  long long* to = (long long*) &c;
+
+  for (size_t i = 0; i < sizeof(Counters) / sizeof(long long); i++) {
+    to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+  }
+}
+
+void IoStats::add(long long& counter, long long n)
+{
+  __atomic_fetch_add(&counter, n, __ATOMIC_RELAXED);
+}
+
+long long IoStats::now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void IoStats::countRead(bool hit)
+{
+  add(counters.reads, 1);
+  if (hit) add(counters.hits, 1);
+}
+
+void IoStats::countWrite()
+{
+  add(counters.writes, 1);
+}
+
+void IoStats::countEviction()
+{
+  add(counters.evictions, 1);
+}
+
+void IoStats::countDiskRead(long long bytes, long long start)
+{
+  add(counters.diskReads, 1);
+  add(counters.bytesRead, bytes);
+  countLatency(READ_OP, start);
+}
+
+void IoStats::countDiskWrite(long long bytes, long long start)
+{
+  add(counters.diskWrites, 1);
+  add(counters.bytesWritten, bytes);
+  countLatency(WRITE_OP, start);
+}
+
+void IoStats::countSync(long long start)
+{
+  add(counters.syncs, 1);
+  countLatency(SYNC_OP, start);
+}
+
+void IoStats::countLatency(Op op, long long start)
+{
+  long long nanos = now() - start;
+  long long micros = nanos / 1000;
+  int       bucket = 0;
+
+  while (bucket < LATENCY_BUCKETS - 1 && micros >= (1LL << bucket)) bucket++;
+  add(counters.latency[op][bucket], 1);
+  add(counters.nanos[op], nanos);
+}
+
+// write a label value with the characters that Prometheus escapes
+static void printLabel(FILE* out, const string& value)
+{
+  for (size_t i = 0; i < value.size(); i++) {
+    char c = value[i];
+    if (c == '\\' || c == '"') fprintf(out, "\\%c", c);
+    else if (c == '\n') fprintf(out, "\\n");
+    else fputc(c, out);
+  }
+}
+
+static void printLabels(FILE* out, const IoStats* s)
+{
+  fprintf(out, "subsystem=\"");
+  printLabel(out, s->getSubsystem());
+  fprintf(out, "\",file=\"");
+  printLabel(out, s->getName());
+  fprintf(out, "\"");
+}
+
+void IoStats::printPrometheus(FILE* out)
+{
+  vector<IoStats*> all;
+  vector<Counters> c;
+
+  getAll(all);
+  c.resize(all.size());
+  for (unsigned i = 0; i < all.size(); i++) all[i]->read(c[i]);
+
+  for (unsigned m = 0; m < sizeof(METRICS) / sizeof(METRICS[0]); m++) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", METRICS[m].name, METRICS[m].help, METRICS[m].name);
+    for (unsigned i = 0; i < all.size(); i++) {
+      fprintf(out, "%s{", METRICS[m].name);
+      printLabels(out, all[i]);
+      fprintf(out, "} %lld\n", c[i].*METRICS[m].counter);
+    }
+  }
+
+  // the histograms count each operation in its bucket and in all the
+  // buckets above it
+  fprintf(out, "# HELP bruinbase_io_latency_seconds The latency of the reads, writes and syncs that went to the disk.\n");
+  fprintf(out, "# TYPE bruinbase_io_latency_seconds histogram\n");
+  for (unsigned i = 0; i < all.size(); i++) {
+    for (int op = 0; op < OPS; op++) {
+      long long count = 0;
+      for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        count += c[i].latency[op][b];
+        fprintf(out, "bruinbase_io_latency_seconds_bucket{");
+        printLabels(out, all[i]);
+        if (b < LATENCY_BUCKETS - 1) fprintf(out, ",op=\"%s\",le=\"%g\"} %lld\n", OP_NAMES[op], (1LL << b) / 1e6, count);
+        else fprintf(out, ",op=\"%s\",le=\"+Inf\"} %lld\n", OP_NAMES[op], count);
+      }
+      fprintf(out, "bruinbase_io_latency_seconds_sum{");
+      printLabels(out, all[i]);
+      fprintf(out, ",op=\"%s\"} %.9f\n", OP_NAMES[op], c[i].nanos[op] / 1e9);
+      fprintf(out, "bruinbase_io_latency_seconds_count{");
+      printLabels(out, all[i]);
+      fprintf(out, ",op=\"%s\"} %lld\n", OP_NAMES[op], count);
+    }
+  }
+}
+
+RC IoStats::savePrometheus(const string& filename)
+{
+  string tmp = filename + ".tmp";
+  FILE*  out;
+
+  // write a new file and rename it over the old one
+  if ((out = fopen(tmp.c_str(), "w")) == NULL) return RC_FILE_OPEN_FAILED;
+  printPrometheus(out);
+  if (ferror(out)) {
+    fclose(out);
+    remove(tmp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+  if (fclose(out) != 0 || rename(tmp.c_str(), filename.c_str()) < 0) {
+    remove(tmp.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+
+  return 0;
+}
+
+RC IoStats::startDump(const string& filename, int seconds)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&dumpLock);
+  if (dumping) {
+    rc = RC_INVALID_PARAMETER;
+  } else {
+    dumpFile = filename;
+    dumpSeconds = (seconds > 0) ? seconds : 1;
+    stopping = false;
+    if (pthread_create(&dumpThread, NULL, dump, NULL) != 0) rc = RC_THREAD_FAILED;
+    else dumping = true;
+  }
+  pthread_mutex_unlock(&dumpLock);
+
+  return rc;
+}
+
+void IoStats::stopDump()
+{
+  pthread_mutex_lock(&dumpLock);
+  if (!dumping) {
+    pthread_mutex_unlock(&dumpLock);
+    return;
+  }
+  stopping = true;
+  pthread_cond_signal(&dumpWake);
+  pthread_mutex_unlock(&dumpLock);
+
+  pthread_join(dumpThread, NULL);
+
+  pthread_mutex_lock(&dumpLock);
+  dumping = false;
+  pthread_mutex_unlock(&dumpLock);
+}
+
+void* IoStats::dump(void* arg)
+{
+  struct timespec until;
+
+  pthread_mutex_lock(&dumpLock);
+  for (;;) {
+    pthread_mutex_unlock(&dumpLock);
+    savePrometheus(dumpFile);
+    pthread_mutex_lock(&dumpLock);
+    if (stopping) break;
+
+    // the condition waits on the realtime clock
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += dumpSeconds;
+    while (!stopping) {
+      if (pthread_cond_timedwait(&dumpWake, &dumpLock, &until) == ETIMEDOUT) break;
+    }
+  }
+  pthread_mutex_unlock(&dumpLock);
+
+  return NULL;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef IOSTATS_H
+#define IOSTATS_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+
+/**
+ * The I/O counters of a file. They are kept for the life of the process
+ * under the name of the file, so they add up over every time the file is
+ * opened, and belong to a subsystem such as table, index or log.
+ * A read of a page counts as a cache hit or as a read from the disk; the
+ * reads, writes and syncs that reach the disk are timed into histograms
+ * of their latencies. The counters may be updated by several threads at
+ * once and are read without stopping them.
+ */
+class IoStats {
+ public:
+  /**
+   * the operations whose latencies are kept
+   */
+  enum Op { READ_OP, WRITE_OP, SYNC_OP };
+  static const int OPS = 3;
+
+  // latency bucket i holds the operations that took less than 2^i
+  // microseconds and no less than 2^(i-1); the last holds the rest
+  static const int LATENCY_BUCKETS = 24;
+
+  /**
+   * a copy of the counters of a file
+   */
+  struct Counters {
+    long long reads;         // pages read
+    long long hits;          // pages read from the page cache
+    long long diskReads;     // reads that went to the disk
+    long long evictions;     // pages of the file evicted from the page cache
+    long long writes;        // pages written
+    long long diskWrites;    // writes that went to the disk
+    long long bytesRead;     // bytes read from the disk
+    long long bytesWritten;  // bytes written to the disk
+    long long syncs;         // fsync() and fdatasync() calls
+    long long latency[OPS][LATENCY_BUCKETS];  // the operations by latency
+    long long nanos[OPS];    // the total time of the operations
+  };
+
+  /**
+   * look up the counters of a file, adding them if there are none.
+   * @param name[IN] the file name, or the name shared by a group of files
+   * @param subsystem[IN] the subsystem the file belongs to
+   * @return the counters, which live until the process exits
+   */
+  static IoStats* get(const std::string& name, const std::string& subsystem);
+
+  /**
+   * @param all[OUT] the counters of all files, by subsystem and name
+   */
+  static void getAll(std::vector<IoStats*>& all);
+
+  const std::string& getName() const { return name; }
+  const std::string& getSubsystem() const { return subsystem; }
+
+  /**
+   * copy the counters.
+   * @param c[OUT] the copy
+   */
+  void read(Counters& c) const;
+
+  /**
+   * count a page read.
+   * @param hit[IN] whether the page was found in the page cache
+   */
+  void countRead(bool hit);
+
+  /**
+   * count a page write.
+   */
+  void countWrite();
+
+  /**
+   * count a page evicted from the page cache.
+   */
+  void countEviction();
+
+  /**
+   * count a read from the disk.
+   * @param bytes[IN] the bytes read
+   * @param start[IN] the now() when the read started
+   */
+  void countDiskRead(long long bytes, long long start);
+
+  /**
+   * count a write to the disk.
+   * @param bytes[IN] the bytes written
+   * @param start[IN] the now() when the write started
+   */
+  void countDiskWrite(long long bytes, long long start);
+
+  /**
+   * count an fsync() or fdatasync().
+   * @param start[IN] the now() when it started
+   */
+  void countSync(long long start);
+
+  /**
+   * @return the monotonic clock in nanoseconds
+   */
+  static long long now();
+
+  /**
+   * write the counters of all files in the Prometheus text format.
+   * @param out[IN] the stream to write to
+   */
+  static void printPrometheus(FILE* out);
+
+  /**
+   * write the counters of all files to a file in the Prometheus text
+   * format. the file is replaced at once, so a reader never sees half of it.
+   * @param filename[IN] the file to write
+   * @return error code. 0 if no error
+   */
+  static RC savePrometheus(const std::string& filename);
+
+  /**
+   * start a thread that writes the counters to a file periodically.
+   * @param filename[IN] the file to write
+   * @param seconds[IN] the time between two writes
+   * @return error code. 0 if no error
+   */
+  static RC startDump(const std::string& filename, int seconds);
+
+  /**
+   * stop the thread started by startDump(), writing the file a last time.
+   */
+  static void stopDump();
+
+ private:
+  IoStats(const std::string& name, const std::string& subsystem);
+
+  // add to a counter that other threads may be updating
+  static void add(long long& counter, long long n);
+
+  // count an operation that started at start in its latency histogram
+  void countLatency(Op op, long long start);
+
+  // the body of the thread started by startDump()
+  static void* dump(void* arg);
+
+  std::string name;
+  std::string subsystem;
+  Counters    counters;
+};
+
+#endif // IOSTATS_H
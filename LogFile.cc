@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Bruinbase.h"
+#include "LogFile.h"
+#include "Crc32c.h"
+
+using std::string;
+using std::vector;
+
+LogFile::LogFile()
+{
+  fd = -1;
+  stats = NULL;
+  fileSize = 0;
+  appendedLsn = flushedLsn = 0;
+  flushing = false;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&flushed, NULL);
+}
+
+LogFile::~LogFile()
+{
+  if (fd >= 0) close();
+  pthread_cond_destroy(&flushed);
+  pthread_mutex_destroy(&mutex);
+}
+
+RC LogFile::open(const string& filename)
+{
+  struct stat statbuf;
+
+  if (fd >= 0) return RC_FILE_OPEN_FAILED;
+
+  fd = ::open(filename.c_str(), O_RDWR|O_CREAT, 0644);
+  if (fd < 0) { fd = -1; return RC_FILE_OPEN_FAILED; }
+
+  if (::fstat(fd, &statbuf) < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
+
+  // a torn record at the end of the file is ignored and overwritten
+  fileSize = statbuf.st_size - statbuf.st_size % sizeof(LogRecord);
+  appendedLsn = flushedLsn = fileSize / sizeof(LogRecord);
+  pending.clear();
+  stats = IoStats::get(filename, "log");
+
+  return 0;
+}
+
+RC LogFile::close()
+{
+  RC rc;
+
+  if (fd < 0) return RC_FILE_CLOSE_FAILED;
+
+  // make every appended record durable before closing
+  if ((rc = commit(appendedLsn)) < 0) return rc;
+
+  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+  fd = -1;
+
+  return 0;
+}
+
+RC LogFile::append(int type, int key, const RecordId& rid, const string& value, LogSeqNum& lsn)
+{
+  LogRecord rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.type = type;
+  rec.key = key;
+  rec.rid = rid;
+  strncpy(rec.value, value.c_str(), RecordFile::MAX_VALUE_LENGTH - 1);
+  rec.checksum = checksum(rec);
+
+  pthread_mutex_lock(&mutex);
+  pending.push_back(rec);
+  lsn = ++appendedLsn;
+  pthread_mutex_unlock(&mutex);
+
+  return 0;
+}
+
+RC LogFile::commit(LogSeqNum lsn)
+{
+  RC rc = 0;
+  vector<LogRecord> batch;
+
+  pthread_mutex_lock(&mutex);
+  while (flushedLsn < lsn) {
+    if (flushing) {
+      // another thread is writing the log; its fsync may cover our record
+      pthread_cond_wait(&flushed, &mutex);
+      continue;
+    }
+
+    // become the leader: take everything appended so far and write it
+    // with a single fsync while other threads keep appending
+    flushing = true;
+    batch.swap(pending);
+    LogSeqNum target = appendedLsn;
+    long offset = fileSize;
+    pthread_mutex_unlock(&mutex);
+
+    size_t bytes = batch.size() * sizeof(LogRecord);
+    long long start = IoStats::now();
+    if (bytes > 0 && ::pwrite(fd, &batch[0], bytes, offset) != (ssize_t) bytes) {
+      rc = RC_FILE_WRITE_FAILED;
+    } else {
+      if (bytes > 0) stats->countDiskWrite(bytes, start);
+      start = IoStats::now();
+      if (::fdatasync(fd) < 0) rc = RC_FILE_WRITE_FAILED;
+      else stats->countSync(start);
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (rc == 0) {
+      fileSize = offset + bytes;
+      flushedLsn = target;
+    } else {
+      // put the records back so that a later commit can retry them
+      pending.insert(pending.begin(), batch.begin(), batch.end());
+    }
+    batch.clear();
+    flushing = false;
+    pthread_cond_broadcast(&flushed);
+    if (rc < 0) break;
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return rc;
+}
+
+RC LogFile::read(int n, LogRecord& rec) const
+{
+  if (n < 0 || (long) (n + 1) * (long) sizeof(LogRecord) > fileSize) return RC_NO_SUCH_RECORD;
+
+  long long start = IoStats::now();
+  if (::pread(fd, &rec, sizeof(rec), (off_t) n * sizeof(LogRecord)) != sizeof(rec)) {
+    return RC_FILE_READ_FAILED;
+  }
+  stats->countDiskRead(sizeof(rec), start);
+
+  // a record that was only partially written before a crash ends the log
+  if (rec.checksum != checksum(rec)) return RC_NO_SUCH_RECORD;
+
+  return 0;
+}
+
+RC LogFile::truncate()
+{
+  RC rc;
+
+  // write out anything still buffered so that no flush is in progress.
+  // lsns keep growing across truncations so that late committers of
+  // records that are already durable return immediately.
+  if ((rc = commit(appendedLsn)) < 0) return rc;
+
+  pthread_mutex_lock(&mutex);
+  long long start = IoStats::now();
+  if (::ftruncate(fd, 0) < 0 || ::fdatasync(fd) < 0) {
+    rc = RC_FILE_WRITE_FAILED;
+  } else {
+    stats->countSync(start);
+    fileSize = 0;
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return rc;
+}
+
+long LogFile::size() const
+{
+  return fileSize;
+}
+
+unsigned LogFile::checksum(const LogRecord& rec)
+{
+  // CRC32C over every byte of the record except the checksum itself
+  return Crc32c::compute(&rec, offsetof(LogRecord, checksum));
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "IoStats.h"
+
+/**
+ * Log sequence number. The n'th record appended to a log has lsn n
+ * (the first record has lsn 1).
+ */
+typedef long LogSeqNum;
+
+/**
+ * A redo record of the write-ahead log.
+ */
+typedef struct {
+  int      type;       // LogFile::LOG_INSERT or LogFile::LOG_DELETE
+  int      key;        // the record key
+  RecordId rid;        // the location of the record in the table
+  char     value[RecordFile::MAX_VALUE_LENGTH]; // the record value (inserts only)
+  unsigned checksum;   // checksum of the fields above, detects torn writes
+} LogRecord;
+
+/**
+ * Sequential write-ahead log of a table.
+ * Records are appended to an in-memory buffer and forced to the disk by
+ * commit(). When several threads commit at the same time, one of them
+ * writes and fsyncs the records of all of them (group commit).
+ */
+class LogFile {
+ public:
+
+  static const int LOG_INSERT = 1;  // a record was appended to the table
+  static const int LOG_DELETE = 2;  // a record was removed from the table
+
+  LogFile();
+  ~LogFile();
+
+  /**
+   * open the log file. the file is created if it does not exist.
+   * @param filename[IN] the name of the file to open
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& filename);
+
+  /**
+   * force all appended records to the disk and close the file.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * append a record to the log buffer. the record is not durable
+   * until commit() is called with the returned lsn (or a later one).
+   * @param type[IN] LOG_INSERT or LOG_DELETE
+   * @param key[IN] the record key
+   * @param rid[IN] the location of the record in the table
+   * @param value[IN] the record value
+   * @param lsn[OUT] the log sequence number of the record
+   * @return error code. 0 if no error
+   */
+  RC append(int type, int key, const RecordId& rid, const std::string& value, LogSeqNum& lsn);
+
+  /**
+   * wait until all records up to lsn are on stable storage.
+   * if no other thread is flushing the log, the caller writes and fsyncs
+   * every record appended so far; otherwise it waits for that flush.
+   * @param lsn[IN] the log sequence number to make durable
+   * @return error code. 0 if no error
+   */
+  RC commit(LogSeqNum lsn);
+
+  /**
+   * read the n'th record stored in the log file (the first record is 0).
+   * @param n[IN] the record number
+   * @param rec[OUT] the record
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD at the end of
+   *         the log or at a torn record
+   */
+  RC read(int n, LogRecord& rec) const;
+
+  /**
+   * discard all records in the log. the caller must have forced
+   * every change covered by the log to the table and index files.
+   * @return error code. 0 if no error
+   */
+  RC truncate();
+
+  /**
+   * @return the size of the log file in bytes
+   */
+  long size() const;
+
+ private:
+  /**
+   * compute the checksum of a log record.
+   */
+  static unsigned checksum(const LogRecord& rec);
+
+  int       fd;           // file descriptor of the log file
+  IoStats*  stats;        // the I/O counters of the log file
+  long      fileSize;     // bytes written to the log file
+  LogSeqNum appendedLsn;  // lsn of the last appended record
+  LogSeqNum flushedLsn;   // lsn of the last durable record
+  bool      flushing;     // a thread is writing the log
+
+  std::vector<LogRecord> pending;  // appended records not written yet
+
+  pthread_mutex_t mutex;  // protects all members above
+  pthread_cond_t  flushed; // signaled when a flush completes
+};
+
+#endif // LOGFILE_H
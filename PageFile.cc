@@ -9,29 +9,215 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include "Crc32c.h"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 using std::string;
+using std::vector;
+using std::make_pair;
 
-int PageFile::readCount = 0;
-int PageFile::writeCount = 0;
+int PageFile::cacheCount = PageFile::DEFAULT_CACHE_SIZE;
 int PageFile::cacheClock = 1;
-struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
+struct PageFile::cacheStruct* PageFile::readCache =
+  (PageFile::cacheStruct*) calloc(PageFile::DEFAULT_CACHE_SIZE, sizeof(PageFile::cacheStruct));
+std::map<std::pair<int, PageId>, int> PageFile::cacheIndex;
+pthread_mutex_t PageFile::cacheLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  PageFile::cacheDone = PTHREAD_COND_INITIALIZER;
+__thread PageFile::IoCounters* PageFile::ioCounters = NULL;
+
+// the subsystems of the kinds of files in IoStats
+static const char* KIND_NAMES[PageFile::FILE_KINDS] = { "table", "index", "other" };
+
+// a slot of the metadata at the start of a file. the slots are a sector
+// each, so that a write torn by a crash damages one of them at most.
+struct MetaSlot {
+  unsigned magic;
+  int      size;               // the size of the metadata
+  unsigned long long sequence; // the number of the commit, odd in slot 1
+  char     data[PageFile::META_SIZE];
+  unsigned crc;                // the checksum of the fields above
+};
+
+static const unsigned META_MAGIC = 0x42425046;  // "FPBB"
+static const int META_SLOT_SIZE = 512;
+static const int HEADER_SIZE = 2 * META_SLOT_SIZE;
+
+// a page on the disk is followed by its checksum
+static const int DISK_PAGE_SIZE = PageFile::PAGE_SIZE + sizeof(unsigned);
+
+// the header of a page in the journal, which the page follows
+struct JournalRecord {
+  unsigned long long sequence; // the commit that covers the page
+  PageId   pid;                // the page
+  unsigned crc;                // the checksum of the fields above and the page
+};
+
+static const int JOURNAL_RECORD_SIZE = sizeof(JournalRecord) + PageFile::PAGE_SIZE;
+
+static unsigned journalChecksum(const JournalRecord& r, const char* page)
+{
+  unsigned crc = Crc32c::compute(&r, offsetof(JournalRecord, crc));
+  return Crc32c::compute(page, PageFile::PAGE_SIZE, crc);
+}
+
+static off_t pageOffset(PageId pid)
+{
+  return HEADER_SIZE + (off_t) pid * DISK_PAGE_SIZE;
+}
+
+static bool isZero(const char* p, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    if (p[i] != 0) return false;
+  }
+  return true;
+}
+
+// whether a page read from the disk matches its checksum. a page of
+// zeros was never written and has none.
+static bool checksumMatches(const char* page, unsigned crc)
+{
+  return crc == Crc32c::compute(page, PageFile::PAGE_SIZE) ||
+         (crc == 0 && isZero(page, PageFile::PAGE_SIZE));
+}
+
+// a read of a page started by readPages()
+struct PageRead {
+  AsyncIo::Request req;
+  int       index;  // the position of the page in the set
+  unsigned  crc;    // the checksum that follows the page on the disk
+  long long start;  // when the read was started
+};
+
+// add one to a counter that other threads may be updating
+static void addCount(long long& counter)
+{
+  __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+}
 
 PageFile::PageFile() 
 { 
   fd = -1; 
   epid = 0; 
+  kind = OTHER_FILE;
+  stats = NULL;
+  writable = false;
+  metaSequence = 0;
+  metaSize = 0;
+  jfd = -1;
+  jsize = 0;
+  committedEnd = 0;
+  flushing = false;
+  flushing = false;
 }
 
 PageFile::PageFile(const string& filename, char mode)
 {
   fd = -1;
   epid = 0;
+  kind = OTHER_FILE;
+  stats = NULL;
+  writable = false;
+  metaSequence = 0;
+  metaSize = 0;
+  jfd = -1;
+  jsize = 0;
+  committedEnd = 0;
   open(filename.c_str(), mode);
 }
 
+void PageFile::setKind(FileKind kind)
+{
+  this->kind = kind;
+}
+
+void PageFile::setStatsName(const string& name)
+{
+  statsName = name;
+}
+
+const char* PageFile::kindName(FileKind kind)
+{
+  return KIND_NAMES[kind];
+}
+
+RC PageFile::setCacheSize(int pages)
+{
+  if (pages < 1) return RC_INVALID_PARAMETER;
+
+  pthread_mutex_lock(&cacheLock);
+  for (int i = 0; i < cacheCount; i++) {
+    if (readCache[i].lastAccessed != 0 || readCache[i].reading || readCache[i].writing) {
+      pthread_mutex_unlock(&cacheLock);
+      return RC_INVALID_FILE_MODE;
+    }
+  }
+  free(readCache);
+  readCache = (cacheStruct*) calloc(pages, sizeof(cacheStruct));
+  cacheCount = pages;
+  pthread_mutex_unlock(&cacheLock);
+  return 0;
+}
+
+int PageFile::getCacheSize()
+{
+  pthread_mutex_lock(&cacheLock);
+  int pages = cacheCount;
+  pthread_mutex_unlock(&cacheLock);
+  return pages;
+}
+
+long long PageFile::getPageReadCount()
+{
+  vector<IoStats*> all;
+  IoStats::Counters c;
+  long long n = 0;
+
+  // the log is not read by pages
+  IoStats::getAll(all);
+  for (unsigned i = 0; i < all.size(); i++) {
+    if (all[i]->getSubsystem() == "log") continue;
+    all[i]->read(c);
+    n += c.diskReads;
+  }
+  return n;
+}
+
+long long PageFile::getPageWriteCount()
+{
+  vector<IoStats*> all;
+  IoStats::Counters c;
+  long long n = 0;
+
+  IoStats::getAll(all);
+  for (unsigned i = 0; i < all.size(); i++) {
+    if (all[i]->getSubsystem() == "log") continue;
+    all[i]->read(c);
+    n += c.diskWrites;
+  }
+  return n;
+}
+
+void PageFile::setIoCounters(IoCounters* counters)
+{
+  ioCounters = counters;
+}
+
+void PageFile::readIoCounters(const IoCounters& from, IoCounters& to)
+{
+  for (int i = 0; i < FILE_KINDS; i++) {
+    to.reads[i] = __atomic_load_n(&from.reads[i], __ATOMIC_RELAXED);
+    to.diskReads[i] = __atomic_load_n(&from.diskReads[i], __ATOMIC_RELAXED);
+    to.diskWrites[i] = __atomic_load_n(&from.diskWrites[i], __ATOMIC_RELAXED);
+  }
+}
+
 RC PageFile::open(const string& filename, char mode)
 {
   RC   rc;
@@ -61,26 +247,98 @@ RC PageFile::open(const string& filename, char mode)
   // get the size of the file to set the end pid
   rc = ::fstat(fd, &statbuf);
   if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
-  epid = statbuf.st_size / PAGE_SIZE;
+  writable = (oflag != O_RDONLY);
+  metaSequence = 0;
+  metaSize = 0;
+  memset(meta, 0, META_SIZE);
+
+  // the counters of the file outlive it, so they add up over every open
+  stats = IoStats::get(statsName.empty() ? filename : statsName, KIND_NAMES[kind]);
+
+  journalName = filename + ".jnl";
+  jfd = -1;
+  jsize = 0;
+  journaled.clear();
+
+  if (statbuf.st_size == 0) {
+    // a new file starts with an empty commit, and without the journal of
+    // a file that had its name before
+    epid = 0;
+    if (writable) {
+      ::unlink(journalName.c_str());
+      if ((rc = writeMeta(meta, 0)) < 0) { ::close(fd); fd = -1; return rc; }
+    }
+  } else if ((rc = readHeader()) < 0) {
+    ::close(fd);
+    fd = -1;
+    return rc;
+  } else {
+    epid = (statbuf.st_size - HEADER_SIZE) / DISK_PAGE_SIZE;
+    if ((rc = recoverJournal()) < 0) {
+      if (jfd >= 0) ::close(jfd);
+      jfd = -1;
+      ::close(fd);
+      fd = -1;
+      return rc;
+    }
+  }
+  committedEnd = epid;
 
   return 0;
 }
 
 RC PageFile::close()
 {
+  RC rc;
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
+  pthread_mutex_lock(&cacheLock);
+  startFlush();
+
+  // write the dirty pages of this file back before closing it. those
+  // in the journal reach their place by a commit of the same metadata.
+  if ((rc = flushPages()) < 0) {
+    endFlush();
+    pthread_mutex_unlock(&cacheLock);
+    return rc;
+  }
+  if (!journaled.empty()) {
+    char data[META_SIZE];
+    memcpy(data, meta, META_SIZE);
+    if ((rc = commitPages(data, metaSize)) < 0) {
+      endFlush();
+      pthread_mutex_unlock(&cacheLock);
+      return rc;
+    }
+  }
+  // the journal is empty once its pages are committed
+  if (jfd >= 0) {
+    ::close(jfd);
+    if (writable) ::unlink(journalName.c_str());
+  }
+  jfd = -1;
+  journaled.clear();
+
   // close the file
-  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+  if (::close(fd) < 0) {
+    endFlush();
+    pthread_mutex_unlock(&cacheLock);
+    return RC_FILE_CLOSE_FAILED;
+  }
 
   // evict all cached pages for this file
-  for (int i = 0; i < CACHE_COUNT; i++) {
+  for (int i = 0; i < cacheCount; i++) {
     if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
+       cacheIndex.erase(make_pair(fd, readCache[i].pid));
        readCache[i].fd = 0;
        readCache[i].pid = 0;
        readCache[i].lastAccessed = 0;
+       readCache[i].dirty = false;
     }
   }
+  endFlush();
+  pthread_mutex_unlock(&cacheLock);
 
   // set the fd and epid to the initial state
   fd = -1; 
@@ -88,91 +346,615 @@ RC PageFile::close()
   return 0;
 }
 
+RC PageFile::flush()
+{
+  pthread_mutex_lock(&cacheLock);
+  startFlush();
+  RC rc = flushPages();
+  endFlush();
+  pthread_mutex_unlock(&cacheLock);
+  return rc;
+}
+
+RC PageFile::flushPages()
+{
+  RC rc;
+
+  // while the file is flushed, no other thread starts to read or write
+  // back one of its pages, so once the slots are passed, the I/O of the
+  // file is over
+  for (int i = 0; i < cacheCount; i++) {
+    cacheStruct& c = readCache[i];
+    while (c.fd == fd && c.lastAccessed != 0 && (c.reading || c.writing)) {
+      pthread_cond_wait(&cacheDone, &cacheLock);
+    }
+    if (c.fd == fd && c.lastAccessed != 0) {
+      if ((rc = writeBack(i)) < 0) return rc;
+    }
+  }
+
+  return 0;
+}
+
+void PageFile::startFlush()
+{
+  while (flushing) pthread_cond_wait(&cacheDone, &cacheLock);
+  flushing = true;
+}
+
+void PageFile::endFlush()
+{
+  flushing = false;
+  pthread_cond_broadcast(&cacheDone);
+}
+
+RC PageFile::sync()
+{
+  RC rc;
+
+  if ((rc = flush()) < 0) return rc;
+
+  long long start = IoStats::now();
+  if (::fsync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  if (jfd >= 0 && ::fsync(jfd) < 0) return RC_FILE_WRITE_FAILED;
+  stats->countSync(start);
+  return 0;
+}
+
+RC PageFile::commit(const void* data, int size)
+{
+  char copy[META_SIZE];
+
+  if (fd < 0 || !writable) return RC_INVALID_FILE_MODE;
+  if (size < 0 || size > META_SIZE) return RC_INVALID_PARAMETER;
+
+  memcpy(copy, data, size);
+  pthread_mutex_lock(&cacheLock);
+  startFlush();
+  RC rc = commitPages(copy, size);
+  endFlush();
+  pthread_mutex_unlock(&cacheLock);
+  return rc;
+}
+
+RC PageFile::commitPages(const void* data, int size)
+{
+  RC rc;
+
+  // the pages, and the journal, reach the disk before the metadata that
+  // describes them
+  if ((rc = flushPages()) < 0) return rc;
+  long long start = IoStats::now();
+  if (jfd >= 0 && !journaled.empty() && ::fsync(jfd) < 0) return RC_FILE_WRITE_FAILED;
+  if (::fsync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  stats->countSync(start);
+
+  // metadata that has not changed is already on the disk, unless the
+  // journal needs a commit to make its pages count
+  bool same = (size == metaSize && memcmp(data, meta, size) == 0);
+  if (!same || !journaled.empty()) {
+    if ((rc = writeMeta(data, size)) < 0) return rc;
+    start = IoStats::now();
+    if (::fsync(fd) < 0) return RC_FILE_WRITE_FAILED;
+    stats->countSync(start);
+  }
+
+  // the journaled pages are committed and can now take their place
+  if (!journaled.empty() && (rc = applyJournal()) < 0) return rc;
+  committedEnd = epid;
+  return 0;
+}
+
+RC PageFile::journalOffset(PageId pid, off_t& offset)
+{
+  if (jfd < 0) {
+    jfd = ::open(journalName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (jfd < 0) return RC_FILE_WRITE_FAILED;
+    jsize = 0;
+  }
+
+  // a page written back twice before a commit keeps its record. the
+  // record is taken before it is written, but the page is read from the
+  // cache until the write is over.
+  std::map<PageId, off_t>::iterator it = journaled.find(pid);
+  offset = (it != journaled.end()) ? it->second : jsize;
+
+  if (offset == jsize) jsize += JOURNAL_RECORD_SIZE;
+  journaled[pid] = offset;
+  return 0;
+}
+
+RC PageFile::readJournal(off_t offset, unsigned long long& sequence, PageId& pid, char* buffer) const
+{
+  JournalRecord r;
+  struct iovec iov[2] = { { &r, sizeof(r) }, { buffer, PAGE_SIZE } };
+
+  ssize_t n = ::preadv(jfd, iov, 2, offset);
+  if (n < 0) return RC_FILE_READ_FAILED;
+  if (n != JOURNAL_RECORD_SIZE || r.crc != journalChecksum(r, buffer)) return RC_CHECKSUM_FAILED;
+  sequence = r.sequence;
+  pid = r.pid;
+  return 0;
+}
+
+RC PageFile::applyJournal()
+{
+  RC  rc;
+  char page[PAGE_SIZE];
+  unsigned long long sequence;
+  PageId pid;
+
+  for (std::map<PageId, off_t>::iterator it = journaled.begin(); it != journaled.end(); ++it) {
+    if ((rc = readJournal(it->second, sequence, pid, page)) < 0) return rc;
+    unsigned crc = Crc32c::compute(page, PAGE_SIZE);
+    struct iovec iov[2] = { { page, PAGE_SIZE }, { &crc, sizeof(crc) } };
+    long long start = IoStats::now();
+    if (::pwritev(fd, iov, 2, pageOffset(pid)) != DISK_PAGE_SIZE) return RC_FILE_WRITE_FAILED;
+    stats->countDiskWrite(DISK_PAGE_SIZE, start);
+    if (pid >= epid) epid = pid + 1;
+  }
+
+  // the journal is emptied only once its pages are in place for good
+  long long start = IoStats::now();
+  if (::fsync(fd) < 0) return RC_FILE_WRITE_FAILED;
+  stats->countSync(start);
+  if (::ftruncate(jfd, 0) < 0) return RC_FILE_WRITE_FAILED;
+  jsize = 0;
+  journaled.clear();
+  return 0;
+}
+
+RC PageFile::recoverJournal()
+{
+  char page[PAGE_SIZE];
+  unsigned long long sequence;
+  PageId pid;
+  struct stat statbuf;
+
+  jfd = ::open(journalName.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (jfd < 0) return 0;
+  if (::fstat(jfd, &statbuf) < 0) return RC_FILE_OPEN_FAILED;
+
+  // the records of the last commit are whole, since the journal was
+  // forced before its metadata; the others belong to an older commit,
+  // or to one that a crash cut short
+  for (off_t offset = 0; offset + JOURNAL_RECORD_SIZE <= statbuf.st_size; offset += JOURNAL_RECORD_SIZE) {
+    if (readJournal(offset, sequence, pid, page) == 0 && sequence == metaSequence && pid >= 0) {
+      journaled[pid] = offset;
+    }
+  }
+  jsize = statbuf.st_size;
+
+  // a file opened for reading reads the journaled pages from the journal
+  return writable ? applyJournal() : 0;
+}
+
+int PageFile::readMeta(void* data) const
+{
+  pthread_mutex_lock(&cacheLock);
+  int size = metaSize;
+  memcpy(data, meta, META_SIZE);
+  pthread_mutex_unlock(&cacheLock);
+  return size;
+}
+
+RC PageFile::writeMeta(const void* data, int size)
+{
+  MetaSlot slot;
+
+  memset(&slot, 0, sizeof(slot));
+  slot.magic = META_MAGIC;
+  slot.size = size;
+  slot.sequence = metaSequence + 1;
+  memcpy(slot.data, data, size);
+  slot.crc = Crc32c::compute(&slot, offsetof(MetaSlot, crc));
+
+  // the commits take turns in the two slots, so the last one is left
+  // whole if this one is torn
+  off_t offset = (off_t) (slot.sequence % 2) * META_SLOT_SIZE;
+  if (::pwrite(fd, &slot, sizeof(slot), offset) != (ssize_t) sizeof(slot)) return RC_FILE_WRITE_FAILED;
+
+  metaSequence = slot.sequence;
+  metaSize = size;
+  memset(meta, 0, META_SIZE);
+  memcpy(meta, data, size);
+  return 0;
+}
+
+RC PageFile::readHeader()
+{
+  MetaSlot slots[2];
+  int      newest = -1;
+
+  // the slot of the last commit is the newer one that is whole
+  if (::pread(fd, slots, sizeof(slots[0]), 0) != (ssize_t) sizeof(slots[0]) ||
+      ::pread(fd, &slots[1], sizeof(slots[1]), META_SLOT_SIZE) != (ssize_t) sizeof(slots[1])) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+  for (int i = 0; i < 2; i++) {
+    const MetaSlot& m = slots[i];
+    if (m.magic != META_MAGIC || m.size < 0 || m.size > META_SIZE ||
+        m.crc != Crc32c::compute(&m, offsetof(MetaSlot, crc))) continue;
+    if (newest < 0 || m.sequence > slots[newest].sequence) newest = i;
+  }
+  if (newest < 0) return RC_INVALID_FILE_FORMAT;
+
+  metaSequence = slots[newest].sequence;
+  metaSize = slots[newest].size;
+  memcpy(meta, slots[newest].data, metaSize);
+  return 0;
+}
+
 PageId PageFile::endPid() const 
 {
-  return epid;
+  pthread_mutex_lock(&cacheLock);
+  PageId pid = epid;
+  pthread_mutex_unlock(&cacheLock);
+  return pid;
 }
 
 RC PageFile::seek(PageId pid) const
 {
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
+  return (::lseek(fd, pageOffset(pid), SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
 }
 
-RC PageFile::write(PageId pid, const void* buffer)
+RC PageFile::writeBack(int slot)
 {
   RC rc;
-  if (pid < 0) return RC_INVALID_PID; 
+  cacheStruct& c = readCache[slot];
+  JournalRecord r;
+  unsigned crc;
+  int      wfd = c.fd;
+  off_t    offset = pageOffset(c.pid);
+  ssize_t  size = DISK_PAGE_SIZE;
 
-  // seek to the location of the page
-  if ((rc = seek(pid) < 0)) return rc;
+  if (!c.dirty) return 0;
 
-  // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  // a page that the last commit covers goes to the journal
+  PageFile* f = c.file;
+  bool journal = (f != NULL && f->metaSize > 0 && c.pid < f->committedEnd);
+  if (journal) {
+    if ((rc = f->journalOffset(c.pid, offset)) < 0) return rc;
+    memset(&r, 0, sizeof(r));
+    r.sequence = f->metaSequence + 1;
+    r.pid = c.pid;
+    wfd = f->jfd;
+    size = JOURNAL_RECORD_SIZE;
+  }
 
-  // if the page is in read cache, invalidate it
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid &&
-        readCache[i].lastAccessed != 0) {
-       readCache[i].fd = 0;
-       readCache[i].pid = 0;
-       readCache[i].lastAccessed = 0;
-       break;
+  // the page is written without the lock. the slot keeps the page
+  // meanwhile, so it can still be read, but not written or evicted.
+  c.writing = true;
+  pthread_mutex_unlock(&cacheLock);
+
+  struct iovec iov[2];
+  if (journal) {
+    r.crc = journalChecksum(r, c.buffer);
+    iov[0].iov_base = &r;
+    iov[0].iov_len = sizeof(r);
+    iov[1].iov_base = c.buffer;
+    iov[1].iov_len = PAGE_SIZE;
+  } else {
+    // the buffer is followed on the disk by its checksum
+    crc = Crc32c::compute(c.buffer, PAGE_SIZE);
+    iov[0].iov_base = c.buffer;
+    iov[0].iov_len = PAGE_SIZE;
+    iov[1].iov_base = &crc;
+    iov[1].iov_len = sizeof(crc);
+  }
+  long long start = IoStats::now();
+  bool written = (::pwritev(wfd, iov, 2, offset) == size);
+
+  pthread_mutex_lock(&cacheLock);
+  c.writing = false;
+  pthread_cond_broadcast(&cacheDone);
+  if (!written) return RC_FILE_WRITE_FAILED;
+  c.dirty = false;
+  c.file = NULL;
+
+  // increase page write count
+  c.stats->countDiskWrite(size, start);
+  if (ioCounters != NULL) addCount(ioCounters->diskWrites[c.kind]);
+
+  return 0;
+}
+
+RC PageFile::evict(int& slot)
+{
+  // find the cache slot to evict. the pages of a file being flushed are
+  // written back by the flush.
+  int toEvict = -1;
+  for (int i = 0; i < cacheCount; i++) {
+    cacheStruct& c = readCache[i];
+    if (c.reading || c.writing) continue;
+    if (c.lastAccessed == 0) {
+      toEvict = i;
+      break;
+    }
+    if (c.dirty && c.file != NULL && c.file->flushing) continue;
+    if (toEvict < 0 || c.lastAccessed < readCache[toEvict].lastAccessed) {
+      toEvict = i;
     }
   }
 
+  slot = -1;
+  if (toEvict < 0) {
+    pthread_cond_wait(&cacheDone, &cacheLock);
+    return 0;
+  }
+
+  // a dirty victim has to reach its file before the slot is reused
+  cacheStruct& c = readCache[toEvict];
+  if (c.lastAccessed != 0 && c.dirty) return writeBack(toEvict);
+
+  if (c.lastAccessed != 0) {
+    cacheIndex.erase(make_pair(c.fd, c.pid));
+    c.stats->countEviction();
+  }
+  c.lastAccessed = 0;
+  slot = toEvict;
+  return 0;
+}
+
+int PageFile::findSlot(int fd, PageId pid)
+{
+  std::map<std::pair<int, PageId>, int>::const_iterator it = cacheIndex.find(make_pair(fd, pid));
+  return (it != cacheIndex.end()) ? it->second : -1;
+}
+
+RC PageFile::write(PageId pid, const void* buffer)
+{
+  RC rc;
+  int slot;
+  if (pid < 0) return RC_INVALID_PID;
+
+  pthread_mutex_lock(&cacheLock);
+
+  // if the page is already cached, overwrite the cached copy once no
+  // thread reads it in or writes it back. otherwise take over a cache
+  // slot for the page.
+  for (;;) {
+    slot = findSlot(fd, pid);
+    if (slot >= 0 && !readCache[slot].reading && !readCache[slot].writing) break;
+    if (slot >= 0) {
+      pthread_cond_wait(&cacheDone, &cacheLock);
+      continue;
+    }
+    if ((rc = evict(slot)) < 0) {
+      pthread_mutex_unlock(&cacheLock);
+      return rc;
+    }
+    if (slot >= 0) {
+      readCache[slot].fd = fd;
+      readCache[slot].pid = pid;
+      cacheIndex[make_pair(fd, pid)] = slot;
+      break;
+    }
+  }
+  readCache[slot].kind = kind;
+  readCache[slot].stats = stats;
+  readCache[slot].file = this;
+  if (stats != NULL) stats->countWrite();
+
+  // the page is written to the disk lazily, when it is evicted or flushed
+  memcpy(readCache[slot].buffer, buffer, PAGE_SIZE);
+  readCache[slot].dirty = true;
+  readCache[slot].lastAccessed = ++cacheClock;
+
   // if the written pid >= end pid, update the end pid
   if (pid >= epid) epid = pid + 1;
 
-  // increase page write count
-  writeCount++;
-
+  pthread_mutex_unlock(&cacheLock);
   return 0;
 }
 
 RC PageFile::read(PageId pid, void* buffer) const
 {
-  RC rc;
+  RC rc = 0;
+  int slot;
 
-  if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+  pthread_mutex_lock(&cacheLock);
+
+  if (pid < 0 || pid >= epid) {
+    pthread_mutex_unlock(&cacheLock);
+    return RC_INVALID_PID;
+  }
+  if (ioCounters != NULL) addCount(ioCounters->reads[kind]);
 
   //
-  // if the page is in cache, read it from there
+  // if the page is in cache, read it from there. a page that another
+  // thread is reading in is waited for, and so is a flush of the file.
   //
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid && 
-        readCache[i].lastAccessed != 0) {
-       memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
-       readCache[i].lastAccessed = ++cacheClock;
-       return 0;
-    }
-  }
-
-  // seek to the page
-  if ((rc = seek(pid) < 0)) return rc;
-  
-  // find the cache slot to evict
-  int toEvict = 0; 
-  for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].lastAccessed == 0) {
-      toEvict = i;
-      break;
+  for (;;) {
+    slot = findSlot(fd, pid);
+    if (slot >= 0 && !readCache[slot].reading) {
+      memcpy(buffer, readCache[slot].buffer, PAGE_SIZE);
+      readCache[slot].lastAccessed = ++cacheClock;
+      stats->countRead(true);
+      pthread_mutex_unlock(&cacheLock);
+      return 0;
     }
-    if (readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
-      toEvict = i;
+    if (slot >= 0 || flushing) {
+      pthread_cond_wait(&cacheDone, &cacheLock);
+      continue;
     }
+    if ((rc = evict(slot)) < 0) {
+      pthread_mutex_unlock(&cacheLock);
+      return rc;
+    }
+    if (slot >= 0) break;
+  }
+
+  // the slot holds the page while it is read without the lock, so that
+  // the other threads that want the page wait for it
+  cacheStruct& c = readCache[slot];
+  c.fd = fd;
+  c.pid = pid;
+  c.dirty = false;
+  c.kind = kind;
+  c.stats = stats;
+  c.file = NULL;
+  c.reading = true;
+  c.lastAccessed = ++cacheClock;
+  cacheIndex[make_pair(fd, pid)] = slot;
+  std::map<PageId, off_t>::const_iterator it = journaled.find(pid);
+  bool  inJournal = (it != journaled.end());
+  off_t joffset = inJournal ? it->second : 0;
+  pthread_mutex_unlock(&cacheLock);
+
+  // read the page to cache first and copy it to the buffer.
+  // pread() leaves the shared file offset alone, so that other threads
+  // reading the same file never see a half-moved cursor.
+  char*    page = c.buffer;
+  unsigned crc = 0;
+  struct iovec iov[2] = { { page, PAGE_SIZE }, { &crc, sizeof(crc) } };
+  long long start = IoStats::now();
+  ssize_t n = JOURNAL_RECORD_SIZE;
+  if (inJournal) {
+    // the page is newer in the journal than in place
+    unsigned long long sequence;
+    PageId jpid;
+    rc = readJournal(joffset, sequence, jpid, page);
+  } else if ((n = ::preadv(fd, iov, 2, pageOffset(pid))) < 0) {
+    rc = RC_FILE_READ_FAILED;
+  } else if (n == 0) {
+    // a page past the end of the file, or one of zeros, was never
+    // written. any other page must match its checksum; one that does
+    // not, say because a crash tore its write, is not cached.
+    memset(page, 0, PAGE_SIZE);
+  } else if (n != DISK_PAGE_SIZE || !checksumMatches(page, crc)) {
+    rc = RC_CHECKSUM_FAILED;
   }
-  readCache[toEvict].fd = fd;
-  readCache[toEvict].pid = pid;
-  readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
+
+  pthread_mutex_lock(&cacheLock);
+  c.reading = false;
+  pthread_cond_broadcast(&cacheDone);
+  if (rc < 0) {
+    cacheIndex.erase(make_pair(fd, pid));
+    c.lastAccessed = 0;
+    pthread_mutex_unlock(&cacheLock);
+    return rc;
   }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
+  memcpy(buffer, page, PAGE_SIZE);
 
   // increase the page read count
-  readCount++;
+  stats->countRead(false);
+  stats->countDiskRead(n, start);
+  if (ioCounters != NULL) addCount(ioCounters->diskReads[kind]);
+
+  pthread_mutex_unlock(&cacheLock);
+  return 0;
+}
+
+RC PageFile::readPages(AsyncIo& io, const PageId* pids, int count, char* buffers) const
+{
+  vector<PageRead> reads;
+  vector<int>      retries;
+  AsyncIo::Request* r;
+  RC rc = 0;
+  RC ret;
+
+  reads.reserve(count);
+
+  // copy the cached pages, and note the others
+  pthread_mutex_lock(&cacheLock);
+  for (int i = 0; i < count; i++) {
+    if (pids[i] < 0 || pids[i] >= epid) {
+      pthread_mutex_unlock(&cacheLock);
+      return RC_INVALID_PID;
+    }
+
+    // a journaled page, or one that another thread is reading in, is
+    // read the way read() reads it
+    int slot = findSlot(fd, pids[i]);
+    if ((slot < 0 && journaled.count(pids[i]) != 0) ||
+        (slot >= 0 && readCache[slot].reading)) {
+      retries.push_back(i);
+      continue;
+    }
+    if (slot < 0) {
+      PageRead p;
+      p.index = i;
+      reads.push_back(p);
+      continue;
+    }
+    memcpy(buffers + i * PAGE_SIZE, readCache[slot].buffer, PAGE_SIZE);
+    readCache[slot].lastAccessed = ++cacheClock;
+    stats->countRead(true);
+    if (ioCounters != NULL) addCount(ioCounters->reads[kind]);
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  // a single page gains nothing from being read on its own
+  if (reads.size() == 1) {
+    retries.push_back(reads[0].index);
+    reads.clear();
+  }
+
+  // keep as many reads in flight as the queue takes, and check each
+  // page as soon as it arrives. after an error, the reads in flight are
+  // waited for but no more are started: they write to reads and buffers,
+  // so this does not return while one of them is in flight.
+  unsigned next = 0;
+  while (next < reads.size() || io.pending() > 0) {
+    while (rc == 0 && next < reads.size() && io.pending() < AsyncIo::QUEUE_DEPTH) {
+      PageRead& p = reads[next++];
+      p.req.fd = fd;
+      p.req.offset = pageOffset(pids[p.index]);
+      p.req.iov[0].iov_base = buffers + p.index * PAGE_SIZE;
+      p.req.iov[0].iov_len = PAGE_SIZE;
+      p.req.iov[1].iov_base = &p.crc;
+      p.req.iov[1].iov_len = sizeof(p.crc);
+      p.req.iovcnt = 2;
+      p.req.data = &p;
+      p.crc = 0;
+      p.start = IoStats::now();
+      if ((ret = io.read(&p.req)) < 0) rc = ret;
+    }
+    if (io.pending() == 0) break;
+    if ((ret = io.complete(r)) < 0) {
+      rc = ret;
+      continue;
+    }
+
+    PageRead& p = *(PageRead*) r->data;
+    char* page = buffers + p.index * PAGE_SIZE;
+    if (r->result < 0) {
+      rc = RC_FILE_READ_FAILED;
+      continue;
+    }
+
+    // a page that does not match its checksum may have been torn by a
+    // write back that raced with the read; it is read again the way
+    // read() does, which waits for the write backs of the page.
+    if (r->result == 0) {
+      memset(page, 0, PAGE_SIZE);
+    } else if (r->result != DISK_PAGE_SIZE || !checksumMatches(page, p.crc)) {
+      retries.push_back(p.index);
+      continue;
+    }
+
+    // the page may have been written to the cache since it was looked
+    // for there, in which case the cached copy is the newer one
+    pthread_mutex_lock(&cacheLock);
+    int slot = findSlot(fd, pids[p.index]);
+    if (slot >= 0 && !readCache[slot].reading) {
+      memcpy(page, readCache[slot].buffer, PAGE_SIZE);
+    }
+    pthread_mutex_unlock(&cacheLock);
+
+    stats->countRead(false);
+    stats->countDiskRead(r->result, p.start);
+    if (ioCounters != NULL) {
+      addCount(ioCounters->reads[kind]);
+      addCount(ioCounters->diskReads[kind]);
+    }
+  }
+  if (rc < 0) return rc;
+
+  for (unsigned i = 0; i < retries.size(); i++) {
+    if ((rc = read(pids[retries[i]], buffers + retries[i] * PAGE_SIZE)) < 0) return rc;
+  }
 
   return 0;
 }
@@ -10,18 +10,59 @@
 #ifndef PAGEFILE_H
 #define PAGEFILE_H
 
+#include <map>
 #include <string>
+#include <utility>
+#include <pthread.h>
 #include "Bruinbase.h"
+#include "IoStats.h"
+#include "AsyncIo.h"
 
 typedef int PageId;
 
 /**
- * read/write a file in the unit of a page
+ * read/write a file in the unit of a page.
+ * the page cache is shared by all files and protected by a mutex, so
+ * different threads may read and write pages concurrently. callers must
+ * still serialize their own accesses to the same page (see BTreeIndex).
+ * the mutex is not held while a page is read into the cache or written
+ * back from it: the slot of the page is marked busy meanwhile, and the
+ * threads that want it wait for the I/O to finish.
+ *
+ * on the disk, a file starts with two slots for its metadata (see
+ * commit()), followed by the pages. each page is followed by its CRC32C
+ * checksum, which is checked whenever the page is read from the disk.
+ * a page that was never written reads as zeros.
+ *
+ * once a file has committed metadata, a page that the last commit covers
+ * is never overwritten in place before the next commit: when it is
+ * written back, it goes to the journal of the file (the file name
+ * followed by ".jnl") instead, and is read from there. the next commit
+ * forces the journal before its metadata and then copies the journaled
+ * pages in place; open() finishes the copying that a crash interrupted.
  */
 class PageFile {
  public:
 
   static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
+  static const int META_SIZE = 256;     // the most bytes of metadata a file keeps
+  static const int DEFAULT_CACHE_SIZE = 10;  // the pages of the cache by default
+
+  /**
+   * the kinds of files whose page accesses are counted apart
+   */
+  enum FileKind { TABLE_FILE, INDEX_FILE, OTHER_FILE };
+  static const int FILE_KINDS = 3;
+
+  /**
+   * the page accesses of one or more threads, by kind of file. a read of
+   * a page found in the cache is a cache hit; the others go to the disk.
+   */
+  struct IoCounters {
+    long long reads[FILE_KINDS];       // the pages read by read()
+    long long diskReads[FILE_KINDS];   // the reads that were not cache hits
+    long long diskWrites[FILE_KINDS];  // the pages written to the disk
+  };
 
   PageFile();
   PageFile(const std::string& filename, char mode);
@@ -36,7 +77,8 @@ class PageFile {
   RC open(const std::string& filename, char mode);
 
   /**
-   * close the file.
+   * close the file. the pages written since the last commit are committed
+   * with the same metadata if some of them are in the journal.
    * @return error code. 0 if no error
    */
   RC close();
@@ -45,19 +87,76 @@ class PageFile {
    * read a disk page into memory buffer.
    * @param pid[IN] the page to read
    * @param buffer[OUT] pointer to memory buffer
-   * @return error code. 0 if no error
+   * @return error code. 0 if no error, RC_CHECKSUM_FAILED if the page
+   *         on the disk does not match its checksum
    */
   RC read(PageId pid, void *buffer) const;
   
+  /**
+   * read a set of disk pages into memory buffers. the pages found in the
+   * cache are copied from it; the reads of the others are all started
+   * before the first of them is waited for, and each is checked against
+   * its checksum as it completes. the pages read from the disk are not
+   * cached, so that a large set does not push the pages of the indexes
+   * out of the cache.
+   * @param io[IN] the reads in flight of the calling thread
+   * @param pids[IN] the pages to read
+   * @param count[IN] the number of pages
+   * @param buffers[OUT] count * PAGE_SIZE bytes. page pids[i] goes to
+   *                     buffers + i * PAGE_SIZE
+   * @return error code. 0 if no error, RC_CHECKSUM_FAILED if a page
+   *         on the disk does not match its checksum
+   */
+  RC readPages(AsyncIo& io, const PageId* pids, int count, char* buffers) const;
+
   /**
    * write the memory buffer to the disk page.
    * if (pid >= endPid()), the file is expanded such that
    * endPid() becomes (pid + 1).
+   * the page is kept dirty in the cache and reaches the disk when it is
+   * evicted or when flush(), sync() or close() is called.
    * @param pid[IN] page to write to
    * @param buffer[IN] the content to write
    * @return error code. 0 if no error
    */
   RC write(PageId pid, const void *buffer);
+
+  /**
+   * write all dirty cached pages of this file to the disk.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * flush all dirty pages of this file and force them to stable storage.
+   * @return error code. 0 if no error
+   */
+  RC sync();
+
+  /**
+   * make the pages written so far durable, and then the metadata that
+   * describes them. the dirty pages are written back and forced to
+   * stable storage, with the journal, before the metadata is written and
+   * forced in turn; the journaled pages are then copied in place.
+   * the metadata goes to the older of the two slots of the file, so a
+   * crash leaves either this metadata or the one committed before it,
+   * along with the pages as they were at that commit. metadata equal to
+   * the last committed one is not written again, unless pages are in the
+   * journal. no other page of the file is read from or written to the
+   * disk from the flush to the metadata.
+   * @param data[IN] the metadata
+   * @param size[IN] the size of the metadata, at most META_SIZE
+   * @return error code. 0 if no error
+   */
+  RC commit(const void* data, int size);
+
+  /**
+   * read the metadata last committed to the file.
+   * @param data[OUT] a buffer of META_SIZE bytes. the bytes after the
+   *                  metadata are set to zero.
+   * @return the size of the metadata, 0 if none was committed
+   */
+  int readMeta(void* data) const;
     
   /**
    * note the +1 part. The last page id in the file is actually endPid()-1.
@@ -67,14 +166,69 @@ class PageFile {
   PageId endPid() const;
 
   /**
-   * @return the total # of disk reads
+   * set the kind of the file, by which its page accesses are counted.
+   * a file is of OTHER_FILE until this is called, which must be before
+   * open(), since its IoStats belong to the subsystem of its kind.
+   * @param kind[IN] the kind of the file
+   */
+  void setKind(FileKind kind);
+
+  /**
+   * count the I/O of the file under another name than its file name, so
+   * that a group of temporary files shares its IoStats. must be called
+   * before open().
+   * @param name[IN] the name of the IoStats
+   */
+  void setStatsName(const std::string& name);
+
+  /**
+   * set the number of pages the cache of all files holds. the cache can
+   * only be resized while it is empty, e.g. before the first file is
+   * opened.
+   * @param pages[IN] the number of pages, at least 1
+   * @return error code. 0 if no error, RC_INVALID_PARAMETER if pages is
+   *         less than 1, RC_INVALID_FILE_MODE if pages are cached
+   */
+  static RC setCacheSize(int pages);
+
+  /**
+   * @return the number of pages the cache holds
+   */
+  static int getCacheSize();
+
+  /**
+   * @return the name of the subsystem of the files of a kind in IoStats
+   */
+  static const char* kindName(FileKind kind);
+
+  /**
+   * count the page accesses of the calling thread in a set of counters,
+   * which several threads may share.
+   * @param counters[IN] the counters, NULL to stop counting
+   */
+  static void setIoCounters(IoCounters* counters);
+
+  /**
+   * @return the counters of the calling thread, NULL if there are none
+   */
+  static IoCounters* getIoCounters() { return ioCounters; }
+
+  /**
+   * copy a set of counters that other threads may be updating.
+   * @param from[IN] the counters to copy
+   * @param to[OUT] the copy
+   */
+  static void readIoCounters(const IoCounters& from, IoCounters& to);
+
+  /**
+   * @return the total # of disk reads of pages
    */
-  static int getPageReadCount()  { return readCount; }
+  static long long getPageReadCount();
   
   /**
-   * @return the total # of disk writes
+   * @return the total # of disk writes of pages
    */
-  static int getPageWriteCount() { return writeCount; }
+  static long long getPageWriteCount();
 
  protected:
   /**
@@ -85,28 +239,162 @@ class PageFile {
    */
   RC seek(PageId pid) const;
 
+  /**
+   * write all dirty cached pages of this file to the disk, and wait for
+   * the reads and write backs of its pages in flight. the caller must
+   * hold cacheLock and have called startFlush().
+   * @return error code. 0 if no error
+   */
+  RC flushPages();
+
+  /**
+   * keep other threads from starting to read or write back a page of this
+   * file, waiting for the thread that already does. the caller must hold
+   * cacheLock, and call endFlush() when done.
+   */
+  void startFlush();
+
+  /**
+   * let other threads read and write back the pages of this file again.
+   * the caller must hold cacheLock.
+   */
+  void endFlush();
+
+  /**
+   * write the cache slot back to its file if it is dirty. the caller must
+   * hold cacheLock, which is released while the page is written.
+   * @param slot[IN] index of the cache slot to write back
+   * @return error code. 0 if no error
+   */
+  static RC writeBack(int slot);
+
+  /**
+   * find a free cache slot, evicting the least recently used page that
+   * no thread is reading or writing back. the caller must hold cacheLock.
+   * when the victim is dirty, it is written back rather than evicted, or
+   * when every slot is busy, one of them is waited for; the lock is
+   * released meanwhile and no slot is returned, so that the caller looks
+   * for its page again.
+   * @param slot[OUT] index of the cache slot, -1 if there is none
+   * @return error code. 0 if no error
+   */
+  static RC evict(int& slot);
+
+  /**
+   * @return the cache slot of a page, -1 if it is not cached. the caller
+   *         must hold cacheLock.
+   */
+  static int findSlot(int fd, PageId pid);
+
+  /**
+   * write metadata to the slot of the next commit, without forcing it to
+   * stable storage. the caller must hold cacheLock, unless the file is
+   * being opened.
+   * @param data[IN] the metadata
+   * @param size[IN] the size of the metadata
+   * @return error code. 0 if no error
+   */
+  RC writeMeta(const void* data, int size);
+
+  /**
+   * write the dirty pages of this file back and commit them with the
+   * metadata (see commit()). the caller must hold cacheLock.
+   * @param data[IN] the metadata, which must not be meta
+   * @param size[IN] the size of the metadata
+   * @return error code. 0 if no error
+   */
+  RC commitPages(const void* data, int size);
+
+  /**
+   * find where a page that the last commit covers goes in the journal,
+   * over its earlier copy there if it has one, opening the journal if
+   * needed. the caller must hold cacheLock.
+   * @param pid[IN] the page
+   * @param offset[OUT] where the record of the page starts
+   * @return error code. 0 if no error
+   */
+  RC journalOffset(PageId pid, off_t& offset);
+
+  /**
+   * read a record of the journal and check it against its checksum.
+   * @param offset[IN] where the record starts in the journal
+   * @param sequence[OUT] the commit the record belongs to
+   * @param pid[OUT] the page of the record
+   * @param buffer[OUT] the content of the page
+   * @return error code. 0 if no error, RC_CHECKSUM_FAILED if the record
+   *         is torn
+   */
+  RC readJournal(off_t offset, unsigned long long& sequence, PageId& pid, char* buffer) const;
+
+  /**
+   * copy the journaled pages in place, force them to stable storage and
+   * empty the journal. the caller must hold cacheLock, unless the file is
+   * being opened.
+   * @return error code. 0 if no error
+   */
+  RC applyJournal();
+
+  /**
+   * find the pages that the last commit put in the journal when the file
+   * is opened, and copy them in place if the file is writable.
+   * @return error code. 0 if no error
+   */
+  RC recoverJournal();
+
+  /**
+   * read the slots of the metadata when the file is opened and keep the
+   * last committed metadata.
+   * @return error code. 0 if no error, RC_INVALID_FILE_FORMAT if neither
+   *         slot holds metadata
+   */
+  RC readHeader();
+
  private:
   int     fd;     // file descriptor of the associated unix file
   PageId  epid;   // (last page id + 1) of the file
+  bool    writable;  // the file was opened in 'w' mode
+  unsigned long long metaSequence;  // the number of the last committed metadata
+  int     metaSize;  // the size of the last committed metadata
+  char    meta[META_SIZE];  // the last committed metadata
+  int     kind;   // the FileKind of the file
+  std::string statsName;  // the name of stats, empty for the file name
+  IoStats* stats; // the I/O counters of the file, NULL until it is opened
+
+  std::string journalName;  // the name of the journal of the file
+  int     jfd;    // the journal, -1 until a page is written to it
+  off_t   jsize;  // the end of the records in the journal
+  PageId  committedEnd;  // epid at the last commit
+  std::map<PageId, off_t> journaled;  // where each journaled page is
+  bool    flushing;  // a thread is flushing the file (see startFlush())
 
   //
   // the following set of members implement LRU caching 
   //
-  static const int CACHE_COUNT = 10;
+  static int cacheCount; // the number of cache slots
 
   static int cacheClock; // clock tick counter for LRU policy
 
+  static pthread_mutex_t cacheLock; // protects the cache, the counters, epid and the metadata
+  static pthread_cond_t  cacheDone; // signaled when the I/O of a slot or a flush ends
+
   // the actual cache data structure
   static struct cacheStruct {
     int    fd;              // file id of the cached page
     PageId pid;             // page id of the cached page
     int    lastAccessed;    // the last time the cached page was accessed
                             //   (lastAccessed == 0) means that the buffer is empty
+    bool   dirty;           // the buffer has not been written to the file yet
+    int    kind;            // the FileKind of the file
+    IoStats* stats;         // the I/O counters of the file
+    PageFile* file;         // the file that wrote the page, NULL if clean
+    bool   reading;         // the page is being read into the buffer
+    bool   writing;         // the buffer is being written back
     char buffer[PAGE_SIZE]; // the buffer used for caching
-  } readCache[CACHE_COUNT];
+  } *readCache;
+
+  static std::map<std::pair<int, PageId>, int> cacheIndex;  // the slot of each cached page
 
-  static int readCount;  // total # of page reads 
-  static int writeCount; // total # of page writes 
+  static __thread IoCounters* ioCounters; // the counters of the thread
 };
   
 #endif // PAGEFILE_H
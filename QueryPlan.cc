@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <time.h>
+#include "QueryPlan.h"
+
+using std::string;
+
+// the names of the kinds of files in the plan
+static const char* KIND_NAMES[PageFile::FILE_KINDS] = { "table", "index", "other" };
+
+// the monotonic clock in nanoseconds
+static long long now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+QueryPlan::QueryPlan(bool analyze, FILE* out)
+{
+  this->analyze = analyze;
+  this->out = out;
+  current = -1;
+  last = 0;
+  counters = NULL;
+  memset(&own, 0, sizeof(own));
+  memset(&seen, 0, sizeof(seen));
+}
+
+int QueryPlan::add(int parent, const string& name, double estimate)
+{
+  Node n;
+
+  n.name = name;
+  n.estimate = estimate;
+  n.parent = parent;
+  n.rows = 0;
+  n.nanos = 0;
+  memset(&n.io, 0, sizeof(n.io));
+  nodes.push_back(n);
+
+  int id = nodes.size() - 1;
+  if (parent >= 0) nodes[parent].children.push_back(id);
+  return id;
+}
+
+void QueryPlan::start()
+{
+  // count in the counters of the statement, or in our own if the thread
+  // has none
+  counters = PageFile::getIoCounters();
+  if (counters == NULL) {
+    counters = &own;
+    PageFile::setIoCounters(&own);
+  }
+
+  PageFile::readIoCounters(*counters, seen);
+  last = now();
+  current = nodes.empty() ? -1 : 0;
+}
+
+int QueryPlan::enter(int node)
+{
+  int before = current;
+
+  charge();
+  current = node;
+  return before;
+}
+
+void QueryPlan::finish()
+{
+  charge();
+  current = -1;
+  if (counters == &own) PageFile::setIoCounters(NULL);
+}
+
+void QueryPlan::charge()
+{
+  PageFile::IoCounters io;
+  long long t = now();
+
+  if (counters == NULL) return;
+  PageFile::readIoCounters(*counters, io);
+
+  if (current >= 0) {
+    Node& n = nodes[current];
+    n.nanos += t - last;
+    for (int i = 0; i < PageFile::FILE_KINDS; i++) {
+      n.io.reads[i] += io.reads[i] - seen.reads[i];
+      n.io.diskReads[i] += io.diskReads[i] - seen.diskReads[i];
+      n.io.diskWrites[i] += io.diskWrites[i] - seen.diskWrites[i];
+    }
+  }
+
+  seen = io;
+  last = t;
+}
+
+void QueryPlan::print() const
+{
+  long long nanos = 0;
+
+  // a statement that failed before it was planned has no operators
+  if (nodes.empty()) return;
+
+  for (unsigned i = 0; i < nodes.size(); i++) {
+    if (nodes[i].parent < 0) print(i, 0);
+    nanos += nodes[i].nanos;
+  }
+  if (analyze) fprintf(out, "Total time: %.3f ms\n", nanos / 1e6);
+}
+
+void QueryPlan::print(int node, int depth) const
+{
+  const Node& n = nodes[node];
+  string indent(depth * 4, ' ');
+
+  fprintf(out, "%s%s%s  (estimated rows %.0f)\n", indent.c_str(), depth > 0 ? "-> " : "", n.name.c_str(), n.estimate);
+
+  if (analyze) {
+    if (depth > 0) indent += "   ";
+    fprintf(out, "%s  actual rows %lld, time %.3f ms\n", indent.c_str(), n.rows, n.nanos / 1e6);
+    for (int i = 0; i < PageFile::FILE_KINDS; i++) {
+      if (n.io.reads[i] == 0 && n.io.diskWrites[i] == 0) continue;
+      fprintf(out, "%s  %s pages: %lld read, %lld from disk, %lld cache hits", indent.c_str(), KIND_NAMES[i],
+              n.io.reads[i], n.io.diskReads[i], n.io.reads[i] - n.io.diskReads[i]);
+      if (n.io.diskWrites[i] > 0) fprintf(out, ", %lld written", n.io.diskWrites[i]);
+      fprintf(out, "\n");
+    }
+  }
+
+  for (unsigned i = 0; i < n.children.size(); i++) print(n.children[i], depth + 1);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef QUERYPLAN_H
+#define QUERYPLAN_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "PageFile.h"
+
+/**
+ * The tree of operators of a statement run by EXPLAIN. Each operator
+ * passes its tuples to its parent; the root produces the result.
+ * With EXPLAIN ANALYZE, the statement runs and the plan counts the tuples
+ * each operator produces, and charges the time and the page accesses of
+ * the thread to the operator that is working. Since an operator hands
+ * each tuple to its parent as soon as it has it, the work of the parent
+ * is charged to the parent, so the numbers of an operator do not include
+ * those of its children.
+ */
+class QueryPlan {
+ public:
+  /**
+   * @param analyze[IN] whether the statement is run: EXPLAIN ANALYZE
+   * @param out[IN] the stream for the plan
+   */
+  QueryPlan(bool analyze, FILE* out);
+
+  /**
+   * @return whether the statement is run
+   */
+  bool isAnalyze() const { return analyze; }
+
+  /**
+   * @return the stream for the plan
+   */
+  FILE* getOut() const { return out; }
+
+  /**
+   * add an operator.
+   * @param parent[IN] the operator that takes its tuples, -1 for the root
+   * @param name[IN] what the operator does
+   * @param estimate[IN] the tuples it is estimated to produce
+   * @return the id of the operator
+   */
+  int add(int parent, const std::string& name, double estimate);
+
+  /**
+   * count the tuples produced by an operator.
+   * @param node[IN] the operator
+   * @param rows[IN] the tuples to add
+   */
+  void addRows(int node, long long rows) { nodes[node].rows += rows; }
+
+  /**
+   * start charging the time and page accesses of the thread to an
+   * operator, from the root at first.
+   */
+  void start();
+
+  /**
+   * charge the time and page accesses of the thread from now on to an
+   * operator.
+   * @param node[IN] the operator
+   * @return the operator they were charged to until now
+   */
+  int enter(int node);
+
+  /**
+   * stop charging the time and page accesses.
+   */
+  void finish();
+
+  /**
+   * print the operators, each under its parent.
+   */
+  void print() const;
+
+ private:
+  struct Node {
+    std::string          name;
+    double               estimate;
+    int                  parent;
+    std::vector<int>     children;
+    long long            rows;
+    long long            nanos;   // the time charged to the operator
+    PageFile::IoCounters io;      // the page accesses charged to it
+  };
+
+  /**
+   * charge what happened since the last call to the current operator.
+   */
+  void charge();
+
+  /**
+   * print an operator and its children, indented by depth.
+   */
+  void print(int node, int depth) const;
+
+  bool              analyze;
+  FILE*             out;
+  std::vector<Node> nodes;
+  int               current;   // the operator being charged, -1 if none
+  long long         last;      // the time of the last charge
+  PageFile::IoCounters* counters;  // the counters of the thread
+  PageFile::IoCounters  own;       // used if the thread has none
+  PageFile::IoCounters  seen;      // the counters at the last charge
+};
+
+#endif // QUERYPLAN_H
@@ -7,6 +7,9 @@
  * @date 3/24/2008
  */
 
+#include <cstring>
+#include <algorithm>
+#include <vector>
 #include "Bruinbase.h"
 #include "RecordFile.h"
 
@@ -31,6 +34,15 @@ static int getRecordCount(const char* page);
 // update # records stored in the page
 static void setRecordCount(char* page, int count);
 
+// check whether the record in the n'th slot has been removed
+static bool isRemoved(const char* page, int n);
+
+// mark the record in the n'th slot as removed
+static void setRemoved(char* page, int n);
+
+// the position of a record in the columns of a file stored by columns
+static int recordIndex(const RecordId& rid);
+
 
 //
 // helper functions for RecordId manipulation
@@ -106,62 +118,227 @@ RecordFile::RecordFile()
 {
   erid.pid = 0;
   erid.sid = 0;
+  committed = erid;
+  columns = false;
+  zones = false;
+  zonesSaved = erid;
+  zonesForced = false;
+  pf.setKind(PageFile::TABLE_FILE);
+  kpf.setKind(PageFile::TABLE_FILE);
+  pthread_mutex_init(&lock, NULL);
 }
 
 RecordFile::RecordFile(const string& filename, char mode)
 {
+  erid.pid = 0;
+  erid.sid = 0;
+  committed = erid;
+  columns = false;
+  zones = false;
+  zonesSaved = erid;
+  zonesForced = false;
+  pf.setKind(PageFile::TABLE_FILE);
+  kpf.setKind(PageFile::TABLE_FILE);
+  pthread_mutex_init(&lock, NULL);
   open(filename, mode);
 }
 
+RecordFile::~RecordFile()
+{
+  pthread_mutex_destroy(&lock);
+}
+
 RC RecordFile::open(const string& filename, char mode)
 {
-  RC   rc;
-  char page[PageFile::PAGE_SIZE];
+  RC rc;
 
   // open the page file
+  columns = false;
   if ((rc = pf.open(filename, mode)) < 0) return rc;
-  
-  //
-  // in the rest of this function, we set the end record id
-  //
 
-  // get the end pid of the file
-  erid.pid = pf.endPid();
+  // the end record id is the one of the last commit
+  readCommitted(pf);
+  return 0;
+}
 
-  // if the end pid is zero, the file is empty.
-  // set the end record id to (0, 0).
-  if (erid.pid == 0) {
-    erid.sid = 0;
-    return 0;
+RC RecordFile::open(const string& keyFile, const string& valueFile, char mode)
+{
+  RC rc;
+
+  columns = true;
+  if ((rc = kpf.open(keyFile, mode)) < 0) return rc;
+  if ((rc = pf.open(valueFile, mode)) < 0) {
+    kpf.close();
+    return rc;
   }
 
-  // obtain # records in the last page to set sid of the end record id.
-  // read the last page of the file and get # records in the page.
-  // remeber that the id of the last page is endPid()-1 not endPid().
-  if ((rc = pf.read(--erid.pid, page)) < 0) {
-    // an error occurred during page read
-    erid.pid = erid.sid = 0;
+  if ((rc = openColumns()) < 0) {
+    kpf.close();
     pf.close();
-    return rc;
+  }
+  return rc;
+}
+
+RC RecordFile::openColumns()
+{
+  // the key file is committed after the value file, so its end record
+  // id covers values that are on the disk
+  readCommitted(kpf);
+  return 0;
+}
+
+void RecordFile::readCommitted(const PageFile& f)
+{
+  char meta[PageFile::META_SIZE];
+
+  // a file that was never committed is empty, whatever pages it has.
+  // the records appended after the last commit may not have reached the
+  // disk whole, so they are dropped, and the next appends overwrite them.
+  erid.pid = erid.sid = 0;
+  if (f.readMeta(meta) == sizeof(RecordId)) memcpy(&erid, meta, sizeof(RecordId));
+  committed = erid;
+}
+
+RC RecordFile::openZones(const string& filename)
+{
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+  RecordId saved = { 0, 0 };
+
+  if ((rc = zpf.open(filename, 'w')) < 0) return rc;
+  zones = true;
+
+  // the zones are complete up to the end record id saved with them, as
+  // long as the table file has kept those records. zones saved at the
+  // end of the table were forced by the sync() that committed it, and
+  // are left as they are.
+  if (zpf.endPid() > 0 && (rc = zpf.read(0, page)) == 0) {
+    memcpy(&saved, page, sizeof(saved));
+    if (saved == erid) {
+      zonesSaved = saved;
+      zonesForced = true;
+      return 0;
+    }
+    if (saved > erid) saved = erid;
+  }
+  zonesSaved.pid = -1;
+  zonesSaved.sid = 0;
+  zonesForced = false;
+
+  // rebuild the other zones from the pages, starting with the page that
+  // was being filled when the zones were saved
+  for (PageId pid = saved.pid; rc == 0 && pid * RECORDS_PER_PAGE < erid.pid * RECORDS_PER_PAGE + erid.sid; pid++) {
+    if ((rc = pf.read(pid, page)) < 0) break;
+    int n = (pid == erid.pid) ? erid.sid : getRecordCount(page);
+    for (int i = 0; rc == 0 && i < n; i++) {
+      int key;
+      memcpy(&key, slotPtr(page, i), sizeof(int));
+      rc = writeZone(pid, key, i == 0);
+    }
   }
 
-  // get # records in the last page
-  erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
-    // the last page is full. advance the end record id to the next page.
-    erid.pid++;
-    erid.sid = 0;
+  if (rc == 0) rc = saveZones(false);
+  if (rc < 0) {
+    zpf.close();
+    zones = false;
   }
-  
+  return rc;
+}
+
+RC RecordFile::readZone(PageId pid, int& min, int& max) const
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+  int  zone[2];
+
+  if (!zones) return RC_INVALID_FILE_MODE;
+
+  PageId zid = 1 + pid / ZONES_PER_PAGE;
+  if (pid < 0 || zid >= zpf.endPid()) return RC_INVALID_PID;
+  if ((rc = zpf.read(zid, page)) < 0) return rc;
+
+  memcpy(zone, page + (pid % ZONES_PER_PAGE) * sizeof(zone), sizeof(zone));
+  min = zone[0];
+  max = zone[1];
+  return 0;
+}
+
+RC RecordFile::writeZone(PageId pid, int key, bool first)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+  int  zone[2];
+
+  PageId zid = 1 + pid / ZONES_PER_PAGE;
+  char*  ptr = page + (pid % ZONES_PER_PAGE) * sizeof(zone);
+  if (zid < zpf.endPid()) {
+    if ((rc = zpf.read(zid, page)) < 0) return rc;
+  } else {
+    memset(page, 0, PageFile::PAGE_SIZE);
+  }
+
+  memcpy(zone, ptr, sizeof(zone));
+  if (first) {
+    zone[0] = zone[1] = key;
+  } else if (key < zone[0]) {
+    zone[0] = key;
+  } else if (key > zone[1]) {
+    zone[1] = key;
+  } else {
+    return 0;
+  }
+  memcpy(ptr, zone, sizeof(zone));
+
+  return zpf.write(zid, page);
+}
+
+RC RecordFile::saveZones(bool force)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+
+  // the zones only change with the end record id, so they are on the
+  // disk if it is
+  RecordId end = endRid();
+  if (end == zonesSaved && (zonesForced || !force)) return 0;
+
+  // the zones reach the disk before the end record id that says they
+  // are complete
+  if ((rc = force ? zpf.sync() : zpf.flush()) < 0) return rc;
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  memcpy(page, &end, sizeof(end));
+  if ((rc = zpf.write(0, page)) < 0) return rc;
+
+  if ((rc = force ? zpf.sync() : zpf.flush()) < 0) return rc;
+  zonesSaved = end;
+  zonesForced = force;
   return 0;
 }
 
 RC RecordFile::close()
 {
+  RC rc = 0;
+
+  // commit the records appended since the last commit
+  if (erid != committed) rc = sync();
+
+  if (zones) {
+    saveZones(false);
+    zpf.close();
+    zones = false;
+  }
+
   erid.pid = 0;
   erid.sid = 0;
 
-  return pf.close();
+  if (columns) {
+    RC krc = kpf.close();
+    columns = false;
+    if (krc < 0 && rc == 0) rc = krc;
+  }
+  RC prc = pf.close();
+  return (rc < 0) ? rc : prc;
 }
 
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
@@ -170,33 +347,172 @@ RC RecordFile::read(const RecordId& rid, int& key, string& value) const
   char page[PageFile::PAGE_SIZE];
   
   // check whether the rid is in the valid range
-  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
+  RecordId end = endRid();
+  if (rid.pid < 0 || rid.pid > end.pid) return RC_INVALID_RID;
   if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
-  if (rid >= erid) return RC_INVALID_RID;
+  if (rid >= end) return RC_INVALID_RID;
+
+  if (columns) return readColumns(rid, key, value);
   
-  // read the page containing the record
+  // read the page containing the record.
+  // appends and removals write whole pages, so the copy is consistent
   if ((rc = pf.read(rid.pid, page)) < 0) return rc;
 
+  // skip the records that have been removed
+  if (isRemoved(page, rid.sid)) return RC_NO_SUCH_RECORD;
+
   // read the record from the slot in the page
   readSlot(page, rid.sid, key, value);
 
   return 0;
 }
 
+RC RecordFile::readBatch(AsyncIo& io, const RecordId* rids, int count, int* keys, string* values, RC* rcs) const
+{
+  std::vector<PageId> pids;
+  std::vector<char>   pages;
+  RC rc;
+
+  if (count == 0) return 0;
+
+  RecordId end = endRid();
+  for (int i = 0; i < count; i++) {
+    const RecordId& rid = rids[i];
+    if (rid.pid < 0 || rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE || rid >= end) return RC_INVALID_RID;
+  }
+
+  if (columns) {
+    for (int i = 0; i < count; i++) {
+      if ((rc = readColumns(rids[i], keys[i], values[i])) < 0 && rc != RC_NO_SUCH_RECORD) return rc;
+      rcs[i] = (rc == RC_NO_SUCH_RECORD) ? rc : 0;
+    }
+    return 0;
+  }
+
+  // read each page of the records once
+  for (int i = 0; i < count; i++) pids.push_back(rids[i].pid);
+  std::sort(pids.begin(), pids.end());
+  pids.erase(std::unique(pids.begin(), pids.end()), pids.end());
+  pages.resize(pids.size() * PageFile::PAGE_SIZE);
+  if ((rc = pf.readPages(io, &pids[0], pids.size(), &pages[0])) < 0) return rc;
+
+  for (int i = 0; i < count; i++) {
+    int n = std::lower_bound(pids.begin(), pids.end(), rids[i].pid) - pids.begin();
+    const char* page = &pages[n * PageFile::PAGE_SIZE];
+    rcs[i] = isRemoved(page, rids[i].sid) ? RC_NO_SUCH_RECORD : 0;
+    if (rcs[i] == 0) readSlot(page, rids[i].sid, keys[i], values[i]);
+  }
+
+  return 0;
+}
+
+RC RecordFile::readKeys(PageId pid, const RecordId& upTo, int* keys, int& count) const
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+
+  count = 0;
+
+  RecordId end = endRid();
+  if (upTo < end) end = upTo;
+  if (pid < 0 || pid > end.pid) return RC_INVALID_PID;
+  if (pid == end.pid && end.sid == 0) return 0;
+
+  if (columns) {
+    // the keys of a row page are all in one block
+    KeyBlock b;
+    int first = pid * RECORDS_PER_PAGE;
+    if ((rc = readKeyBlock(first / KEYS_PER_BLOCK, b)) < 0) return rc;
+
+    int n = (pid == end.pid) ? end.sid : RECORDS_PER_PAGE;
+    for (int i = first % KEYS_PER_BLOCK; i < first % KEYS_PER_BLOCK + n; i++) {
+      if (!((b.removed[i / 8] >> (i % 8)) & 1)) keys[count++] = b.keys[i];
+    }
+    return 0;
+  }
+
+  if ((rc = pf.read(pid, page)) < 0) return rc;
+
+  // the last page may be partially filled
+  int n = (pid == end.pid) ? end.sid : getRecordCount(page);
+  for (int i = 0; i < n; i++) {
+    if (isRemoved(page, i)) continue;
+    memcpy(&keys[count++], slotPtr(page, i), sizeof(int));
+  }
+
+  return 0;
+}
+
+RC RecordFile::readKeyBlock(int block, KeyBlock& b) const
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+
+  if (!columns) return RC_INVALID_FILE_MODE;
+  if ((rc = kpf.read(block, page)) < 0) return rc;
+
+  memcpy(&b, page, sizeof(KeyBlock));
+  return 0;
+}
+
+int RecordFile::blockCount() const
+{
+  RecordId end = endRid();
+  return (end.pid * RECORDS_PER_PAGE + end.sid + KEYS_PER_BLOCK - 1) / KEYS_PER_BLOCK;
+}
+
+RC RecordFile::readColumns(const RecordId& rid, int& key, string& value) const
+{
+  KeyBlock b;
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+
+  int i = recordIndex(rid);
+  if ((rc = readKeyBlock(i / KEYS_PER_BLOCK, b)) < 0) return rc;
+
+  int n = i % KEYS_PER_BLOCK;
+  if ((b.removed[n / 8] >> (n % 8)) & 1) return RC_NO_SUCH_RECORD;
+  key = b.keys[n];
+
+  // the value is read only for a record that is still there
+  if ((rc = pf.read(i / VALUES_PER_PAGE, page)) < 0) return rc;
+  value.assign(page + (i % VALUES_PER_PAGE) * MAX_VALUE_LENGTH);
+
+  return 0;
+}
+
 RC RecordFile::append(int key, const std::string& value, RecordId& rid)
 {
   RC   rc;
   char page[PageFile::PAGE_SIZE];
 
+  pthread_mutex_lock(&lock);
+
+  if (columns) {
+    if ((rc = appendColumns(key, value)) == 0) rid = erid++;
+    pthread_mutex_unlock(&lock);
+    return rc;
+  }
+
   // unless we are writing to the the first slot of an empty page,
   // we have to read the page first
   if (erid.sid > 0) {
-    if ((rc = pf.read(erid.pid, page)) < 0) return rc;
+    if ((rc = pf.read(erid.pid, page)) < 0) {
+      pthread_mutex_unlock(&lock);
+      return rc;
+    }
   } else {
     // if this is the first slot of an empty page
     // we can simply initialize the page with zeros
     memset(page, 0, PageFile::PAGE_SIZE);
   }
+
+  // widen the zone of the page first: a zone may cover a key that never
+  // reached the page, but not miss one that did
+  if (zones && (rc = writeZone(erid.pid, key, erid.sid == 0)) < 0) {
+    pthread_mutex_unlock(&lock);
+    return rc;
+  }
     
   // write the record to the first empty slot 
   writeSlot(page, erid.sid, key, value);
@@ -206,7 +522,10 @@ RC RecordFile::append(int key, const std::string& value, RecordId& rid)
   setRecordCount(page, erid.sid + 1);
 
   // write the page to the disk
-  if ((rc = pf.write(erid.pid, page)) < 0) return rc;
+  if ((rc = pf.write(erid.pid, page)) < 0) {
+    pthread_mutex_unlock(&lock);
+    return rc;
+  }
     
   // we need to output the rid of the record slot
   rid = erid;
@@ -214,12 +533,135 @@ RC RecordFile::append(int key, const std::string& value, RecordId& rid)
   // advance the end record id by one to the next empty slot
   ++erid;
 
+  pthread_mutex_unlock(&lock);
   return 0;
 }
 
-const RecordId& RecordFile::endRid() const
+RC RecordFile::appendColumns(int key, const string& value)
 {
-  return erid;
+  KeyBlock b;
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+
+  int i = recordIndex(erid);
+  int n = i % KEYS_PER_BLOCK;
+  int v = i % VALUES_PER_PAGE;
+
+  // write the value first, so that a key in the key file always has a
+  // value even if the second write does not happen
+  if (v > 0) {
+    if ((rc = pf.read(i / VALUES_PER_PAGE, page)) < 0) return rc;
+  } else {
+    memset(page, 0, PageFile::PAGE_SIZE);
+  }
+  char* ptr = page + v * MAX_VALUE_LENGTH;
+  strncpy(ptr, value.c_str(), MAX_VALUE_LENGTH - 1);
+  ptr[MAX_VALUE_LENGTH - 1] = 0;
+  if ((rc = pf.write(i / VALUES_PER_PAGE, page)) < 0) return rc;
+
+  if (n > 0) {
+    if ((rc = readKeyBlock(i / KEYS_PER_BLOCK, b)) < 0) return rc;
+    b.min = std::min(b.min, key);
+    b.max = std::max(b.max, key);
+  } else {
+    memset(&b, 0, sizeof(b));
+    b.min = b.max = key;
+  }
+  b.keys[n] = key;
+  b.count = n + 1;
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  memcpy(page, &b, sizeof(b));
+  return kpf.write(i / KEYS_PER_BLOCK, page);
+}
+
+RC RecordFile::removeColumns(const RecordId& rid)
+{
+  KeyBlock b;
+  RC       rc;
+  char     page[PageFile::PAGE_SIZE];
+
+  // only the key file marks removed records. min and max are kept, since
+  // they only have to bound the keys of the block.
+  int i = recordIndex(rid);
+  int n = i % KEYS_PER_BLOCK;
+  if ((rc = readKeyBlock(i / KEYS_PER_BLOCK, b)) < 0) return rc;
+  if ((b.removed[n / 8] >> (n % 8)) & 1) return 0;
+
+  b.removed[n / 8] |= 1 << (n % 8);
+  memset(page, 0, PageFile::PAGE_SIZE);
+  memcpy(page, &b, sizeof(b));
+  return kpf.write(i / KEYS_PER_BLOCK, page);
+}
+
+RC RecordFile::remove(const RecordId& rid)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+
+  // check whether the rid is in the valid range
+  if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
+
+  pthread_mutex_lock(&lock);
+  if (rid.pid < 0 || rid >= erid) {
+    pthread_mutex_unlock(&lock);
+    return RC_INVALID_RID;
+  }
+
+  // read the page containing the record, mark the slot as removed and
+  // write the page back (nothing to do if the record is already gone)
+  if (columns) {
+    rc = removeColumns(rid);
+  } else if ((rc = pf.read(rid.pid, page)) == 0 && !isRemoved(page, rid.sid)) {
+    setRemoved(page, rid.sid);
+    rc = pf.write(rid.pid, page);
+  }
+
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+RC RecordFile::flush()
+{
+  RC rc;
+
+  if (columns && (rc = kpf.flush()) < 0) return rc;
+  if ((rc = pf.flush()) < 0) return rc;
+  if (zones) return saveZones(false);
+  return 0;
+}
+
+RC RecordFile::sync()
+{
+  RC       rc;
+  RecordId end = endRid();
+
+  // the pages are forced before the end record id that covers their
+  // records, and the values before the keys that refer to them
+  if (columns) {
+    if ((rc = pf.sync()) < 0) return rc;
+    rc = kpf.commit(&end, sizeof(end));
+  } else {
+    rc = pf.commit(&end, sizeof(end));
+  }
+  if (rc < 0) return rc;
+  committed = end;
+
+  if (zones) return saveZones(true);
+  return 0;
+}
+
+RecordId RecordFile::endRid() const
+{
+  pthread_mutex_lock(&lock);
+  RecordId end = erid;
+  pthread_mutex_unlock(&lock);
+  return end;
+}
+
+static int recordIndex(const RecordId& rid)
+{
+  return rid.pid * RecordFile::RECORDS_PER_PAGE + rid.sid;
 }
 
 static int getRecordCount(const char* page)
@@ -237,6 +679,26 @@ static void setRecordCount(char* page, int count)
   memcpy(page, &count, sizeof(int));
 }
 
+static bool isRemoved(const char* page, int n)
+{
+  int bitmap;
+
+  // the removed-slot bitmap follows the last slot of the page.
+  // pages written before removal was supported have zeros there.
+  memcpy(&bitmap, page + sizeof(int) + (sizeof(int)+RecordFile::MAX_VALUE_LENGTH)*RecordFile::RECORDS_PER_PAGE, sizeof(int));
+  return (bitmap >> n) & 1;
+}
+
+static void setRemoved(char* page, int n)
+{
+  int bitmap;
+  char* ptr = page + sizeof(int) + (sizeof(int)+RecordFile::MAX_VALUE_LENGTH)*RecordFile::RECORDS_PER_PAGE;
+
+  memcpy(&bitmap, ptr, sizeof(int));
+  bitmap |= (1 << n);
+  memcpy(ptr, &bitmap, sizeof(int));
+}
+
 static char* slotPtr(char* page, int n) 
 {
   // compute the location of the n'th slot in a page.
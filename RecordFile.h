@@ -11,6 +11,7 @@
 #define RECORDFILE_H
 
 #include <string>
+#include <pthread.h>
 #include "PageFile.h"
 
 /**
@@ -39,7 +40,12 @@ bool operator== (const RecordId& r1, const RecordId& r2);
 bool operator!= (const RecordId& r1, const RecordId& r2);
 
 /**
- * read/write a record to a file
+ * read/write a record to a file.
+ * a file stores its records either by rows, each (key, value) pair in one
+ * slot of a page, or by columns, the keys packed in one file and the
+ * values in another, so that the keys can be read without the values.
+ * a record has the same RecordId in both layouts.
+ * all operations may be called by several threads at the same time.
  */
 class RecordFile {
  public:
@@ -51,9 +57,35 @@ class RecordFile {
   static const int RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int))/ (sizeof(int) + MAX_VALUE_LENGTH);  
     // Note that we subtract sizeof(int) from PAGE_SIZE because the first
     // four bytes in the page is used to store # records in the page.
+    // The bitmap of removed slots is stored in the unused space that
+    // follows the last slot.
+
+  // number of keys per page of the key file of a file stored by columns:
+  // as many whole row pages as fit with a bit each for the removed bitmap
+  static const int KEYS_PER_BLOCK = (PageFile::PAGE_SIZE - 3 * sizeof(int)) * 8 / (8 * sizeof(int) + 1) / RECORDS_PER_PAGE * RECORDS_PER_PAGE;
+
+  // number of values per page of the value file of a file stored by columns
+  static const int VALUES_PER_PAGE = PageFile::PAGE_SIZE / MAX_VALUE_LENGTH;
+
+  // number of (smallest key, largest key) pairs per page of a zone map
+  static const int ZONES_PER_PAGE = PageFile::PAGE_SIZE / (2 * sizeof(int));
+
+  /**
+   * a page of the key file of a file stored by columns: the keys of
+   * KEYS_PER_BLOCK consecutive records, starting at the record with RecordId
+   * (block * KEYS_PER_BLOCK / RECORDS_PER_PAGE, 0)
+   */
+  struct KeyBlock {
+    int           count;  // the records in the block
+    int           min;    // the smallest key ever appended to the block
+    int           max;    // the largest key ever appended to the block
+    int           keys[KEYS_PER_BLOCK];
+    unsigned char removed[(KEYS_PER_BLOCK + 7) / 8];  // bit i is set if record i was removed
+  };
 
   RecordFile();
   RecordFile(const std::string& filename, char mode);
+  ~RecordFile();
   
   /**
    * open a file in read or write mode.
@@ -65,7 +97,50 @@ class RecordFile {
   RC open(const std::string& filename, char mode);
 
   /**
-   * close the file.
+   * open a file stored by columns in read or write mode.
+   * when opened in 'w' mode, the files that do not exist are created.
+   * @param keyFile[IN] the name of the file of the keys
+   * @param valueFile[IN] the name of the file of the values
+   * @param mode[IN] 'r' for read, 'w' for write
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& keyFile, const std::string& valueFile, char mode);
+
+  /**
+   * @return whether the file is stored by columns
+   */
+  bool hasColumns() const { return columns; }
+
+  /**
+   * keep the smallest and largest key of each page of a file stored by
+   * rows in a zone map file, which append() keeps up to date. the zones
+   * of the pages appended since the zone map was last saved by flush(),
+   * sync() or close() are rebuilt from the pages, so a new zone map
+   * reads the whole file once. a zone map saved at the end of the file
+   * is neither rebuilt nor written.
+   * @param filename[IN] the name of the zone map file
+   * @return error code. 0 if no error
+   */
+  RC openZones(const std::string& filename);
+
+  /**
+   * @return whether the file has a zone map
+   */
+  bool hasZones() const { return zones; }
+
+  /**
+   * read the zone of a page: no key that was ever appended to the page is
+   * smaller than min or larger than max.
+   * @param pid[IN] the page
+   * @param min[OUT] the smallest key of the page
+   * @param max[OUT] the largest key of the page
+   * @return error code. 0 if no error, RC_INVALID_FILE_MODE if the file
+   *         has no zone map
+   */
+  RC readZone(PageId pid, int& min, int& max) const;
+
+  /**
+   * close the file, committing the records appended since the last sync().
    * @return error code. 0 if no error
    */
   RC close();
@@ -75,10 +150,55 @@ class RecordFile {
    * @param rid[IN] the id of the record to read
    * @param key[OUT] the record key
    * @param value[OUT] the record valu
-   * @return error code. 0 if no error
+   * @return error code. 0 if no error, RC_NO_SUCH_RECORD if the record
+   *         has been removed
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * read a set of records, with the reads of their pages in flight
+   * together (see PageFile::readPages()). each page is read once,
+   * however many of the records it holds. the records of a file stored
+   * by columns are read one by one.
+   * @param io[IN] the reads in flight of the calling thread
+   * @param rids[IN] the ids of the records to read
+   * @param count[IN] the number of records
+   * @param keys[OUT] the record keys, count of them
+   * @param values[OUT] the record values, count of them
+   * @param rcs[OUT] for each record, 0 or RC_NO_SUCH_RECORD if it has
+   *                 been removed
+   * @return error code. 0 if no error
+   */
+  RC readBatch(AsyncIo& io, const RecordId* rids, int count, int* keys, std::string* values, RC* rcs) const;
+
+  /**
+   * read the keys of the records in a page that have not been removed.
+   * the values are not copied, which makes this much cheaper than
+   * calling read() for every slot of the page.
+   * @param pid[IN] the page to read
+   * @param end[IN] the records from end on are left out, such as those
+   *        appended after a scan started
+   * @param keys[OUT] the keys; must have room for RECORDS_PER_PAGE keys
+   * @param count[OUT] the number of keys stored in keys
+   * @return error code. 0 if no error
+   */
+  RC readKeys(PageId pid, const RecordId& end, int* keys, int& count) const;
+
+  /**
+   * read a block of keys of a file stored by columns. only one page of
+   * the key file is read.
+   * @param block[IN] the block to read. the first block is 0
+   * @param b[OUT] the keys of the block
+   * @return error code. 0 if no error, RC_INVALID_FILE_MODE if the file
+   *         is stored by rows
+   */
+  RC readKeyBlock(int block, KeyBlock& b) const;
+
+  /**
+   * @return the number of blocks of a file stored by columns
+   */
+  int blockCount() const;
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -90,15 +210,71 @@ class RecordFile {
    */
   RC append(int key, const std::string& value, RecordId& rid);
 
+  /**
+   * remove the record from the file.
+   * the slot is marked as deleted in the page and is not reused.
+   * removing an already removed record is not an error.
+   * @param rid[IN] the id of the record to remove
+   * @return error code. 0 if no error
+   */
+  RC remove(const RecordId& rid);
+
+  /**
+   * write the dirty pages of the file back to the disk.
+   * @return error code. 0 if no error
+   */
+  RC flush();
+
+  /**
+   * write the dirty pages of the file back and force them to the disk,
+   * then commit the end record id. when the file is opened again, only
+   * the records appended before the last commit are in it; close()
+   * commits the file as well.
+   * @return error code. 0 if no error
+   */
+  RC sync();
+
   /**
    * note the +1 part. The rid of the last record is endRid()-1.
    * @return (last record id + 1) of the RecordFile
    */
-  const RecordId& endRid() const;
+  RecordId endRid() const;
 
  private:
-  PageFile pf;     // the PageFile used to store the records
+  RecordFile(const RecordFile&);             // not copyable: owns the mutex
+  RecordFile& operator=(const RecordFile&);
+
+  PageFile pf;     // the PageFile used to store the records, or the values
+                   // when stored by columns
+  PageFile kpf;    // the PageFile of the keys when stored by columns
+  bool     columns;  // whether the file is stored by columns
+  PageFile zpf;    // the zone map of a file stored by rows. page 0 holds
+                   // the end record id when the zones were last saved
+  bool     zones;  // whether the file has a zone map
+  RecordId zonesSaved;   // the end record id in page 0 of the zone map
+  bool     zonesForced;  // whether that page was forced to the disk
   RecordId erid;   // the last record id of the file + 1
+  RecordId committed;  // erid when the file was last committed by sync()
+
+  // the parts of open(), read(), append() and remove() for a file stored
+  // by columns
+  RC openColumns();
+  RC readColumns(const RecordId& rid, int& key, std::string& value) const;
+  RC appendColumns(int key, const std::string& value);
+  RC removeColumns(const RecordId& rid);
+
+  // set erid and committed to the end record id committed to a page file
+  void readCommitted(const PageFile& f);
+
+  // widen the zone of a page to a key, or start it with the key
+  RC writeZone(PageId pid, int key, bool first);
+
+  // write the end record id to the zone map, after all zones up to it,
+  // unless it is there already
+  RC saveZones(bool force);
+
+  // protects erid and serializes the updates of pages
+  mutable pthread_mutex_t lock;
 };
 
 #endif // RECORDFILE_H
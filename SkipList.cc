@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include "SkipList.h"
+
+// the bytes of a node with height levels of links
+static size_t nodeSize(int height)
+{
+  return sizeof(SkipList::Node) + (height - 1) * sizeof(SkipList::Node*);
+}
+
+SkipList::SkipList()
+{
+  head = (Node*) arena.allocate(nodeSize(MAX_HEIGHT));
+  memset(head, 0, nodeSize(MAX_HEIGHT));
+  height = 1;
+  count = 0;
+  state = 2463534242U;
+}
+
+bool SkipList::before(const Node* node, int key, const RecordId& rid)
+{
+  return node->key < key || (node->key == key && node->rid < rid);
+}
+
+int SkipList::randomHeight()
+{
+  int h = 1;
+
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  for (unsigned bits = state; h < MAX_HEIGHT && (bits & 3) == 0; bits >>= 2) h++;
+  return h;
+}
+
+void SkipList::put(int key, const RecordId& rid, bool removed)
+{
+  Node* prev[MAX_HEIGHT];
+  Node* x = head;
+
+  // the last node before the pair at each level
+  for (int i = height - 1; i >= 0; i--) {
+    while (x->next[i] != NULL && before(x->next[i], key, rid)) x = x->next[i];
+    prev[i] = x;
+  }
+
+  x = x->next[0];
+  if (x != NULL && x->key == key && x->rid == rid) {
+    x->removed = removed;
+    return;
+  }
+
+  int h = randomHeight();
+  for (; height < h; height++) prev[height] = head;
+
+  x = (Node*) arena.allocate(nodeSize(h));
+  x->key = key;
+  x->rid = rid;
+  x->removed = removed;
+  for (int i = 0; i < h; i++) {
+    x->next[i] = prev[i]->next[i];
+    prev[i]->next[i] = x;
+  }
+  count++;
+}
+
+const SkipList::Node* SkipList::seek(int key) const
+{
+  const Node* x = head;
+
+  for (int i = height - 1; i >= 0; i--) {
+    while (x->next[i] != NULL && x->next[i]->key < key) x = x->next[i];
+  }
+  return x->next[0];
+}
+
+const SkipList::Node* SkipList::seekLast(int key) const
+{
+  const Node* x = head;
+
+  for (int i = height - 1; i >= 0; i--) {
+    while (x->next[i] != NULL && x->next[i]->key <= key) x = x->next[i];
+  }
+  return (x == head) ? NULL : x;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "Arena.h"
+
+/**
+ * The memtable of a log-structured index: the (key, RecordId) pairs added
+ * to the index since it was last written to the disk, in (key, RecordId)
+ * order. Each pair is kept once, with whether it was last added or
+ * removed. The nodes are placed in an arena and freed all at once when
+ * the list is destroyed.
+ * The list does no locking: the caller keeps readers out while a pair is
+ * put into it.
+ */
+class SkipList {
+ public:
+  static const int MAX_HEIGHT = 16;  // the most levels of links of a node
+
+  /**
+   * a pair in the list
+   */
+  struct Node {
+    int      key;
+    RecordId rid;
+    bool     removed;  // whether the pair was last removed from the index
+    Node*    next[1];  // the next node at each level; height entries long
+  };
+
+  SkipList();
+
+  /**
+   * add a pair, or set whether it is removed if the list has it.
+   * @param key[IN] the key of the pair
+   * @param rid[IN] the RecordId of the pair
+   * @param removed[IN] whether the pair is removed from the index
+   */
+  void put(int key, const RecordId& rid, bool removed);
+
+  /**
+   * @return the number of pairs in the list
+   */
+  int size() const { return count; }
+
+  /**
+   * find the first pair whose key is larger than or equal to key.
+   * @param key[IN] the key to find
+   * @return the node of the pair, NULL if there is none
+   */
+  const Node* seek(int key) const;
+
+  /**
+   * find the last pair whose key is smaller than or equal to key.
+   * @param key[IN] the key to find
+   * @return the node of the pair, NULL if there is none
+   */
+  const Node* seekLast(int key) const;
+
+  /**
+   * @param node[IN] a node of the list
+   * @return the node of the next pair, NULL after the last one
+   */
+  static const Node* next(const Node* node) { return node->next[0]; }
+
+ private:
+  SkipList(const SkipList&);             // not copyable: owns the arena
+  SkipList& operator=(const SkipList&);
+
+  /**
+   * whether the pair of node comes before (key, rid)
+   */
+  static bool before(const Node* node, int key, const RecordId& rid);
+
+  /**
+   * draw the height of a new node: each level is kept with probability 1/4.
+   */
+  int randomHeight();
+
+  Arena    arena;               // the memory of the nodes
+  Node*    head;                // the node before the first pair, MAX_HEIGHT high
+  int      height;              // the levels in use
+  int      count;               // the number of pairs
+  unsigned state;               // the state of the random heights (xorshift)
+};
+
+#endif // SKIPLIST_H
@@ -8,289 +8,3396 @@
  */
 
 #include <cstdio>
+#include <cstring>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <algorithm>
+#include <climits>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "Bruinbase.h"
 #include "SqlEngine.h"
 #include "BTreeIndex.h"
+#include "BTreeNode.h"
+#include "LogFile.h"
+#include "ThreadPool.h"
+#include "HashAggregate.h"
+#include "HashJoin.h"
+#include "ExternalSort.h"
+#include "BloomFilter.h"
+#include "TableStats.h"
+#include "QueryPlan.h"
+#include "IoStats.h"
+#include "Catalog.h"
+#include "AsyncIo.h"
 
 using namespace std;
 
-// external functions and variables for load file and sql command parsing 
-extern FILE* sqlin;
-int sqlparse(void);
+// external functions for sql command parsing. the scanner and the parser
+// are reentrant: each parse keeps its state in its own scanner.
+int  sqllex_init(void** scanner);
+int  sqllex_destroy(void* scanner);
+void sqlset_in(FILE* in, void* scanner);
+struct yy_buffer_state* sql_scan_string(const char* str, void* scanner);
+int  sqlparse(void* scanner, SqlSession* session);
+
+//
+// tables are opened on first use and shared by all sessions, so that
+// their pages stay cached and their index latches are shared. changes
+// by INSERT and DELETE are written back lazily; only the log is forced
+// per change.
+//
+struct TableHandle {
+  string           name;     // the table name
+  pthread_rwlock_t latch;    // shared by statements, exclusive to open and close
+  pthread_mutex_t  lock;     // serializes INSERTs and DELETEs
+  bool             isOpen;   // whether the files below are open
+  RecordFile       rf;       // the table file
+  RecordId         visible;  // the end of rf that statements see, by visibleEnd()
+  BTreeIndex       idx;      // the index on key, if hasIndex
+  bool             hasIndex; // whether the table has an index
+  LogFile          log;      // the write-ahead log, opened by the first change
+  bool             logOpen;  // whether log is open
+  BloomFilter      bloom;    // the Bloom filters on key and value, if LOAD built them
+  TableStats       stats;    // the statistics of the table, if it was analyzed
+};
+
+//
+// a prepared SELECT statement. it refers to the shared handle of its
+// table, which lives until shutdown().
+//
+struct PreparedSelect {
+  int             attr;    // attribute in the SELECT clause
+  TableHandle*    table;   // the table in the FROM clause
+  WhereClause     where;   // the WHERE clause; placeholders have NULL values
+  SelOrder        order;   // the ORDER BY and LIMIT clauses
+  unsigned        params;  // the number of placeholders
+};
+
+static map<string, TableHandle*> tables;
+static pthread_mutex_t tablesLock = PTHREAD_MUTEX_INITIALIZER;
+
+// how the tables were stored when they were last closed. it is read when
+// the first table is used and written by shutdown() and LOAD.
+static Catalog catalog;
+static bool    catalogLoaded = false;  // protected by tablesLock
+static const char* CATALOG_FILE = "bruinbase.catalog";
+
+// the log is emptied by a checkpoint once it grows beyond this size
+static const long CHECKPOINT_LOG_SIZE = 1024 * 1024;
+
+// the workers that read the parts of a table for a parallel scan. they
+// are started by the first large scan and stopped by shutdown().
+static ThreadPool scanPool;
+static pthread_mutex_t scanPoolLock = PTHREAD_MUTEX_INITIALIZER;
+
+// a table is split into parts of at least this many tuples for a
+// parallel scan
+static const int PART_TUPLES = 2048;
+
+// the memory of the hash tables of a GROUP BY before they spill to
+// temporary files
+static const size_t GROUP_MEMORY = 16 * 1024 * 1024;
+
+// the memory of the hash table of a hash join before both tables are
+// partitioned to temporary files
+static const size_t JOIN_MEMORY = 16 * 1024 * 1024;
+
+// the estimated bytes of a tuple in the hash table of a hash join
+static const int JOIN_TUPLE_BYTES = 64;
+
+// the most index entries of one table of a merge join whose tuples are
+// read from the table file together, in RecordId order
+static const int MERGE_BATCH = 16384;
+
+// the most tuples of an index scan whose reads are in flight together.
+// the first batch of a scan holds one tuple and the batches double, so
+// that a LIMIT reads few more tuples than it returns.
+static const int FETCH_BATCH = 256;
+
+// the memory of the buffers of a sort before they are written to
+// temporary files as sorted runs
+static const size_t SORT_MEMORY = 16 * 1024 * 1024;
+
+// look up the handle of a table, adding a closed one if there is none
+static TableHandle* getTable(const string& table);
+
+// open a table for a statement and hold its latch shared until
+// releaseTable(). the table file is created if create is true.
+static RC openTable(const string& table, bool create, TableHandle*& t);
+
+// like openTable() for a handle that was looked up before
+static RC acquireTable(TableHandle* t, bool create);
+
+// release a table opened by openTable()
+static void releaseTable(TableHandle* t);
+
+// the end of the table file that statements see. a statement reads the
+// table up to the end it sees when it starts (its snapshot), so tuples
+// that an INSERT or a LOAD is still adding are not seen.
+static RecordId visibleEnd(TableHandle* t);
+
+// let statements see the tuples appended to the table file so far. the
+// caller must hold t->lock or the table latch exclusively.
+static void publishEnd(TableHandle* t);
+
+// check whether the files of a table exist
+static bool tableExists(const string& table);
+
+// open the table file of a table in 'w' mode. a table is stored by
+// columns if it has a key file or, when it is new, if columns is true.
+static RC openRecords(RecordFile& rf, const string& table, bool columns);
+
+// open the files of a table, recovering it if a crash left a log behind.
+// a new table is stored by columns if columns is true.
+// the caller must hold the table latch exclusively.
+static RC openTableFiles(TableHandle* t, bool columns);
+
+// checkpoint and close the files of a table.
+// the caller must hold the table latch exclusively.
+static RC closeTableFiles(TableHandle* t);
+
+// open the log of a table. the caller must hold t->lock or the table
+// latch exclusively.
+static RC openLog(TableHandle* t);
+
+// redo the changes in the log of a freshly opened table
+static RC replayLog(TableHandle* t);
+
+// bring the index of a table up to its table file, when the last commit
+// of the index did not cover it: add the tuples after the end of the
+// table committed with the index, or build the index again if its nodes
+// were updated in place since (the loading flag of older versions of
+// LOAD). the caller must hold the table latch exclusively, or t->lock
+// when the index was committed by this run.
+static RC recoverIndex(TableHandle* t);
+
+// build the index of an open table again from its table file
+static RC rebuildIndex(TableHandle* t);
+
+// force the table and index to disk, save the Bloom filters and empty
+// the log
+static RC checkpoint(TableHandle* t);
+
+// load the Bloom filters of a table and add the tuples appended after
+// they were saved. a table whose filters cannot be loaded has none.
+static void openBloom(TableHandle* t);
+
+// build the Bloom filters of a table after LOAD appended the tuples
+// from start on, whose hashes are in hashes (key, value, key, ...)
+static RC loadBloom(RecordFile& rf, const string& table, const RecordId& start, const vector<unsigned long long>& hashes);
+
+// check the Bloom filters of a table for a WHERE clause. false if no
+// tuple can satisfy it: each conjunction asks for a key or a value that
+// is not in the table.
+static bool mayMatch(TableHandle* t, const WhereClause& where);
+
+// check whether the index contains the (key, rid) pair
+static bool indexContains(BTreeIndex& idx, int key, const RecordId& rid);
+
+// called by scanTable() for each tuple that satisfies the WHERE clause.
+// returns false to stop the scan.
+typedef bool (*TupleVisitor)(void* arg, int key, const string& value, const RecordId& rid);
+
+// an inclusive range of keys to read from an index
+struct KeyRange {
+  int lo;  // the smallest key
+  int hi;  // the largest key
+};
+
+// flags of scanTable()
+static const int SCAN_BACKWARD  = 1;  // read the index in descending key order
+static const int SCAN_KEYS      = 2;  // visit() does not use the tuple value
+static const int SCAN_ANY_ORDER = 4;  // the tuples may come in any order
+
+// pass the tuples of a table that satisfy the WHERE clause to visit().
+// the index, if any, is read once over the key ranges of the clause, in
+// ascending key order or, with SCAN_BACKWARD, in descending key order.
+// with SCAN_KEYS and a clause without value conditions, the tuples are
+// not read from the table file and visit() gets an empty value. with
+// SCAN_ANY_ORDER, the table file is read instead of the index when the
+// statistics of the table say that it takes fewer page reads.
+static RC scanTable(TableHandle* t, const WhereClause& where, int flags, TupleVisitor visit, void* arg);
+
+// the ways scanTable() reads a table
+enum ScanMethod {
+  NO_SCAN,      // the Bloom filters rule out every tuple
+  INDEX_SCAN,   // the key ranges are read from the index
+  ROW_SCAN,     // the table file is read by rows
+  COLUMN_SCAN   // the table file is read by columns
+};
+
+// the way scanTable() reads the tuples of a table that satisfy the WHERE
+// clause with the given flags
+static ScanMethod scanMethod(TableHandle* t, const WhereClause& where, int flags);
+
+// describe the way scanTable() reads a table, for EXPLAIN
+static string scanName(TableHandle* t, const WhereClause& where, int flags);
+
+// scanTable() over the given key ranges of the index of a table. the
+// entries of tuples from end on are left out.
+static RC scanIndex(TableHandle* t, const vector<KeyRange>& ranges, const RecordId& end, const WhereClause& where, int flags, TupleVisitor visit, void* arg);
+
+// the tuples of an index scan that are read from the table file together
+struct FetchBatch {
+  vector<RecordId> rids;    // the tuples to read, in the order of the index
+  vector<int>      keys;
+  vector<string>   values;
+  vector<RC>       rcs;     // RC_NO_SUCH_RECORD for the deleted tuples
+  size_t           limit;   // the batch is read once it has this many tuples
+};
+
+// read the tuples of a batch and pass those that satisfy the WHERE clause
+// to visit(), in the order of the index. more is set to false if visit()
+// stops the scan.
+static RC fetchTuples(TableHandle* t, FetchBatch& batch, const WhereClause& where, TupleVisitor visit, void* arg, bool& more);
+
+// read the tuple at rid and pass it to visit() if it satisfies the WHERE
+// clause. more is set to false if visit() stops the scan.
+static RC visitTuple(TableHandle* t, const RecordId& rid, const WhereClause& where, TupleVisitor visit, void* arg, bool& more);
+
+// compute the sorted, disjoint key ranges that hold every key that can
+// satisfy the WHERE clause
+static void keyRanges(const WhereClause& where, vector<KeyRange>& ranges);
+
+// order key ranges by their smallest key
+static bool rangeBefore(const KeyRange& a, const KeyRange& b);
+
+// compute the key ranges that hold the keys in both sets of sorted,
+// disjoint key ranges
+static void intersectRanges(const vector<KeyRange>& a, const vector<KeyRange>& b, vector<KeyRange>& ranges);
+
+// check whether the WHERE clause has no condition on value
+static bool keysOnly(const WhereClause& where);
+
+// collect the value fields of all conditions from left to right
+static void valueSlots(WhereClause& where, vector<char**>& slots);
+
+// check whether a condition has a ? placeholder instead of a value
+static bool hasPlaceholder(const WhereClause& where);
+
+// check whether the tuple satisfies the WHERE clause
+static bool matchWhere(int key, const string& value, const WhereClause& where);
+
+// check whether the tuple satisfies all conditions
+static bool matchConditions(int key, const string& value, const vector<SelCond>& cond);
+
+// check whether the tuple satisfies a condition
+static bool matchCondition(const SelCond& cond, int key, const string& value);
+
+// check whether the keys in the ranges of keyRanges() are exactly the
+// keys that satisfy the WHERE clause
+static bool rangesExact(const WhereClause& where);
+
+// scanTable() over the pages from first up to last of a table without an
+// index that is stored by rows, up to the tuple at end. the pages whose
+// zone holds no key in the key ranges are not read.
+static RC scanRows(TableHandle* t, PageId first, PageId last, const RecordId& end, const WhereClause& where, TupleVisitor visit, void* arg);
+
+// check whether a key from lo to hi can be in one of the sorted ranges
+static bool rangesOverlap(const vector<KeyRange>& ranges, int lo, int hi);
+
+// scanTable() over the records from page first up to page last of a
+// table without an index that is stored by columns, up to the tuple at
+// end. only the key file is read for the blocks whose keys are all
+// outside the key ranges.
+static RC scanColumns(TableHandle* t, PageId first, PageId last, const RecordId& end, const WhereClause& where, int flags, TupleVisitor visit, void* arg);
+
+// set the bits of match for the records of a block that are not removed
+// and whose key is in one of the ranges.
+// @return whether any bit is set
+static bool matchKeys(const RecordFile::KeyBlock& b, const vector<KeyRange>& ranges, unsigned char* match);
+
+// run a SELECT on a table opened by the caller
+static RC runSelect(SqlSession& session, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order);
+
+// read the tuples of a table that satisfy the WHERE clause through an
+// external sort, in the order of ORDER BY or, without it, of the
+// attribute in the SELECT clause. a profiled plan gets the work of the
+// sort and of the scan charged to the operators sortNode and scanNode.
+static RC sortTable(TableHandle* t, const WhereClause& where, int attr, const SelOrder& order, TupleVisitor visit, void* arg, QueryPlan* plan, int sortNode, int scanNode);
+
+// the names of the attributes in the SELECT clause, for EXPLAIN
+static const char* ATTR_NAMES[] = { "", "key", "value", "*", "COUNT(*)", "MIN(key)", "MAX(key)",
+                                    "SUM(key)", "AVG(key)", "MIN(value)", "MAX(value)" };
+
+// an operator of a plan run by EXPLAIN ANALYZE, passed to stepTuple()
+// with each tuple it produces
+struct PlanStep {
+  QueryPlan*   plan;
+  int          node;    // the operator that produces the tuples
+  int          parent;  // the operator that takes them
+  TupleVisitor visit;   // the visitor of the parent
+  void*        arg;
+};
+
+// make an operator of a profiled plan pass its tuples to visit() through
+// stepTuple(), which counts them and charges visit() to the parent.
+// visit and arg are left alone if plan is NULL.
+static void planStep(PlanStep& step, QueryPlan* plan, int node, int parent, TupleVisitor& visit, void*& arg);
+
+// count a tuple of an operator of a profiled plan and pass it to the
+// parent, charging the parent for what it does with it
+static bool stepTuple(void* arg, int key, const string& value, const RecordId& rid);
+
+// scanTable() as the operator node of a plan, whose tuples go to the
+// operator parent. the plan is NULL if the statement is not profiled.
+static RC planScan(QueryPlan* plan, int node, int parent, TableHandle* t, const WhereClause& where, int flags, TupleVisitor visit, void* arg);
+
+// describe the OFFSET and LIMIT clauses, for EXPLAIN
+static string limitText(const SelOrder& order);
+
+// the rows that are left of rows after the OFFSET and LIMIT clauses
+static double limitRows(double rows, const SelOrder& order);
+
+// run a SELECT of an aggregate on a table opened by the caller
+static RC runAggregate(SqlSession& session, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order);
+
+// print an aggregate of a set of tuples, without a newline
+static void printAggregate(FILE* out, int attr, int count, long long sum, int key, const char* value);
+
+// a part of a table read by one thread of a parallel scan: a set of key
+// ranges of the index or, without an index, a range of pages of the
+// table file
+struct TablePart {
+  vector<KeyRange> ranges;  // the key ranges to read from the index
+  PageId           first;   // the first page to read from the table file
+  PageId           last;    // the page after the last one to read
+  RecordId         end;     // the end of the table when the scan started
+};
+
+// start the scan workers if they are not running yet
+// @return the number of workers
+static int scanWorkers();
+
+// split the part of a table that can satisfy the WHERE clause into parts
+// for the scan workers. large tables get one part per worker; a table
+// with no matching key ranges gets none.
+static void splitTable(TableHandle* t, const WhereClause& where, vector<TablePart>& parts);
+
+// scanTable() over a part of a table
+static RC scanPart(TableHandle* t, const TablePart& part, const WhereClause& where, int flags, TupleVisitor visit, void* arg);
+
+// run task() on every argument, using the scan workers, and wait until
+// all of them have finished
+static void runParallel(ThreadPool::Task task, const vector<void*>& args);
+
+// count and sum the keys that satisfy a WHERE clause without value
+// conditions. large tables are split into parts that are read in
+// parallel by the scan workers.
+static RC reduceKeys(TableHandle* t, const WhereClause& where, int& count, long long& sum);
+
+// run a SELECT with GROUP BY on a table opened by the caller
+static RC runGroupBy(SqlSession& session, int group, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order);
+
+// a column of a join: the table (0: left, 1: right) and the attribute
+struct JoinRef {
+  int side;
+  int attr;
+};
+
+// a condition between two columns of a join, checked on each joined pair
+struct JoinCheck {
+  JoinRef             column;
+  SelCond::Comparator comp;
+  JoinRef             other;
+};
+
+// run a join of two tables opened by the caller
+static RC runJoin(SqlSession& session, int attr, const vector<JoinRef>& refs, TableHandle* t[2], const vector<SelCond> filter[2], const vector<JoinCheck>& checks, const SelOrder& order);
+
+// estimate the number of tuples of a table that satisfy the WHERE clause
+// from the statistics of the table. without statistics, every key of an
+// indexed table is assumed to be in the table once.
+static long long estimateTuples(TableHandle* t, const WhereClause& where);
+
+// estimate the fraction of the tuples of an analyzed table that satisfy
+// the WHERE clause
+static double selectivity(TableHandle* t, const WhereClause& where);
+
+// the number of pages in the file of a table
+static long long tablePages(TableHandle* t);
+
+// estimate the page reads of reading the tuples of an indexed table that
+// satisfy the WHERE clause through the index, with the scanTable() flags
+static double indexCost(TableHandle* t, const WhereClause& where, int flags);
+
+// whether reading a table through its index takes fewer page reads than
+// reading its table file. always true without statistics.
+static bool indexCheaper(TableHandle* t, const WhereClause& where, int flags);
+
+// collect the statistics of a table file from all of its tuples
+static RC analyzeRecords(RecordFile& rf, TableStats& stats);
+
+// compare the columns of two tuples. a key is equal to a value that
+// writes it in decimal; it is ordered against a value by atoi().
+static bool compareColumns(int attr, int key, const char* value, SelCond::Comparator comp, int otherAttr, int otherKey, const char* otherValue);
 
 
 RC SqlEngine::run(FILE* commandline)
 {
-  fprintf(stdout, "Bruinbase> ");
+  SqlSession session(stdout, stderr);
+  void*      scanner;
+
+  fprintf(stdout, "Bruinbase> ");
+
+  // set the command line input and start parsing user input
+  if (sqllex_init(&scanner) != 0) return RC_FILE_READ_FAILED;
+  sqlset_in(commandline, scanner);
+  sqlparse(scanner, &session);  // sqlparse() is defined in SqlParser.tab.c generated from
+                                // SqlParser.y by bison (bison is GNU equivalent of yacc)
+  sqllex_destroy(scanner);
+  endSession(session);
+
+  // write back the tables changed by INSERT and DELETE
+  return shutdown();
+}
+
+RC SqlEngine::execute(SqlSession& session, const string& commands)
+{
+  void* scanner;
+
+  if (sqllex_init(&scanner) != 0) return RC_FILE_READ_FAILED;
+  sql_scan_string(commands.c_str(), scanner);
+  sqlparse(scanner, &session);
+  sqllex_destroy(scanner);  // also frees the string buffer
+
+  return 0;
+}
+
+RC SqlEngine::select(SqlSession& session, int attr, const string& table, const WhereClause& where, const SelOrder& order)
+{
+  TableHandle* t;  // the table and its index
+  RC rc;
+
+  if (hasPlaceholder(where)) {
+    fprintf(session.err, "Error: ? can only be used in PREPARE\n");
+    return RC_INVALID_PARAMETER;
+  }
+
+  // open the table file
+  if ((rc = openTable(table, false, t)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  rc = runSelect(session, attr, t, where, order);
+
+  releaseTable(t);
+  return rc;
+}
+
+RC SqlEngine::prepare(SqlSession& session, const string& name, int attr, const string& table, const WhereClause& where, const SelOrder& order)
+{
+  PreparedSelect* ps;
+  TableHandle*    t;
+  vector<char**>  slots;
+  RC              rc;
+
+  // check that the table exists; its handle stays valid until shutdown()
+  if ((rc = openTable(table, false, t)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+  releaseTable(t);
+
+  ps = new PreparedSelect;
+  ps->attr = attr;
+  ps->table = t;
+  ps->where = where;
+  ps->order = order;
+  ps->params = 0;
+  valueSlots(ps->where, slots);
+  for (unsigned i = 0; i < slots.size(); i++) {
+    if (*slots[i] == NULL) {
+      ps->params++;
+    } else {
+      *slots[i] = strdup(*slots[i]);
+    }
+  }
+
+  deallocate(session, name);
+  session.prepared[name] = ps;
+
+  return 0;
+}
+
+RC SqlEngine::executePrepared(SqlSession& session, const string& name, const vector<char*>& params)
+{
+  map<string, PreparedSelect*>::iterator it;
+  PreparedSelect*  ps;
+  WhereClause      where;  // the WHERE clause with the placeholders bound
+  vector<char**>   slots;
+  unsigned         n;
+  RC               rc;
+
+  if ((it = session.prepared.find(name)) == session.prepared.end()) {
+    fprintf(session.err, "Error: prepared statement %s does not exist\n", name.c_str());
+    return RC_NO_SUCH_STATEMENT;
+  }
+  ps = it->second;
+
+  if (params.size() != ps->params) {
+    fprintf(session.err, "Error: %s expects %u parameters\n", name.c_str(), ps->params);
+    return RC_INVALID_PARAMETER;
+  }
+
+  // bind the parameters to the placeholders from left to right
+  where = ps->where;
+  valueSlots(where, slots);
+  n = 0;
+  for (unsigned i = 0; i < slots.size(); i++) {
+    if (*slots[i] == NULL) *slots[i] = params[n++];
+  }
+
+  if ((rc = acquireTable(ps->table, false)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", ps->table->name.c_str());
+    return rc;
+  }
+
+  rc = runSelect(session, ps->attr, ps->table, where, ps->order);
+
+  releaseTable(ps->table);
+  return rc;
+}
+
+RC SqlEngine::deallocate(SqlSession& session, const string& name)
+{
+  map<string, PreparedSelect*>::iterator it;
+  vector<char**> slots;
+
+  if ((it = session.prepared.find(name)) == session.prepared.end()) {
+    return RC_NO_SUCH_STATEMENT;
+  }
+
+  PreparedSelect* ps = it->second;
+  valueSlots(ps->where, slots);
+  for (unsigned i = 0; i < slots.size(); i++) {
+    free(*slots[i]);
+  }
+  delete ps;
+  session.prepared.erase(it);
+
+  return 0;
+}
+
+void SqlEngine::endSession(SqlSession& session)
+{
+  while (!session.prepared.empty()) {
+    deallocate(session, session.prepared.begin()->first);
+  }
+
+  // a statement after EXPLAIN ANALYZE that was cut off still prints
+  // its results to /dev/null
+  if (session.plan != NULL) {
+    if (session.plan->isAnalyze()) {
+      fclose(session.out);
+      session.out = session.plan->getOut();
+    }
+    delete session.plan;
+    session.plan = NULL;
+  }
+}
+
+//
+// the state of a SELECT passed to selectTuple() by scanTable()
+//
+struct SelectState {
+  SqlSession* session;  // the session to print to
+  int         attr;     // attribute in the SELECT clause
+  int         count;    // the number of matching tuples
+  int         offset;   // matching tuples still to skip
+  int         limit;    // tuples still to print, -1 for no limit
+  int         printed;  // the number of printed tuples
+};
+
+static bool selectTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  SelectState* s = (SelectState*) arg;
+
+  // increase matching tuple counter
+  s->count++;
+
+  // apply OFFSET and LIMIT
+  if (s->offset > 0) {
+    s->offset--;
+    return true;
+  }
+  if (s->limit == 0) return false;
+  if (s->limit > 0) s->limit--;
+
+  // print the tuple 
+  switch (s->attr) {
+  case 1:  // SELECT key
+    fprintf(s->session->out, "%d\n", key);
+    break;
+  case 2:  // SELECT value
+    fprintf(s->session->out, "%s\n", value.c_str());
+    break;
+  case 3:  // SELECT *
+    fprintf(s->session->out, "%d '%s'\n", key, value.c_str());
+    break;
+  }
+  s->printed++;
+
+  // stop the scan once the last tuple has been printed
+  return s->limit != 0;
+}
+
+//
+// the state of SELECT DISTINCT passed to distinctTuple(). the tuples
+// arrive with equal ones next to each other.
+//
+struct DistinctState {
+  TupleVisitor visit;   // where the distinct tuples go
+  void*        arg;
+  int          attr;    // the attribute that must differ, 3 for both
+  bool         first;   // no tuple has arrived yet
+  int          key;     // the last tuple
+  string       value;
+};
+
+static bool distinctTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  DistinctState* s = (DistinctState*) arg;
+  int attr = s->attr;
+
+  if (!s->first && (attr == 2 || key == s->key) && (attr == 1 || value == s->value)) return true;
+  s->first = false;
+  s->key = key;
+  s->value = value;
+
+  return s->visit(s->arg, key, value, rid);
+}
+
+static RC runSelect(SqlSession& session, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order)
+{
+  SelectState   state = { &session, attr, 0, order.offset, order.limit, 0 };
+  DistinctState distinct = { selectTuple, &state, attr, true, 0, "" };
+  TupleVisitor  visit = selectTuple;
+  void*         arg = &state;
+  QueryPlan*    plan = session.plan;
+  PlanStep      steps[2];
+  int           result = -1, unique = -1, sorter = -1, scan = -1;  // the operators of the plan
+  RC rc;
+
+  if (attr >= 4) return runAggregate(session, attr, t, where, order);
+
+  // DISTINCT drops each tuple equal to the one before, so the tuples must
+  // come ordered on the selected attribute
+  int sortAttr = (order.order != SelOrder::NONE) ? order.attr : (attr == 2 ? 2 : 1);
+  if (order.distinct) {
+    if (attr != 3 && sortAttr != attr) {
+      fprintf(session.err, "Error: ORDER BY must be on the DISTINCT attribute\n");
+      return RC_INVALID_ATTRIBUTE;
+    }
+  }
+
+  // the index returns the tuples in key order, so no sorting is needed
+  // and the scan can stop at the limit
+  bool sorted = !((order.order == SelOrder::NONE && !order.distinct) ||
+                  (sortAttr == 1 && t->hasIndex && (!order.distinct || attr == 1)));
+  int flags = (order.order == SelOrder::DESC) ? SCAN_BACKWARD : 0;
+  if (attr == 1) flags |= SCAN_KEYS;
+  if (order.order == SelOrder::NONE && !order.distinct) flags |= SCAN_ANY_ORDER;
+
+  if (plan != NULL) {
+    // the scan of sortTable()
+    int scanFlags = sorted ? (((attr == 1 && sortAttr == 1) ? SCAN_KEYS : 0) | SCAN_ANY_ORDER) : flags;
+    double tuples = (scanMethod(t, where, scanFlags) == NO_SCAN) ? 0 : estimateTuples(t, where);
+    double rows = tuples;
+    if (order.distinct && t->stats.isValid()) {
+      if (attr == 1) rows = min(rows, (double) t->stats.getDistinctKeys());
+      if (attr == 2) rows = min(rows, (double) t->stats.getDistinctValues());
+    }
+
+    int parent = result = plan->add(-1, string("Result ") + ATTR_NAMES[attr] + limitText(order), limitRows(rows, order));
+    if (order.distinct) parent = unique = plan->add(parent, string("Unique on ") + ATTR_NAMES[attr], rows);
+    if (sorted) {
+      parent = sorter = plan->add(parent, string("Sort by ") + ATTR_NAMES[sortAttr] +
+                                  (order.order == SelOrder::DESC ? " desc" : ""), tuples);
+    }
+    scan = plan->add(parent, scanName(t, where, scanFlags), tuples);
+
+    if (!plan->isAnalyze()) return 0;
+    plan->enter(result);
+  }
+
+  if (order.distinct) {
+    planStep(steps[0], plan, unique, result, visit, arg);
+    distinct.visit = visit;
+    distinct.arg = arg;
+    visit = distinctTuple;
+    arg = &distinct;
+  }
+
+  if (sorted) {
+    planStep(steps[1], plan, sorter, order.distinct ? unique : result, visit, arg);
+    rc = sortTable(t, where, attr, order, visit, arg, plan, sorter, scan);
+  } else {
+    rc = planScan(plan, scan, order.distinct ? unique : result, t, where, flags, visit, arg);
+  }
+  if (plan != NULL) plan->addRows(result, state.printed);
+
+  if (rc < 0) {
+    fprintf(session.err, "Error: while reading a tuple from table %s\n", t->name.c_str());
+    return rc;
+  }
+
+  return 0;
+}
+
+static void planStep(PlanStep& step, QueryPlan* plan, int node, int parent, TupleVisitor& visit, void*& arg)
+{
+  if (plan == NULL) return;
+
+  step.plan = plan;
+  step.node = node;
+  step.parent = parent;
+  step.visit = visit;
+  step.arg = arg;
+  visit = stepTuple;
+  arg = &step;
+}
+
+static bool stepTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  PlanStep* s = (PlanStep*) arg;
+
+  s->plan->addRows(s->node, 1);
+  s->plan->enter(s->parent);
+  bool more = s->visit(s->arg, key, value, rid);
+  s->plan->enter(s->node);
+
+  return more;
+}
+
+static RC planScan(QueryPlan* plan, int node, int parent, TableHandle* t, const WhereClause& where, int flags, TupleVisitor visit, void* arg)
+{
+  PlanStep step;
+
+  if (plan == NULL) return scanTable(t, where, flags, visit, arg);
+
+  planStep(step, plan, node, parent, visit, arg);
+  int before = plan->enter(node);
+  RC rc = scanTable(t, where, flags, visit, arg);
+  plan->enter(before);
+
+  return rc;
+}
+
+static string limitText(const SelOrder& order)
+{
+  char buf[64];
+
+  if (order.limit < 0 && order.offset == 0) return "";
+  if (order.limit < 0) snprintf(buf, sizeof(buf), " offset %d", order.offset);
+  else if (order.offset == 0) snprintf(buf, sizeof(buf), " limit %d", order.limit);
+  else snprintf(buf, sizeof(buf), " limit %d offset %d", order.limit, order.offset);
+  return buf;
+}
+
+static double limitRows(double rows, const SelOrder& order)
+{
+  rows = max(0.0, rows - order.offset);
+  return (order.limit >= 0) ? min(rows, (double) order.limit) : rows;
+}
+
+//
+// the tuples passed to an external sort by sortTuple()
+//
+struct SortState {
+  ExternalSort* sorter;
+  RC            rc;    // the first error of adding a tuple
+};
+
+static bool sortTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  SortState* s = (SortState*) arg;
+
+  return (s->rc = s->sorter->add(key, value, rid)) == 0;
+}
+
+static RC sortTable(TableHandle* t, const WhereClause& where, int attr, const SelOrder& order, TupleVisitor visit, void* arg, QueryPlan* plan, int sortNode, int scanNode)
+{
+  int sortAttr = (order.order != SelOrder::NONE) ? order.attr : (attr == 2 ? 2 : 1);
+  RC rc;
+
+  // with a limit, only the first offset + limit tuples need to be in
+  // order. DISTINCT does not know how many tuples it will drop.
+  int limit = (order.limit >= 0 && !order.distinct) ? order.offset + order.limit : -1;
+
+  ExternalSort sorter(sortAttr, order.order == SelOrder::DESC, limit, SORT_MEMORY,
+                      scanWorkers() > 0 ? &scanPool : NULL);
+  SortState state = { &sorter, 0 };
+
+  // SELECT key sorted by key does not need the values
+  int flags = (attr == 1 && sortAttr == 1) ? SCAN_KEYS : 0;
+  if ((rc = planScan(plan, scanNode, sortNode, t, where, flags | SCAN_ANY_ORDER, sortTuple, &state)) < 0) return rc;
+  if (state.rc < 0) return state.rc;
+  if (plan != NULL) plan->enter(sortNode);
+  if ((rc = sorter.sort()) < 0) return rc;
+
+  int         key;
+  const char* value;
+  RecordId    rid;
+  while ((rc = sorter.next(key, value, rid)) == 0) {
+    if (!visit(arg, key, value, rid)) return 0;
+  }
+  return (rc == RC_END_OF_TREE) ? 0 : rc;
+}
+
+//
+// the state of an aggregate passed to aggregateTuple() by scanTable()
+//
+struct AggregateState {
+  int       attr;     // the aggregate in the SELECT clause
+  bool      ordered;  // the tuples arrive in key order
+  int       count;    // the number of matching tuples
+  long long sum;      // the sum of their keys
+  int       key;      // the smallest or largest key so far
+  string    value;    // the smallest or largest value so far
+};
+
+static bool aggregateTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  AggregateState* s = (AggregateState*) arg;
+
+  switch (s->attr) {
+  case 5:  // MIN(key)
+    if (s->count == 0 || key < s->key) s->key = key;
+    break;
+  case 6:  // MAX(key)
+    if (s->count == 0 || key > s->key) s->key = key;
+    break;
+  case 9:  // MIN(value)
+    if (s->count == 0 || value < s->value) s->value = value;
+    break;
+  case 10: // MAX(value)
+    if (s->count == 0 || value > s->value) s->value = value;
+    break;
+  default: // COUNT(*), SUM(key), AVG(key)
+    s->sum += key;
+    break;
+  }
+  s->count++;
+
+  // in key order, the first tuple is the smallest or largest key
+  return !(s->ordered && (s->attr == 5 || s->attr == 6));
+}
+
+static RC runAggregate(SqlSession& session, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order)
+{
+  AggregateState state;
+  QueryPlan*     plan = session.plan;
+  int            aggregate = -1, scan = -1;  // the operators of the plan
+  RC rc;
+
+  state.attr = attr;
+  state.ordered = false;
+  state.count = 0;
+  state.sum = 0;
+  state.key = 0;
+
+  bool reduce = (attr == 4 || attr == 7 || attr == 8) && keysOnly(where);
+  int flags;
+  if (reduce) flags = SCAN_KEYS;
+  else if ((attr == 5 || attr == 6) && t->hasIndex) flags = (attr == 6 ? SCAN_BACKWARD : 0) | SCAN_KEYS;
+  else flags = ((attr == 9 || attr == 10) ? 0 : SCAN_KEYS) | SCAN_ANY_ORDER;
+
+  if (plan != NULL) {
+    double tuples = (scanMethod(t, where, flags) == NO_SCAN) ? 0 : estimateTuples(t, where);
+    if ((attr == 5 || attr == 6) && t->hasIndex) tuples = min(tuples, 1.0);
+    aggregate = plan->add(-1, string("Aggregate ") + ATTR_NAMES[attr] + limitText(order), limitRows(1, order));
+    scan = plan->add(aggregate, scanName(t, where, flags), tuples);
+
+    if (!plan->isAnalyze()) return 0;
+    plan->enter(aggregate);
+  }
+
+  if (reduce) {
+    // only the keys are needed: add them up page by page
+    if (plan != NULL) plan->enter(scan);
+    rc = reduceKeys(t, where, state.count, state.sum);
+    if (plan != NULL) {
+      plan->addRows(scan, state.count);
+      plan->enter(aggregate);
+    }
+  } else {
+    // an indexed table is read from the matching end for MIN(key) and
+    // MAX(key), which stops at the first tuple
+    state.ordered = !(flags & SCAN_ANY_ORDER);
+    rc = planScan(plan, scan, aggregate, t, where, flags, aggregateTuple, &state);
+  }
+
+  if (rc < 0) {
+    fprintf(session.err, "Error: while reading a tuple from table %s\n", t->name.c_str());
+    return rc;
+  }
+
+  // an aggregate is one row
+  if (order.offset > 0 || order.limit == 0) return 0;
+
+  printAggregate(session.out, attr, state.count, state.sum, state.key, state.value.c_str());
+  fprintf(session.out, "\n");
+  if (plan != NULL) plan->addRows(aggregate, 1);
+
+  return 0;
+}
+
+static void printAggregate(FILE* out, int attr, int count, long long sum, int key, const char* value)
+{
+  if (attr == 4) {
+    fprintf(out, "%d", count);
+  } else if (count == 0) {
+    // aggregates other than COUNT(*) of no tuples are NULL
+    fprintf(out, "NULL");
+  } else {
+    switch (attr) {
+    case 5:
+    case 6:
+      fprintf(out, "%d", key);
+      break;
+    case 7:
+      fprintf(out, "%lld", sum);
+      break;
+    case 8:
+      fprintf(out, "%.2f", (double) sum / count);
+      break;
+    case 9:
+    case 10:
+      fprintf(out, "%s", value);
+      break;
+    }
+  }
+}
+
+//
+// the tasks of runParallel()
+//
+struct ParallelJob {
+  ThreadPool::Task task;     // the function run on every argument
+  pthread_mutex_t  lock;     // protects pending
+  pthread_cond_t   done;     // signaled when pending drops to 0
+  int              pending;  // the tasks on the workers that have not finished
+  PageFile::IoCounters* counters;  // where the page accesses of the tasks are counted
+};
+
+struct ParallelTask {
+  ParallelJob* job;
+  void*        arg;
+};
+
+static void runParallelTask(void* arg)
+{
+  ParallelTask* p = (ParallelTask*) arg;
+
+  // count the page accesses for the thread that waits for the task
+  PageFile::IoCounters* counters = PageFile::getIoCounters();
+  PageFile::setIoCounters(p->job->counters);
+  p->job->task(p->arg);
+  PageFile::setIoCounters(counters);
+
+  pthread_mutex_lock(&p->job->lock);
+  if (--p->job->pending == 0) pthread_cond_signal(&p->job->done);
+  pthread_mutex_unlock(&p->job->lock);
+}
+
+static void runParallel(ThreadPool::Task task, const vector<void*>& args)
+{
+  ParallelJob job;
+  vector<ParallelTask> tasks(args.size());
+
+  job.task = task;
+  job.pending = 0;
+  job.counters = PageFile::getIoCounters();
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.done, NULL);
+
+  // run all tasks but the first on the workers, and the first one here.
+  // a task that cannot be queued is run here as well.
+  for (unsigned i = 1; i < args.size(); i++) {
+    tasks[i].job = &job;
+    tasks[i].arg = args[i];
+    pthread_mutex_lock(&job.lock);
+    job.pending++;
+    pthread_mutex_unlock(&job.lock);
+    if (scanPool.submit(runParallelTask, &tasks[i]) < 0) {
+      pthread_mutex_lock(&job.lock);
+      job.pending--;
+      pthread_mutex_unlock(&job.lock);
+      task(args[i]);
+    }
+  }
+  if (!args.empty()) task(args[0]);
+
+  pthread_mutex_lock(&job.lock);
+  while (job.pending > 0) pthread_cond_wait(&job.done, &job.lock);
+  pthread_mutex_unlock(&job.lock);
+  pthread_cond_destroy(&job.done);
+  pthread_mutex_destroy(&job.lock);
+}
+
+static int scanWorkers()
+{
+  int n;
+
+  pthread_mutex_lock(&scanPoolLock);
+  if (scanPool.size() == 0 && scanPool.start(sysconf(_SC_NPROCESSORS_ONLN) - 1) < 0) n = 0;
+  else n = scanPool.size();
+  pthread_mutex_unlock(&scanPoolLock);
+
+  return n;
+}
+
+static void splitTable(TableHandle* t, const WhereClause& where, vector<TablePart>& parts)
+{
+  vector<KeyRange> ranges;
+  IndexCursor cursor;
+  RecordId    rid;
+  int         lo, hi;
+
+  // a clause that the Bloom filters reject needs no part
+  if (!mayMatch(t, where)) return;
+
+  // split the table into parts by its size, at most one per worker
+  // plus one for this thread
+  RecordId end = visibleEnd(t);
+  long long tuples = (long long) end.pid * RecordFile::RECORDS_PER_PAGE + end.sid;
+  int n = max(1LL, min((long long) sysconf(_SC_NPROCESSORS_ONLN), tuples / PART_TUPLES));
+
+  if (n > 1) n = min(n, scanWorkers() + 1);
+
+  if (!t->hasIndex) {
+    // split the pages evenly. the parts of a table stored by columns
+    // start at a block, so that each block of keys is read once.
+    PageId unit = t->rf.hasColumns() ? RecordFile::KEYS_PER_BLOCK / RecordFile::RECORDS_PER_PAGE : 1;
+    PageId units = (end.pid + (end.sid > 0 ? 1 : 0) + unit - 1) / unit;
+    parts.resize(n);
+    for (int i = 0; i < n; i++) {
+      parts[i].first = (PageId) ((long long) units * i / n) * unit;
+      parts[i].last = (PageId) ((long long) units * (i + 1) / n) * unit;
+      parts[i].end = end;
+    }
+    return;
+  }
+
+  keyRanges(where, ranges);
+  if (ranges.empty()) return;
+  if (n == 1) {
+    parts.resize(1);
+    parts[0].ranges = ranges;
+    parts[0].end = end;
+    return;
+  }
+
+  // clip the ranges to the smallest and largest keys in the index,
+  // which are found in treeHeight page reads each
+  if (t->idx.locate(INT_MIN, cursor) != 0 || t->idx.readForward(cursor, lo, rid) != 0) return;
+  if (t->idx.locateBackward(INT_MAX, cursor) != 0 || t->idx.readBackward(cursor, hi, rid) != 0) return;
+  long long width = 0;
+  for (unsigned i = 0; i < ranges.size(); i++) {
+    ranges[i].lo = max(ranges[i].lo, lo);
+    ranges[i].hi = min(ranges[i].hi, hi);
+    if (ranges[i].lo <= ranges[i].hi) width += (long long) ranges[i].hi - ranges[i].lo + 1;
+  }
+
+  // give each part an equal share of the key space
+  parts.resize(n);
+  for (int i = 0; i < n; i++) parts[i].end = end;
+  long long share = (width + n - 1) / n;
+  long long left = share;
+  int p = 0;
+  for (unsigned i = 0; i < ranges.size(); i++) {
+    long long from = ranges[i].lo;
+    while (from <= ranges[i].hi) {
+      long long to = min((long long) ranges[i].hi, from + left - 1);
+      KeyRange r = { (int) from, (int) to };
+      parts[p].ranges.push_back(r);
+      left -= to - from + 1;
+      from = to + 1;
+      if (left == 0 && p < n - 1) {
+        p++;
+        left = share;
+      }
+    }
+  }
+}
+
+static RC scanPart(TableHandle* t, const TablePart& part, const WhereClause& where, int flags, TupleVisitor visit, void* arg)
+{
+  if (t->hasIndex) return scanIndex(t, part.ranges, part.end, where, flags, visit, arg);
+  if (t->rf.hasColumns()) return scanColumns(t, part.first, part.last, part.end, where, flags, visit, arg);
+  return scanRows(t, part.first, part.last, part.end, where, visit, arg);
+}
+
+//
+// a part of a reduceKeys(), run by reducePart()
+//
+struct ReducePart {
+  TableHandle*        t;
+  const WhereClause*  where;
+  const TablePart*    part;
+  int                 count;   // the number of matching keys
+  long long           sum;     // the sum of the matching keys
+  int                 batched; // the keys in batch
+  int                 batch[256];  // matching keys not added to sum yet
+  RC                  rc;
+};
+
+// add up an array of keys. the loop has no branches so that the compiler
+// can turn it into vector instructions.
+static long long sumKeys(const int* keys, int n)
+{
+  long long sum = 0;
+  for (int i = 0; i < n; i++) sum += keys[i];
+  return sum;
+}
+
+static bool batchKey(void* arg, int key, const string& value, const RecordId& rid)
+{
+  ReducePart* p = (ReducePart*) arg;
+
+  p->batch[p->batched++] = key;
+  if (p->batched == (int) (sizeof(p->batch) / sizeof(int))) {
+    p->sum += sumKeys(p->batch, p->batched);
+    p->count += p->batched;
+    p->batched = 0;
+  }
+  return true;
+}
+
+// reducePart() of a table without an index that is stored by columns
+static void reduceColumns(ReducePart* p)
+{
+  RecordFile::KeyBlock b;
+  vector<KeyRange>     ranges;
+  unsigned char        match[sizeof(b.removed)];
+  int                  keys[RecordFile::KEYS_PER_BLOCK];
+
+  keyRanges(*p->where, ranges);
+  bool exact = rangesExact(*p->where);
+
+  RecordId end = p->part->end;
+  int first = p->part->first * RecordFile::RECORDS_PER_PAGE;
+  int last = min(p->part->last * RecordFile::RECORDS_PER_PAGE, end.pid * RecordFile::RECORDS_PER_PAGE + end.sid);
+  for (int block = first / RecordFile::KEYS_PER_BLOCK; block * RecordFile::KEYS_PER_BLOCK < last; block++) {
+    if ((p->rc = p->t->rf.readKeyBlock(block, b)) < 0) return;
+    if (!matchKeys(b, ranges, match)) continue;
+
+    // the parts start at a block, so only the last part ends inside one
+    int n = 0;
+    int to = min(b.count, last - block * RecordFile::KEYS_PER_BLOCK);
+    for (int i = 0; i < to; i++) {
+      if (((match[i / 8] >> (i % 8)) & 1) && (exact || matchWhere(b.keys[i], "", *p->where))) {
+        keys[n++] = b.keys[i];
+      }
+    }
+    p->sum += sumKeys(keys, n);
+    p->count += n;
+  }
+}
+
+static void reducePart(void* arg)
+{
+  ReducePart* p = (ReducePart*) arg;
+  vector<KeyRange> ranges;
+  int keys[RecordFile::RECORDS_PER_PAGE];
+  int n, lo, hi;
+
+  p->rc = 0;
+  p->batched = 0;
+  if (p->t->hasIndex) {
+    p->rc = scanIndex(p->t, p->part->ranges, p->part->end, *p->where, SCAN_KEYS, batchKey, p);
+  } else if (p->t->rf.hasColumns()) {
+    reduceColumns(p);
+  } else {
+    keyRanges(*p->where, ranges);
+    for (PageId pid = p->part->first; pid < p->part->last; pid++) {
+      // skip the pages whose zone holds no key in the ranges
+      if (p->t->rf.readZone(pid, lo, hi) == 0 && !rangesOverlap(ranges, lo, hi)) continue;
+      if ((p->rc = p->t->rf.readKeys(pid, p->part->end, keys, n)) < 0) break;
+
+      // drop the keys that do not satisfy the clause, then add up the rest
+      if (!p->where->empty()) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+          if (matchWhere(keys[i], "", *p->where)) keys[m++] = keys[i];
+        }
+        n = m;
+      }
+      p->sum += sumKeys(keys, n);
+      p->count += n;
+    }
+  }
+  p->sum += sumKeys(p->batch, p->batched);
+  p->count += p->batched;
+}
+
+static RC reduceKeys(TableHandle* t, const WhereClause& where, int& count, long long& sum)
+{
+  vector<TablePart> parts;
+  RC rc = 0;
+
+  count = 0;
+  sum = 0;
+
+  splitTable(t, where, parts);
+
+  vector<ReducePart> reduce(parts.size());
+  vector<void*> args;
+  for (unsigned i = 0; i < parts.size(); i++) {
+    reduce[i].t = t;
+    reduce[i].where = &where;
+    reduce[i].part = &parts[i];
+    reduce[i].count = 0;
+    reduce[i].sum = 0;
+    args.push_back(&reduce[i]);
+  }
+  runParallel(reducePart, args);
+
+  // combine the partial results
+  for (unsigned i = 0; i < reduce.size(); i++) {
+    if (reduce[i].rc < 0) rc = reduce[i].rc;
+    count += reduce[i].count;
+    sum += reduce[i].sum;
+  }
+
+  return rc;
+}
+
+RC SqlEngine::groupBy(SqlSession& session, int group, int attr, const string& table, const WhereClause& where, const SelOrder& order)
+{
+  TableHandle* t;
+  RC rc;
+
+  if (hasPlaceholder(where)) {
+    fprintf(session.err, "Error: ? can only be used in PREPARE\n");
+    return RC_INVALID_PARAMETER;
+  }
+  if (order.order != SelOrder::NONE && order.attr != group) {
+    fprintf(session.err, "Error: ORDER BY with GROUP BY must be on the GROUP BY attribute\n");
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  if ((rc = openTable(table, false, t)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  rc = runGroupBy(session, group, attr, t, where, order);
+
+  releaseTable(t);
+  return rc;
+}
+
+//
+// a part of a GROUP BY, aggregated by groupPart() into its own table
+//
+struct GroupPart {
+  TableHandle*        t;
+  const WhereClause*  where;
+  const TablePart*    part;
+  int                 flags;  // the flags of scanPart()
+  HashAggregate*      agg;    // the groups of this part
+  long long           tuples; // the tuples added to agg
+  RC                  rc;
+};
+
+static bool groupTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  GroupPart* p = (GroupPart*) arg;
+
+  p->tuples++;
+  p->rc = p->agg->add(key, value);
+  return p->rc == 0;
+}
+
+static void groupPart(void* arg)
+{
+  GroupPart* p = (GroupPart*) arg;
+  RC rc;
+
+  p->rc = 0;
+  if ((rc = scanPart(p->t, *p->part, *p->where, p->flags, groupTuple, p)) < 0) p->rc = rc;
+}
+
+//
+// the state of the output of a GROUP BY, passed to printGroup()
+//
+struct GroupState {
+  SqlSession* session;  // the session to print to
+  int         group;    // the attribute to group by
+  int         attr;     // the aggregate of each group, 0 for none
+  int         offset;   // groups still to skip
+  int         limit;    // groups still to print, -1 for no limit
+  int         groups;   // the groups passed to printGroup()
+  int         printed;  // the printed groups
+};
+
+static bool printGroup(void* arg, int key, const char* value, const GroupAggregate& agg)
+{
+  GroupState* s = (GroupState*) arg;
+  FILE* out = s->session->out;
+
+  s->groups++;
+
+  // apply OFFSET and LIMIT
+  if (s->offset > 0) {
+    s->offset--;
+    return true;
+  }
+  if (s->limit == 0) return false;
+  if (s->limit > 0) s->limit--;
+
+  // the group column, quoted as in SELECT * when an aggregate follows
+  if (s->group == 1) fprintf(out, "%d", key);
+  else if (s->attr == 0) fprintf(out, "%s", value);
+  else fprintf(out, "'%s'", value);
+
+  if (s->attr != 0) {
+    fprintf(out, " ");
+    printAggregate(out, s->attr, agg.count, agg.sum, agg.key, agg.value);
+  }
+  fprintf(out, "\n");
+  s->printed++;
+
+  return s->limit != 0;
+}
+
+static RC runGroupBy(SqlSession& session, int group, int attr, TableHandle* t, const WhereClause& where, const SelOrder& order)
+{
+  GroupState state = { &session, group, attr, order.offset, order.limit, 0, 0 };
+  vector<TablePart> parts;
+  vector<GroupPart> groups;
+  vector<void*> args;
+  QueryPlan* plan = session.plan;
+  int        result = -1, sorter = -1, hash = -1, scan = -1;  // the operators of the plan
+  RC rc = 0;
+
+  int flags = (group == 1 && attr != 9 && attr != 10) ? SCAN_KEYS : 0;
+
+  if (plan != NULL) {
+    double tuples = (scanMethod(t, where, flags) == NO_SCAN) ? 0 : estimateTuples(t, where);
+    double rows = tuples;
+    if (t->stats.isValid()) {
+      rows = min(rows, (double) (group == 1 ? t->stats.getDistinctKeys() : t->stats.getDistinctValues()));
+    }
+
+    int parent = result = plan->add(-1, string("Result ") + ATTR_NAMES[group] + (attr != 0 ? ", " : "") +
+                                    (attr != 0 ? ATTR_NAMES[attr] : "") + limitText(order), limitRows(rows, order));
+    if (order.order != SelOrder::NONE) {
+      parent = sorter = plan->add(parent, string("Sort by ") + ATTR_NAMES[group] + (order.order == SelOrder::DESC ? " desc" : ""), rows);
+    }
+    hash = plan->add(parent, string("Hash Aggregate by ") + ATTR_NAMES[group], rows);
+    bool parallel = scanWorkers() > 0 && tuples > 0;
+    scan = plan->add(hash, (parallel ? "Parallel " : "") + scanName(t, where, flags), tuples);
+
+    if (!plan->isAnalyze()) return 0;
+    plan->enter(scan);
+  }
+
+  // aggregate each part of the table into its own hash table, which
+  // needs no locking, then merge the tables
+  splitTable(t, where, parts);
+  if (parts.empty()) return 0;
+
+  groups.resize(parts.size());
+  for (unsigned i = 0; i < parts.size(); i++) {
+    groups[i].t = t;
+    groups[i].where = &where;
+    groups[i].part = &parts[i];
+    groups[i].flags = flags;
+    groups[i].agg = new HashAggregate(group, attr, GROUP_MEMORY / parts.size());
+    groups[i].tuples = 0;
+    args.push_back(&groups[i]);
+  }
+  runParallel(groupPart, args);
+  if (plan != NULL) plan->enter(hash);
+
+  HashAggregate* agg = groups[0].agg;
+  for (unsigned i = 0; i < groups.size(); i++) {
+    if (groups[i].rc < 0) rc = groups[i].rc;
+    if (plan != NULL) plan->addRows(scan, groups[i].tuples);
+    if (i > 0) {
+      if (rc == 0) rc = agg->merge(*groups[i].agg);
+      delete groups[i].agg;
+    }
+  }
+
+  if (rc == 0) {
+    if (order.order == SelOrder::NONE) {
+      rc = agg->finish(printGroup, &state);
+      if (plan != NULL) plan->addRows(hash, state.groups);
+    } else {
+      // with a limit, only the first offset + limit groups need to be
+      // in order
+      int limit = (order.limit >= 0) ? order.offset + order.limit : -1;
+      int groups;
+      if (plan != NULL) plan->enter(sorter);
+      rc = agg->finishSorted(order.order == SelOrder::DESC, limit, SORT_MEMORY,
+                             scanWorkers() > 0 ? &scanPool : NULL, printGroup, &state, groups);
+      if (plan != NULL) {
+        plan->addRows(hash, groups);
+        plan->addRows(sorter, state.groups);
+      }
+    }
+  }
+  delete agg;
+  if (plan != NULL) plan->addRows(result, state.printed);
+
+  if (rc < 0) {
+    fprintf(session.err, "Error: while grouping the tuples of table %s\n", t->name.c_str());
+    return rc;
+  }
+
+  return 0;
+}
+
+RC SqlEngine::join(SqlSession& session, int attr, const vector<JoinColumn>& columns, const string& left, const string& right, const vector<JoinCond>& where, const SelOrder& order)
+{
+  TableHandle*      t[2];       // the left and right tables
+  vector<SelCond>   filter[2];  // the conditions on one table and a value
+  vector<JoinCheck> checks;     // the conditions between two columns
+  vector<JoinRef>   refs;       // the columns to print
+  RC rc;
+
+  if (left == right) {
+    fprintf(session.err, "Error: a table cannot be joined with itself\n");
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  // resolve the table names of the columns
+  for (unsigned i = 0; i < columns.size(); i++) {
+    JoinRef r = { columns[i].table == left ? 0 : 1, columns[i].attr };
+    if (columns[i].table != left && columns[i].table != right) {
+      fprintf(session.err, "Error: table %s is not in the FROM clause\n", columns[i].table);
+      return RC_INVALID_ATTRIBUTE;
+    }
+    refs.push_back(r);
+  }
+  for (unsigned i = 0; i < where.size(); i++) {
+    const JoinCond& c = where[i];
+    if ((c.column.table != left && c.column.table != right) ||
+        (c.value == NULL && c.other.table != left && c.other.table != right)) {
+      fprintf(session.err, "Error: table %s is not in the FROM clause\n",
+              (c.column.table != left && c.column.table != right) ? c.column.table : c.other.table);
+      return RC_INVALID_ATTRIBUTE;
+    }
+
+    int side = (c.column.table == left) ? 0 : 1;
+    if (c.value != NULL) {
+      // a condition on one table is applied while that table is scanned
+      SelCond cond;
+      cond.attr = c.column.attr;
+      cond.comp = c.comp;
+      cond.value = c.value;
+      filter[side].push_back(cond);
+    } else {
+      JoinCheck check = { { side, c.column.attr }, c.comp, { c.other.table == left ? 0 : 1, c.other.attr } };
+      checks.push_back(check);
+    }
+  }
+
+  // the tables are opened in name order, so that two joins never wait
+  // for each other's latches
+  bool swapped = right < left;
+  if ((rc = openTable(swapped ? right : left, false, t[swapped ? 1 : 0])) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", (swapped ? right : left).c_str());
+    return rc;
+  }
+  if ((rc = openTable(swapped ? left : right, false, t[swapped ? 0 : 1])) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", (swapped ? left : right).c_str());
+    releaseTable(t[swapped ? 1 : 0]);
+    return rc;
+  }
+
+  rc = runJoin(session, attr, refs, t, filter, checks, order);
+
+  releaseTable(t[0]);
+  releaseTable(t[1]);
+  return rc;
+}
+
+//
+// the state of a join, passed to joinPair() for each pair of tuples
+// that satisfy the join condition
+//
+struct JoinState {
+  SqlSession*       session;
+  int               attr;      // 3: *, 4: count(*), 0: the columns in refs
+  vector<JoinRef>   refs;      // the columns to print
+  vector<JoinCheck> checks;    // the other conditions between two columns
+  int               count;     // the number of joined tuples
+  int               offset;    // joined tuples still to skip
+  int               limit;     // joined tuples still to print, -1 for no limit
+};
+
+static bool joinPair(JoinState* s, int leftKey, const char* leftValue, int rightKey, const char* rightValue)
+{
+  int         key[2] = { leftKey, rightKey };
+  const char* value[2] = { leftValue, rightValue };
+  FILE*       out = s->session->out;
+
+  for (unsigned i = 0; i < s->checks.size(); i++) {
+    const JoinCheck& c = s->checks[i];
+    if (!compareColumns(c.column.attr, key[c.column.side], value[c.column.side], c.comp,
+                        c.other.attr, key[c.other.side], value[c.other.side])) return true;
+  }
+
+  s->count++;
+  if (s->attr == 4) return true;
+
+  // apply OFFSET and LIMIT
+  if (s->offset > 0) {
+    s->offset--;
+    return true;
+  }
+  if (s->limit == 0) return false;
+  if (s->limit > 0) s->limit--;
+
+  if (s->attr == 3) {
+    fprintf(out, "%d '%s' %d '%s'\n", leftKey, leftValue, rightKey, rightValue);
+  } else {
+    for (unsigned i = 0; i < s->refs.size(); i++) {
+      if (i > 0) fprintf(out, " ");
+      if (s->refs[i].attr == 1) fprintf(out, "%d", key[s->refs[i].side]);
+      else fprintf(out, "'%s'", value[s->refs[i].side]);
+    }
+    fprintf(out, "\n");
+  }
+
+  return s->limit != 0;
+}
+
+//
+// the tables of a hash join, passed to buildTuple() and probeTuple()
+//
+struct HashJoinState {
+  HashJoin*   join;
+  JoinState*  state;
+  bool        buildLeft;  // whether the left table is the build side
+  RC          rc;
+};
+
+static bool buildTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  HashJoinState* s = (HashJoinState*) arg;
+
+  s->rc = s->join->build(key, value);
+  return s->rc == 0;
+}
+
+static bool hashJoinPair(void* arg, int buildKey, const char* buildValue, int probeKey, const char* probeValue)
+{
+  HashJoinState* s = (HashJoinState*) arg;
+
+  if (s->buildLeft) return joinPair(s->state, buildKey, buildValue, probeKey, probeValue);
+  return joinPair(s->state, probeKey, probeValue, buildKey, buildValue);
+}
+
+static bool probeTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  HashJoinState* s = (HashJoinState*) arg;
+  bool more;
+
+  s->rc = s->join->probe(key, value, hashJoinPair, s, more);
+  return s->rc == 0 && more;
+}
+
+//
+// the inner table of an index nested-loop join, passed to lookupTuple()
+// for each tuple of the outer table
+//
+struct IndexJoinState {
+  TableHandle*        inner;       // the inner table, joined on its key
+  const WhereClause*  innerWhere;  // the conditions on the inner table
+  int                 outerAttr;   // the join column of the outer table
+  bool                innerLeft;   // whether the inner table is the left one
+  JoinState*          state;
+  RC                  rc;
+  QueryPlan*          plan;        // the profiled plan, NULL if none
+  int                 node;        // the operator of the lookups in plan
+  int                 parent;      // the operator of the join
+  RecordId            innerEnd;    // the end of the inner table when the join started
+};
+
+static bool lookupTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  IndexJoinState* s = (IndexJoinState*) arg;
+  IndexCursor cursor;
+  RecordId    irid;
+  int         searchKey, ikey, k;
+  string      ivalue;
+  char        buf[16];
+  RC          rc;
+
+  // a value joins the key it writes in decimal
+  searchKey = key;
+  if (s->outerAttr == 2) {
+    searchKey = atoi(value.c_str());
+    snprintf(buf, sizeof(buf), "%d", searchKey);
+    if (value != buf) return true;
+  }
+
+  if (!s->inner->bloom.mayContainKey(searchKey)) return true;
+
+  bool more = true;
+  if (s->plan != NULL) s->plan->enter(s->node);
+  if (s->inner->idx.locate(searchKey, cursor) == 0) {
+    while (more && s->inner->idx.readForward(cursor, k, irid) == 0 && k == searchKey) {
+      if (irid >= s->innerEnd) continue;
+      if ((rc = s->inner->rf.read(irid, ikey, ivalue)) == RC_NO_SUCH_RECORD) continue;
+      if (rc < 0) {
+        s->rc = rc;
+        more = false;
+        break;
+      }
+      if (!matchWhere(ikey, ivalue, *s->innerWhere)) continue;
+
+      if (s->plan != NULL) {
+        s->plan->addRows(s->node, 1);
+        s->plan->enter(s->parent);
+      }
+      more = s->innerLeft ? joinPair(s->state, ikey, ivalue.c_str(), key, value.c_str())
+                          : joinPair(s->state, key, value.c_str(), ikey, ivalue.c_str());
+      if (s->plan != NULL) s->plan->enter(s->node);
+    }
+  }
+  if (s->plan != NULL) s->plan->enter(s->parent);
+
+  return more;
+}
+
+//
+// an index entry of a merge join and the tuple it points to
+//
+struct MergeRow {
+  int      key;
+  RecordId rid;
+  string   value;
+  bool     live;   // the tuple exists and satisfies the conditions of its table
+};
+
+//
+// the two tables of a merge join, each read through its key index
+//
+struct MergeState {
+  TableHandle*       t[2];
+  const WhereClause* where[2];
+  bool               fetch[2];    // whether the tuples are read from the table file
+  IndexCursor        cursor[2];
+  int                key[2];      // the key of the next index entry of each table
+  RecordId           rid[2];      // the RecordId of the next index entry
+  vector<MergeRow>   rows[2];     // the entries of the matching keys, in key order
+  JoinState*         state;
+  QueryPlan*         plan;        // the profiled plan, NULL if none
+  int                node[2];     // the operators of the index scans in plan
+  RecordId           end[2];      // the end of each table when the join started
+};
+
+// read the next index entry of a table of a merge join.
+// returns false at the end of the index.
+static bool mergeNext(MergeState& m, int side)
+{
+  return m.t[side]->idx.readForward(m.cursor[side], m.key[side], m.rid[side]) == 0;
+}
+
+// read the tuples of the rows in the batch and join the rows with equal
+// keys. the tuples of each table are read together, so each table page
+// is read once per batch and the reads of the pages are in flight at
+// the same time.
+static RC mergeBatch(MergeState& m, bool& more)
+{
+  vector<MergeRow*> order;
+  vector<RecordId>  rids;
+  vector<int>       keys;
+  vector<string>    values;
+  vector<RC>        rcs;
+  RC  rc;
+
+  for (int s = 0; s < 2; s++) {
+    vector<MergeRow>& rows = m.rows[s];
+    if (m.plan != NULL) m.plan->addRows(m.node[s], rows.size());
+    if (!m.fetch[s]) {
+      // the conditions are all on key
+      for (unsigned i = 0; i < rows.size(); i++) {
+        rows[i].live = rows[i].rid < m.end[s] && matchWhere(rows[i].key, "", *m.where[s]);
+      }
+      continue;
+    }
+
+    // the rows past the snapshot of the join are left out
+    order.clear();
+    rids.clear();
+    for (unsigned i = 0; i < rows.size(); i++) {
+      rows[i].live = false;
+      if (rows[i].rid >= m.end[s]) continue;
+      order.push_back(&rows[i]);
+      rids.push_back(rows[i].rid);
+    }
+    if (order.empty()) continue;
+
+    keys.resize(order.size());
+    values.resize(order.size());
+    rcs.resize(order.size());
+    if ((rc = m.t[s]->rf.readBatch(AsyncIo::forThread(), &rids[0], rids.size(), &keys[0], &values[0], &rcs[0])) < 0) return rc;
+
+    for (unsigned i = 0; i < order.size(); i++) {
+      if (rcs[i] != 0) continue;
+      order[i]->value.swap(values[i]);
+      order[i]->live = matchWhere(keys[i], order[i]->value, *m.where[s]);
+    }
+  }
+
+  // both tables have the same keys in the same order. join each key's
+  // rows of one table with its rows of the other.
+  vector<MergeRow>& left = m.rows[0];
+  vector<MergeRow>& right = m.rows[1];
+  unsigned i = 0, j = 0;
+  while (more && i < left.size()) {
+    unsigned iend = i, jend = j;
+    while (iend < left.size() && left[iend].key == left[i].key) iend++;
+    while (jend < right.size() && right[jend].key == right[j].key) jend++;
+
+    for (unsigned a = i; more && a < iend; a++) {
+      if (!left[a].live) continue;
+      for (unsigned b = j; more && b < jend; b++) {
+        if (!right[b].live) continue;
+        more = joinPair(m.state, left[a].key, left[a].value.c_str(), right[b].key, right[b].value.c_str());
+      }
+    }
+    i = iend;
+    j = jend;
+  }
+
+  left.clear();
+  right.clear();
+  return 0;
+}
+
+// join two indexed tables on their keys by reading both indexes in key
+// order. the index that is behind skips forward to the key of the other,
+// and the tuples are only read for the keys found in both indexes.
+static RC mergeJoin(MergeState& m, const vector<KeyRange>& ranges)
+{
+  unsigned r = 0;
+  int  batch = 64;    // the batch grows so that a LIMIT reads few tuples
+  bool more = true;
+  RC   rc;
+
+  if (ranges.empty()) return 0;
+  for (int s = 0; s < 2; s++) {
+    if (m.t[s]->idx.locate(ranges[0].lo, m.cursor[s]) != 0 || !mergeNext(m, s)) return 0;
+  }
+
+  for (;;) {
+    // the smallest key both tables can still have, in a key range
+    int target = max(m.key[0], m.key[1]);
+    while (r < ranges.size() && target > ranges[r].hi) r++;
+    if (r == ranges.size()) break;
+    if (target < ranges[r].lo) target = ranges[r].lo;
+
+    if (m.key[0] == target && m.key[1] == target) {
+      // collect the entries of the key from both tables
+      bool end = false;
+      for (int s = 0; s < 2; s++) {
+        bool next;
+        do {
+          MergeRow row = { target, m.rid[s], "", true };
+          m.rows[s].push_back(row);
+        } while ((next = mergeNext(m, s)) && m.key[s] == target);
+        if (!next) end = true;
+      }
+
+      if (end || (int) m.rows[0].size() + (int) m.rows[1].size() >= batch) {
+        if ((rc = mergeBatch(m, more)) < 0) return rc;
+        if (!more) return 0;
+        batch = min(batch * 2, MERGE_BATCH);
+      }
+      if (end) return 0;
+      continue;
+    }
+
+    for (int s = 0; s < 2; s++) {
+      if (m.key[s] >= target) continue;
+      if (m.t[s]->idx.skipTo(target, m.cursor[s]) != 0 || !mergeNext(m, s)) {
+        return mergeBatch(m, more);
+      }
+    }
+  }
+
+  return mergeBatch(m, more);
+}
+
+static RC runJoin(SqlSession& session, int attr, const vector<JoinRef>& refs, TableHandle* t[2], const vector<SelCond> filter[2], const vector<JoinCheck>& checks, const SelOrder& order)
+{
+  JoinState   state;
+  WhereClause where[2];
+  long long   tuples[2], pages[2], leaves[2], scan[2];
+  BTLeafNode  leaf;
+  RC          rc = 0;
+
+  state.session = &session;
+  state.attr = attr;
+  state.refs = refs;
+  state.count = 0;
+  state.offset = order.offset;
+  state.limit = order.limit;
+
+  for (int i = 0; i < 2; i++) {
+    if (!filter[i].empty()) where[i].push_back(filter[i]);
+    tuples[i] = estimateTuples(t[i], where[i]);
+    pages[i] = tablePages(t[i]);
+
+    // scanTable() reads an indexed table in key order, so each tuple may
+    // be on another page than the one before, unless the statistics say
+    // that reading the table file is cheaper
+    leaves[i] = t[i]->hasIndex ? tuples[i] / leaf.getMaxKeyCount() + t[i]->idx.getTreeHeight() : 0;
+    scan[i] = (t[i]->hasIndex && indexCheaper(t[i], where[i], 0)) ? leaves[i] + tuples[i] : pages[i];
+  }
+
+  // a merge join reads the tuples of a table only for a value that is
+  // printed, compared or in a condition on the table
+  bool fetch[2];
+  for (int i = 0; i < 2; i++) fetch[i] = (attr == 3 || !keysOnly(where[i]));
+  for (unsigned i = 0; i < refs.size(); i++) {
+    if (refs[i].attr == 2) fetch[refs[i].side] = true;
+  }
+  for (unsigned i = 0; i < checks.size(); i++) {
+    if (checks[i].column.attr == 2) fetch[checks[i].column.side] = true;
+    if (checks[i].other.attr == 2) fetch[checks[i].other.side] = true;
+  }
+
+  // the plan: the cost of each join is estimated in page reads. a hash
+  // join reads both tables, twice more if it has to partition them. an
+  // index nested-loop join reads the outer table and, for each outer
+  // tuple, the inner index from the root and the matching inner tuple.
+  // a merge join reads the leaf nodes of both indexes once and, for each
+  // batch of matching tuples, the table pages that hold them.
+  int  equi = -1;            // the join condition of the chosen plan
+  int  inner = -1;           // the inner table of an index join, -1 for a hash join
+  bool merge = false;        // whether the plan is a merge join
+  int  build = tuples[0] <= tuples[1] ? 0 : 1;
+  double best = scan[0] + scan[1];
+  double bytes = JOIN_TUPLE_BYTES;
+  if (t[build]->stats.isValid()) bytes = sizeof(int) * 4 + t[build]->stats.getAvgValueLength() + 1;
+  if (tuples[build] * bytes > (double) JOIN_MEMORY) best *= 3;
+
+  for (unsigned i = 0; i < checks.size(); i++) {
+    const JoinCheck& c = checks[i];
+    if (c.comp != SelCond::EQ || c.column.side == c.other.side) continue;
+    if (equi < 0) equi = i;
+
+    // both tables are read in key order through their indexes
+    if (c.column.attr == 1 && c.other.attr == 1 && t[0]->hasIndex && t[1]->hasIndex) {
+      long long matches = min(tuples[0], tuples[1]);
+      long long batches = (matches + MERGE_BATCH - 1) / MERGE_BATCH;
+      double cost = leaves[0] + leaves[1];
+      for (int k = 0; k < 2; k++) {
+        if (fetch[k]) cost += min(matches, batches * min(pages[k], (long long) MERGE_BATCH));
+      }
+      if (cost < best) {
+        best = cost;
+        equi = i;
+        inner = -1;
+        merge = true;
+      }
+    }
+
+    // the inner table is joined on its key and needs an index
+    for (int k = 0; k < 2; k++) {
+      const JoinRef& in = (k == 0) ? c.column : c.other;
+      int outer = 1 - in.side;
+      if (in.attr != 1 || !t[in.side]->hasIndex) continue;
+      double cost = scan[outer] + tuples[outer] * (t[in.side]->idx.getTreeHeight() + 1);
+      if (cost < best) {
+        best = cost;
+        equi = i;
+        inner = in.side;
+        merge = false;
+      }
+    }
+  }
+  if (equi < 0) {
+    fprintf(session.err, "Error: a join needs an equality condition between the two tables\n");
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  // the join condition is met by the plan; the others are checked on
+  // each joined pair
+  const JoinCheck& jc = checks[equi];
+  for (unsigned i = 0; i < checks.size(); i++) {
+    if ((int) i != equi) state.checks.push_back(checks[i]);
+  }
+  int attrOf[2];
+  attrOf[jc.column.side] = jc.column.attr;
+  attrOf[jc.other.side] = jc.other.attr;
+
+  // the plan is the join with the reads of the two tables below it
+  QueryPlan* plan = session.plan;
+  int        join = -1, child[2] = { -1, -1 };  // the operators of the plan
+  if (plan != NULL) {
+    string on = t[jc.column.side]->name + "." + ATTR_NAMES[jc.column.attr] + " = " +
+                t[jc.other.side]->name + "." + ATTR_NAMES[jc.other.attr];
+    double rows = min(tuples[0], tuples[1]);
+
+    if (merge) {
+      join = plan->add(-1, "Merge Join on " + on + limitText(order), attr == 4 ? 1 : limitRows(rows, order));
+      for (int i = 0; i < 2; i++) child[i] = plan->add(join, scanName(t[i], where[i], fetch[i] ? 0 : SCAN_KEYS), tuples[i]);
+    } else if (inner >= 0) {
+      int outer = 1 - inner;
+      join = plan->add(-1, "Index Nested Loop Join on " + on + limitText(order), attr == 4 ? 1 : limitRows(rows, order));
+      child[outer] = plan->add(join, scanName(t[outer], where[outer], SCAN_ANY_ORDER), tuples[outer]);
+      child[inner] = plan->add(join, "Index Lookup on " + t[inner]->name, rows);
+    } else {
+      bool partitioned = tuples[build] * bytes > (double) JOIN_MEMORY;
+      join = plan->add(-1, "Hash Join on " + on + (partitioned ? " (partitioned)" : "") + limitText(order),
+                       attr == 4 ? 1 : limitRows(rows, order));
+      child[build] = plan->add(join, "Build: " + scanName(t[build], where[build], SCAN_ANY_ORDER), tuples[build]);
+      child[1 - build] = plan->add(join, "Probe: " + scanName(t[1 - build], where[1 - build], SCAN_ANY_ORDER), tuples[1 - build]);
+    }
+
+    if (!plan->isAnalyze()) return 0;
+    plan->enter(join);
+  }
+
+  if (merge) {
+    vector<KeyRange> ranges[2], both;
+    MergeState m;
+    for (int i = 0; i < 2; i++) {
+      m.t[i] = t[i];
+      m.where[i] = &where[i];
+      m.fetch[i] = fetch[i];
+      m.end[i] = visibleEnd(t[i]);
+      keyRanges(where[i], ranges[i]);
+    }
+    m.state = &state;
+    m.plan = plan;
+    m.node[0] = child[0];
+    m.node[1] = child[1];
+    intersectRanges(ranges[0], ranges[1], both);
+    rc = mergeJoin(m, both);
+  } else if (inner >= 0) {
+    int outer = 1 - inner;
+    IndexJoinState s = { t[inner], &where[inner], attrOf[outer], inner == 0, &state, 0, plan, child[inner], join,
+                          visibleEnd(t[inner]) };
+    rc = planScan(plan, child[outer], join, t[outer], where[outer], SCAN_ANY_ORDER, lookupTuple, &s);
+    if (rc == 0) rc = s.rc;
+  } else {
+    HashJoin hash(attrOf[build], attrOf[1 - build], JOIN_MEMORY);
+    HashJoinState s = { &hash, &state, build == 0, 0 };
+    rc = planScan(plan, child[build], join, t[build], where[build], SCAN_ANY_ORDER, buildTuple, &s);
+    if (rc == 0) rc = s.rc;
+    if (rc == 0) rc = planScan(plan, child[1 - build], join, t[1 - build], where[1 - build], SCAN_ANY_ORDER, probeTuple, &s);
+    if (rc == 0) rc = s.rc;
+    if (rc == 0 && state.limit != 0) rc = hash.finish(hashJoinPair, &s);
+  }
+  if (plan != NULL) plan->addRows(join, attr == 4 ? 1 : state.count);
+
+  if (rc < 0) {
+    fprintf(session.err, "Error: while joining tables %s and %s\n", t[0]->name.c_str(), t[1]->name.c_str());
+    return rc;
+  }
+
+  // print the joined tuple count if "select count(*)", which is one row
+  if (attr == 4 && order.offset == 0 && order.limit != 0) {
+    fprintf(session.out, "%d\n", state.count);
+  }
+
+  return 0;
+}
+
+static long long estimateTuples(TableHandle* t, const WhereClause& where)
+{
+  vector<KeyRange> ranges;
+  RecordId end = visibleEnd(t);
+  long long tuples = (long long) end.pid * RecordFile::RECORDS_PER_PAGE + end.sid;
+
+  // the statistics give the fraction of the tuples, which stays about
+  // the same as tuples are inserted after they were collected
+  if (t->stats.isValid()) return (long long) (tuples * selectivity(t, where) + 0.5);
+
+  if (!t->hasIndex) return tuples;
+
+  long long keys = 0;
+  keyRanges(where, ranges);
+  for (unsigned i = 0; i < ranges.size(); i++) keys += (long long) ranges[i].hi - ranges[i].lo + 1;
+  return min(tuples, keys);
+}
+
+static double selectivity(TableHandle* t, const WhereClause& where)
+{
+  const TableStats& st = t->stats;
+  double total = 0;
+
+  if (where.empty()) return 1;
+
+  for (unsigned i = 0; i < where.size(); i++) {
+    const vector<SelCond>& cond = where[i];
+    vector<KeyRange> ranges;
+    double s = 0;
+
+    // the key conditions by the histogram
+    keyRanges(WhereClause(1, cond), ranges);
+    for (unsigned r = 0; r < ranges.size(); r++) s += st.keySelectivity(ranges[r].lo, ranges[r].hi);
+
+    // the value conditions by the distinct values, or a third of the
+    // tuples for a comparison
+    for (unsigned j = 0; j < cond.size(); j++) {
+      if (cond[j].attr != 2) continue;
+      switch (cond[j].comp) {
+      case SelCond::EQ: s *= st.valueSelectivity(); break;
+      case SelCond::IN: s *= min(1.0, cond[j].list.size() * st.valueSelectivity()); break;
+      case SelCond::NE: break;
+      default: s /= 3; break;
+      }
+    }
+
+    // the conjunctions are taken to select different tuples
+    total += s;
+  }
+
+  return min(1.0, total);
+}
+
+static long long tablePages(TableHandle* t)
+{
+  RecordId end = visibleEnd(t);
+  return end.pid + (end.sid > 0 ? 1 : 0);
+}
+
+static double indexCost(TableHandle* t, const WhereClause& where, int flags)
+{
+  BTLeafNode leaf;
+  long long  tuples = estimateTuples(t, where);
+
+  // the leaf nodes over the matching keys, and the table page of each
+  // tuple unless the index holds all that is needed
+  double cost = (double) tuples / leaf.getMaxKeyCount() + t->idx.getTreeHeight();
+  if (!((flags & SCAN_KEYS) && keysOnly(where))) cost += tuples;
+  return cost;
+}
+
+static bool indexCheaper(TableHandle* t, const WhereClause& where, int flags)
+{
+  if (!t->stats.isValid()) return true;
+  return indexCost(t, where, flags) <= tablePages(t);
+}
+
+static RC analyzeRecords(RecordFile& rf, TableStats& stats)
+{
+  RecordId rid = { 0, 0 };
+  RecordId end = rf.endRid();
+  int      key;
+  string   value;
+  RC       rc;
+
+  stats.start();
+  for (; rid < end; ++rid) {
+    if ((rc = rf.read(rid, key, value)) == RC_NO_SUCH_RECORD) continue;
+    if (rc < 0) return rc;
+    stats.add(key, value);
+  }
+  stats.finish(end.pid + (end.sid > 0 ? 1 : 0));
+
+  return 0;
+}
+
+static bool compareColumns(int attr, int key, const char* value, SelCond::Comparator comp, int otherAttr, int otherKey, const char* otherValue)
+{
+  char buf[16];
+  int  diff;
+
+  if (attr == 1 && otherAttr == 1) {
+    diff = (key > otherKey) - (key < otherKey);
+  } else if (attr == 2 && otherAttr == 2) {
+    diff = strcmp(value, otherValue);
+  } else if (comp == SelCond::EQ || comp == SelCond::NE) {
+    snprintf(buf, sizeof(buf), "%d", attr == 1 ? key : otherKey);
+    diff = strcmp(buf, attr == 1 ? otherValue : value);
+  } else {
+    int a = (attr == 1) ? key : atoi(value);
+    int b = (otherAttr == 1) ? otherKey : atoi(otherValue);
+    diff = (a > b) - (a < b);
+  }
+
+  switch (comp) {
+  case SelCond::EQ: return diff == 0;
+  case SelCond::NE: return diff != 0;
+  case SelCond::GT: return diff > 0;
+  case SelCond::LT: return diff < 0;
+  case SelCond::GE: return diff >= 0;
+  case SelCond::LE: return diff <= 0;
+  default: return false;
+  }
+}
+
+// the index entries of LOAD in key order, for BTreeIndex::bulkLoad()
+static RC sortedEntry(void* arg, int& key, RecordId& rid)
+{
+  const char* value;
+
+  return ((ExternalSort*) arg)->next(key, value, rid);
+}
+
+// add the sorted index entries of the tuples that LOAD appended. the
+// merge copies only the nodes on the paths to the leaf nodes that get
+// keys; the statements reading the tree skip the new keys, since they
+// are past the end of their snapshots.
+static RC addEntries(TableHandle* t, ExternalSort* sorter)
+{
+  return t->idx.merge(sortedEntry, sorter);
+}
+
+RC SqlEngine::load(SqlSession& session, const string& table, const string& loadfile, bool index, bool columns, bool lsm)
+{
+  TableHandle* t;  // the shared handle of the table
+  RecordId   rid;  // record cursor for table scanning
+  ifstream ifs;    // Input file stream for the load file
+  ExternalSort* sorter = NULL;  // the new index entries, in key order
+  RecordId   start;             // the end of the table before the load
+  RecordId   end;               // the end of the table after the load
+  bool       indexed = true;    // whether every new tuple went into sorter
+  TableStats stats;             // the statistics of the table after the load
+  vector<unsigned long long> hashes;  // the Bloom filter hashes of the new tuples
+
+  int    ret = 0;
+  int    key;     
+  string value;
+  string line;
+
+  // a new table is created in the layout asked for, and an index asked
+  // for is built over the tuples the table has, or made log-structured,
+  // before other sessions can use them
+  t = getTable(table);
+  pthread_rwlock_wrlock(&t->latch);
+  if (!t->isOpen) ret = openTableFiles(t, columns);
+  else if (t->hasIndex) t->idx.releasePages();
+  if (ret == 0 && index && (!t->hasIndex || (lsm && !t->idx.isLogStructured()))) {
+    if (t->hasIndex) {
+      ret = t->idx.makeLogStructured();
+    } else if ((ret = t->idx.open(table + ".idx", 'w')) == 0 && (!lsm || (ret = t->idx.makeLogStructured()) == 0)) {
+      t->hasIndex = true;
+      ret = rebuildIndex(t);
+    }
+    if (ret < 0) {
+      fprintf(session.err, "Error: Cannot access/create %s index file\n", loadfile.c_str());
+      pthread_rwlock_unlock(&t->latch);
+      return ret;
+    }
+  }
+  pthread_rwlock_unlock(&t->latch);
+
+  // the tuples are appended under the shared latch, so other sessions go
+  // on reading the table as it was before the load until it is committed.
+  // t->lock keeps INSERT and DELETE out until then.
+  if ((ret = acquireTable(t, true)) < 0) {
+    fprintf(session.err, "Error: Cannot access/create table %s\n", table.c_str());
+    return ret;
+  }
+  pthread_mutex_lock(&t->lock);
+  start = t->rf.endRid();
+  stats.start();
+
+  // the new index entries are merged with those of the index into a new
+  // tree at the end, which leaves the tree that statements read as it is,
+  // or inserted into it if they are few
+  if (t->hasIndex) {
+    sorter = new ExternalSort(1, false, -1, SORT_MEMORY, scanWorkers() > 0 ? &scanPool : NULL);
+  }
+
+  // open the load file
+  ifs.open(loadfile.c_str(), ifstream::in);
+  if (ret = !ifs.is_open()) {
+    fprintf(session.err, "Error: Cannot open %s file\n", loadfile.c_str());
+    goto exit_load;
+  }
+
+  // read load file line by line and insert, parse and insert tuples into record file and index
+  getline(ifs, line);
+  for (unsigned lineNum = 1; ifs.good(); lineNum++) {
+    if (parseLoadLine(line, key, value)) {
+      fprintf(session.err, "Warning: Could not parse line %u from file %s\n", lineNum, loadfile.c_str());
+      goto next_line;
+    }
+
+    if (t->rf.append(key, value, rid)) {
+      fprintf(session.err, "Warning: Could not insert tuple with key %i into %s RecordFile\n", key, table.c_str());
+      goto next_line;
+    }
+    hashes.push_back(BloomFilter::hashKey(key));
+    hashes.push_back(BloomFilter::hashValue(value.c_str()));
+    stats.add(key, value);
+
+    if (sorter != NULL && indexed && sorter->add(key, "", rid)) {
+      fprintf(session.err, "Warning: Could not insert key %i into index\n", key);
+      indexed = false;
+    }
+    next_line:
+    getline(ifs, line);
+  }
+  ret = 1;
+
+  // merge the new keys into the index. if they cannot be merged, the
+  // new tuples are inserted into the tree one by one instead.
+  if (sorter != NULL && (!indexed || sorter->sort() < 0 || addEntries(t, sorter) < 0)) {
+    fprintf(session.err, "Warning: Could not build the index of table %s, adding the keys one by one\n", table.c_str());
+    if (recoverIndex(t) < 0) {
+      fprintf(session.err, "Error: Could not build the index of table %s\n", table.c_str());
+    }
+  }
+  if (loadBloom(t->rf, table, start, hashes) < 0) {
+    fprintf(session.err, "Warning: Could not build the Bloom filters of table %s\n", table.c_str());
+  }
+
+  // the filters that statements use lose no tuple before they see it.
+  // they are replaced by the filters sized for the table below.
+  for (unsigned i = 0; i + 1 < hashes.size(); i += 2) t->bloom.addHashes(hashes[i], hashes[i + 1]);
+
+  // the statistics of a table that was empty are collected on the way;
+  // those of a table that had tuples are collected again from all of them
+  if (start.pid == 0 && start.sid == 0) {
+    rid = t->rf.endRid();
+    stats.finish(rid.pid + (rid.sid > 0 ? 1 : 0));
+  } else if (analyzeRecords(t->rf, stats) < 0) {
+    stats.clear();
+  }
+  if (!stats.isValid() || stats.save(table + ".stats") < 0) {
+    fprintf(session.err, "Warning: Could not collect the statistics of table %s\n", table.c_str());
+  }
+
+  // commit the table and then the index that covers it, and let the
+  // other sessions see the new tuples
+  exit_load:
+  ifs.close();
+  end = t->rf.endRid();
+  if (t->rf.sync() < 0 || (t->hasIndex && t->idx.commit(end, false) < 0)) {
+    fprintf(session.err, "Error: Could not commit table %s\n", table.c_str());
+  }
+  publishEnd(t);
+  catalog.update(table, t->rf.hasColumns(), t->hasIndex, end);
+  catalog.save(CATALOG_FILE);
+  pthread_mutex_unlock(&t->lock);
+  releaseTable(t);
+  delete sorter;
+
+  // the filters and statistics of the table are replaced, and the pages
+  // of the index tree replaced by this load and earlier ones freed, if no
+  // statement is using it; otherwise the next open of the table reads
+  // them, or the next load frees them
+  if (ret == 1 && pthread_rwlock_trywrlock(&t->latch) == 0) {
+    if (t->isOpen) {
+      t->bloom.clear();
+      openBloom(t);
+      if (stats.isValid()) t->stats = stats;
+      if (t->hasIndex) t->idx.releasePages();
+    }
+    pthread_rwlock_unlock(&t->latch);
+  }
+
+  return ret;
+}
+
+RC SqlEngine::analyze(SqlSession& session, const string& table)
+{
+  TableHandle* t;
+  TableStats   stats;
+  RC rc;
+
+  if ((rc = openTable(table, false, t)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  // the table is read like a scan, so other sessions may go on using it
+  rc = analyzeRecords(t->rf, stats);
+  if (rc == 0) rc = stats.save(table + ".stats");
+  releaseTable(t);
+
+  if (rc < 0) {
+    fprintf(session.err, "Error: Could not analyze table %s\n", table.c_str());
+    return rc;
+  }
+
+  // statements read the statistics under the shared table latch
+  pthread_rwlock_wrlock(&t->latch);
+  if (t->isOpen) t->stats = stats;
+  pthread_rwlock_unlock(&t->latch);
+
+  return 0;
+}
+
+// the names of the disk operations in SHOW STATS
+static const char* IO_OP_NAMES[IoStats::OPS] = { "read", "write", "sync" };
+
+// add the counters in from to those in to
+static void addIoCounters(IoStats::Counters& to, const IoStats::Counters& from)
+{
+  long long* t = (long long*) &to;
+  const long long* f = (const long long*) &from;
+
+  for (size_t i = 0; i < sizeof(IoStats::Counters) / sizeof(long long); i++) t[i] += f[i];
+}
+
+// print a line of SHOW STATS, followed by the latencies of its disk
+// operations. the percentiles are the upper bounds of their buckets.
+static void printIoCounters(FILE* out, const string& subsystem, const string& file, const IoStats::Counters& c)
+{
+  fprintf(out, "%-9s %-24s %10lld %10lld %11lld %10lld %10lld %11lld %12lld %13lld %8lld\n",
+          subsystem.c_str(), file.c_str(), c.reads, c.hits, c.diskReads, c.evictions,
+          c.writes, c.diskWrites, c.bytesRead, c.bytesWritten, c.syncs);
+
+  for (int op = 0; op < IoStats::OPS; op++) {
+    const long long* buckets = c.latency[op];
+    long long count = 0;
+    int p50 = -1, p99 = -1;
+
+    for (int b = 0; b < IoStats::LATENCY_BUCKETS; b++) count += buckets[b];
+    if (count == 0) continue;
+
+    long long seen = 0;
+    for (int b = 0; b < IoStats::LATENCY_BUCKETS; b++) {
+      seen += buckets[b];
+      if (p50 < 0 && seen * 2 >= count) p50 = b;
+      if (p99 < 0 && seen * 100 >= count * 99) p99 = b;
+    }
+
+    fprintf(out, "%-9s   %s latency: %lld, mean %.1f us", "", IO_OP_NAMES[op], count, c.nanos[op] / 1e3 / count);
+    if (p50 < IoStats::LATENCY_BUCKETS - 1) fprintf(out, ", p50 < %lld us", 1LL << p50);
+    else fprintf(out, ", p50 >= %lld us", 1LL << (p50 - 1));
+    if (p99 < IoStats::LATENCY_BUCKETS - 1) fprintf(out, ", p99 < %lld us\n", 1LL << p99);
+    else fprintf(out, ", p99 >= %lld us\n", 1LL << (p99 - 1));
+  }
+}
+
+RC SqlEngine::showStats(SqlSession& session)
+{
+  vector<IoStats*> all;
+  IoStats::Counters c, total;
+
+  fprintf(session.out, "%-9s %-24s %10s %10s %11s %10s %10s %11s %12s %13s %8s\n",
+          "subsystem", "file", "reads", "hits", "disk reads", "evictions",
+          "writes", "disk writes", "bytes read", "bytes written", "syncs");
+
+  // the files come ordered by subsystem, and each subsystem ends with its
+  // totals
+  IoStats::getAll(all);
+  memset(&total, 0, sizeof(total));
+  for (unsigned i = 0; i < all.size(); i++) {
+    all[i]->read(c);
+    printIoCounters(session.out, all[i]->getSubsystem(), all[i]->getName(), c);
+    addIoCounters(total, c);
+
+    if (i + 1 == all.size() || all[i + 1]->getSubsystem() != all[i]->getSubsystem()) {
+      printIoCounters(session.out, all[i]->getSubsystem(), "(total)", total);
+      memset(&total, 0, sizeof(total));
+    }
+  }
+
+  return 0;
+}
+
+RC SqlEngine::insert(SqlSession& session, const string& table, int key, const string& value)
+{
+  TableHandle* t;
+  RecordId     rid;
+  LogSeqNum    lsn;
+  RC           rc;
+
+  if ((rc = openTable(table, true, t)) < 0) {
+    fprintf(session.err, "Error: Cannot access/create table %s\n", table.c_str());
+    return rc;
+  }
+
+  pthread_mutex_lock(&t->lock);
+
+  if ((rc = openLog(t)) < 0) {
+    fprintf(session.err, "Error: Cannot open the log of table %s\n", table.c_str());
+    pthread_mutex_unlock(&t->lock);
+    releaseTable(t);
+    return rc;
+  }
+
+  // apply the change to the cached table and index pages. the filters
+  // hold the tuple before a scan can find it in the table file.
+  t->bloom.add(key, value);
+  if ((rc = t->rf.append(key, value, rid)) < 0) {
+    fprintf(session.err, "Error: Could not insert tuple with key %i into %s\n", key, table.c_str());
+    pthread_mutex_unlock(&t->lock);
+    releaseTable(t);
+    return rc;
+  }
+  if (t->hasIndex && (rc = t->idx.insert(key, rid)) < 0) {
+    fprintf(session.err, "Warning: Could not insert key %i into index\n", key);
+  }
+  publishEnd(t);
+
+  // record the change in the log; the pages themselves are written later
+  t->log.append(LogFile::LOG_INSERT, key, rid, value, lsn);
+  if (t->log.size() > CHECKPOINT_LOG_SIZE) checkpoint(t);
+
+  pthread_mutex_unlock(&t->lock);
+
+  // wait until the log record is durable. concurrent writers that get
+  // here at the same time share a single fsync.
+  rc = t->log.commit(lsn);
+  releaseTable(t);
+  return rc;
+}
+
+//
+// the tuples to delete, collected by removeTuple() during scanTable()
+//
+struct RemoveState {
+  vector<int>      keys;
+  vector<RecordId> rids;
+};
+
+static bool removeTuple(void* arg, int key, const string& value, const RecordId& rid)
+{
+  RemoveState* s = (RemoveState*) arg;
+
+  s->keys.push_back(key);
+  s->rids.push_back(rid);
+  return true;
+}
+
+RC SqlEngine::remove(SqlSession& session, const string& table, const WhereClause& where)
+{
+  TableHandle* t;
+  RemoveState  state;  // the tuples to delete
+  LogSeqNum    lsn = 0;
+  RC           rc;
+
+  if (hasPlaceholder(where)) {
+    fprintf(session.err, "Error: ? can only be used in PREPARE\n");
+    return RC_INVALID_PARAMETER;
+  }
+
+  if ((rc = openTable(table, false, t)) < 0) {
+    fprintf(session.err, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  pthread_mutex_lock(&t->lock);
+
+  if ((rc = openLog(t)) < 0) {
+    fprintf(session.err, "Error: Cannot open the log of table %s\n", table.c_str());
+    pthread_mutex_unlock(&t->lock);
+    releaseTable(t);
+    return rc;
+  }
+
+  // collect the matching tuples first, then remove them
+  if ((rc = scanTable(t, where, SCAN_KEYS, removeTuple, &state)) < 0) {
+    fprintf(session.err, "Error: while reading a tuple from table %s\n", table.c_str());
+    pthread_mutex_unlock(&t->lock);
+    releaseTable(t);
+    return rc;
+  }
+
+  // remove the tuples and log each removal
+  rc = 0;
+  for (unsigned i = 0; i < state.rids.size(); i++) {
+    if ((rc = t->rf.remove(state.rids[i])) < 0) {
+      fprintf(session.err, "Error: Could not delete tuple with key %i from %s\n", state.keys[i], table.c_str());
+      break;
+    }
+    if (t->hasIndex) t->idx.remove(state.keys[i], state.rids[i]);
+    t->log.append(LogFile::LOG_DELETE, state.keys[i], state.rids[i], "", lsn);
+  }
+  if (t->log.size() > CHECKPOINT_LOG_SIZE) checkpoint(t);
+
+  pthread_mutex_unlock(&t->lock);
+
+  if (lsn > 0) {
+    RC ret = t->log.commit(lsn);
+    if (rc == 0) rc = ret;
+  }
+  releaseTable(t);
+  return rc;
+}
+
+RC SqlEngine::shutdown()
+{
+  RC rc = 0, ret;
+
+  pthread_mutex_lock(&scanPoolLock);
+  scanPool.stop();
+  pthread_mutex_unlock(&scanPoolLock);
+
+  pthread_mutex_lock(&tablesLock);
+  for (map<string, TableHandle*>::iterator it = tables.begin(); it != tables.end(); ++it) {
+    TableHandle* t = it->second;
+    pthread_rwlock_wrlock(&t->latch);
+    if ((ret = closeTableFiles(t)) < 0) rc = ret;
+    pthread_rwlock_unlock(&t->latch);
+    pthread_rwlock_destroy(&t->latch);
+    pthread_mutex_destroy(&t->lock);
+    delete t;
+  }
+  tables.clear();
+  if (catalogLoaded) catalog.save(CATALOG_FILE);
+  pthread_mutex_unlock(&tablesLock);
+
+  return rc;
+}
+
+static TableHandle* getTable(const string& table)
+{
+  TableHandle* t;
+
+  pthread_mutex_lock(&tablesLock);
+
+  // a catalog that cannot be read is as good as an empty one
+  if (!catalogLoaded) {
+    catalog.load(CATALOG_FILE);
+    catalogLoaded = true;
+  }
+
+  map<string, TableHandle*>::iterator it = tables.find(table);
+  if (it != tables.end()) {
+    t = it->second;
+  } else {
+    t = new TableHandle;
+    t->name = table;
+    pthread_rwlock_init(&t->latch, NULL);
+    pthread_mutex_init(&t->lock, NULL);
+    t->isOpen = false;
+    t->hasIndex = false;
+    t->logOpen = false;
+    t->visible.pid = t->visible.sid = 0;
+    tables[table] = t;
+  }
+
+  pthread_mutex_unlock(&tablesLock);
+  return t;
+}
+
+static RC openTable(const string& table, bool create, TableHandle*& t)
+{
+  t = getTable(table);
+  return acquireTable(t, create);
+}
+
+static RC acquireTable(TableHandle* t, bool create)
+{
+  RC rc = 0;
+
+  pthread_rwlock_rdlock(&t->latch);
+  while (!t->isOpen) {
+    // the files are opened under the exclusive latch. another session
+    // may open them first, or a LOAD may close them again before we get
+    // the shared latch back.
+    pthread_rwlock_unlock(&t->latch);
+    pthread_rwlock_wrlock(&t->latch);
+    if (!t->isOpen) {
+      if (!create && !tableExists(t->name)) {
+        rc = RC_FILE_OPEN_FAILED;
+      } else {
+        rc = openTableFiles(t, false);
+      }
+    }
+    pthread_rwlock_unlock(&t->latch);
+    if (rc < 0) return rc;
+    pthread_rwlock_rdlock(&t->latch);
+  }
+
+  return 0;
+}
+
+static void releaseTable(TableHandle* t)
+{
+  pthread_rwlock_unlock(&t->latch);
+}
+
+static RecordId visibleEnd(TableHandle* t)
+{
+  RecordId end;
+
+  __atomic_load(&t->visible, &end, __ATOMIC_ACQUIRE);
+  return end;
+}
+
+static void publishEnd(TableHandle* t)
+{
+  RecordId end = t->rf.endRid();
+
+  // the tuples before end are in the table file, and in the index and
+  // the Bloom filters, before statements can see them
+  __atomic_store(&t->visible, &end, __ATOMIC_RELEASE);
+}
+
+static bool tableExists(const string& table)
+{
+  Catalog::Entry e;
+
+  if (catalog.find(table, e)) return true;
+  return access((table + ".tbl").c_str(), F_OK) == 0 || access((table + ".key").c_str(), F_OK) == 0;
+}
+
+static RC openRecords(RecordFile& rf, const string& table, bool columns)
+{
+  Catalog::Entry e;
+  RC rc;
+
+  // a table stored by rows is in a .tbl file. one stored by columns has
+  // its keys in a .key file and its values in a .val file.
+  if (catalog.find(table, e) ? e.columns :
+      (access((table + ".key").c_str(), F_OK) == 0 || (columns && !tableExists(table)))) {
+    return rf.open(table + ".key", table + ".val", 'w');
+  }
+  if ((rc = rf.open(table + ".tbl", 'w')) < 0) return rc;
+
+  // the zone map in the .zone file lets scans skip pages. a table whose
+  // zone map cannot be opened is scanned in full.
+  rf.openZones(table + ".zone");
+  return 0;
+}
+
+static RC openTableFiles(TableHandle* t, bool columns)
+{
+  struct stat statbuf;
+  Catalog::Entry e;
+  RC rc;
 
-  // set the command line input and start parsing user input
-  sqlin = commandline;
-  sqlparse();  // sqlparse() is defined in SqlParser.tab.c generated from
-               // SqlParser.y by bison (bison is GNU equivalent of yacc)
+  // the catalog saves looking for the files of a table that has not
+  // changed since it was last closed
+  bool known = catalog.find(t->name, e);
+  t->hasIndex = known ? e.hasIndex : (access((t->name + ".idx").c_str(), F_OK) == 0);
+
+  if ((rc = openRecords(t->rf, t->name, columns)) < 0) return rc;
+  if (known && t->rf.endRid() != e.end) catalog.remove(t->name);
+  if (t->hasIndex && (rc = t->idx.open(t->name + ".idx", 'w')) < 0) {
+    t->rf.close();
+    return rc;
+  }
+  t->isOpen = true;
 
+  if (t->hasIndex && recoverIndex(t) < 0) {
+    fprintf(stderr, "Error: Could not recover the index of table %s\n", t->name.c_str());
+  }
+
+  // a log that outlived its table handle means the last run did not
+  // shut down; redo the changes that did not reach the table
+  if (stat((t->name + ".log").c_str(), &statbuf) == 0 && statbuf.st_size > 0) {
+    if ((rc = openLog(t)) < 0 || (rc = replayLog(t)) < 0) {
+      fprintf(stderr, "Error: Could not recover table %s from its log\n", t->name.c_str());
+    }
+  }
+
+  openBloom(t);
+
+  // a table without statistics is planned by fixed rules
+  t->stats.load(t->name + ".stats");
+  publishEnd(t);
   return 0;
 }
 
-RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
+static RC closeTableFiles(TableHandle* t)
 {
-  RecordFile rf;       // RecordFile containing the table
-  RecordId   rid;      // record cursor for table scanning
-  BTreeIndex bti;      // BTree Index for iterating through the index
-  IndexCursor cursor;  // cursor for scanning index contents
+  RC rc;
 
-  RC     rc;
-  int    key;     
-  string value;
-  int    count;
-  int    diff;
-  int    index;
+  if (!t->isOpen) return 0;
 
-  // open the table file
-  if ((rc = rf.open(table + ".tbl", 'r')) < 0) {
-    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+  rc = checkpoint(t);
+  bool columns = t->rf.hasColumns();
+  RecordId end = t->rf.endRid();
+  t->rf.close();
+  catalog.update(t->name, columns, t->hasIndex, end);
+  t->bloom.clear();
+  t->stats.clear();
+  if (t->hasIndex) t->idx.close();
+  if (t->logOpen) t->log.close();
+  t->isOpen = false;
+  t->logOpen = false;
+
+  return rc;
+}
+
+static RC openLog(TableHandle* t)
+{
+  RC rc;
+
+  if (t->logOpen) return 0;
+  if ((rc = t->log.open(t->name + ".log")) < 0) return rc;
+  t->logOpen = true;
+
+  return 0;
+}
+
+static RC replayLog(TableHandle* t)
+{
+  LogRecord rec;
+  RecordId  rid;
+  RC        rc;
+  int       n;
+
+  for (n = 0; t->log.read(n, rec) == 0; n++) {
+    switch (rec.type) {
+    case LogFile::LOG_INSERT:
+      // the tuple reached the table file if its slot is below the end rid
+      if (rec.rid < t->rf.endRid()) {
+        rid = rec.rid;
+      } else if ((rc = t->rf.append(rec.key, rec.value, rid)) < 0) {
+        return rc;
+      }
+      if (t->hasIndex && !indexContains(t->idx, rec.key, rid)) {
+        if ((rc = t->idx.insert(rec.key, rid)) < 0) return rc;
+      }
+      break;
+    case LogFile::LOG_DELETE:
+      // both removals are no-ops if they were already applied
+      if ((rc = t->rf.remove(rec.rid)) < 0) return rc;
+      if (t->hasIndex) t->idx.remove(rec.key, rec.rid);
+      break;
+    }
+  }
+
+  // make the recovered state durable so the log can be emptied
+  return (n > 0) ? checkpoint(t) : 0;
+}
+
+static RC recoverIndex(TableHandle* t)
+{
+  RecordId rid;
+  RecordId end = t->rf.endRid();
+  RecordId from = t->idx.getIndexedEnd();
+  int      key;
+  string   value;
+  RC       rc;
+
+  if (from == end && !t->idx.isLoading()) return 0;
+
+  // a LOAD that committed the index with the loading flag and did not
+  // finish updated its nodes in place, so the tree of that commit is gone
+  if (t->idx.isLoading() || from > end) return rebuildIndex(t);
+
+  // neither file overwrites a page its last commit covers before the
+  // next one, so after a crash the index is the tree of its commit and
+  // covers the table exactly up to from. the tuples after it are added.
+  for (rid = from; rid < end; ++rid) {
+    if ((rc = t->rf.read(rid, key, value)) == RC_NO_SUCH_RECORD) continue;
+    if (rc < 0) return rc;
+    if (!indexContains(t->idx, key, rid) && (rc = t->idx.insert(key, rid)) < 0) return rc;
+  }
+
+  return t->idx.commit(end, false);
+}
+
+static RC rebuildIndex(TableHandle* t)
+{
+  ExternalSort sorter(1, false, -1, SORT_MEMORY, scanWorkers() > 0 ? &scanPool : NULL);
+  RecordId     rid;
+  RecordId     end = t->rf.endRid();
+  string       indexname = t->name + ".idx";
+  int          key;
+  string       value;
+  RC           rc;
+
+  // the index keeps being log-structured
+  bool lsm = t->idx.isLogStructured();
+  t->idx.close();
+  unlink(indexname.c_str());
+  if ((rc = t->idx.open(indexname, 'w')) < 0 || (lsm && (rc = t->idx.makeLogStructured()) < 0)) {
+    t->hasIndex = false;
     return rc;
   }
 
-  count = 0;
-  if (bti.open(table + ".idx", 'r')) {
-    // scan the table file from the beginning
-    rid.pid = rid.sid = 0;
-    while (rid < rf.endRid()) {
-      // read the tuple
-      if ((rc = rf.read(rid, key, value)) < 0) {
-        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
-        goto exit_select;
-      }
+  for (rid.pid = rid.sid = 0; rid < end; ++rid) {
+    if ((rc = t->rf.read(rid, key, value)) == RC_NO_SUCH_RECORD) continue;
+    if (rc < 0 || (rc = sorter.add(key, "", rid)) < 0) return rc;
+  }
+  if ((rc = sorter.sort()) < 0 || (rc = t->idx.bulkLoad(sortedEntry, &sorter)) < 0) return rc;
 
-      // check the conditions on the tuple
-      for (unsigned i = 0; i < cond.size(); i++) {
-        // compute the difference between the tuple value and the condition value
-        switch (cond[i].attr) {
-        case 1:
-          diff = key - atoi(cond[i].value);
-          break;
-        case 2:
-    	  diff = strcmp(value.c_str(), cond[i].value);
-	      break;
-        }
+  return t->idx.commit(end, false);
+}
+
+static RC checkpoint(TableHandle* t)
+{
+  RC rc;
+
+  // the table is committed before the index that covers it
+  if ((rc = t->rf.sync()) < 0) return rc;
+  if (t->hasIndex && (rc = t->idx.commit(t->rf.endRid(), false)) < 0) return rc;
+
+  // filters that cannot be saved are caught up by openBloom() from the
+  // ones saved before, so the log does not have to be kept for them
+  if (t->bloom.isValid()) t->bloom.save(t->name + ".bloom", t->rf.endRid());
+
+  return t->logOpen ? t->log.truncate() : 0;
+}
+
+static void openBloom(TableHandle* t)
+{
+  RecordId rid;
+  RecordId end = t->rf.endRid();
+  int      key;
+  string   value;
+
+  if (t->bloom.load(t->name + ".bloom", rid) < 0) return;
+
+  // filters that hold more tuples than the table file belong to an
+  // older table of the same name
+  if (rid > end) {
+    t->bloom.clear();
+    return;
+  }
 
-        // skip the tuple if any condition is not met
-        switch (cond[i].comp) {
-        case SelCond::EQ:
-          if (diff != 0) goto next_tuple;
-          break;
-        case SelCond::NE:
-          if (diff == 0) goto next_tuple;
-          break;
-        case SelCond::GT:
-          if (diff <= 0) goto next_tuple;
-          break;
-        case SelCond::LT:
-          if (diff >= 0) goto next_tuple;
-          break;
-        case SelCond::GE:
-          if (diff < 0) goto next_tuple;
-          break;
-        case SelCond::LE:
-          if (diff  > 0) goto next_tuple;
-          break;
+  for (; rid < end; ++rid) {
+    if (t->rf.read(rid, key, value) == 0) t->bloom.add(key, value);
+  }
+}
+
+static RC loadBloom(RecordFile& rf, const string& table, const RecordId& start, const vector<unsigned long long>& hashes)
+{
+  BloomFilter bloom;
+  RecordId    saved;
+  RecordId    end = rf.endRid();
+  RecordId    rid;
+  int         key;
+  string      value;
+  RC          rc;
+
+  // the filters are sized for the table after the load. filters that
+  // hold the tuples before it and have room for the new ones are kept;
+  // others are built again from the table file.
+  long long tuples = (long long) end.pid * RecordFile::RECORDS_PER_PAGE + end.sid;
+  if (bloom.load(table + ".bloom", saved) < 0 || saved != start || bloom.capacity() < tuples) {
+    bloom.create(tuples);
+    for (rid.pid = 0, rid.sid = 0; rid < start; ++rid) {
+      if ((rc = rf.read(rid, key, value)) == RC_NO_SUCH_RECORD) continue;
+      if (rc < 0) return rc;
+      bloom.add(key, value);
+    }
+  }
+
+  for (unsigned i = 0; i + 1 < hashes.size(); i += 2) bloom.addHashes(hashes[i], hashes[i + 1]);
+  return bloom.save(table + ".bloom", end);
+}
+
+static bool mayMatch(TableHandle* t, const WhereClause& where)
+{
+  if (!t->bloom.isValid() || where.empty()) return true;
+
+  for (unsigned i = 0; i < where.size(); i++) {
+    const vector<SelCond>& cond = where[i];
+    bool rejected = false;
+
+    for (unsigned j = 0; !rejected && j < cond.size(); j++) {
+      const SelCond& c = cond[j];
+      if (c.comp == SelCond::EQ && c.value != NULL) {
+        rejected = (c.attr == 1) ? !t->bloom.mayContainKey(atoi(c.value)) : !t->bloom.mayContainValue(c.value);
+      } else if (c.comp == SelCond::IN) {
+        // an IN list is rejected if each of its values is
+        rejected = true;
+        for (unsigned k = 0; rejected && k < c.list.size(); k++) {
+          if (c.list[k] == NULL) rejected = false;
+          else rejected = (c.attr == 1) ? !t->bloom.mayContainKey(atoi(c.list[k])) : !t->bloom.mayContainValue(c.list[k]);
         }
       }
+    }
+    if (!rejected) return true;
+  }
+  return false;
+}
 
-      // the condition is met for the tuple. 
-      // increase matching tuple counter
-      count++;
+static bool indexContains(BTreeIndex& idx, int key, const RecordId& rid)
+{
+  IndexCursor cursor;
+  int         curKey;
+  RecordId    curRid;
 
-      // print the tuple 
-      switch (attr) {
-      case 1:  // SELECT key
-        fprintf(stdout, "%d\n", key);
-        break;
-      case 2:  // SELECT value
-        fprintf(stdout, "%s\n", value.c_str());
-        break;
-      case 3:  // SELECT *
-        fprintf(stdout, "%d '%s'\n", key, value.c_str());
-        break;
-      }
+  if (idx.locate(key, cursor) != 0) return false;
+  while (idx.readForward(cursor, curKey, curRid) == 0 && curKey == key) {
+    if (curRid == rid) return true;
+  }
+  return false;
+}
+
+static ScanMethod scanMethod(TableHandle* t, const WhereClause& where, int flags)
+{
+  // the Bloom filters rule out point lookups of missing keys and values
+  // without reading the index or the table file
+  if (!mayMatch(t, where)) return NO_SCAN;
+
+  if (!t->hasIndex || ((flags & SCAN_ANY_ORDER) && !indexCheaper(t, where, flags))) {
+    return t->rf.hasColumns() ? COLUMN_SCAN : ROW_SCAN;
+  }
+  return INDEX_SCAN;
+}
+
+static string scanName(TableHandle* t, const WhereClause& where, int flags)
+{
+  bool keys = (flags & SCAN_KEYS) && keysOnly(where);
+
+  switch (scanMethod(t, where, flags)) {
+  case NO_SCAN:
+    return "No Scan on " + t->name + " (ruled out by the Bloom filters)";
+  case INDEX_SCAN:
+    return string(keys ? "Index Only Scan" : "Index Scan") + ((flags & SCAN_BACKWARD) ? " Backward" : "") + " on " + t->name;
+  case COLUMN_SCAN:
+    return string("Column Scan on ") + t->name + (keys ? " (keys only)" : "");
+  default:
+    return "Table Scan on " + t->name;
+  }
+}
+
+static RC scanTable(TableHandle* t, const WhereClause& where, int flags, TupleVisitor visit, void* arg)
+{
+  RecordId    end = visibleEnd(t);  // the end of the table when the scan starts
+  vector<KeyRange> ranges;
+
+  switch (scanMethod(t, where, flags)) {
+  case NO_SCAN:
+    return 0;
+  case INDEX_SCAN:
+    // read the key ranges in one pass over the index
+    keyRanges(where, ranges);
+    return scanIndex(t, ranges, end, where, flags, visit, arg);
+  default:
+    // scan the table file from the beginning. tuples inserted or loaded
+    // by other sessions during the scan are not seen.
+    if (t->rf.hasColumns()) return scanColumns(t, 0, end.pid + 1, end, where, flags, visit, arg);
+    return scanRows(t, 0, end.pid + 1, end, where, visit, arg);
+  }
+}
+
+static RC scanIndex(TableHandle* t, const vector<KeyRange>& ranges, const RecordId& end, const WhereClause& where, int flags, TupleVisitor visit, void* arg)
+{
+  IndexCursor cursor;  // cursor for scanning index contents
+  RecordId    rid;
+  FetchBatch  batch;   // the tuples to read from the table file
+
+  RC     rc;
+  int    key;
+  bool   more = true;
 
-      // move to the next tuple
-      next_tuple:
-      ++rid;
+  if (ranges.empty()) return 0;
+
+  // the index holds the keys, so the table file is only read when the
+  // visitor or the clause needs the value. the tuples are read in
+  // batches, with the reads of their pages in flight together.
+  bool keys = (flags & SCAN_KEYS) && keysOnly(where);
+  batch.limit = 1;
+
+  if (!(flags & SCAN_BACKWARD)) {
+    unsigned r = 0;
+    if (t->idx.locate(ranges[0].lo, cursor) != 0) return 0;
+    while (more && t->idx.readForward(cursor, key, rid) == 0) {
+      if (key > ranges[r].hi) {
+        // move on to the first range that can hold the key
+        while (r < ranges.size() && key > ranges[r].hi) r++;
+        if (r == ranges.size()) break;
+
+        // jump over the gap before the range. the index is searched from
+        // the root only if the range does not start in the current leaf.
+        if (key < ranges[r].lo) {
+          if (t->idx.skipTo(ranges[r].lo, cursor) != 0) break;
+          continue;
+        }
+      }
+      if (rid >= end) continue;  // not in the snapshot of the scan
+      if (keys) {
+        if (matchWhere(key, "", where)) more = visit(arg, key, "", rid);
+        continue;
+      }
+      batch.rids.push_back(rid);
+      if (batch.rids.size() >= batch.limit && (rc = fetchTuples(t, batch, where, visit, arg, more)) < 0) return rc;
     }
   } else {
-    index = -1;
-    for (unsigned i = 0; i < cond.size(); i++) {
-      // Skip value columns
-      if (cond[i].attr != 1)
-        continue;
+    // the same, from the last key of the last range down
+    int r = ranges.size() - 1;
+    if (t->idx.locateBackward(ranges[r].hi, cursor) != 0) return 0;
+    while (more && t->idx.readBackward(cursor, key, rid) == 0) {
+      if (key < ranges[r].lo) {
+        while (r >= 0 && key < ranges[r].lo) r--;
+        if (r < 0) break;
 
-      if (cond[i].comp == SelCond::EQ) {
-        index = i;
-        break;
+        if (key > ranges[r].hi) {
+          if (t->idx.locateBackward(ranges[r].hi, cursor) != 0) break;
+          continue;
+        }
+      }
+      if (rid >= end) continue;
+      if (keys) {
+        if (matchWhere(key, "", where)) more = visit(arg, key, "", rid);
+        continue;
       }
+      batch.rids.push_back(rid);
+      if (batch.rids.size() >= batch.limit && (rc = fetchTuples(t, batch, where, visit, arg, more)) < 0) return rc;
+    }
+  }
+
+  // the tuples of the last batch
+  if (more && (rc = fetchTuples(t, batch, where, visit, arg, more)) < 0) return rc;
+
+  return 0;
+}
+
+static RC fetchTuples(TableHandle* t, FetchBatch& batch, const WhereClause& where, TupleVisitor visit, void* arg, bool& more)
+{
+  int n = batch.rids.size();
+  RC  rc;
 
-      if ((cond[i].comp == SelCond::GT || cond[i].comp == SelCond::GE) &&
-          (index == -1 || atoi(cond[i].value) > atoi(cond[index].value)))
-        index = i;
+  if (n == 0) return 0;
+
+  batch.keys.resize(n);
+  batch.values.resize(n);
+  batch.rcs.resize(n);
+  if ((rc = t->rf.readBatch(AsyncIo::forThread(), &batch.rids[0], n, &batch.keys[0], &batch.values[0], &batch.rcs[0])) < 0) return rc;
+
+  for (int i = 0; more && i < n; i++) {
+    if (batch.rcs[i] == 0 && matchWhere(batch.keys[i], batch.values[i], where)) {
+      more = visit(arg, batch.keys[i], batch.values[i], batch.rids[i]);
     }
+  }
 
-    if (index > -1)
-      bti.locate(atoi(cond[index].value), cursor);
-    else
-      bti.locate(0, cursor);
+  batch.rids.clear();
+  batch.limit = min(batch.limit * 2, (size_t) FETCH_BATCH);
+  return 0;
+}
 
-    while ((bti.readForward(cursor, key, rid)) == 0) {
-      // read the tuple
-      if ((rc = rf.read(rid, key, value)) < 0) {
-        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
-        goto exit_select;
-      }
+static RC scanRows(TableHandle* t, PageId first, PageId last, const RecordId& end, const WhereClause& where, TupleVisitor visit, void* arg)
+{
+  vector<KeyRange> ranges;
+  RecordId rid = { first, 0 };
+  bool     more = true;
+  RC       rc;
+  int      lo, hi;
 
-      // check the conditions on the tuple
-      for (unsigned i = 0; i < cond.size(); i++) {
-        // compute the difference between the tuple value and the condition value
-        switch (cond[i].attr) {
-        case 1:
-          diff = key - atoi(cond[i].value);
-          break;
-        case 2:
-    	  diff = strcmp(value.c_str(), cond[i].value);
-	      break;
-        }
+  keyRanges(where, ranges);
+  if (ranges.empty()) return 0;
 
-        // check the condition
-        switch (cond[i].comp) {
-        case SelCond::EQ:
-          if (diff != 0) {
-            if (cond[i].attr == 1) goto print_and_exit;
-            else continue;
-          }
-          break;
-        case SelCond::NE:
-          if (diff == 0) continue;
-          break;
-        case SelCond::GT:
-          if (diff <= 0) continue;
-          break;
-        case SelCond::LT:
-          if (diff >= 0) {
-            if (cond[i].attr == 1) goto print_and_exit;
-            else continue;
-          }
-          break;
-        case SelCond::GE:
-          if (diff < 0) continue;
-          break;
-        case SelCond::LE:
-          if (diff > 0) {
-            if (cond[i].attr == 1) goto print_and_exit;
-            else continue;
-          }
-          break;
-        }
-      }
+  while (more && rid.pid < last && rid < end) {
+    if (rid.sid == 0 && t->rf.readZone(rid.pid, lo, hi) == 0 && !rangesOverlap(ranges, lo, hi)) {
+      rid.pid++;
+      continue;
+    }
+    if ((rc = visitTuple(t, rid, where, visit, arg, more)) < 0) return rc;
+    ++rid;
+  }
+  return 0;
+}
+
+static bool rangesOverlap(const vector<KeyRange>& ranges, int lo, int hi)
+{
+  // find the first range that does not end before lo
+  unsigned a = 0, b = ranges.size();
+  while (a < b) {
+    unsigned m = (a + b) / 2;
+    if (ranges[m].hi < lo) a = m + 1;
+    else b = m;
+  }
+  return a < ranges.size() && ranges[a].lo <= hi;
+}
 
-      // the condition is met for the tuple. 
-      // increase matching tuple counter
-      count++;
+static RC scanColumns(TableHandle* t, PageId first, PageId last, const RecordId& end, const WhereClause& where, int flags, TupleVisitor visit, void* arg)
+{
+  RecordFile::KeyBlock b;
+  vector<KeyRange>     ranges;
+  unsigned char        match[sizeof(b.removed)];
 
-      // print the tuple 
-      switch (attr) {
-      case 1:  // SELECT key
-        fprintf(stdout, "%d\n", key);
-        break;
-      case 2:  // SELECT value
-        fprintf(stdout, "%s\n", value.c_str());
-        break;
-      case 3:  // SELECT *
-        fprintf(stdout, "%d '%s'\n", key, value.c_str());
-        break;
-      }
+  RC     rc;
+  bool   more = true;
+
+  keyRanges(where, ranges);
+  if (ranges.empty()) return 0;
+
+  // the key file holds the keys, so the value file is only read when the
+  // visitor or the clause needs the value
+  bool keys = (flags & SCAN_KEYS) && keysOnly(where);
+
+  int from = first * RecordFile::RECORDS_PER_PAGE;
+  int to = min(last * RecordFile::RECORDS_PER_PAGE, end.pid * RecordFile::RECORDS_PER_PAGE + end.sid);
+  for (int block = from / RecordFile::KEYS_PER_BLOCK; more && block * RecordFile::KEYS_PER_BLOCK < to; block++) {
+    if ((rc = t->rf.readKeyBlock(block, b)) < 0) return rc;
+    if (!matchKeys(b, ranges, match)) continue;
+
+    int base = block * RecordFile::KEYS_PER_BLOCK;
+    int n = min(b.count, to - base);
+    for (int i = max(0, from - base); more && i < n; i++) {
+      if (!((match[i / 8] >> (i % 8)) & 1)) continue;
+
+      RecordId rid = { (base + i) / RecordFile::RECORDS_PER_PAGE, (base + i) % RecordFile::RECORDS_PER_PAGE };
+      if (keys) {
+        if (matchWhere(b.keys[i], "", where)) more = visit(arg, b.keys[i], "", rid);
+      } else if ((rc = visitTuple(t, rid, where, visit, arg, more)) < 0) return rc;
     }
   }
 
-  print_and_exit:
-  // print matching tuple count if "select count(*)"
-  if (attr == 4) {
-    fprintf(stdout, "%d\n", count);
+  return 0;
+}
+
+// set the bits of match for the keys in [lo, hi]. the keys are compared
+// eight at a time with SSE2 where the compiler targets it.
+static void markRange(const int* keys, int n, int lo, int hi, unsigned char* match)
+{
+  int i = 0;
+
+#ifdef __SSE2__
+  __m128i vlo = _mm_set1_epi32(lo);
+  __m128i vhi = _mm_set1_epi32(hi);
+  for (; i + 8 <= n; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i*) (keys + i));
+    __m128i b = _mm_loadu_si128((const __m128i*) (keys + i + 4));
+
+    // a key is out of the range if lo > key or key > hi
+    __m128i outA = _mm_or_si128(_mm_cmpgt_epi32(vlo, a), _mm_cmpgt_epi32(a, vhi));
+    __m128i outB = _mm_or_si128(_mm_cmpgt_epi32(vlo, b), _mm_cmpgt_epi32(b, vhi));
+    int out = _mm_movemask_ps(_mm_castsi128_ps(outA)) | (_mm_movemask_ps(_mm_castsi128_ps(outB)) << 4);
+    match[i / 8] |= ~out & 0xff;
   }
-  rc = 0;
+#endif
 
-  // close the table file and return
-  exit_select:
-  rf.close();
-  return rc;
+  for (; i < n; i++) {
+    if (keys[i] >= lo && keys[i] <= hi) match[i / 8] |= 1 << (i % 8);
+  }
 }
 
-RC SqlEngine::load(const string& table, const string& loadfile, bool index)
+static bool matchKeys(const RecordFile::KeyBlock& b, const vector<KeyRange>& ranges, unsigned char* match)
 {
-  RecordFile rf;   // RecordFile containing the table
-  RecordId   rid;  // record cursor for table scanning
-  BTreeIndex bti;  // BTree Index for inserting indices
-  ifstream ifs;    // Input file stream for the load file
+  bool any = false;
 
-  int    ret;
-  int    key;     
+  memset(match, 0, sizeof(b.removed));
+
+  // the smallest and largest key of the block rule out most ranges
+  // without looking at the keys
+  for (unsigned r = 0; r < ranges.size() && ranges[r].lo <= b.max; r++) {
+    if (ranges[r].hi < b.min) continue;
+    if (ranges[r].lo <= b.min && ranges[r].hi >= b.max) {
+      memset(match, 0xff, sizeof(b.removed));
+    } else {
+      markRange(b.keys, b.count, ranges[r].lo, ranges[r].hi, match);
+    }
+    any = true;
+  }
+  if (!any) return false;
+
+  for (unsigned i = 0; i < sizeof(b.removed); i++) match[i] &= ~b.removed[i];
+  return true;
+}
+
+static RC visitTuple(TableHandle* t, const RecordId& rid, const WhereClause& where, TupleVisitor visit, void* arg, bool& more)
+{
+  RC     rc;
+  int    key;
   string value;
-  string line;
 
-  // open the table file
-  if ((ret = rf.open(table + ".tbl", 'w')) < 0) {
-    fprintf(stderr, "Error: Cannot access/create table %s\n", table.c_str());
-    return ret;
+  // read the tuple, skipping deleted ones
+  if ((rc = t->rf.read(rid, key, value)) == RC_NO_SUCH_RECORD) return 0;
+  if (rc < 0) return rc;
+
+  if (matchWhere(key, value, where)) more = visit(arg, key, value, rid);
+  return 0;
+}
+
+static void keyRanges(const WhereClause& where, vector<KeyRange>& ranges)
+{
+  vector<KeyRange> all;
+  KeyRange range;
+
+  // a clause without conditions matches every key
+  if (where.empty()) {
+    range.lo = INT_MIN;
+    range.hi = INT_MAX;
+    ranges.push_back(range);
+    return;
+  }
+
+  for (unsigned i = 0; i < where.size(); i++) {
+    const vector<SelCond>& cond = where[i];
+    const SelCond* in = NULL;
+    long long lo = INT_MIN, hi = INT_MAX;
+
+    // intersect the bounds of the key conditions of the conjunction
+    for (unsigned j = 0; j < cond.size(); j++) {
+      if (cond[j].attr != 1) continue;
+      if (cond[j].comp == SelCond::IN) {
+        if (in == NULL) in = &cond[j];
+        continue;
+      }
+
+      long long v = atoi(cond[j].value);
+      switch (cond[j].comp) {
+      case SelCond::EQ: lo = max(lo, v); hi = min(hi, v); break;
+      case SelCond::GT: lo = max(lo, v + 1); break;
+      case SelCond::GE: lo = max(lo, v); break;
+      case SelCond::LT: hi = min(hi, v - 1); break;
+      case SelCond::LE: hi = min(hi, v); break;
+      default: break;
+      }
+    }
+    if (lo > hi) continue;
+
+    if (in == NULL) {
+      range.lo = lo;
+      range.hi = hi;
+      all.push_back(range);
+      continue;
+    }
+
+    // an IN list is a set of single keys, keeping those that satisfy
+    // the other key conditions
+    for (unsigned j = 0; j < in->list.size(); j++) {
+      int v = atoi(in->list[j]);
+      bool ok = true;
+      for (unsigned k = 0; ok && k < cond.size(); k++) {
+        if (cond[k].attr == 1) ok = matchCondition(cond[k], v, "");
+      }
+      if (ok) {
+        range.lo = range.hi = v;
+        all.push_back(range);
+      }
+    }
   }
 
-  // open an index file
-  if (index) {
-    if (ret = bti.open(table + ".idx", 'w')) {
-      fprintf(stderr, "Error: Cannot access/create %s index file\n", loadfile.c_str());
-      goto exit_load;
+  // sort the ranges and merge the overlapping and adjacent ones
+  sort(all.begin(), all.end(), rangeBefore);
+  for (unsigned i = 0; i < all.size(); i++) {
+    if (!ranges.empty() && (long long) all[i].lo <= (long long) ranges.back().hi + 1) {
+      ranges.back().hi = max(ranges.back().hi, all[i].hi);
+    } else {
+      ranges.push_back(all[i]);
     }
   }
+}
 
-  // open the load file
-  ifs.open(loadfile.c_str(), ifstream::in);
-  if (ret = !ifs.is_open()) {
-    fprintf(stderr, "Error: Cannot open %s file\n", loadfile.c_str());
-    goto exit_load;
+static bool rangeBefore(const KeyRange& a, const KeyRange& b)
+{
+  return a.lo < b.lo;
+}
+
+static void intersectRanges(const vector<KeyRange>& a, const vector<KeyRange>& b, vector<KeyRange>& ranges)
+{
+  unsigned i = 0, j = 0;
+
+  while (i < a.size() && j < b.size()) {
+    KeyRange range = { max(a[i].lo, b[j].lo), min(a[i].hi, b[j].hi) };
+    if (range.lo <= range.hi) ranges.push_back(range);
+
+    // the range that ends first cannot overlap any later range
+    if (a[i].hi < b[j].hi) i++;
+    else j++;
   }
+}
 
-  // read load file line by line and insert, parse and insert tuples into record file and index
-  getline(ifs, line);
-  for (unsigned lineNum = 1; ifs.good(); lineNum++) {
-    if (parseLoadLine(line, key, value)) {
-      fprintf(stderr, "Warning: Could not parse line %u from file %s\n", lineNum, loadfile.c_str());
-      goto next_line;
+static bool rangesExact(const WhereClause& where)
+{
+  // keyRanges() ignores <> and every condition on value
+  for (unsigned i = 0; i < where.size(); i++) {
+    for (unsigned j = 0; j < where[i].size(); j++) {
+      if (where[i][j].attr != 1 || where[i][j].comp == SelCond::NE) return false;
     }
+  }
+  return true;
+}
 
-    if (rf.append(key, value, rid)) {
-      fprintf(stderr, "Warning: Could not insert tuple with key %i into %s RecordFile\n", key, table.c_str());
-      goto next_line;
+static bool keysOnly(const WhereClause& where)
+{
+  for (unsigned i = 0; i < where.size(); i++) {
+    for (unsigned j = 0; j < where[i].size(); j++) {
+      if (where[i][j].attr != 1) return false;
     }
+  }
+  return true;
+}
 
-    if (index) {
-      if (bti.insert(key, rid)) {
-        fprintf(stderr, "Warning: Could not insert key %i into index\n", key);
-        goto next_line;
+static void valueSlots(WhereClause& where, vector<char**>& slots)
+{
+  for (unsigned i = 0; i < where.size(); i++) {
+    for (unsigned j = 0; j < where[i].size(); j++) {
+      SelCond& c = where[i][j];
+      if (c.comp != SelCond::IN) {
+        slots.push_back(&c.value);
+      } else {
+        for (unsigned k = 0; k < c.list.size(); k++) {
+          slots.push_back(&c.list[k]);
+        }
       }
     }
-    next_line:
-    getline(ifs, line);
   }
-  ret = 1;
+}
 
-  // close files and streams and return
-  exit_load:
-  rf.close();
-  ifs.close();
-  if (index) {
-    bti.close();
+static bool hasPlaceholder(const WhereClause& where)
+{
+  vector<char**> slots;
+
+  valueSlots(const_cast<WhereClause&>(where), slots);
+  for (unsigned i = 0; i < slots.size(); i++) {
+    if (*slots[i] == NULL) return true;
   }
+  return false;
+}
 
-  return ret;
+static bool matchWhere(int key, const string& value, const WhereClause& where)
+{
+  if (where.empty()) return true;
+
+  for (unsigned i = 0; i < where.size(); i++) {
+    if (matchConditions(key, value, where[i])) return true;
+  }
+  return false;
+}
+
+static bool matchConditions(int key, const string& value, const vector<SelCond>& cond)
+{
+  for (unsigned i = 0; i < cond.size(); i++) {
+    if (!matchCondition(cond[i], key, value)) return false;
+  }
+  return true;
+}
+
+static bool matchCondition(const SelCond& cond, int key, const string& value)
+{
+  int diff;
+
+  // an IN list is satisfied by any of its values
+  if (cond.comp == SelCond::IN) {
+    for (unsigned i = 0; i < cond.list.size(); i++) {
+      SelCond eq;
+      eq.attr = cond.attr;
+      eq.comp = SelCond::EQ;
+      eq.value = cond.list[i];
+      if (matchCondition(eq, key, value)) return true;
+    }
+    return false;
+  }
+
+  // compute the difference between the tuple value and the condition value
+  switch (cond.attr) {
+  case 1:
+    diff = key - atoi(cond.value);
+    break;
+  case 2:
+    diff = strcmp(value.c_str(), cond.value);
+    break;
+  }
+
+  // check the condition
+  switch (cond.comp) {
+  case SelCond::EQ:
+    return diff == 0;
+  case SelCond::NE:
+    return diff != 0;
+  case SelCond::GT:
+    return diff > 0;
+  case SelCond::LT:
+    return diff < 0;
+  case SelCond::GE:
+    return diff >= 0;
+  case SelCond::LE:
+    return diff <= 0;
+  default:
+    return false;
+  }
 }
 
 RC SqlEngine::parseLoadLine(const string& line, int& key, string& value)
@@ -10,6 +10,9 @@
 #ifndef SQLENGINE_H
 #define SQLENGINE_H
 
+#include <cstdio>
+#include <map>
+#include <string>
 #include <vector>
 #include "Bruinbase.h"
 #include "RecordFile.h"
@@ -19,12 +22,83 @@
  */
 struct SelCond {
   int attr;     // attribute: 1 - key column,  2 - value column
-  enum Comparator { EQ, NE, LT, GT, LE, GE } comp;
-  char* value;  // the value to compare
+  enum Comparator { EQ, NE, LT, GT, LE, GE, IN } comp;
+  char* value;  // the value to compare, NULL for a ? placeholder. unused by IN
+  std::vector<char*> list;  // the values of IN, NULL entries are placeholders
+};
+
+/**
+ * a WHERE clause in disjunctive normal form. a tuple satisfies the
+ * clause if it satisfies all conditions of at least one of the
+ * conjunctions. an empty clause is satisfied by every tuple.
+ */
+typedef std::vector<std::vector<SelCond> > WhereClause;
+
+/**
+ * the DISTINCT, ORDER BY and LIMIT clauses of a SELECT
+ */
+struct SelOrder {
+  enum Direction { NONE, ASC, DESC } order;  // ORDER BY, NONE if absent
+  int  attr;      // the attribute in ORDER BY (1: key, 2: value)
+  int  limit;     // the maximum number of tuples to return, -1 for no limit
+  int  offset;    // the number of tuples to skip before the first one returned
+  bool distinct;  // SELECT DISTINCT: each tuple is returned once
+};
+
+/**
+ * a column of one of the tables of a join, such as movie.key
+ */
+struct JoinColumn {
+  char* table;  // the table name
+  int   attr;   // attribute: 1 - key column,  2 - value column
+};
+
+/**
+ * a condition in the WHERE clause of a join. it compares a column with
+ * another column or with a value.
+ */
+struct JoinCond {
+  JoinColumn column;  // the column on the left of the comparator
+  SelCond::Comparator comp;  // any comparator but IN
+  JoinColumn other;   // the column on the right, if value is NULL
+  char* value;        // the value on the right, NULL for a column
+};
+
+/**
+ * a SELECT statement prepared by PREPARE (defined in SqlEngine.cc)
+ */
+struct PreparedSelect;
+
+/**
+ * the plan of a statement run by EXPLAIN (defined in QueryPlan.h)
+ */
+class QueryPlan;
+
+/**
+ * the state of a client session. query results and the prompt are
+ * written to out; error messages and query statistics to err.
+ */
+struct SqlSession {
+  FILE* out;    // the stream for results
+  FILE* err;    // the stream for error messages
+  bool  quit;   // the client issued QUIT
+  QueryPlan* plan;  // the plan of the statement after EXPLAIN, NULL if none
+  std::map<std::string, PreparedSelect*> prepared;  // prepared statements by name
+
+  /**
+   * a session with no EXPLAIN and no prepared statements.
+   * @param out[IN] the stream for results
+   * @param err[IN] the stream for error messages
+   */
+  SqlSession(FILE* out = NULL, FILE* err = NULL)
+    : out(out), err(err), quit(false), plan(NULL) {}
 };
 
 /**
  * the class that takes, parses, and executes the user commands.
+ * several sessions may execute commands at the same time. tables are
+ * opened on first use and shared by all sessions until shutdown() is
+ * called.
  */
 class SqlEngine {
  public:
@@ -38,26 +112,178 @@ class SqlEngine {
    */
   static RC run(FILE* commandline);
 
+  /**
+   * parses and executes complete command lines of a session.
+   * errors are reported to session.err.
+   * @param session[IN/OUT] the session issuing the commands
+   * @param commands[IN] one or more commands, each ending with a newline
+   * @return error code. 0 if no error
+   */
+  static RC execute(SqlSession& session, const std::string& commands);
+
   /**
    * executes a SELECT statement.
-   * all conditions in conds must be ANDed together.
-   * the result of the SELECT is printed on screen.
+   * the result of the SELECT is printed to session.out.
+   * for ORDER BY key, an indexed table is read in key order (backward
+   * for DESC); the matching tuples of other tables, and those of any
+   * table for ORDER BY value, are sorted with an external merge sort.
+   * the scan stops as soon as LIMIT tuples have been printed.
+   * DISTINCT sorts the tuples on the selected attribute (or on the ORDER
+   * BY attribute for *) and drops the repeated ones.
+   * an aggregate prints a single row. MIN(key) and MAX(key) of an indexed
+   * table read only the first or last matching index entry.
+   * @param session[IN] the session issuing the statement
    * @param attr[IN] attribute in the SELECT clause
-   * (1: key, 2: value, 3: *, 4: count(*))
+   * (1: key, 2: value, 3: *, 4: count(*), 5: min(key), 6: max(key),
+   *  7: sum(key), 8: avg(key), 9: min(value), 10: max(value))
    * @param table[IN] the table name in the FROM clause
-   * @param conds[IN] list of conditions in the WHERE clause
+   * @param where[IN] the WHERE clause
+   * @param order[IN] the DISTINCT, ORDER BY and LIMIT clauses
    * @return error code. 0 if no error
    */
-  static RC select(int attr, const std::string& table, const std::vector<SelCond>& conds);
+  static RC select(SqlSession& session, int attr, const std::string& table, const WhereClause& where, const SelOrder& order);
+
+  /**
+   * executes a SELECT statement with GROUP BY, printing one row per group
+   * to session.out. the groups are aggregated in a hash table, in
+   * parallel for large tables, and come in no particular order unless
+   * ORDER BY key is given with GROUP BY key.
+   * @param session[IN] the session issuing the statement
+   * @param group[IN] the attribute in the GROUP BY clause (1: key, 2: value)
+   * @param attr[IN] the aggregate in the SELECT clause, as in select(),
+   *                 or 0 if only the group attribute is selected
+   * @param table[IN] the table name in the FROM clause
+   * @param where[IN] the WHERE clause
+   * @param order[IN] the ORDER BY and LIMIT clauses
+   * @return error code. 0 if no error
+   */
+  static RC groupBy(SqlSession& session, int group, int attr, const std::string& table, const WhereClause& where, const SelOrder& order);
+
+  /**
+   * executes a SELECT statement that joins two tables on the equality of
+   * a column of each, printing the joined tuples to session.out.
+   * conditions between a column and a value are applied to the scan of
+   * that column's table. when the inner table has an index on its join
+   * column and the outer table is small enough, every outer tuple is
+   * looked up in the index (index nested-loop join); otherwise the
+   * smaller table is loaded into a hash table that the other one probes,
+   * partitioned to temporary files if it is too large (hash join).
+   * @param session[IN] the session issuing the statement
+   * @param attr[IN] 3: *, 4: count(*), 0: the listed columns
+   * @param columns[IN] the columns to print when attr is 0
+   * @param left[IN] the first table in the FROM clause
+   * @param right[IN] the second table in the FROM clause
+   * @param where[IN] the conditions of the WHERE clause, all of which
+   *                  must hold. one must be an equality between the tables.
+   * @param order[IN] the LIMIT clause
+   * @return error code. 0 if no error
+   */
+  static RC join(SqlSession& session, int attr, const std::vector<JoinColumn>& columns, const std::string& left, const std::string& right, const std::vector<JoinCond>& where, const SelOrder& order);
+
+  /**
+   * prepare a SELECT statement for repeated execution. the statement
+   * keeps its conditions and the shared handle of its table, so an
+   * execution only binds the placeholders and runs the scan.
+   * a statement with the same name is replaced.
+   * @param session[IN/OUT] the session that owns the statement
+   * @param name[IN] the statement name
+   * @param attr[IN] attribute in the SELECT clause, as in select()
+   * @param table[IN] the table name in the FROM clause
+   * @param where[IN] the WHERE clause. NULL values are placeholders,
+   * numbered from left to right
+   * @param order[IN] the ORDER BY and LIMIT clauses
+   * @return error code. 0 if no error
+   */
+  static RC prepare(SqlSession& session, const std::string& name, int attr, const std::string& table, const WhereClause& where, const SelOrder& order);
+
+  /**
+   * execute a prepared SELECT statement.
+   * @param session[IN] the session that owns the statement
+   * @param name[IN] the statement name
+   * @param params[IN] the values of the placeholders, in order
+   * @return error code. 0 if no error
+   */
+  static RC executePrepared(SqlSession& session, const std::string& name, const std::vector<char*>& params);
+
+  /**
+   * drop a prepared statement.
+   * @param session[IN/OUT] the session that owns the statement
+   * @param name[IN] the statement name
+   * @return error code. 0 if no error
+   */
+  static RC deallocate(SqlSession& session, const std::string& name);
+
+  /**
+   * drop all prepared statements of a session that ends.
+   * @param session[IN/OUT] the session
+   */
+  static void endSession(SqlSession& session);
 
   /**
    * load a table from a load file.
+   * other sessions may read the table meanwhile; they see the loaded
+   * tuples once the load is committed.
+   * @param session[IN] the session issuing the command
    * @param table[IN] the table name in the LOAD command
    * @param loadfile[IN] the file name of the load file
    * @param index[IN] true if "WITH INDEX" option was specified
+   * @param columns[IN] true if "AS COLUMNS" was specified: a new table is
+   *                    stored by columns. an existing table keeps its layout.
+   * @param lsm[IN] true if "WITH LSM INDEX" was specified: the index is
+   *                log-structured, and an existing index is made so.
+   * @return error code. 0 if no error
+   */
+  static RC load(SqlSession& session, const std::string& table, const std::string& loadfile, bool index, bool columns, bool lsm);
+
+  /**
+   * collect the statistics of a table that the planner uses to estimate
+   * how many tuples a WHERE clause selects. LOAD collects them as well.
+   * the table cannot be used by other sessions while it is analyzed.
+   * @param session[IN] the session issuing the command
+   * @param table[IN] the table name in the ANALYZE command
+   * @return error code. 0 if no error
+   */
+  static RC analyze(SqlSession& session, const std::string& table);
+
+  /**
+   * print the I/O counters of every file used since the process started:
+   * page reads and cache hits, evictions, writes, bytes and syncs, with
+   * the totals of each subsystem and the latencies of the disk operations.
+   * @param session[IN] the session issuing the command
+   * @return error code. 0 if no error
+   */
+  static RC showStats(SqlSession& session);
+
+  /**
+   * insert a single tuple into a table.
+   * the change is written to the table's write-ahead log and the call
+   * returns once the log record is on disk. table and index pages are
+   * written back lazily.
+   * @param session[IN] the session issuing the command
+   * @param table[IN] the table name in the INSERT command
+   * @param key[IN] the key of the new tuple
+   * @param value[IN] the value of the new tuple
+   * @return error code. 0 if no error
+   */
+  static RC insert(SqlSession& session, const std::string& table, int key, const std::string& value);
+
+  /**
+   * delete the tuples that satisfy the WHERE clause from a table.
+   * like insert(), the change is made durable through the write-ahead log.
+   * @param session[IN] the session issuing the command
+   * @param table[IN] the table name in the DELETE command
+   * @param where[IN] the WHERE clause
+   * @return error code. 0 if no error
+   */
+  static RC remove(SqlSession& session, const std::string& table, const WhereClause& where);
+
+  /**
+   * write back all tables modified by insert() and remove(),
+   * empty their write-ahead logs and close all tables.
+   * no session may execute commands during the call.
    * @return error code. 0 if no error
    */
-  static RC load(const std::string& table, const std::string& loadfile, bool index);
+  static RC shutdown();
 
   /**
    * parse a line from the load file into the (key, value) pair.
@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+/*
+ * The benchmark of the load and query paths. It generates a load file of
+ * synthetic tuples, loads it with and without an index, runs timed point
+ * lookups, range scans and COUNT(*) through SqlEngine::execute() and
+ * writes the results as JSON. The data and the queries only depend on the
+ * seed, so two runs with the same options do the same work.
+ *
+ *   SqlEngineBench [-n rows] [-k uniform|sequential|zipf|all] [-q lookups]
+ *                  [-r scans] [-s seed] [-d dir] [-o file]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <dirent.h>
+#include "Bruinbase.h"
+#include "SqlEngine.h"
+#include "IoStats.h"
+#include "PageFile.h"
+
+using std::string;
+using std::vector;
+
+// the keys of the tuples
+enum KeyDistribution { UNIFORM_KEYS, SEQUENTIAL_KEYS, ZIPF_KEYS };
+static const char* DISTRIBUTION_NAMES[] = { "uniform", "sequential", "zipf" };
+static const int DISTRIBUTIONS = 3;
+
+// the skew of the Zipfian keys; rank r is drawn with probability ~ 1/r^theta
+static const double ZIPF_THETA = 0.99;
+
+// the values are between these lengths
+static const int MIN_VALUE_LENGTH = 4;
+static const int MAX_VALUE_LENGTH = 99;
+
+// the sample of the keys that the queries draw from
+static const int SAMPLE_SIZE = 65536;
+
+// the fractions of the table that the range scans select
+static const double SELECTIVITIES[] = { 0.0001, 0.001, 0.01, 0.1 };
+
+// the times COUNT(*) is run
+static const int COUNT_RUNS = 5;
+
+/**
+ * the random numbers of the benchmark (splitmix64)
+ */
+struct Random {
+  unsigned long long state;
+
+  unsigned long long next()
+  {
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // a number in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // a number in [0, n)
+  long long below(long long n) { return (long long) (uniform() * n); }
+};
+
+/**
+ * the ranks of a Zipfian distribution over n items, drawn as in Gray et
+ * al., "Quickly Generating Billion-Record Synthetic Databases"
+ */
+struct Zipf {
+  long long n;
+  double    zetan;
+  double    alpha;
+  double    eta;
+
+  void init(long long items)
+  {
+    double zeta2 = 1 + pow(0.5, ZIPF_THETA);
+
+    n = items;
+    zetan = 0;
+    for (long long i = 1; i <= n; i++) zetan += pow((double) i, -ZIPF_THETA);
+    alpha = 1 / (1 - ZIPF_THETA);
+    eta = (1 - pow(2.0 / n, 1 - ZIPF_THETA)) / (1 - zeta2 / zetan);
+  }
+
+  long long next(Random& random)
+  {
+    double u = random.uniform();
+    double uz = u * zetan;
+
+    if (uz < 1) return 0;
+    if (uz < 1 + pow(0.5, ZIPF_THETA)) return 1;
+    return (long long) (n * pow(eta * u - eta + 1, alpha));
+  }
+};
+
+/**
+ * the measurements of a workload
+ */
+struct Result {
+  string distribution;
+  string workload;
+  string table;             // "table" for the table without an index, or "index"
+  double selectivity;       // the fraction of the table selected, 0 if none
+  long long operations;
+  long long rows;           // the rows loaded or returned
+  double seconds;
+  vector<long long> nanos;  // the latency of each operation
+  IoStats::Counters io;     // the page I/O of all operations
+};
+
+/**
+ * the stream that a statement prints its result to. only the lines are
+ * counted, so the time of the statement is not that of writing its rows.
+ */
+struct Sink {
+  long long lines;
+};
+
+static ssize_t sinkWrite(void* cookie, const char* buf, size_t size)
+{
+  Sink* sink = (Sink*) cookie;
+
+  for (const char* p = buf; (p = (const char*) memchr(p, '\n', buf + size - p)) != NULL; p++) {
+    sink->lines++;
+  }
+  return size;
+}
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "usage: %s [-n rows] [-k uniform|sequential|zipf|all] [-q lookups] [-r scans] [-s seed] [-d dir] [-o file] [-c cache-pages]\n", prog);
+}
+
+// add the counters of all files into c
+static void readIo(IoStats::Counters& c)
+{
+  vector<IoStats*> all;
+  IoStats::Counters one;
+  long long* to = (long long*) &c;
+  const long long* from = (const long long*) &one;
+
+  memset(&c, 0, sizeof(c));
+  IoStats::getAll(all);
+  for (unsigned i = 0; i < all.size(); i++) {
+    all[i]->read(one);
+    for (size_t j = 0; j < sizeof(c) / sizeof(long long); j++) to[j] += from[j];
+  }
+}
+
+// subtract the counters in before from those in c
+static void subtractIo(IoStats::Counters& c, const IoStats::Counters& before)
+{
+  long long* to = (long long*) &c;
+  const long long* from = (const long long*) &before;
+
+  for (size_t j = 0; j < sizeof(c) / sizeof(long long); j++) to[j] -= from[j];
+}
+
+// write the load file of a distribution, keeping a sample of its keys
+static RC generate(const string& filename, KeyDistribution dist, long long rows,
+                   unsigned long long seed, vector<int>& sample)
+{
+  Random random = { seed };
+  Random sampling = { seed ^ 0x5A5A5A5AULL };
+  Zipf   zipf = { 0, 0, 0, 0 };
+  char   value[MAX_VALUE_LENGTH + 1];
+  FILE*  out;
+
+  if ((out = fopen(filename.c_str(), "w")) == NULL) return RC_FILE_OPEN_FAILED;
+  if (dist == ZIPF_KEYS) zipf.init(rows);
+
+  sample.clear();
+  for (long long i = 0; i < rows; i++) {
+    int key;
+    switch (dist) {
+    case UNIFORM_KEYS: key = (int) random.below(2147483647LL); break;
+    case SEQUENTIAL_KEYS: key = (int) i; break;
+    default:
+      // scatter the ranks so that the popular keys are not all small
+      key = (int) ((unsigned long long) (zipf.next(random) + 1) * 2654435761ULL % 2147483647ULL);
+      break;
+    }
+
+    int length = MIN_VALUE_LENGTH + (int) random.below(MAX_VALUE_LENGTH - MIN_VALUE_LENGTH + 1);
+    for (int j = 0; j < length; j++) value[j] = 'a' + (int) random.below(26);
+    value[length] = 0;
+    fprintf(out, "%d,\"%s\"\n", key, value);
+
+    // reservoir sampling, so that the sample follows the distribution
+    if (sample.size() < (size_t) SAMPLE_SIZE) sample.push_back(key);
+    else {
+      long long j = sampling.below(i + 1);
+      if (j < SAMPLE_SIZE) sample[j] = key;
+    }
+  }
+
+  if (fclose(out) != 0) return RC_FILE_WRITE_FAILED;
+  std::sort(sample.begin(), sample.end());
+  return 0;
+}
+
+// run statements, timing each of them
+static void run(SqlSession& session, Sink& sink, const vector<string>& statements, Result& r)
+{
+  IoStats::Counters before;
+  long long lines = sink.lines;
+  long long start;
+
+  readIo(before);
+  r.nanos.clear();
+  start = IoStats::now();
+  for (unsigned i = 0; i < statements.size(); i++) {
+    long long t = IoStats::now();
+    SqlEngine::execute(session, statements[i]);
+    fflush(session.out);
+    r.nanos.push_back(IoStats::now() - t);
+  }
+  r.seconds = (IoStats::now() - start) / 1e9;
+
+  readIo(r.io);
+  subtractIo(r.io, before);
+  r.operations = statements.size();
+  r.rows = sink.lines - lines;
+}
+
+// the latency below which a fraction q of the operations took, in ms
+static double percentile(const vector<long long>& sorted, double q)
+{
+  size_t i = (size_t) ceil(q * sorted.size());
+
+  if (i > 0) i--;
+  return sorted[std::min(i, sorted.size() - 1)] / 1e6;
+}
+
+static void printResult(FILE* out, const Result& r, bool last)
+{
+  vector<long long> sorted(r.nanos);
+
+  std::sort(sorted.begin(), sorted.end());
+  fprintf(out, "    {\"distribution\": \"%s\", \"workload\": \"%s\", \"table\": \"%s\",",
+          r.distribution.c_str(), r.workload.c_str(), r.table.c_str());
+  if (r.selectivity > 0) fprintf(out, " \"selectivity\": %g,", r.selectivity);
+  fprintf(out, "\n     \"operations\": %lld, \"rows\": %lld, \"seconds\": %.6f,",
+          r.operations, r.rows, r.seconds);
+  fprintf(out, " \"operations_per_second\": %.1f, \"rows_per_second\": %.1f,\n",
+          r.seconds > 0 ? r.operations / r.seconds : 0, r.seconds > 0 ? r.rows / r.seconds : 0);
+  fprintf(out, "     \"latency_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+          percentile(sorted, 0.5), percentile(sorted, 0.95), percentile(sorted, 0.99),
+          sorted.back() / 1e6);
+  fprintf(out, "     \"pages\": {\"reads\": %lld, \"cache_hits\": %lld, \"disk_reads\": %lld, \"writes\": %lld, \"disk_writes\": %lld, \"syncs\": %lld}}%s\n",
+          r.io.reads, r.io.hits, r.io.diskReads, r.io.writes, r.io.diskWrites, r.io.syncs,
+          last ? "" : ",");
+}
+
+// remove the files in the directory, and the directory
+static void removeDir(const string& dir)
+{
+  DIR* d;
+  struct dirent* e;
+
+  if ((d = opendir(dir.c_str())) != NULL) {
+    while ((e = readdir(d)) != NULL) {
+      if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+        unlink((dir + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+// run the workloads of a distribution
+static RC benchmark(SqlSession& session, Sink& sink, KeyDistribution dist, long long rows,
+                    int lookups, int scans, unsigned long long seed, vector<Result>& results)
+{
+  const char*    name = DISTRIBUTION_NAMES[dist];
+  string         plain = string(name) + "_table";
+  string         indexed = string(name) + "_index";
+  string         loadfile = string(name) + ".del";
+  vector<int>    sample;
+  vector<string> statements;
+  Random         random = { seed + dist };
+  Result         r;
+  char           buf[256];
+  RC             rc;
+
+  fprintf(stderr, "%s: generating %lld rows\n", name, rows);
+  if ((rc = generate(loadfile, dist, rows, seed + dist, sample)) < 0) return rc;
+  r.distribution = name;
+  r.selectivity = 0;
+
+  // LOAD without and with an index
+  for (int index = 0; index <= 1; index++) {
+    fprintf(stderr, "%s: load%s\n", name, index ? " with index" : "");
+    statements.assign(1, "load " + (index ? indexed : plain) + " from '" + loadfile + "'" +
+                      (index ? " with index" : "") + "\n");
+    r.workload = "load";
+    r.table = index ? "index" : "table";
+    run(session, sink, statements, r);
+    r.rows = rows;
+    results.push_back(r);
+  }
+  unlink(loadfile.c_str());
+
+  // the table without an index is scanned, the other reads only its index
+  for (int index = 0; index <= 1; index++) {
+    fprintf(stderr, "%s: count(*)%s\n", name, index ? " with index" : "");
+    statements.assign(COUNT_RUNS, "select count(*) from " + (index ? indexed : plain) + "\n");
+    r.workload = "count";
+    r.table = index ? "index" : "table";
+    run(session, sink, statements, r);
+    if (r.rows != COUNT_RUNS) {
+      fprintf(stderr, "Error: count(*) of %s failed\n", (index ? indexed : plain).c_str());
+      return RC_INVALID_FILE_FORMAT;
+    }
+    results.push_back(r);
+  }
+
+  // point lookups of keys drawn from the sample, so that the popular keys
+  // of a skewed distribution are looked up more often
+  fprintf(stderr, "%s: %d point lookups\n", name, lookups);
+  statements.clear();
+  for (int i = 0; i < lookups; i++) {
+    snprintf(buf, sizeof(buf), "select * from %s where key = %d\n", indexed.c_str(), sample[random.below(sample.size())]);
+    statements.push_back(buf);
+  }
+  r.workload = "point_lookup";
+  r.table = "index";
+  run(session, sink, statements, r);
+  results.push_back(r);
+
+  // range scans between two keys of the sample that are about the
+  // selectivity apart
+  for (unsigned s = 0; s < sizeof(SELECTIVITIES) / sizeof(SELECTIVITIES[0]); s++) {
+    long long width = (long long) (SELECTIVITIES[s] * sample.size());
+    if (width < 1) width = 1;
+
+    statements.clear();
+    for (int i = 0; i < scans; i++) {
+      long long from = random.below(sample.size() - width);
+      snprintf(buf, sizeof(buf), "where key >= %d and key < %d\n", sample[from], sample[from + width]);
+      statements.push_back(buf);
+    }
+
+    for (int index = 0; index <= 1; index++) {
+      vector<string> scan(statements);
+      fprintf(stderr, "%s: %d range scans of %g%s\n", name, scans, SELECTIVITIES[s], index ? " with index" : "");
+      for (unsigned i = 0; i < scan.size(); i++) scan[i] = "select * from " + (index ? indexed : plain) + " " + scan[i];
+      r.workload = "range_scan";
+      r.table = index ? "index" : "table";
+      r.selectivity = SELECTIVITIES[s];
+      run(session, sink, scan, r);
+      results.push_back(r);
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  long long rows = 1000000;
+  int       lookups = 10000;
+  int       scans = 10;
+  unsigned long long seed = 1;
+  string    dir;
+  string    output;
+  string    distribution = "all";
+  bool      removeWhenDone = false;
+  vector<Result> results;
+  int       opt;
+  RC        rc = 0;
+
+  while ((opt = getopt(argc, argv, "n:k:q:r:s:d:o:c:")) != -1) {
+    switch (opt) {
+    case 'n': rows = atoll(optarg); break;
+    case 'k': distribution = optarg; break;
+    case 'q': lookups = atoi(optarg); break;
+    case 'r': scans = atoi(optarg); break;
+    case 's': seed = strtoull(optarg, NULL, 10); break;
+    case 'd': dir = optarg; break;
+    case 'o': output = optarg; break;
+    case 'c':
+      if (PageFile::setCacheSize(atoi(optarg)) < 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    default: usage(argv[0]); return 1;
+    }
+  }
+  if (rows < 2 || lookups < 1 || scans < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // the tables are created in the current directory
+  if (dir.empty()) {
+    const char* tmp = getenv("TMPDIR");
+    string name = string(tmp != NULL ? tmp : "/tmp") + "/bruinbase-bench.XXXXXX";
+    vector<char> path(name.begin(), name.end());
+    path.push_back(0);
+    if (mkdtemp(&path[0]) == NULL) {
+      fprintf(stderr, "Error: cannot create a directory in %s\n", tmp != NULL ? tmp : "/tmp");
+      return 1;
+    }
+    dir = &path[0];
+    removeWhenDone = true;
+  }
+  FILE* out = stdout;
+  if (!output.empty() && (out = fopen(output.c_str(), "w")) == NULL) {
+    fprintf(stderr, "Error: cannot write to %s\n", output.c_str());
+    return 1;
+  }
+  if (chdir(dir.c_str()) < 0) {
+    fprintf(stderr, "Error: cannot use the directory %s\n", dir.c_str());
+    return 1;
+  }
+
+  // the rows of the results are counted and dropped. the time printed
+  // after each query goes to the error stream, so that is dropped too;
+  // a statement that fails shows up in the rows it returns
+  Sink sink = { 0 };
+  cookie_io_functions_t functions = { NULL, sinkWrite, NULL, NULL };
+  SqlSession session(fopencookie(&sink, "w", functions), fopen("/dev/null", "w"));
+
+  for (int d = 0; d < DISTRIBUTIONS && rc == 0; d++) {
+    if (distribution != "all" && distribution != DISTRIBUTION_NAMES[d]) continue;
+    rc = benchmark(session, sink, (KeyDistribution) d, rows, lookups, scans, seed, results);
+  }
+  SqlEngine::endSession(session);
+  SqlEngine::shutdown();
+  fclose(session.out);
+  fclose(session.err);
+
+  if (results.empty() && rc == 0) {
+    fprintf(stderr, "Error: unknown distribution %s\n", distribution.c_str());
+    rc = RC_INVALID_PARAMETER;
+  }
+
+  fprintf(out, "{\n  \"rows\": %lld,\n  \"seed\": %llu,\n  \"results\": [\n", rows, seed);
+  for (unsigned i = 0; i < results.size(); i++) printResult(out, results[i], i + 1 == results.size());
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+
+  if (removeWhenDone) removeDir(dir);
+  return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,2453 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 2
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+/* Substitute the variable and function names.  */
+#define yyparse         sqlparse
+#define yylex           sqllex
+#define yyerror         sqlerror
+#define yydebug         sqldebug
+#define yynerrs         sqlnerrs
+
+/* First part of user prologue.  */
+#line 1 "SqlParser.y"
+
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include <climits>
+#include <string>
+#include "Bruinbase.h"
+#include "SqlEngine.h" 
+#include "PageFile.h"
+#include "QueryPlan.h"
+
+#line 88 "SqlParser.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "SqlParser.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_SELECT = 3,                     /* SELECT  */
+  YYSYMBOL_FROM = 4,                       /* FROM  */
+  YYSYMBOL_WHERE = 5,                      /* WHERE  */
+  YYSYMBOL_LOAD = 6,                       /* LOAD  */
+  YYSYMBOL_WITH = 7,                       /* WITH  */
+  YYSYMBOL_INDEX = 8,                      /* INDEX  */
+  YYSYMBOL_LSM = 9,                        /* LSM  */
+  YYSYMBOL_QUIT = 10,                      /* QUIT  */
+  YYSYMBOL_COUNT = 11,                     /* COUNT  */
+  YYSYMBOL_AND = 12,                       /* AND  */
+  YYSYMBOL_OR = 13,                        /* OR  */
+  YYSYMBOL_IN = 14,                        /* IN  */
+  YYSYMBOL_INSERT = 15,                    /* INSERT  */
+  YYSYMBOL_INTO = 16,                      /* INTO  */
+  YYSYMBOL_VALUES = 17,                    /* VALUES  */
+  YYSYMBOL_DELETE = 18,                    /* DELETE  */
+  YYSYMBOL_PREPARE = 19,                   /* PREPARE  */
+  YYSYMBOL_AS = 20,                        /* AS  */
+  YYSYMBOL_EXECUTE = 21,                   /* EXECUTE  */
+  YYSYMBOL_DEALLOCATE = 22,                /* DEALLOCATE  */
+  YYSYMBOL_ORDER = 23,                     /* ORDER  */
+  YYSYMBOL_BY = 24,                        /* BY  */
+  YYSYMBOL_ASC = 25,                       /* ASC  */
+  YYSYMBOL_DESC = 26,                      /* DESC  */
+  YYSYMBOL_LIMIT = 27,                     /* LIMIT  */
+  YYSYMBOL_OFFSET = 28,                    /* OFFSET  */
+  YYSYMBOL_MIN = 29,                       /* MIN  */
+  YYSYMBOL_MAX = 30,                       /* MAX  */
+  YYSYMBOL_SUM = 31,                       /* SUM  */
+  YYSYMBOL_AVG = 32,                       /* AVG  */
+  YYSYMBOL_GROUP = 33,                     /* GROUP  */
+  YYSYMBOL_DISTINCT = 34,                  /* DISTINCT  */
+  YYSYMBOL_COLUMNS = 35,                   /* COLUMNS  */
+  YYSYMBOL_ANALYZE = 36,                   /* ANALYZE  */
+  YYSYMBOL_EXPLAIN = 37,                   /* EXPLAIN  */
+  YYSYMBOL_SHOW = 38,                      /* SHOW  */
+  YYSYMBOL_STATS = 39,                     /* STATS  */
+  YYSYMBOL_COMMA = 40,                     /* COMMA  */
+  YYSYMBOL_STAR = 41,                      /* STAR  */
+  YYSYMBOL_LF = 42,                        /* LF  */
+  YYSYMBOL_LPAREN = 43,                    /* LPAREN  */
+  YYSYMBOL_RPAREN = 44,                    /* RPAREN  */
+  YYSYMBOL_QMARK = 45,                     /* QMARK  */
+  YYSYMBOL_DOT = 46,                       /* DOT  */
+  YYSYMBOL_INTEGER = 47,                   /* INTEGER  */
+  YYSYMBOL_STRING = 48,                    /* STRING  */
+  YYSYMBOL_ID = 49,                        /* ID  */
+  YYSYMBOL_EQUAL = 50,                     /* EQUAL  */
+  YYSYMBOL_NEQUAL = 51,                    /* NEQUAL  */
+  YYSYMBOL_LESS = 52,                      /* LESS  */
+  YYSYMBOL_LESSEQUAL = 53,                 /* LESSEQUAL  */
+  YYSYMBOL_GREATER = 54,                   /* GREATER  */
+  YYSYMBOL_GREATEREQUAL = 55,              /* GREATEREQUAL  */
+  YYSYMBOL_YYACCEPT = 56,                  /* $accept  */
+  YYSYMBOL_commands = 57,                  /* commands  */
+  YYSYMBOL_command = 58,                   /* command  */
+  YYSYMBOL_quit_command = 59,              /* quit_command  */
+  YYSYMBOL_load_command = 60,              /* load_command  */
+  YYSYMBOL_analyze_command = 61,           /* analyze_command  */
+  YYSYMBOL_show_command = 62,              /* show_command  */
+  YYSYMBOL_insert_command = 63,            /* insert_command  */
+  YYSYMBOL_delete_command = 64,            /* delete_command  */
+  YYSYMBOL_select_command = 65,            /* select_command  */
+  YYSYMBOL_explain_command = 66,           /* explain_command  */
+  YYSYMBOL_explain = 67,                   /* explain  */
+  YYSYMBOL_columns = 68,                   /* columns  */
+  YYSYMBOL_column = 69,                    /* column  */
+  YYSYMBOL_join_conditions = 70,           /* join_conditions  */
+  YYSYMBOL_join_condition = 71,            /* join_condition  */
+  YYSYMBOL_prepare_command = 72,           /* prepare_command  */
+  YYSYMBOL_where_clause = 73,              /* where_clause  */
+  YYSYMBOL_order_clause = 74,              /* order_clause  */
+  YYSYMBOL_direction = 75,                 /* direction  */
+  YYSYMBOL_limit_clause = 76,              /* limit_clause  */
+  YYSYMBOL_execute_command = 77,           /* execute_command  */
+  YYSYMBOL_deallocate_command = 78,        /* deallocate_command  */
+  YYSYMBOL_parameters = 79,                /* parameters  */
+  YYSYMBOL_conditions = 80,                /* conditions  */
+  YYSYMBOL_conjunction = 81,               /* conjunction  */
+  YYSYMBOL_condition = 82,                 /* condition  */
+  YYSYMBOL_values = 83,                    /* values  */
+  YYSYMBOL_attributes = 84,                /* attributes  */
+  YYSYMBOL_attribute = 85,                 /* attribute  */
+  YYSYMBOL_value = 86,                     /* value  */
+  YYSYMBOL_table = 87,                     /* table  */
+  YYSYMBOL_comparator = 88                 /* comparator  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+/* Second part of user prologue.  */
+#line 33 "SqlParser.y"
+
+int  sqllex(YYSTYPE* lvalp, void* scanner);
+void sqlerror(void* scanner, SqlSession* session, const char *str) { fprintf(session->err, "Error: %s\n", str); }
+
+// the time and page accesses of a query
+struct QueryStats {
+  struct timespec      time;  // the start of the query
+  PageFile::IoCounters io;    // the page accesses of the query
+};
+
+static void startQuery(SqlSession* session, QueryStats& stats)
+{
+  // count the page accesses of this thread, and of the workers it waits
+  // for, apart from those of other sessions
+  memset(&stats.io, 0, sizeof(stats.io));
+  PageFile::setIoCounters(&stats.io);
+  if (session->plan != NULL) session->plan->start();
+
+  clock_gettime(CLOCK_MONOTONIC, &stats.time);
+}
+
+static void finishQuery(SqlSession* session, const QueryStats& stats)
+{
+  struct timespec etime;
+  long long       pages = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &etime);
+  if (session->plan != NULL) session->plan->finish();
+  PageFile::setIoCounters(NULL);
+
+  // EXPLAIN without ANALYZE runs nothing
+  if (session->plan != NULL && !session->plan->isAnalyze()) return;
+
+  for (int i = 0; i < PageFile::FILE_KINDS; i++) pages += stats.io.diskReads[i];
+  fprintf(session->err, "  -- %.3f seconds to run the select command. Read %lld pages\n",
+          (etime.tv_sec - stats.time.tv_sec) + (etime.tv_nsec - stats.time.tv_nsec) / 1e9, pages);
+}
+
+// start EXPLAIN [ANALYZE]. the results of a statement that is run are
+// dropped; only the plan is printed.
+static void startExplain(SqlSession* session, bool analyze)
+{
+  session->plan = new QueryPlan(analyze, session->out);
+  if (analyze) session->out = fopen("/dev/null", "w");
+}
+
+// finish EXPLAIN, printing the plan unless the statement failed to parse
+static void finishExplain(SqlSession* session, bool print)
+{
+  if (session->plan == NULL) return;
+
+  if (session->plan->isAnalyze()) {
+    fclose(session->out);
+    session->out = session->plan->getOut();
+  }
+  if (print) session->plan->print();
+  delete session->plan;
+  session->plan = NULL;
+}
+
+static void runSelect(SqlSession* session, int attr, const char* table, const WhereClause& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::select(*session, attr, table, where, order);
+  finishQuery(session, stats);
+}
+
+static void runGroupBy(SqlSession* session, int group, int attr, const char* table, const WhereClause& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::groupBy(*session, group, attr, table, where, order);
+  finishQuery(session, stats);
+}
+
+static void runJoin(SqlSession* session, int attr, const std::vector<JoinColumn>& columns, const char* left, const char* right, const std::vector<JoinCond>& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::join(*session, attr, columns, left, right, where, order);
+  finishQuery(session, stats);
+}
+
+static void runExecute(SqlSession* session, const char* name, const std::vector<char*>& params)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::executePrepared(*session, name, params);
+  finishQuery(session, stats);
+}
+
+static void freeWhere(WhereClause* where)
+{
+  for (unsigned i = 0; i < where->size(); i++) {
+    for (unsigned j = 0; j < (*where)[i].size(); j++) {
+      SelCond& c = (*where)[i][j];
+      free(c.value);
+      for (unsigned k = 0; k < c.list.size(); k++) free(c.list[k]);
+    }
+  }
+  delete where;
+}
+
+static void freeColumns(std::vector<JoinColumn>* columns)
+{
+  for (unsigned i = 0; i < columns->size(); i++) free((*columns)[i].table);
+  delete columns;
+}
+
+static void freeJoinConds(std::vector<JoinCond>* conds)
+{
+  for (unsigned i = 0; i < conds->size(); i++) {
+    JoinCond& c = (*conds)[i];
+    free(c.column.table);
+    free(c.other.table);
+    free(c.value);
+  }
+  delete conds;
+}
+
+#line 336 "SqlParser.tab.c"
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  2
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   219
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  56
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  33
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  89
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  217
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   310
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    34,
+      35,    36,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    47,    48,    49,    50,    51,    52,    53,    54,
+      55
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,   191,   191,   192,   196,   197,   198,   199,   200,   201,
+     202,   203,   204,   205,   206,   207,   211,   215,   219,   224,
+     229,   234,   239,   244,   252,   259,   263,   272,   277,   285,
+     290,   299,   305,   312,   320,   330,   334,   335,   339,   343,
+     350,   357,   362,   370,   377,   393,   399,   412,   413,   417,
+     418,   430,   431,   432,   436,   443,   451,   463,   468,   479,
+     488,   493,   498,   502,   509,   515,   523,   529,   537,   544,
+     556,   561,   568,   569,   570,   571,   572,   573,   580,   590,
+     598,   599,   600,   604,   608,   609,   610,   611,   612,   613
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "SELECT", "FROM",
+  "WHERE", "LOAD", "WITH", "INDEX", "LSM", "QUIT", "COUNT", "AND", "OR",
+  "IN", "INSERT", "INTO", "VALUES", "DELETE", "PREPARE", "AS", "EXECUTE",
+  "DEALLOCATE", "ORDER", "BY", "ASC", "DESC", "LIMIT", "OFFSET", "MIN",
+  "MAX", "SUM", "AVG", "GROUP", "DISTINCT", "COLUMNS", "ANALYZE",
+  "EXPLAIN", "SHOW", "STATS", "COMMA", "STAR", "LF", "LPAREN", "RPAREN",
+  "QMARK", "DOT", "INTEGER", "STRING", "ID", "EQUAL", "NEQUAL", "LESS",
+  "LESSEQUAL", "GREATER", "GREATEREQUAL", "$accept", "commands", "command",
+  "quit_command", "load_command", "analyze_command", "show_command",
+  "insert_command", "delete_command", "select_command", "explain_command",
+  "explain", "columns", "column", "join_conditions", "join_condition",
+  "prepare_command", "where_clause", "order_clause", "direction",
+  "limit_clause", "execute_command", "deallocate_command", "parameters",
+  "conditions", "conjunction", "condition", "values", "attributes",
+  "attribute", "value", "table", "comparator", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-159)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int16 yypact[] =
+{
+    -159,    98,  -159,   -28,   118,   -25,  -159,    60,    70,    35,
+      48,    61,   -25,    57,    68,  -159,  -159,  -159,  -159,  -159,
+    -159,  -159,  -159,  -159,  -159,    78,  -159,  -159,  -159,  -159,
+    -159,    66,    69,    71,    72,    -1,  -159,    65,     7,  -159,
+     114,    81,  -159,   119,   -25,   -25,   102,   -35,    82,    84,
+    -159,    86,  -159,    83,    83,    83,    83,  -159,   126,  -159,
+      83,   -25,    88,   -25,    -1,    90,   122,    12,   128,  -159,
+      32,  -159,  -159,  -159,    97,    99,   101,   107,   -25,  -159,
+     113,    65,  -159,    18,   150,    15,   112,    83,  -159,   131,
+    -159,  -159,   -19,  -159,  -159,  -159,  -159,   151,   -25,    83,
+     -25,    45,   -25,    58,   129,  -159,   111,    19,   154,  -159,
+      -9,    -1,   164,    41,   127,    42,   165,   158,   174,   159,
+     135,   160,   143,  -159,   151,    40,   178,   145,   148,    83,
+    -159,    83,   147,  -159,  -159,  -159,  -159,  -159,  -159,    55,
+     187,   -25,  -159,  -159,  -159,   152,    88,    88,    83,   167,
+      83,  -159,   163,   157,  -159,    44,  -159,   149,   154,  -159,
+      55,  -159,  -159,  -159,  -159,   -25,   151,  -159,   123,     0,
+    -159,     0,    80,   146,    42,   175,   156,   166,  -159,   161,
+      33,  -159,   151,    42,   -29,    88,   162,   168,  -159,  -159,
+     173,  -159,   169,    83,  -159,   170,   171,    55,  -159,    42,
+     172,  -159,  -159,  -159,  -159,  -159,  -159,  -159,    42,  -159,
+    -159,  -159,   176,  -159,   177,  -159,  -159
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       3,     0,     1,     0,     0,     0,    17,     0,     0,     0,
+       0,     0,     0,    36,     0,    16,     2,    14,     4,     5,
+       8,     9,    10,     6,     7,     0,    11,    12,    13,    15,
+      74,     0,     0,     0,     0,     0,    73,    79,     0,    38,
+       0,    72,    83,     0,     0,     0,     0,     0,     0,     0,
+      37,     0,    35,     0,     0,     0,     0,    79,     0,    72,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,    57,
+       0,    59,    24,    25,     0,     0,     0,     0,     0,    40,
+       0,     0,    39,    47,     0,     0,     0,     0,    27,     0,
+      60,    61,     0,    75,    76,    77,    78,    47,     0,     0,
+       0,    54,     0,     0,     0,    18,     0,     0,    64,    66,
+       0,     0,     0,     0,     0,    54,     0,    48,     0,     0,
+       0,     0,     0,    49,    47,     0,     0,     0,     0,     0,
+      28,     0,     0,    84,    85,    86,    88,    87,    89,     0,
+       0,     0,    62,    63,    58,     0,     0,     0,     0,    55,
+       0,    29,     0,     0,    19,     0,    20,     0,    65,    67,
+       0,    82,    80,    81,    68,     0,    47,    30,     0,    54,
+      41,    54,    51,     0,    54,     0,     0,     0,    22,     0,
+       0,    70,    47,    54,     0,     0,     0,     0,    52,    53,
+      54,    56,     0,     0,    21,     0,     0,     0,    69,    54,
+       0,    43,    44,    42,    34,    33,    50,    31,    54,    23,
+      26,    71,     0,    45,     0,    46,    32
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int16 yypgoto[] =
+{
+    -159,  -159,  -159,  -159,  -159,  -159,  -159,  -159,  -159,   181,
+    -159,  -159,  -159,    -3,    56,    17,  -159,   -91,  -112,  -159,
+    -156,  -159,  -159,  -159,   108,    79,    85,  -159,   -26,    -4,
+    -158,    -8,    47
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_uint8 yydefgoto[] =
+{
+       0,     1,    16,    17,    18,    19,    20,    21,    22,    23,
+      24,    25,    38,   168,   169,   170,    26,   101,   122,   190,
+     123,    27,    28,    92,   107,   108,   109,   180,    40,    59,
+     164,    43,   139
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_uint8 yytable[] =
+{
+      41,    39,   181,   145,    49,   132,   115,    69,    70,    58,
+      30,    61,   185,   186,    29,   187,   161,    87,   162,   163,
+      81,   113,   103,    99,    42,   114,   202,   120,    31,    32,
+      33,    34,   129,   152,   206,   104,    66,    67,    84,   211,
+      36,   133,   134,   135,   136,   137,   138,    62,    57,    74,
+      75,    76,    77,    80,    88,    83,    79,   105,   100,    82,
+     153,   130,   192,   112,   177,   119,   125,   126,   119,   120,
+      97,   200,   120,   197,    45,   183,    44,   198,   121,    90,
+      91,     4,   154,   110,    46,   140,   178,   212,   142,   143,
+     116,   199,   118,    50,   124,   110,   214,    47,     2,     3,
+     161,     4,   162,   163,     5,   188,   189,    51,     6,    53,
+      48,    60,    54,     7,    55,    56,     8,     9,    63,    10,
+      11,    64,    68,    65,    71,   110,    72,   110,    73,    30,
+      78,    89,    57,   166,    12,    13,    14,    81,    85,    86,
+      15,    93,    30,    94,   172,    95,   174,    31,    32,    33,
+      34,    96,    35,    98,   102,   106,    99,   182,   128,    36,
+      31,    32,    33,    34,   127,   111,   131,    37,   141,   144,
+     146,   129,    36,   133,   134,   135,   136,   137,   138,   147,
+      57,   201,   149,   148,   150,   151,   155,   156,   157,   208,
+     160,   165,   176,   191,   167,   173,   175,   179,   194,   193,
+     120,   195,   203,   171,   204,   196,    52,   117,   158,     0,
+     205,   207,   209,   210,   213,   184,   159,     0,   215,   216
+};
+
+static const yytype_int16 yycheck[] =
+{
+       4,     4,   160,   115,    12,    14,    97,    42,    43,    35,
+      11,     4,    12,   169,    42,   171,    45,     5,    47,    48,
+      49,    40,     7,     5,    49,    44,   184,    27,    29,    30,
+      31,    32,    13,   124,   190,    20,    44,    45,    64,   197,
+      41,    50,    51,    52,    53,    54,    55,    40,    49,    53,
+      54,    55,    56,    61,    42,    63,    60,    42,    40,    62,
+      20,    42,   174,    89,    20,    23,     8,     9,    23,    27,
+      78,   183,    27,    40,     4,   166,    16,    44,    33,    47,
+      48,     3,    42,    87,    49,   111,    42,   199,    47,    48,
+      98,   182,   100,    36,   102,    99,   208,    49,     0,     1,
+      45,     3,    47,    48,     6,    25,    26,    39,    10,    43,
+      49,    46,    43,    15,    43,    43,    18,    19,     4,    21,
+      22,    40,    20,     4,    42,   129,    42,   131,    42,    11,
+       4,     3,    49,   141,    36,    37,    38,    49,    48,    17,
+      42,    44,    11,    44,   148,    44,   150,    29,    30,    31,
+      32,    44,    34,    40,     4,    43,     5,   165,    47,    41,
+      29,    30,    31,    32,    35,    34,    12,    49,     4,    42,
+       5,    13,    41,    50,    51,    52,    53,    54,    55,     5,
+      49,   184,    47,    24,    24,    42,     8,    42,    40,   193,
+      43,     4,    35,    47,    42,    28,    33,    48,    42,    24,
+      27,    35,   185,   147,    42,    44,    25,    99,   129,    -1,
+      42,    42,    42,    42,    42,   168,   131,    -1,    42,    42
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,    57,     0,     1,     3,     6,    10,    15,    18,    19,
+      21,    22,    36,    37,    38,    42,    58,    59,    60,    61,
+      62,    63,    64,    65,    66,    67,    72,    77,    78,    42,
+      11,    29,    30,    31,    32,    34,    41,    49,    68,    69,
+      84,    85,    49,    87,    16,     4,    49,    49,    49,    87,
+      36,    39,    65,    43,    43,    43,    43,    49,    84,    85,
+      46,     4,    40,     4,    40,     4,    87,    87,    20,    42,
+      43,    42,    42,    42,    85,    85,    85,    85,     4,    85,
+      87,    49,    69,    87,    84,    48,    17,     5,    42,     3,
+      47,    48,    79,    44,    44,    44,    44,    87,    40,     5,
+      40,    73,     4,     7,    20,    42,    43,    80,    81,    82,
+      85,    34,    84,    40,    44,    73,    87,    80,    87,    23,
+      27,    33,    74,    76,    87,     8,     9,    35,    47,    13,
+      42,    12,    14,    50,    51,    52,    53,    54,    55,    88,
+      84,     4,    47,    48,    42,    74,     5,     5,    24,    47,
+      24,    42,    73,    20,    42,     8,    42,    40,    81,    82,
+      43,    45,    47,    48,    86,     4,    87,    42,    69,    70,
+      71,    70,    85,    28,    85,    33,    35,    20,    42,    48,
+      83,    86,    87,    73,    88,    12,    76,    76,    25,    26,
+      75,    47,    74,    24,    42,    35,    44,    40,    44,    73,
+      74,    69,    86,    71,    42,    42,    76,    42,    85,    42,
+      42,    86,    74,    42,    74,    42,    42
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    56,    57,    57,    58,    58,    58,    58,    58,    58,
+      58,    58,    58,    58,    58,    58,    58,    59,    60,    60,
+      60,    60,    60,    60,    61,    62,    63,    64,    64,    65,
+      65,    65,    65,    65,    65,    66,    67,    67,    68,    68,
+      69,    70,    70,    71,    71,    72,    72,    73,    73,    74,
+      74,    75,    75,    75,    76,    76,    76,    77,    77,    78,
+      79,    79,    79,    79,    80,    80,    81,    81,    82,    82,
+      83,    83,    84,    84,    84,    84,    84,    84,    84,    85,
+      86,    86,    86,    87,    88,    88,    88,    88,    88,    88
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     2,     0,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     1,     1,     2,     1,     1,     5,     7,
+       7,     9,     8,    10,     3,     3,    10,     4,     6,     7,
+       8,    10,    12,    10,    10,     2,     1,     2,     1,     3,
+       3,     1,     3,     3,     3,    10,    11,     0,     2,     1,
+       5,     0,     1,     1,     0,     2,     4,     3,     6,     3,
+       1,     1,     3,     3,     1,     3,     1,     3,     3,     5,
+       1,     3,     1,     1,     1,     4,     4,     4,     4,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (scanner, session, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, scanner, session); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, void* scanner, SqlSession* session)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (scanner);
+  YY_USE (session);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, void* scanner, SqlSession* session)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep, scanner, session);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, void* scanner, SqlSession* session)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], scanner, session);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, scanner, session); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, void* scanner, SqlSession* session)
+{
+  YY_USE (yyvaluep);
+  YY_USE (scanner);
+  YY_USE (session);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  switch (yykind)
+    {
+    case YYSYMBOL_INTEGER: /* INTEGER  */
+#line 182 "SqlParser.y"
+            { free(((*yyvaluep).string)); }
+#line 1175 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_STRING: /* STRING  */
+#line 182 "SqlParser.y"
+            { free(((*yyvaluep).string)); }
+#line 1181 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_ID: /* ID  */
+#line 182 "SqlParser.y"
+            { free(((*yyvaluep).string)); }
+#line 1187 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_columns: /* columns  */
+#line 184 "SqlParser.y"
+            { freeColumns(((*yyvaluep).columns)); }
+#line 1193 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_column: /* column  */
+#line 186 "SqlParser.y"
+            { free(((*yyvaluep).column).table); }
+#line 1199 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_join_conditions: /* join_conditions  */
+#line 185 "SqlParser.y"
+            { freeJoinConds(((*yyvaluep).jconds)); }
+#line 1205 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_join_condition: /* join_condition  */
+#line 187 "SqlParser.y"
+            { free(((*yyvaluep).jcond)->column.table); free(((*yyvaluep).jcond)->other.table); free(((*yyvaluep).jcond)->value); delete ((*yyvaluep).jcond); }
+#line 1211 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_where_clause: /* where_clause  */
+#line 183 "SqlParser.y"
+            { freeWhere(((*yyvaluep).where)); }
+#line 1217 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_conditions: /* conditions  */
+#line 183 "SqlParser.y"
+            { freeWhere(((*yyvaluep).where)); }
+#line 1223 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_value: /* value  */
+#line 182 "SqlParser.y"
+            { free(((*yyvaluep).string)); }
+#line 1229 "SqlParser.tab.c"
+        break;
+
+    case YYSYMBOL_table: /* table  */
+#line 182 "SqlParser.y"
+            { free(((*yyvaluep).string)); }
+#line 1235 "SqlParser.tab.c"
+        break;
+
+      default:
+        break;
+    }
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (void* scanner, SqlSession* session)
+{
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
+
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, scanner);
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 4: /* command: load_command  */
+#line 196 "SqlParser.y"
+                     { fprintf(session->out, "Bruinbase> "); }
+#line 1511 "SqlParser.tab.c"
+    break;
+
+  case 5: /* command: analyze_command  */
+#line 197 "SqlParser.y"
+                          { fprintf(session->out, "Bruinbase> "); }
+#line 1517 "SqlParser.tab.c"
+    break;
+
+  case 6: /* command: select_command  */
+#line 198 "SqlParser.y"
+                         { fprintf(session->out, "Bruinbase> "); }
+#line 1523 "SqlParser.tab.c"
+    break;
+
+  case 7: /* command: explain_command  */
+#line 199 "SqlParser.y"
+                          { fprintf(session->out, "Bruinbase> "); }
+#line 1529 "SqlParser.tab.c"
+    break;
+
+  case 8: /* command: show_command  */
+#line 200 "SqlParser.y"
+                       { fprintf(session->out, "Bruinbase> "); }
+#line 1535 "SqlParser.tab.c"
+    break;
+
+  case 9: /* command: insert_command  */
+#line 201 "SqlParser.y"
+                         { fprintf(session->out, "Bruinbase> "); }
+#line 1541 "SqlParser.tab.c"
+    break;
+
+  case 10: /* command: delete_command  */
+#line 202 "SqlParser.y"
+                         { fprintf(session->out, "Bruinbase> "); }
+#line 1547 "SqlParser.tab.c"
+    break;
+
+  case 11: /* command: prepare_command  */
+#line 203 "SqlParser.y"
+                          { fprintf(session->out, "Bruinbase> "); }
+#line 1553 "SqlParser.tab.c"
+    break;
+
+  case 12: /* command: execute_command  */
+#line 204 "SqlParser.y"
+                          { fprintf(session->out, "Bruinbase> "); }
+#line 1559 "SqlParser.tab.c"
+    break;
+
+  case 13: /* command: deallocate_command  */
+#line 205 "SqlParser.y"
+                             { fprintf(session->out, "Bruinbase> "); }
+#line 1565 "SqlParser.tab.c"
+    break;
+
+  case 15: /* command: error LF  */
+#line 207 "SqlParser.y"
+                   {
+	  finishExplain(session, false);
+	  fprintf(session->out, "Bruinbase> ");
+	}
+#line 1574 "SqlParser.tab.c"
+    break;
+
+  case 16: /* command: LF  */
+#line 211 "SqlParser.y"
+             { fprintf(session->out, "Bruinbase> "); }
+#line 1580 "SqlParser.tab.c"
+    break;
+
+  case 17: /* quit_command: QUIT  */
+#line 215 "SqlParser.y"
+             { session->quit = true; return 0; }
+#line 1586 "SqlParser.tab.c"
+    break;
+
+  case 18: /* load_command: LOAD table FROM STRING LF  */
+#line 219 "SqlParser.y"
+                                  { 
+	  SqlEngine::load(*session, std::string((yyvsp[-3].string)), std::string((yyvsp[-1].string)), false, false, false); 
+	  free((yyvsp[-3].string));
+	  free((yyvsp[-1].string));
+	}
+#line 1596 "SqlParser.tab.c"
+    break;
+
+  case 19: /* load_command: LOAD table FROM STRING WITH INDEX LF  */
+#line 224 "SqlParser.y"
+                                               { 
+	  SqlEngine::load(*session, std::string((yyvsp[-5].string)), std::string((yyvsp[-3].string)), true, false, false); 
+	  free((yyvsp[-5].string));
+	  free((yyvsp[-3].string));
+	}
+#line 1606 "SqlParser.tab.c"
+    break;
+
+  case 20: /* load_command: LOAD table FROM STRING AS COLUMNS LF  */
+#line 229 "SqlParser.y"
+                                               { 
+	  SqlEngine::load(*session, std::string((yyvsp[-5].string)), std::string((yyvsp[-3].string)), false, true, false); 
+	  free((yyvsp[-5].string));
+	  free((yyvsp[-3].string));
+	}
+#line 1616 "SqlParser.tab.c"
+    break;
+
+  case 21: /* load_command: LOAD table FROM STRING WITH INDEX AS COLUMNS LF  */
+#line 234 "SqlParser.y"
+                                                          { 
+	  SqlEngine::load(*session, std::string((yyvsp[-7].string)), std::string((yyvsp[-5].string)), true, true, false); 
+	  free((yyvsp[-7].string));
+	  free((yyvsp[-5].string));
+	}
+#line 1626 "SqlParser.tab.c"
+    break;
+
+  case 22: /* load_command: LOAD table FROM STRING WITH LSM INDEX LF  */
+#line 239 "SqlParser.y"
+                                                   { 
+	  SqlEngine::load(*session, std::string((yyvsp[-6].string)), std::string((yyvsp[-4].string)), true, false, true); 
+	  free((yyvsp[-6].string));
+	  free((yyvsp[-4].string));
+	}
+#line 1636 "SqlParser.tab.c"
+    break;
+
+  case 23: /* load_command: LOAD table FROM STRING WITH LSM INDEX AS COLUMNS LF  */
+#line 244 "SqlParser.y"
+                                                              { 
+	  SqlEngine::load(*session, std::string((yyvsp[-8].string)), std::string((yyvsp[-6].string)), true, true, true); 
+	  free((yyvsp[-8].string));
+	  free((yyvsp[-6].string));
+	}
+#line 1646 "SqlParser.tab.c"
+    break;
+
+  case 24: /* analyze_command: ANALYZE table LF  */
+#line 252 "SqlParser.y"
+                         {
+	  SqlEngine::analyze(*session, std::string((yyvsp[-1].string)));
+	  free((yyvsp[-1].string));
+	}
+#line 1655 "SqlParser.tab.c"
+    break;
+
+  case 25: /* show_command: SHOW STATS LF  */
+#line 259 "SqlParser.y"
+                      { SqlEngine::showStats(*session); }
+#line 1661 "SqlParser.tab.c"
+    break;
+
+  case 26: /* insert_command: INSERT INTO table VALUES LPAREN INTEGER COMMA STRING RPAREN LF  */
+#line 263 "SqlParser.y"
+                                                                       {
+	  SqlEngine::insert(*session, std::string((yyvsp[-7].string)), atoi((yyvsp[-4].string)), std::string((yyvsp[-2].string)));
+	  free((yyvsp[-7].string));
+	  free((yyvsp[-4].string));
+	  free((yyvsp[-2].string));
+	}
+#line 1672 "SqlParser.tab.c"
+    break;
+
+  case 27: /* delete_command: DELETE FROM table LF  */
+#line 272 "SqlParser.y"
+                             {
+	  WhereClause where;
+	  SqlEngine::remove(*session, std::string((yyvsp[-1].string)), where);
+	  free((yyvsp[-1].string));
+	}
+#line 1682 "SqlParser.tab.c"
+    break;
+
+  case 28: /* delete_command: DELETE FROM table WHERE conditions LF  */
+#line 277 "SqlParser.y"
+                                                {
+	  SqlEngine::remove(*session, std::string((yyvsp[-3].string)), *(yyvsp[-1].where));
+	  free((yyvsp[-3].string));
+	  freeWhere((yyvsp[-1].where));
+	}
+#line 1692 "SqlParser.tab.c"
+    break;
+
+  case 29: /* select_command: SELECT attributes FROM table where_clause order_clause LF  */
+#line 285 "SqlParser.y"
+                                                                  {
+		runSelect(session, (yyvsp[-5].integer), (yyvsp[-3].string), *(yyvsp[-2].where), (yyvsp[-1].order));
+	  	free((yyvsp[-3].string));
+	  	freeWhere((yyvsp[-2].where));
+	}
+#line 1702 "SqlParser.tab.c"
+    break;
+
+  case 30: /* select_command: SELECT DISTINCT attributes FROM table where_clause order_clause LF  */
+#line 290 "SqlParser.y"
+                                                                             {
+	  if ((yyvsp[-5].integer) >= 4) sqlerror(scanner, session, "DISTINCT is only supported on key, value and *");
+	  else {
+	    (yyvsp[-1].order).distinct = true;
+	    runSelect(session, (yyvsp[-5].integer), (yyvsp[-3].string), *(yyvsp[-2].where), (yyvsp[-1].order));
+	  }
+	  free((yyvsp[-3].string));
+	  freeWhere((yyvsp[-2].where));
+	}
+#line 1716 "SqlParser.tab.c"
+    break;
+
+  case 31: /* select_command: SELECT attributes FROM table where_clause GROUP BY attribute order_clause LF  */
+#line 299 "SqlParser.y"
+                                                                                       {
+	  if ((yyvsp[-8].integer) != (yyvsp[-2].integer)) sqlerror(scanner, session, "the SELECT clause must list the GROUP BY attribute");
+	  else runGroupBy(session, (yyvsp[-2].integer), 0, (yyvsp[-6].string), *(yyvsp[-5].where), (yyvsp[-1].order));
+	  free((yyvsp[-6].string));
+	  freeWhere((yyvsp[-5].where));
+	}
+#line 1727 "SqlParser.tab.c"
+    break;
+
+  case 32: /* select_command: SELECT attribute COMMA attributes FROM table where_clause GROUP BY attribute order_clause LF  */
+#line 305 "SqlParser.y"
+                                                                                                       {
+	  if ((yyvsp[-10].integer) != (yyvsp[-2].integer)) sqlerror(scanner, session, "the SELECT clause must list the GROUP BY attribute");
+	  else if ((yyvsp[-8].integer) < 4) sqlerror(scanner, session, "only an aggregate can follow the GROUP BY attribute");
+	  else runGroupBy(session, (yyvsp[-2].integer), (yyvsp[-8].integer), (yyvsp[-6].string), *(yyvsp[-5].where), (yyvsp[-1].order));
+	  free((yyvsp[-6].string));
+	  freeWhere((yyvsp[-5].where));
+	}
+#line 1739 "SqlParser.tab.c"
+    break;
+
+  case 33: /* select_command: SELECT attributes FROM table COMMA table WHERE join_conditions limit_clause LF  */
+#line 312 "SqlParser.y"
+                                                                                         {
+	  std::vector<JoinColumn> none;
+	  if ((yyvsp[-8].integer) != 3 && (yyvsp[-8].integer) != 4) sqlerror(scanner, session, "the columns of a join must be qualified with their table");
+	  else runJoin(session, (yyvsp[-8].integer), none, (yyvsp[-6].string), (yyvsp[-4].string), *(yyvsp[-2].jconds), (yyvsp[-1].order));
+	  free((yyvsp[-6].string));
+	  free((yyvsp[-4].string));
+	  freeJoinConds((yyvsp[-2].jconds));
+	}
+#line 1752 "SqlParser.tab.c"
+    break;
+
+  case 34: /* select_command: SELECT columns FROM table COMMA table WHERE join_conditions limit_clause LF  */
+#line 320 "SqlParser.y"
+                                                                                      {
+	  runJoin(session, 0, *(yyvsp[-8].columns), (yyvsp[-6].string), (yyvsp[-4].string), *(yyvsp[-2].jconds), (yyvsp[-1].order));
+	  freeColumns((yyvsp[-8].columns));
+	  free((yyvsp[-6].string));
+	  free((yyvsp[-4].string));
+	  freeJoinConds((yyvsp[-2].jconds));
+	}
+#line 1764 "SqlParser.tab.c"
+    break;
+
+  case 35: /* explain_command: explain select_command  */
+#line 330 "SqlParser.y"
+                               { finishExplain(session, true); }
+#line 1770 "SqlParser.tab.c"
+    break;
+
+  case 36: /* explain: EXPLAIN  */
+#line 334 "SqlParser.y"
+                { startExplain(session, false); }
+#line 1776 "SqlParser.tab.c"
+    break;
+
+  case 37: /* explain: EXPLAIN ANALYZE  */
+#line 335 "SqlParser.y"
+                          { startExplain(session, true); }
+#line 1782 "SqlParser.tab.c"
+    break;
+
+  case 38: /* columns: column  */
+#line 339 "SqlParser.y"
+               {
+	  (yyval.columns) = new std::vector<JoinColumn>;
+	  (yyval.columns)->push_back((yyvsp[0].column));
+	}
+#line 1791 "SqlParser.tab.c"
+    break;
+
+  case 39: /* columns: columns COMMA column  */
+#line 343 "SqlParser.y"
+                               {
+	  (yyvsp[-2].columns)->push_back((yyvsp[0].column));
+	  (yyval.columns) = (yyvsp[-2].columns);
+	}
+#line 1800 "SqlParser.tab.c"
+    break;
+
+  case 40: /* column: ID DOT attribute  */
+#line 350 "SqlParser.y"
+                         {
+	  (yyval.column).table = (yyvsp[-2].string);
+	  (yyval.column).attr = (yyvsp[0].integer);
+	}
+#line 1809 "SqlParser.tab.c"
+    break;
+
+  case 41: /* join_conditions: join_condition  */
+#line 357 "SqlParser.y"
+                       {
+	  (yyval.jconds) = new std::vector<JoinCond>;
+	  (yyval.jconds)->push_back(*(yyvsp[0].jcond));
+	  delete (yyvsp[0].jcond);
+	}
+#line 1819 "SqlParser.tab.c"
+    break;
+
+  case 42: /* join_conditions: join_conditions AND join_condition  */
+#line 362 "SqlParser.y"
+                                             {
+	  (yyvsp[-2].jconds)->push_back(*(yyvsp[0].jcond));
+	  (yyval.jconds) = (yyvsp[-2].jconds);
+	  delete (yyvsp[0].jcond);
+	}
+#line 1829 "SqlParser.tab.c"
+    break;
+
+  case 43: /* join_condition: column comparator column  */
+#line 370 "SqlParser.y"
+                                 {
+	  (yyval.jcond) = new JoinCond;
+	  (yyval.jcond)->column = (yyvsp[-2].column);
+	  (yyval.jcond)->comp = static_cast<SelCond::Comparator>((yyvsp[-1].integer));
+	  (yyval.jcond)->other = (yyvsp[0].column);
+	  (yyval.jcond)->value = NULL;
+	}
+#line 1841 "SqlParser.tab.c"
+    break;
+
+  case 44: /* join_condition: column comparator value  */
+#line 377 "SqlParser.y"
+                                  {
+	  if ((yyvsp[0].string) == NULL) {
+	    sqlerror(scanner, session, "? can only be used in PREPARE");
+	    free((yyvsp[-2].column).table);
+	    YYERROR;
+	  }
+	  (yyval.jcond) = new JoinCond;
+	  (yyval.jcond)->column = (yyvsp[-2].column);
+	  (yyval.jcond)->comp = static_cast<SelCond::Comparator>((yyvsp[-1].integer));
+	  (yyval.jcond)->other.table = NULL;
+	  (yyval.jcond)->other.attr = 0;
+	  (yyval.jcond)->value = (yyvsp[0].string);
+	}
+#line 1859 "SqlParser.tab.c"
+    break;
+
+  case 45: /* prepare_command: PREPARE ID AS SELECT attributes FROM table where_clause order_clause LF  */
+#line 393 "SqlParser.y"
+                                                                                {
+	  SqlEngine::prepare(*session, std::string((yyvsp[-8].string)), (yyvsp[-5].integer), std::string((yyvsp[-3].string)), *(yyvsp[-2].where), (yyvsp[-1].order));
+	  free((yyvsp[-8].string));
+	  free((yyvsp[-3].string));
+	  freeWhere((yyvsp[-2].where));
+	}
+#line 1870 "SqlParser.tab.c"
+    break;
+
+  case 46: /* prepare_command: PREPARE ID AS SELECT DISTINCT attributes FROM table where_clause order_clause LF  */
+#line 399 "SqlParser.y"
+                                                                                           {
+	  if ((yyvsp[-5].integer) >= 4) sqlerror(scanner, session, "DISTINCT is only supported on key, value and *");
+	  else {
+	    (yyvsp[-1].order).distinct = true;
+	    SqlEngine::prepare(*session, std::string((yyvsp[-9].string)), (yyvsp[-5].integer), std::string((yyvsp[-3].string)), *(yyvsp[-2].where), (yyvsp[-1].order));
+	  }
+	  free((yyvsp[-9].string));
+	  free((yyvsp[-3].string));
+	  freeWhere((yyvsp[-2].where));
+	}
+#line 1885 "SqlParser.tab.c"
+    break;
+
+  case 47: /* where_clause: %empty  */
+#line 412 "SqlParser.y"
+                              { (yyval.where) = new WhereClause; }
+#line 1891 "SqlParser.tab.c"
+    break;
+
+  case 48: /* where_clause: WHERE conditions  */
+#line 413 "SqlParser.y"
+                           { (yyval.where) = (yyvsp[0].where); }
+#line 1897 "SqlParser.tab.c"
+    break;
+
+  case 49: /* order_clause: limit_clause  */
+#line 417 "SqlParser.y"
+                     { (yyval.order) = (yyvsp[0].order); }
+#line 1903 "SqlParser.tab.c"
+    break;
+
+  case 50: /* order_clause: ORDER BY attribute direction limit_clause  */
+#line 418 "SqlParser.y"
+                                                    {
+	  if ((yyvsp[-2].integer) != 1 && (yyvsp[-2].integer) != 2) {
+	    sqlerror(scanner, session, "only ORDER BY key and ORDER BY value are supported");
+	    YYERROR;
+	  }
+	  (yyval.order) = (yyvsp[0].order);
+	  (yyval.order).order = (yyvsp[-1].direction);
+	  (yyval.order).attr = (yyvsp[-2].integer);
+	}
+#line 1917 "SqlParser.tab.c"
+    break;
+
+  case 51: /* direction: %empty  */
+#line 430 "SqlParser.y"
+                                   { (yyval.direction) = SelOrder::ASC; }
+#line 1923 "SqlParser.tab.c"
+    break;
+
+  case 52: /* direction: ASC  */
+#line 431 "SqlParser.y"
+               { (yyval.direction) = SelOrder::ASC; }
+#line 1929 "SqlParser.tab.c"
+    break;
+
+  case 53: /* direction: DESC  */
+#line 432 "SqlParser.y"
+               { (yyval.direction) = SelOrder::DESC; }
+#line 1935 "SqlParser.tab.c"
+    break;
+
+  case 54: /* limit_clause: %empty  */
+#line 436 "SqlParser.y"
+                              {
+	  (yyval.order).order = SelOrder::NONE;
+	  (yyval.order).attr = 1;
+	  (yyval.order).limit = -1;
+	  (yyval.order).offset = 0;
+	  (yyval.order).distinct = false;
+	}
+#line 1947 "SqlParser.tab.c"
+    break;
+
+  case 55: /* limit_clause: LIMIT INTEGER  */
+#line 443 "SqlParser.y"
+                        {
+	  (yyval.order).order = SelOrder::NONE;
+	  (yyval.order).attr = 1;
+	  (yyval.order).limit = atoi((yyvsp[0].string));
+	  (yyval.order).offset = 0;
+	  (yyval.order).distinct = false;
+	  free((yyvsp[0].string));
+	}
+#line 1960 "SqlParser.tab.c"
+    break;
+
+  case 56: /* limit_clause: LIMIT INTEGER OFFSET INTEGER  */
+#line 451 "SqlParser.y"
+                                       {
+	  (yyval.order).order = SelOrder::NONE;
+	  (yyval.order).attr = 1;
+	  (yyval.order).limit = atoi((yyvsp[-2].string));
+	  (yyval.order).offset = atoi((yyvsp[0].string));
+	  (yyval.order).distinct = false;
+	  free((yyvsp[-2].string));
+	  free((yyvsp[0].string));
+	}
+#line 1974 "SqlParser.tab.c"
+    break;
+
+  case 57: /* execute_command: EXECUTE ID LF  */
+#line 463 "SqlParser.y"
+                      {
+	  std::vector<char*> params;
+	  runExecute(session, (yyvsp[-1].string), params);
+	  free((yyvsp[-1].string));
+	}
+#line 1984 "SqlParser.tab.c"
+    break;
+
+  case 58: /* execute_command: EXECUTE ID LPAREN parameters RPAREN LF  */
+#line 468 "SqlParser.y"
+                                                 {
+	  runExecute(session, (yyvsp[-4].string), *(yyvsp[-2].values));
+	  free((yyvsp[-4].string));
+	  for (unsigned i = 0; i < (yyvsp[-2].values)->size(); i++) {
+	    free((*(yyvsp[-2].values))[i]);
+	  }
+	  delete (yyvsp[-2].values);
+	}
+#line 1997 "SqlParser.tab.c"
+    break;
+
+  case 59: /* deallocate_command: DEALLOCATE ID LF  */
+#line 479 "SqlParser.y"
+                         {
+	  if (SqlEngine::deallocate(*session, std::string((yyvsp[-1].string))) < 0) {
+	    fprintf(session->err, "Error: prepared statement %s does not exist\n", (yyvsp[-1].string));
+	  }
+	  free((yyvsp[-1].string));
+	}
+#line 2008 "SqlParser.tab.c"
+    break;
+
+  case 60: /* parameters: INTEGER  */
+#line 488 "SqlParser.y"
+                {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back((yyvsp[0].string));
+	  (yyval.values) = v;
+	}
+#line 2018 "SqlParser.tab.c"
+    break;
+
+  case 61: /* parameters: STRING  */
+#line 493 "SqlParser.y"
+                 {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back((yyvsp[0].string));
+	  (yyval.values) = v;
+	}
+#line 2028 "SqlParser.tab.c"
+    break;
+
+  case 62: /* parameters: parameters COMMA INTEGER  */
+#line 498 "SqlParser.y"
+                                   {
+	  (yyvsp[-2].values)->push_back((yyvsp[0].string));
+	  (yyval.values) = (yyvsp[-2].values);
+	}
+#line 2037 "SqlParser.tab.c"
+    break;
+
+  case 63: /* parameters: parameters COMMA STRING  */
+#line 502 "SqlParser.y"
+                                  {
+	  (yyvsp[-2].values)->push_back((yyvsp[0].string));
+	  (yyval.values) = (yyvsp[-2].values);
+	}
+#line 2046 "SqlParser.tab.c"
+    break;
+
+  case 64: /* conditions: conjunction  */
+#line 509 "SqlParser.y"
+                    {
+	  WhereClause* w = new WhereClause;
+	  w->push_back(*(yyvsp[0].conds));
+	  (yyval.where) = w;
+	  delete (yyvsp[0].conds);
+	}
+#line 2057 "SqlParser.tab.c"
+    break;
+
+  case 65: /* conditions: conditions OR conjunction  */
+#line 515 "SqlParser.y"
+                                    {
+	  (yyvsp[-2].where)->push_back(*(yyvsp[0].conds));
+	  (yyval.where) = (yyvsp[-2].where);
+	  delete (yyvsp[0].conds);
+	}
+#line 2067 "SqlParser.tab.c"
+    break;
+
+  case 66: /* conjunction: condition  */
+#line 523 "SqlParser.y"
+                  {
+	  std::vector<SelCond>* v = new std::vector<SelCond>;
+	  v->push_back(*(yyvsp[0].cond));
+	  (yyval.conds) = v;
+          delete (yyvsp[0].cond);
+	}
+#line 2078 "SqlParser.tab.c"
+    break;
+
+  case 67: /* conjunction: conjunction AND condition  */
+#line 529 "SqlParser.y"
+                                    {
+	  (yyvsp[-2].conds)->push_back(*(yyvsp[0].cond));
+	  (yyval.conds) = (yyvsp[-2].conds);
+          delete (yyvsp[0].cond);
+	}
+#line 2088 "SqlParser.tab.c"
+    break;
+
+  case 68: /* condition: attribute comparator value  */
+#line 537 "SqlParser.y"
+                                   { 
+	  SelCond* c = new SelCond;
+	  c->attr = (yyvsp[-2].integer);
+	  c->comp = static_cast<SelCond::Comparator>((yyvsp[-1].integer));
+	  c->value = (yyvsp[0].string);
+	  (yyval.cond) = c;
+        }
+#line 2100 "SqlParser.tab.c"
+    break;
+
+  case 69: /* condition: attribute IN LPAREN values RPAREN  */
+#line 544 "SqlParser.y"
+                                            {
+	  SelCond* c = new SelCond;
+	  c->attr = (yyvsp[-4].integer);
+	  c->comp = SelCond::IN;
+	  c->value = NULL;
+	  c->list = *(yyvsp[-1].values);
+	  (yyval.cond) = c;
+	  delete (yyvsp[-1].values);
+	}
+#line 2114 "SqlParser.tab.c"
+    break;
+
+  case 70: /* values: value  */
+#line 556 "SqlParser.y"
+              {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back((yyvsp[0].string));
+	  (yyval.values) = v;
+	}
+#line 2124 "SqlParser.tab.c"
+    break;
+
+  case 71: /* values: values COMMA value  */
+#line 561 "SqlParser.y"
+                             {
+	  (yyvsp[-2].values)->push_back((yyvsp[0].string));
+	  (yyval.values) = (yyvsp[-2].values);
+	}
+#line 2133 "SqlParser.tab.c"
+    break;
+
+  case 72: /* attributes: attribute  */
+#line 568 "SqlParser.y"
+                  { (yyval.integer) = (yyvsp[0].integer); }
+#line 2139 "SqlParser.tab.c"
+    break;
+
+  case 73: /* attributes: STAR  */
+#line 569 "SqlParser.y"
+                { (yyval.integer) = 3; }
+#line 2145 "SqlParser.tab.c"
+    break;
+
+  case 74: /* attributes: COUNT  */
+#line 570 "SqlParser.y"
+                { (yyval.integer) = 4; }
+#line 2151 "SqlParser.tab.c"
+    break;
+
+  case 75: /* attributes: MIN LPAREN attribute RPAREN  */
+#line 571 "SqlParser.y"
+                                      { (yyval.integer) = ((yyvsp[-1].integer) == 1) ? 5 : 9; }
+#line 2157 "SqlParser.tab.c"
+    break;
+
+  case 76: /* attributes: MAX LPAREN attribute RPAREN  */
+#line 572 "SqlParser.y"
+                                      { (yyval.integer) = ((yyvsp[-1].integer) == 1) ? 6 : 10; }
+#line 2163 "SqlParser.tab.c"
+    break;
+
+  case 77: /* attributes: SUM LPAREN attribute RPAREN  */
+#line 573 "SqlParser.y"
+                                      {
+	  if ((yyvsp[-1].integer) != 1) {
+	    sqlerror(scanner, session, "SUM is only supported on key");
+	    YYERROR;
+	  }
+	  (yyval.integer) = 7;
+	}
+#line 2175 "SqlParser.tab.c"
+    break;
+
+  case 78: /* attributes: AVG LPAREN attribute RPAREN  */
+#line 580 "SqlParser.y"
+                                      {
+	  if ((yyvsp[-1].integer) != 1) {
+	    sqlerror(scanner, session, "AVG is only supported on key");
+	    YYERROR;
+	  }
+	  (yyval.integer) = 8;
+	}
+#line 2187 "SqlParser.tab.c"
+    break;
+
+  case 79: /* attribute: ID  */
+#line 590 "SqlParser.y"
+           { 
+		if (strcasecmp((yyvsp[0].string), "key") == 0) (yyval.integer)=1;
+		else if (strcasecmp((yyvsp[0].string), "value") == 0) (yyval.integer)=2;
+		else sqlerror(scanner, session, "wrong attribute name. neither key or value");
+		free((yyvsp[0].string));
+	}
+#line 2198 "SqlParser.tab.c"
+    break;
+
+  case 80: /* value: INTEGER  */
+#line 598 "SqlParser.y"
+                 { (yyval.string) = (yyvsp[0].string); }
+#line 2204 "SqlParser.tab.c"
+    break;
+
+  case 81: /* value: STRING  */
+#line 599 "SqlParser.y"
+                 { (yyval.string) = (yyvsp[0].string); }
+#line 2210 "SqlParser.tab.c"
+    break;
+
+  case 82: /* value: QMARK  */
+#line 600 "SqlParser.y"
+                 { (yyval.string) = NULL; }
+#line 2216 "SqlParser.tab.c"
+    break;
+
+  case 83: /* table: ID  */
+#line 604 "SqlParser.y"
+           { (yyval.string) = (yyvsp[0].string); }
+#line 2222 "SqlParser.tab.c"
+    break;
+
+  case 84: /* comparator: EQUAL  */
+#line 608 "SqlParser.y"
+                       { (yyval.integer) = SelCond::EQ; }
+#line 2228 "SqlParser.tab.c"
+    break;
+
+  case 85: /* comparator: NEQUAL  */
+#line 609 "SqlParser.y"
+                       { (yyval.integer) = SelCond::NE; }
+#line 2234 "SqlParser.tab.c"
+    break;
+
+  case 86: /* comparator: LESS  */
+#line 610 "SqlParser.y"
+                       { (yyval.integer) = SelCond::LT; }
+#line 2240 "SqlParser.tab.c"
+    break;
+
+  case 87: /* comparator: GREATER  */
+#line 611 "SqlParser.y"
+                       { (yyval.integer) = SelCond::GT; }
+#line 2246 "SqlParser.tab.c"
+    break;
+
+  case 88: /* comparator: LESSEQUAL  */
+#line 612 "SqlParser.y"
+                       { (yyval.integer) = SelCond::LE; }
+#line 2252 "SqlParser.tab.c"
+    break;
+
+  case 89: /* comparator: GREATEREQUAL  */
+#line 613 "SqlParser.y"
+                       { (yyval.integer) = SelCond::GE; }
+#line 2258 "SqlParser.tab.c"
+    break;
+
+
+#line 2262 "SqlParser.tab.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (scanner, session, YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, scanner, session);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, scanner, session);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (scanner, session, YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, scanner, session);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, scanner, session);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
@@ -0,0 +1,147 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison interface for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_SQL_SQLPARSER_TAB_H_INCLUDED
+# define YY_SQL_SQLPARSER_TAB_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int sqldebug;
+#endif
+
+/* Token kinds.  */
+#ifndef YYTOKENTYPE
+# define YYTOKENTYPE
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    SELECT = 258,                  /* SELECT  */
+    FROM = 259,                    /* FROM  */
+    WHERE = 260,                   /* WHERE  */
+    LOAD = 261,                    /* LOAD  */
+    WITH = 262,                    /* WITH  */
+    INDEX = 263,                   /* INDEX  */
+    LSM = 264,                     /* LSM  */
+    QUIT = 265,                    /* QUIT  */
+    COUNT = 266,                   /* COUNT  */
+    AND = 267,                     /* AND  */
+    OR = 268,                      /* OR  */
+    IN = 269,                      /* IN  */
+    INSERT = 270,                  /* INSERT  */
+    INTO = 271,                    /* INTO  */
+    VALUES = 272,                  /* VALUES  */
+    DELETE = 273,                  /* DELETE  */
+    PREPARE = 274,                 /* PREPARE  */
+    AS = 275,                      /* AS  */
+    EXECUTE = 276,                 /* EXECUTE  */
+    DEALLOCATE = 277,              /* DEALLOCATE  */
+    ORDER = 278,                   /* ORDER  */
+    BY = 279,                      /* BY  */
+    ASC = 280,                     /* ASC  */
+    DESC = 281,                    /* DESC  */
+    LIMIT = 282,                   /* LIMIT  */
+    OFFSET = 283,                  /* OFFSET  */
+    MIN = 284,                     /* MIN  */
+    MAX = 285,                     /* MAX  */
+    SUM = 286,                     /* SUM  */
+    AVG = 287,                     /* AVG  */
+    GROUP = 288,                   /* GROUP  */
+    DISTINCT = 289,                /* DISTINCT  */
+    COLUMNS = 290,                 /* COLUMNS  */
+    ANALYZE = 291,                 /* ANALYZE  */
+    EXPLAIN = 292,                 /* EXPLAIN  */
+    SHOW = 293,                    /* SHOW  */
+    STATS = 294,                   /* STATS  */
+    COMMA = 295,                   /* COMMA  */
+    STAR = 296,                    /* STAR  */
+    LF = 297,                      /* LF  */
+    LPAREN = 298,                  /* LPAREN  */
+    RPAREN = 299,                  /* RPAREN  */
+    QMARK = 300,                   /* QMARK  */
+    DOT = 301,                     /* DOT  */
+    INTEGER = 302,                 /* INTEGER  */
+    STRING = 303,                  /* STRING  */
+    ID = 304,                      /* ID  */
+    EQUAL = 305,                   /* EQUAL  */
+    NEQUAL = 306,                  /* NEQUAL  */
+    LESS = 307,                    /* LESS  */
+    LESSEQUAL = 308,               /* LESSEQUAL  */
+    GREATER = 309,                 /* GREATER  */
+    GREATEREQUAL = 310             /* GREATEREQUAL  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
+#endif
+
+/* Value type.  */
+#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
+union YYSTYPE
+{
+#line 18 "SqlParser.y"
+
+  int integer;
+  char* string;
+  SelCond* cond;
+  std::vector<SelCond>* conds;
+  WhereClause* where;
+  std::vector<char*>* values;
+  SelOrder order;
+  SelOrder::Direction direction;
+  JoinColumn column;
+  std::vector<JoinColumn>* columns;
+  JoinCond* jcond;
+  std::vector<JoinCond>* jconds;
+
+#line 134 "SqlParser.tab.h"
+
+};
+typedef union YYSTYPE YYSTYPE;
+# define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
+#endif
+
+
+
+
+int sqlparse (void* scanner, SqlSession* session);
+
+
+#endif /* !YY_SQL_SQLPARSER_TAB_H_INCLUDED  */
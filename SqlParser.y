@@ -1,50 +1,190 @@
 %{
 #include <cstdio>
 #include <cstring>
-#include <sys/times.h>
+#include <time.h>
 #include <climits>
 #include <string>
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
 #include "PageFile.h"
+#include "QueryPlan.h"
+%}
+
+/* the parser keeps no global state, so that sessions can parse in parallel */
+%define api.pure full
+%lex-param   {void* scanner}
+%parse-param {void* scanner} {SqlSession* session}
+
+%union {
+  int integer;
+  char* string;
+  SelCond* cond;
+  std::vector<SelCond>* conds;
+  WhereClause* where;
+  std::vector<char*>* values;
+  SelOrder order;
+  SelOrder::Direction direction;
+  JoinColumn column;
+  std::vector<JoinColumn>* columns;
+  JoinCond* jcond;
+  std::vector<JoinCond>* jconds;
+}
+
+%{
+int  sqllex(YYSTYPE* lvalp, void* scanner);
+void sqlerror(void* scanner, SqlSession* session, const char *str) { fprintf(session->err, "Error: %s\n", str); }
 
-int  sqllex(void);  
-void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
-extern "C" { int  sqlwrap() { return 1; } }
+// the time and page accesses of a query
+struct QueryStats {
+  struct timespec      time;  // the start of the query
+  PageFile::IoCounters io;    // the page accesses of the query
+};
 
-static void runSelect(int attr, const char* table, const std::vector<SelCond>& conds)
+static void startQuery(SqlSession* session, QueryStats& stats)
 {
-  struct tms tmsbuf;
-  clock_t btime, etime;
-  int     bpagecnt, epagecnt;
+  // count the page accesses of this thread, and of the workers it waits
+  // for, apart from those of other sessions
+  memset(&stats.io, 0, sizeof(stats.io));
+  PageFile::setIoCounters(&stats.io);
+  if (session->plan != NULL) session->plan->start();
 
-  btime = times(&tmsbuf);
-  bpagecnt = PageFile::getPageReadCount();
-  SqlEngine::select(attr, table, conds);
-  etime = times(&tmsbuf);
-  epagecnt = PageFile::getPageReadCount();
+  clock_gettime(CLOCK_MONOTONIC, &stats.time);
+}
+
+static void finishQuery(SqlSession* session, const QueryStats& stats)
+{
+  struct timespec etime;
+  long long       pages = 0;
 
-  fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
+  clock_gettime(CLOCK_MONOTONIC, &etime);
+  if (session->plan != NULL) session->plan->finish();
+  PageFile::setIoCounters(NULL);
+
+  // EXPLAIN without ANALYZE runs nothing
+  if (session->plan != NULL && !session->plan->isAnalyze()) return;
+
+  for (int i = 0; i < PageFile::FILE_KINDS; i++) pages += stats.io.diskReads[i];
+  fprintf(session->err, "  -- %.3f seconds to run the select command. Read %lld pages\n",
+          (etime.tv_sec - stats.time.tv_sec) + (etime.tv_nsec - stats.time.tv_nsec) / 1e9, pages);
 }
 
-%}
+// start EXPLAIN [ANALYZE]. the results of a statement that is run are
+// dropped; only the plan is printed.
+static void startExplain(SqlSession* session, bool analyze)
+{
+  session->plan = new QueryPlan(analyze, session->out);
+  if (analyze) session->out = fopen("/dev/null", "w");
+}
 
-%union {
-  int integer;
-  char* string;
-  SelCond* cond;
-  std::vector<SelCond>* conds;
+// finish EXPLAIN, printing the plan unless the statement failed to parse
+static void finishExplain(SqlSession* session, bool print)
+{
+  if (session->plan == NULL) return;
+
+  if (session->plan->isAnalyze()) {
+    fclose(session->out);
+    session->out = session->plan->getOut();
+  }
+  if (print) session->plan->print();
+  delete session->plan;
+  session->plan = NULL;
 }
 
-%token SELECT FROM WHERE LOAD WITH INDEX QUIT COUNT AND OR 
-%token COMMA STAR LF
+static void runSelect(SqlSession* session, int attr, const char* table, const WhereClause& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::select(*session, attr, table, where, order);
+  finishQuery(session, stats);
+}
+
+static void runGroupBy(SqlSession* session, int group, int attr, const char* table, const WhereClause& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::groupBy(*session, group, attr, table, where, order);
+  finishQuery(session, stats);
+}
+
+static void runJoin(SqlSession* session, int attr, const std::vector<JoinColumn>& columns, const char* left, const char* right, const std::vector<JoinCond>& where, const SelOrder& order)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::join(*session, attr, columns, left, right, where, order);
+  finishQuery(session, stats);
+}
+
+static void runExecute(SqlSession* session, const char* name, const std::vector<char*>& params)
+{
+  QueryStats stats;
+
+  startQuery(session, stats);
+  SqlEngine::executePrepared(*session, name, params);
+  finishQuery(session, stats);
+}
+
+static void freeWhere(WhereClause* where)
+{
+  for (unsigned i = 0; i < where->size(); i++) {
+    for (unsigned j = 0; j < (*where)[i].size(); j++) {
+      SelCond& c = (*where)[i][j];
+      free(c.value);
+      for (unsigned k = 0; k < c.list.size(); k++) free(c.list[k]);
+    }
+  }
+  delete where;
+}
+
+static void freeColumns(std::vector<JoinColumn>* columns)
+{
+  for (unsigned i = 0; i < columns->size(); i++) free((*columns)[i].table);
+  delete columns;
+}
+
+static void freeJoinConds(std::vector<JoinCond>* conds)
+{
+  for (unsigned i = 0; i < conds->size(); i++) {
+    JoinCond& c = (*conds)[i];
+    free(c.column.table);
+    free(c.other.table);
+    free(c.value);
+  }
+  delete conds;
+}
+%}
+
+%token SELECT FROM WHERE LOAD WITH INDEX LSM QUIT COUNT AND OR IN
+%token INSERT INTO VALUES DELETE PREPARE AS EXECUTE DEALLOCATE
+%token ORDER BY ASC DESC LIMIT OFFSET
+%token MIN MAX SUM AVG GROUP DISTINCT COLUMNS ANALYZE EXPLAIN SHOW STATS
+%token COMMA STAR LF LPAREN RPAREN QMARK DOT
 %token <string> INTEGER STRING ID
 %token EQUAL NEQUAL LESS LESSEQUAL GREATER GREATEREQUAL 
 
 %type <integer> attributes attribute comparator
 %type <string> table value
 %type <cond> condition
-%type <conds> conditions
+%type <conds> conjunction
+%type <where> conditions
+%type <values> parameters values
+%type <where> where_clause
+%type <order> order_clause limit_clause
+%type <direction> direction
+%type <column> column
+%type <columns> columns
+%type <jcond> join_condition
+%type <jconds> join_conditions
+
+/* free what a statement allocated so far when it is dropped on an error */
+%destructor { free($$); } <string>
+%destructor { freeWhere($$); } <where>
+%destructor { freeColumns($$); } <columns>
+%destructor { freeJoinConds($$); } <jconds>
+%destructor { free($$.table); } <column>
+%destructor { free($$->column.table); free($$->other.table); free($$->value); delete $$; } <jcond>
 %%
 
 commands:
@@ -53,54 +193,340 @@ commands:
 	;
 
 command:
-        load_command { fprintf(stdout, "Bruinbase> "); }
-	| select_command { fprintf(stdout, "Bruinbase> "); }
+        load_command { fprintf(session->out, "Bruinbase> "); }
+	| analyze_command { fprintf(session->out, "Bruinbase> "); }
+	| select_command { fprintf(session->out, "Bruinbase> "); }
+	| explain_command { fprintf(session->out, "Bruinbase> "); }
+	| show_command { fprintf(session->out, "Bruinbase> "); }
+	| insert_command { fprintf(session->out, "Bruinbase> "); }
+	| delete_command { fprintf(session->out, "Bruinbase> "); }
+	| prepare_command { fprintf(session->out, "Bruinbase> "); }
+	| execute_command { fprintf(session->out, "Bruinbase> "); }
+	| deallocate_command { fprintf(session->out, "Bruinbase> "); }
 	| quit_command
-	| error LF { fprintf(stdout, "Bruinbase> "); }
-	| LF { fprintf(stdout, "Bruinbase> "); }
+	| error LF {
+	  finishExplain(session, false);
+	  fprintf(session->out, "Bruinbase> ");
+	}
+	| LF { fprintf(session->out, "Bruinbase> "); }
 	;
 
 quit_command:
-	QUIT { return 0; }
+	QUIT { session->quit = true; return 0; }
 	;
 
 load_command:
 	LOAD table FROM STRING LF { 
-	  SqlEngine::load(std::string($2), std::string($4), false); 
+	  SqlEngine::load(*session, std::string($2), std::string($4), false, false, false); 
 	  free($2);
 	  free($4);
 	}
 	| LOAD table FROM STRING WITH INDEX LF { 
-	  SqlEngine::load(std::string($2), std::string($4), true); 
+	  SqlEngine::load(*session, std::string($2), std::string($4), true, false, false); 
+	  free($2);
+	  free($4);
+	}
+	| LOAD table FROM STRING AS COLUMNS LF { 
+	  SqlEngine::load(*session, std::string($2), std::string($4), false, true, false); 
+	  free($2);
+	  free($4);
+	}
+	| LOAD table FROM STRING WITH INDEX AS COLUMNS LF { 
+	  SqlEngine::load(*session, std::string($2), std::string($4), true, true, false); 
+	  free($2);
+	  free($4);
+	}
+	| LOAD table FROM STRING WITH LSM INDEX LF { 
+	  SqlEngine::load(*session, std::string($2), std::string($4), true, false, true); 
+	  free($2);
+	  free($4);
+	}
+	| LOAD table FROM STRING WITH LSM INDEX AS COLUMNS LF { 
+	  SqlEngine::load(*session, std::string($2), std::string($4), true, true, true); 
 	  free($2);
 	  free($4);
 	}
 	;
 
-select_command:
-	SELECT attributes FROM table LF {
-   	        std::vector<SelCond> conds;
-		runSelect($2, $4, conds);
-		free($4);
+analyze_command:
+	ANALYZE table LF {
+	  SqlEngine::analyze(*session, std::string($2));
+	  free($2);
 	}
-	| SELECT attributes FROM table WHERE conditions LF {
-	        runSelect($2, $4, *$6);
+	;
+
+show_command:
+	SHOW STATS LF { SqlEngine::showStats(*session); }
+	;
+
+insert_command:
+	INSERT INTO table VALUES LPAREN INTEGER COMMA STRING RPAREN LF {
+	  SqlEngine::insert(*session, std::string($3), atoi($6), std::string($8));
+	  free($3);
+	  free($6);
+	  free($8);
+	}
+	;
+
+delete_command:
+	DELETE FROM table LF {
+	  WhereClause where;
+	  SqlEngine::remove(*session, std::string($3), where);
+	  free($3);
+	}
+	| DELETE FROM table WHERE conditions LF {
+	  SqlEngine::remove(*session, std::string($3), *$5);
+	  free($3);
+	  freeWhere($5);
+	}
+	;
+
+select_command:
+	SELECT attributes FROM table where_clause order_clause LF {
+		runSelect(session, $2, $4, *$5, $6);
 	  	free($4);
-	  	for (unsigned i = 0; i < $6->size(); i++) {
-		    free((*$6)[i].value);
-		}
-	  	delete $6;
+	  	freeWhere($5);
+	}
+	| SELECT DISTINCT attributes FROM table where_clause order_clause LF {
+	  if ($3 >= 4) sqlerror(scanner, session, "DISTINCT is only supported on key, value and *");
+	  else {
+	    $7.distinct = true;
+	    runSelect(session, $3, $5, *$6, $7);
+	  }
+	  free($5);
+	  freeWhere($6);
+	}
+	| SELECT attributes FROM table where_clause GROUP BY attribute order_clause LF {
+	  if ($2 != $8) sqlerror(scanner, session, "the SELECT clause must list the GROUP BY attribute");
+	  else runGroupBy(session, $8, 0, $4, *$5, $9);
+	  free($4);
+	  freeWhere($5);
+	}
+	| SELECT attribute COMMA attributes FROM table where_clause GROUP BY attribute order_clause LF {
+	  if ($2 != $10) sqlerror(scanner, session, "the SELECT clause must list the GROUP BY attribute");
+	  else if ($4 < 4) sqlerror(scanner, session, "only an aggregate can follow the GROUP BY attribute");
+	  else runGroupBy(session, $10, $4, $6, *$7, $11);
+	  free($6);
+	  freeWhere($7);
+	}
+	| SELECT attributes FROM table COMMA table WHERE join_conditions limit_clause LF {
+	  std::vector<JoinColumn> none;
+	  if ($2 != 3 && $2 != 4) sqlerror(scanner, session, "the columns of a join must be qualified with their table");
+	  else runJoin(session, $2, none, $4, $6, *$8, $9);
+	  free($4);
+	  free($6);
+	  freeJoinConds($8);
+	}
+	| SELECT columns FROM table COMMA table WHERE join_conditions limit_clause LF {
+	  runJoin(session, 0, *$2, $4, $6, *$8, $9);
+	  freeColumns($2);
+	  free($4);
+	  free($6);
+	  freeJoinConds($8);
+	}
+	;
+
+explain_command:
+	explain select_command { finishExplain(session, true); }
+	;
+
+explain:
+	EXPLAIN { startExplain(session, false); }
+	| EXPLAIN ANALYZE { startExplain(session, true); }
+	;
+
+columns:
+	column {
+	  $$ = new std::vector<JoinColumn>;
+	  $$->push_back($1);
+	}
+	| columns COMMA column {
+	  $1->push_back($3);
+	  $$ = $1;
+	}
+	;
+
+column:
+	ID DOT attribute {
+	  $$.table = $1;
+	  $$.attr = $3;
+	}
+	;
+
+join_conditions:
+	join_condition {
+	  $$ = new std::vector<JoinCond>;
+	  $$->push_back(*$1);
+	  delete $1;
+	}
+	| join_conditions AND join_condition {
+	  $1->push_back(*$3);
+	  $$ = $1;
+	  delete $3;
+	}
+	;
+
+join_condition:
+	column comparator column {
+	  $$ = new JoinCond;
+	  $$->column = $1;
+	  $$->comp = static_cast<SelCond::Comparator>($2);
+	  $$->other = $3;
+	  $$->value = NULL;
+	}
+	| column comparator value {
+	  if ($3 == NULL) {
+	    sqlerror(scanner, session, "? can only be used in PREPARE");
+	    free($1.table);
+	    YYERROR;
+	  }
+	  $$ = new JoinCond;
+	  $$->column = $1;
+	  $$->comp = static_cast<SelCond::Comparator>($2);
+	  $$->other.table = NULL;
+	  $$->other.attr = 0;
+	  $$->value = $3;
+	}
+	;
+
+prepare_command:
+	PREPARE ID AS SELECT attributes FROM table where_clause order_clause LF {
+	  SqlEngine::prepare(*session, std::string($2), $5, std::string($7), *$8, $9);
+	  free($2);
+	  free($7);
+	  freeWhere($8);
+	}
+	| PREPARE ID AS SELECT DISTINCT attributes FROM table where_clause order_clause LF {
+	  if ($6 >= 4) sqlerror(scanner, session, "DISTINCT is only supported on key, value and *");
+	  else {
+	    $10.distinct = true;
+	    SqlEngine::prepare(*session, std::string($2), $6, std::string($8), *$9, $10);
+	  }
+	  free($2);
+	  free($8);
+	  freeWhere($9);
+	}
+	;
+
+where_clause:
+	/* no WHERE clause */ { $$ = new WhereClause; }
+	| WHERE conditions { $$ = $2; }
+	;
+
+order_clause:
+	limit_clause { $$ = $1; }
+	| ORDER BY attribute direction limit_clause {
+	  if ($3 != 1 && $3 != 2) {
+	    sqlerror(scanner, session, "only ORDER BY key and ORDER BY value are supported");
+	    YYERROR;
+	  }
+	  $$ = $5;
+	  $$.order = $4;
+	  $$.attr = $3;
+	}
+	;
+
+direction:
+	/* ascending by default */ { $$ = SelOrder::ASC; }
+	| ASC  { $$ = SelOrder::ASC; }
+	| DESC { $$ = SelOrder::DESC; }
+	;
+
+limit_clause:
+	/* no LIMIT clause */ {
+	  $$.order = SelOrder::NONE;
+	  $$.attr = 1;
+	  $$.limit = -1;
+	  $$.offset = 0;
+	  $$.distinct = false;
+	}
+	| LIMIT INTEGER {
+	  $$.order = SelOrder::NONE;
+	  $$.attr = 1;
+	  $$.limit = atoi($2);
+	  $$.offset = 0;
+	  $$.distinct = false;
+	  free($2);
+	}
+	| LIMIT INTEGER OFFSET INTEGER {
+	  $$.order = SelOrder::NONE;
+	  $$.attr = 1;
+	  $$.limit = atoi($2);
+	  $$.offset = atoi($4);
+	  $$.distinct = false;
+	  free($2);
+	  free($4);
+	}
+	;
+
+execute_command:
+	EXECUTE ID LF {
+	  std::vector<char*> params;
+	  runExecute(session, $2, params);
+	  free($2);
+	}
+	| EXECUTE ID LPAREN parameters RPAREN LF {
+	  runExecute(session, $2, *$4);
+	  free($2);
+	  for (unsigned i = 0; i < $4->size(); i++) {
+	    free((*$4)[i]);
+	  }
+	  delete $4;
+	}
+	;
+
+deallocate_command:
+	DEALLOCATE ID LF {
+	  if (SqlEngine::deallocate(*session, std::string($2)) < 0) {
+	    fprintf(session->err, "Error: prepared statement %s does not exist\n", $2);
+	  }
+	  free($2);
+	}
+	;
+
+parameters:
+	INTEGER {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back($1);
+	  $$ = v;
+	}
+	| STRING {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back($1);
+	  $$ = v;
+	}
+	| parameters COMMA INTEGER {
+	  $1->push_back($3);
+	  $$ = $1;
+	}
+	| parameters COMMA STRING {
+	  $1->push_back($3);
+	  $$ = $1;
 	}
 	;
 
 conditions:
+	conjunction {
+	  WhereClause* w = new WhereClause;
+	  w->push_back(*$1);
+	  $$ = w;
+	  delete $1;
+	}
+	| conditions OR conjunction {
+	  $1->push_back(*$3);
+	  $$ = $1;
+	  delete $3;
+	}
+	;
+
+conjunction:
 	condition {
 	  std::vector<SelCond>* v = new std::vector<SelCond>;
 	  v->push_back(*$1);
 	  $$ = v;
           delete $1;
 	}
-	| conditions AND condition {
+	| conjunction AND condition {
 	  $1->push_back(*$3);
 	  $$ = $1;
           delete $3;
@@ -115,25 +541,63 @@ condition:
 	  c->value = $3;
 	  $$ = c;
         }
+	| attribute IN LPAREN values RPAREN {
+	  SelCond* c = new SelCond;
+	  c->attr = $1;
+	  c->comp = SelCond::IN;
+	  c->value = NULL;
+	  c->list = *$4;
+	  $$ = c;
+	  delete $4;
+	}
+	;
+
+values:
+	value {
+	  std::vector<char*>* v = new std::vector<char*>;
+	  v->push_back($1);
+	  $$ = v;
+	}
+	| values COMMA value {
+	  $1->push_back($3);
+	  $$ = $1;
+	}
 	;
 
 attributes:
 	attribute { $$ = $1; }
 	| STAR  { $$ = 3; }
 	| COUNT { $$ = 4; }
+	| MIN LPAREN attribute RPAREN { $$ = ($3 == 1) ? 5 : 9; }
+	| MAX LPAREN attribute RPAREN { $$ = ($3 == 1) ? 6 : 10; }
+	| SUM LPAREN attribute RPAREN {
+	  if ($3 != 1) {
+	    sqlerror(scanner, session, "SUM is only supported on key");
+	    YYERROR;
+	  }
+	  $$ = 7;
+	}
+	| AVG LPAREN attribute RPAREN {
+	  if ($3 != 1) {
+	    sqlerror(scanner, session, "AVG is only supported on key");
+	    YYERROR;
+	  }
+	  $$ = 8;
+	}
 	;
 
 attribute:
 	ID { 
 		if (strcasecmp($1, "key") == 0) $$=1;
 		else if (strcasecmp($1, "value") == 0) $$=2;
-		else sqlerror("wrong attribute name. neither key or value");
+		else sqlerror(scanner, session, "wrong attribute name. neither key or value");
 		free($1);
 	}
 
 value:
 	INTEGER  { $$ = $1; }
         | STRING { $$ = $1; }
+        | QMARK  { $$ = NULL; }
 	;
 
 table:
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "Bruinbase.h"
+#include "SqlServer.h"
+
+using std::string;
+using std::list;
+using std::vector;
+
+// a connection that sends a longer line than this is closed
+static const size_t MAX_LINE_LENGTH = 64 * 1024;
+
+// the signal handler wakes up the polling thread through this pipe
+static volatile sig_atomic_t stopRequested = 0;
+static int signalFd = -1;
+
+static void handleSignal(int sig)
+{
+  stopRequested = 1;
+  if (signalFd >= 0) ::write(signalFd, "", 1);
+}
+
+SqlServer::SqlServer()
+{
+  listenFd = -1;
+  wakeFds[0] = wakeFds[1] = -1;
+  pthread_mutex_init(&finishedLock, NULL);
+}
+
+SqlServer::~SqlServer()
+{
+  if (listenFd >= 0) ::close(listenFd);
+  if (!socketPath.empty()) unlink(socketPath.c_str());
+  pthread_mutex_destroy(&finishedLock);
+}
+
+RC SqlServer::listenUnix(const string& path)
+{
+  struct sockaddr_un addr;
+
+  if (path.size() >= sizeof(addr.sun_path)) return RC_SOCKET_FAILED;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  if ((listenFd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return RC_SOCKET_FAILED;
+
+  unlink(path.c_str());
+  if (bind(listenFd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(listenFd, SOMAXCONN) < 0) {
+    ::close(listenFd);
+    listenFd = -1;
+    return RC_SOCKET_FAILED;
+  }
+  socketPath = path;
+
+  return 0;
+}
+
+RC SqlServer::listenTcp(int port)
+{
+  struct sockaddr_in addr;
+  int on = 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if ((listenFd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return RC_SOCKET_FAILED;
+
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(listenFd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(listenFd, SOMAXCONN) < 0) {
+    ::close(listenFd);
+    listenFd = -1;
+    return RC_SOCKET_FAILED;
+  }
+
+  return 0;
+}
+
+RC SqlServer::run(int threads)
+{
+  RC   rc;
+  char buf[64];
+  vector<struct pollfd>   fds;
+  vector<Connection*>     polled;
+
+  if (listenFd < 0) return RC_SOCKET_FAILED;
+  if (pipe(wakeFds) < 0) return RC_SOCKET_FAILED;
+  if ((rc = pool.start(threads)) < 0) return rc;
+
+  // clients that go away while we write to them must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+  signalFd = wakeFds[1];
+  signal(SIGINT, handleSignal);
+  signal(SIGTERM, handleSignal);
+
+  while (!stopRequested) {
+    // wait for the wake-up pipe, new clients, and input on idle connections
+    struct pollfd p;
+    fds.clear();
+    polled.clear();
+    p.fd = wakeFds[0]; p.events = POLLIN; p.revents = 0;
+    fds.push_back(p);
+    p.fd = listenFd;
+    fds.push_back(p);
+    for (list<Connection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+      if ((*it)->busy) continue;
+      p.fd = (*it)->fd;
+      fds.push_back(p);
+      polled.push_back(*it);
+    }
+
+    if (poll(&fds[0], fds.size(), -1) < 0) continue;  // interrupted by a signal
+
+    // take back the connections whose commands have been executed
+    if (fds[0].revents & POLLIN) {
+      list<Connection*> done;
+
+      ::read(wakeFds[0], buf, sizeof(buf));
+      pthread_mutex_lock(&finishedLock);
+      done.swap(finished);
+      pthread_mutex_unlock(&finishedLock);
+
+      for (list<Connection*>::iterator it = done.begin(); it != done.end(); ++it) {
+        (*it)->busy = false;
+        if ((*it)->session.quit) close(*it);
+      }
+    }
+
+    if (fds[1].revents & POLLIN) accept();
+
+    for (unsigned i = 0; i < polled.size(); i++) {
+      if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) receive(polled[i]);
+    }
+  }
+
+  // finish the commands that are running, then close every connection
+  pool.stop();
+  while (!connections.empty()) close(connections.front());
+  finished.clear();
+
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signalFd = -1;
+  ::close(wakeFds[0]);
+  ::close(wakeFds[1]);
+
+  return SqlEngine::shutdown();
+}
+
+void SqlServer::accept()
+{
+  int fd;
+  FILE* out;
+
+  if ((fd = ::accept(listenFd, NULL, NULL)) < 0) return;
+
+  // results and errors go to the client through a buffered stream that
+  // is flushed after each batch of commands
+  if ((out = fdopen(dup(fd), "w")) == NULL) {
+    ::close(fd);
+    return;
+  }
+
+  Connection* conn = new Connection;
+  conn->fd = fd;
+  conn->session = SqlSession(out, out);
+  conn->busy = false;
+  conn->server = this;
+  connections.push_back(conn);
+
+  fprintf(out, "Bruinbase> ");
+  fflush(out);
+}
+
+bool SqlServer::receive(Connection* conn)
+{
+  char buf[4096];
+  ssize_t n;
+
+  if ((n = ::read(conn->fd, buf, sizeof(buf))) <= 0) {
+    close(conn);
+    return false;
+  }
+  conn->input.append(buf, n);
+
+  if (conn->input.find('\n') != string::npos) {
+    // the worker owns the connection until it is on the finished list
+    conn->busy = true;
+    if (pool.submit(execute, conn) < 0) {
+      close(conn);
+      return false;
+    }
+  } else if (conn->input.size() > MAX_LINE_LENGTH) {
+    close(conn);
+    return false;
+  }
+
+  return true;
+}
+
+void SqlServer::close(Connection* conn)
+{
+  SqlEngine::endSession(conn->session);
+  fclose(conn->session.out);
+  ::close(conn->fd);
+  connections.remove(conn);
+  delete conn;
+}
+
+void SqlServer::execute(void* arg)
+{
+  Connection* conn = (Connection*) arg;
+  SqlServer*  server = conn->server;
+  string::size_type end;
+
+  // run the complete lines; a partial last line waits for more input
+  while (!conn->session.quit && (end = conn->input.rfind('\n')) != string::npos) {
+    string commands = conn->input.substr(0, end + 1);
+    conn->input.erase(0, end + 1);
+    SqlEngine::execute(conn->session, commands);
+  }
+  fflush(conn->session.out);
+
+  pthread_mutex_lock(&server->finishedLock);
+  server->finished.push_back(conn);
+  pthread_mutex_unlock(&server->finishedLock);
+  ::write(server->wakeFds[1], "", 1);
+}
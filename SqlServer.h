@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef SQLSERVER_H
+#define SQLSERVER_H
+
+#include <list>
+#include <string>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "SqlEngine.h"
+#include "ThreadPool.h"
+
+/**
+ * Serves SQL sessions over a unix domain socket or a TCP port on the
+ * loopback interface. A client sends command lines like on the console
+ * and receives the output of each command followed by the prompt.
+ * One thread waits for connections and input. Complete command lines
+ * are run on a pool of worker threads; the commands of a connection run
+ * one after another, commands of different connections in parallel.
+ */
+class SqlServer {
+ public:
+  SqlServer();
+  ~SqlServer();
+
+  /**
+   * listen on a unix domain socket. an existing socket file is replaced.
+   * @param path[IN] the file name of the socket
+   * @return error code. 0 if no error
+   */
+  RC listenUnix(const std::string& path);
+
+  /**
+   * listen on a TCP port of the loopback interface.
+   * @param port[IN] the port number
+   * @return error code. 0 if no error
+   */
+  RC listenTcp(int port);
+
+  /**
+   * serve clients until SIGINT or SIGTERM is received, then finish the
+   * running commands and shut the SQL engine down.
+   * @param threads[IN] the number of worker threads
+   * @return error code. 0 if no error
+   */
+  RC run(int threads);
+
+ private:
+  SqlServer(const SqlServer&);              // not copyable: owns sockets
+  SqlServer& operator=(const SqlServer&);
+
+  /**
+   * a client connection.
+   */
+  struct Connection {
+    int         fd;       // the socket
+    SqlSession  session;  // session.out and session.err write to the socket
+    std::string input;    // received bytes that have not been executed
+    bool        busy;     // a worker is executing the commands in input
+    SqlServer*  server;   // the server the connection belongs to
+  };
+
+  /**
+   * accept a new client and send it the prompt.
+   */
+  void accept();
+
+  /**
+   * read from an idle connection and hand complete lines to a worker.
+   * @param conn[IN] the connection that has input
+   * @return false if the connection was closed
+   */
+  bool receive(Connection* conn);
+
+  /**
+   * close a connection and free it.
+   * @param conn[IN] the connection to close
+   */
+  void close(Connection* conn);
+
+  /**
+   * a worker task: execute the complete command lines of a connection.
+   * @param arg[IN] the connection
+   */
+  static void execute(void* arg);
+
+  int           listenFd;   // the listening socket
+  std::string   socketPath; // the unix socket file, removed on exit
+  int           wakeFds[2]; // self-pipe waking up the polling thread
+  ThreadPool    pool;       // runs the commands
+
+  std::list<Connection*> connections;  // open connections
+  std::list<Connection*> finished;     // connections whose worker is done
+  pthread_mutex_t        finishedLock; // protects finished
+};
+
+#endif // SQLSERVER_H
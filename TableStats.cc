@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include <cstring>
+#include <algorithm>
+#include "TableStats.h"
+#include "BloomFilter.h"
+#include "PageFile.h"
+
+using std::string;
+using std::min;
+using std::max;
+
+// the first bytes of a statistics file
+static const int STATS_MAGIC = 0x53544154;
+
+// the layout of a statistics file, which fits in one page
+struct StatsPage {
+  int       magic;
+  int       buckets;
+  long long tuples;
+  long long pages;
+  long long distinctKeys;
+  long long distinctValues;
+  long long totalLength;
+  int       minLength;
+  int       maxLength;
+  int       minKey;
+  int       maxKey;
+  int       sampled;
+  int       bound[TableStats::BUCKETS + 1];
+  int       count[TableStats::BUCKETS];
+};
+
+TableStats::TableStats()
+{
+  clear();
+}
+
+void TableStats::clear()
+{
+  valid = false;
+  tuples = 0;
+  pages = 0;
+  distinctKeys = 0;
+  distinctValues = 0;
+  minLength = 0;
+  maxLength = 0;
+  totalLength = 0;
+  minKey = 0;
+  maxKey = 0;
+  buckets = 0;
+  sampled = 0;
+  sample.clear();
+}
+
+void TableStats::start()
+{
+  clear();
+  keySketch.clear();
+  valueSketch.clear();
+  random = 0x2545f4914f6cdd1dULL;
+}
+
+void TableStats::add(int key, const string& value)
+{
+  int length = min((int) value.size(), RecordFile::MAX_VALUE_LENGTH - 1);
+
+  if (tuples == 0 || length < minLength) minLength = length;
+  if (tuples == 0 || length > maxLength) maxLength = length;
+  if (tuples == 0 || key < minKey) minKey = key;
+  if (tuples == 0 || key > maxKey) maxKey = key;
+  totalLength += length;
+
+  keySketch.add(BloomFilter::hashKey(key));
+  valueSketch.add(BloomFilter::hashValue(value.c_str()));
+
+  // keep each key in the sample with the same probability: the n-th key
+  // replaces a random one of the sample with probability SAMPLE / n
+  tuples++;
+  if (sample.size() < (size_t) SAMPLE) {
+    sample.push_back(key);
+  } else {
+    random ^= random >> 12;
+    random ^= random << 25;
+    random ^= random >> 27;
+    unsigned long long r = (random * 0x2545f4914f6cdd1dULL) % tuples;
+    if (r < (unsigned long long) SAMPLE) sample[r] = key;
+  }
+}
+
+void TableStats::finish(long long pages)
+{
+  this->pages = pages;
+  distinctKeys = min(tuples, max(tuples > 0 ? 1LL : 0LL, keySketch.estimate()));
+  distinctValues = min(tuples, max(tuples > 0 ? 1LL : 0LL, valueSketch.estimate()));
+
+  // split the sorted sample into buckets of equal size
+  std::sort(sample.begin(), sample.end());
+  sampled = sample.size();
+  buckets = min(sampled, (int) BUCKETS);
+  for (int i = 0; i < buckets; i++) {
+    int first = (long long) sampled * i / buckets;
+    int next = (long long) sampled * (i + 1) / buckets;
+    bound[i] = sample[first];
+    count[i] = next - first;
+  }
+  if (buckets > 0) bound[buckets] = sample[sampled - 1];
+
+  // the sample no longer takes memory
+  std::vector<int>().swap(sample);
+  valid = true;
+}
+
+double TableStats::keySelectivity(int lo, int hi) const
+{
+  if (!valid || tuples == 0 || lo > hi || hi < minKey || lo > maxKey) return 0;
+  if (lo == hi) return 1.0 / distinctKeys;
+
+  // the keys of a bucket are taken to be spread evenly over its range
+  double n = 0;
+  for (int i = 0; i < buckets; i++) {
+    double from = bound[i];
+    double to = (i + 1 < buckets) ? bound[i + 1] : (double) bound[buckets] + 1;
+    if (to <= from) {
+      // a bucket of one frequent key
+      if (lo <= bound[i] && bound[i] <= hi) n += count[i];
+      continue;
+    }
+    double overlap = min(to, (double) hi + 1) - max(from, (double) lo);
+    if (overlap > 0) n += count[i] * overlap / (to - from);
+  }
+
+  return min(1.0, max(n / sampled, 1.0 / distinctKeys));
+}
+
+double TableStats::valueSelectivity() const
+{
+  if (!valid || distinctValues == 0) return 0;
+  return 1.0 / distinctValues;
+}
+
+RC TableStats::load(const string& filename)
+{
+  PageFile  pf;
+  RC        rc;
+  char      page[PageFile::PAGE_SIZE];
+  StatsPage s;
+
+  clear();
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+  if (pf.endPid() < 1) rc = RC_INVALID_FILE_FORMAT;
+  else rc = pf.read(0, page);
+  pf.close();
+  if (rc < 0) return rc;
+
+  memcpy(&s, page, sizeof(s));
+  if (s.magic != STATS_MAGIC || s.buckets < 0 || s.buckets > BUCKETS || s.tuples < 0) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  tuples = s.tuples;
+  pages = s.pages;
+  distinctKeys = s.distinctKeys;
+  distinctValues = s.distinctValues;
+  totalLength = s.totalLength;
+  minLength = s.minLength;
+  maxLength = s.maxLength;
+  minKey = s.minKey;
+  maxKey = s.maxKey;
+  sampled = s.sampled;
+  buckets = s.buckets;
+  memcpy(bound, s.bound, sizeof(bound));
+  memcpy(count, s.count, sizeof(count));
+  valid = true;
+
+  return 0;
+}
+
+RC TableStats::save(const string& filename) const
+{
+  PageFile  pf;
+  RC        rc;
+  char      page[PageFile::PAGE_SIZE];
+  StatsPage s;
+
+  if (!valid) return RC_INVALID_FILE_MODE;
+
+  memset(&s, 0, sizeof(s));
+  s.magic = STATS_MAGIC;
+  s.buckets = buckets;
+  s.tuples = tuples;
+  s.pages = pages;
+  s.distinctKeys = distinctKeys;
+  s.distinctValues = distinctValues;
+  s.totalLength = totalLength;
+  s.minLength = minLength;
+  s.maxLength = maxLength;
+  s.minKey = minKey;
+  s.maxKey = maxKey;
+  s.sampled = sampled;
+  memcpy(s.bound, bound, sizeof(bound));
+  memcpy(s.count, count, sizeof(count));
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  memcpy(page, &s, sizeof(s));
+
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+  rc = pf.write(0, page);
+  RC crc = pf.close();
+  return (rc < 0) ? rc : crc;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "HyperLogLog.h"
+
+/**
+ * Statistics of a table for the planner: the number of tuples and pages,
+ * estimates of the distinct keys and values, an equi-depth histogram of
+ * the keys and the lengths of the values. They are collected by adding
+ * every tuple of the table between start() and finish(), and are stored
+ * in a file of one page.
+ * The histogram is built from a fixed-size random sample of the keys.
+ * Each of its buckets holds about as many sampled keys as the others, so
+ * frequent keys get narrow buckets.
+ */
+class TableStats {
+ public:
+  static const int BUCKETS = 64;       // the buckets of the histogram
+  static const int SAMPLE = 65536;     // the keys sampled for the histogram
+
+  TableStats();
+
+  /**
+   * drop the statistics.
+   */
+  void clear();
+
+  /**
+   * @return whether there are statistics
+   */
+  bool isValid() const { return valid; }
+
+  /**
+   * start collecting statistics.
+   */
+  void start();
+
+  /**
+   * add a tuple of the table.
+   * @param key[IN] the tuple key
+   * @param value[IN] the tuple value
+   */
+  void add(int key, const std::string& value);
+
+  /**
+   * finish collecting statistics.
+   * @param pages[IN] the pages of the table file
+   */
+  void finish(long long pages);
+
+  /**
+   * read the statistics from a file.
+   * @param filename[IN] the file written by save()
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the statistics to a file.
+   * @param filename[IN] the file to write
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+  long long getTuples() const { return tuples; }
+  long long getPages() const { return pages; }
+  long long getDistinctKeys() const { return distinctKeys; }
+  long long getDistinctValues() const { return distinctValues; }
+  int       getMinValueLength() const { return minLength; }
+  int       getMaxValueLength() const { return maxLength; }
+  double    getAvgValueLength() const { return tuples > 0 ? (double) totalLength / tuples : 0; }
+
+  /**
+   * estimate the fraction of the tuples with a key in [lo, hi]. a single
+   * key takes its share of the distinct keys.
+   */
+  double keySelectivity(int lo, int hi) const;
+
+  /**
+   * estimate the fraction of the tuples with a given value.
+   */
+  double valueSelectivity() const;
+
+ private:
+  bool      valid;
+  long long tuples;          // the tuples when the statistics were collected
+  long long pages;           // the pages of the table file then
+  long long distinctKeys;
+  long long distinctValues;
+  int       minLength;       // the shortest value
+  int       maxLength;       // the longest value
+  long long totalLength;     // the characters of all values
+  int       minKey;          // the smallest key
+  int       maxKey;          // the largest key
+
+  // bucket i holds count[i] sampled keys in [bound[i], bound[i + 1]);
+  // the last bucket also holds bound[buckets]
+  int              buckets;
+  int              bound[BUCKETS + 1];
+  int              count[BUCKETS];
+  int              sampled;  // the keys in the histogram
+
+  // used while collecting
+  HyperLogLog      keySketch;
+  HyperLogLog      valueSketch;
+  std::vector<int> sample;
+  unsigned long long random;
+};
+
+#endif // TABLESTATS_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#include "Bruinbase.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool()
+{
+  stopping = false;
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&ready, NULL);
+}
+
+ThreadPool::~ThreadPool()
+{
+  stop();
+  pthread_cond_destroy(&ready);
+  pthread_mutex_destroy(&lock);
+}
+
+RC ThreadPool::start(int threads)
+{
+  pthread_t thread;
+
+  pthread_mutex_lock(&lock);
+  stopping = false;
+  pthread_mutex_unlock(&lock);
+
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&thread, NULL, worker, this) != 0) {
+      stop();
+      return RC_THREAD_FAILED;
+    }
+    this->threads.push_back(thread);
+  }
+
+  return 0;
+}
+
+RC ThreadPool::submit(Task task, void* arg)
+{
+  QueuedTask t = { task, arg };
+
+  pthread_mutex_lock(&lock);
+  if (stopping || threads.empty()) {
+    pthread_mutex_unlock(&lock);
+    return RC_THREAD_FAILED;
+  }
+  queue.push_back(t);
+  pthread_cond_signal(&ready);
+  pthread_mutex_unlock(&lock);
+
+  return 0;
+}
+
+void ThreadPool::stop()
+{
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_cond_broadcast(&ready);
+  pthread_mutex_unlock(&lock);
+
+  // the workers drain the queue before they exit
+  for (unsigned i = 0; i < threads.size(); i++) {
+    pthread_join(threads[i], NULL);
+  }
+  threads.clear();
+}
+
+int ThreadPool::size() const
+{
+  return threads.size();
+}
+
+void* ThreadPool::worker(void* arg)
+{
+  ThreadPool* pool = (ThreadPool*) arg;
+  QueuedTask  t;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queue.empty() && !pool->stopping) {
+      pthread_cond_wait(&pool->ready, &pool->lock);
+    }
+    if (pool->queue.empty()) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    t = pool->queue.front();
+    pool->queue.pop_front();
+    pthread_mutex_unlock(&pool->lock);
+
+    t.task(t.arg);
+  }
+}
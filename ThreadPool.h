@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2008 by The Regents of the University of California
+ * Redistribution of this file is permitted under the terms of the GNU
+ * Public License (GPL).
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+
+/**
+ * A fixed set of worker threads that run tasks from a shared queue.
+ * Tasks are run in the order they were submitted, but tasks submitted
+ * back to back may run at the same time on different workers.
+ */
+class ThreadPool {
+ public:
+  /**
+   * A task is a function that is called with its argument on a worker.
+   */
+  typedef void (*Task)(void* arg);
+
+  ThreadPool();
+  ~ThreadPool();
+
+  /**
+   * start the worker threads.
+   * @param threads[IN] the number of worker threads
+   * @return error code. 0 if no error
+   */
+  RC start(int threads);
+
+  /**
+   * queue a task to be run by one of the workers.
+   * @param task[IN] the function to run
+   * @param arg[IN] the argument passed to task
+   * @return error code. 0 if no error
+   */
+  RC submit(Task task, void* arg);
+
+  /**
+   * run the tasks that are still queued, then stop the workers.
+   */
+  void stop();
+
+  /**
+   * @return the number of worker threads
+   */
+  int size() const;
+
+ private:
+  ThreadPool(const ThreadPool&);              // not copyable: owns threads
+  ThreadPool& operator=(const ThreadPool&);
+
+  /**
+   * the loop of a worker thread.
+   * @param arg[IN] the pool the worker belongs to
+   */
+  static void* worker(void* arg);
+
+  struct QueuedTask {
+    Task  task;
+    void* arg;
+  };
+
+  std::vector<pthread_t>  threads;  // the worker threads
+  std::deque<QueuedTask>  queue;    // tasks that have not started yet
+  bool                    stopping; // stop() was called
+
+  pthread_mutex_t lock;   // protects queue and stopping
+  pthread_cond_t  ready;  // signaled when a task is queued or on stop()
+};
+
+#endif // THREADPOOL_H
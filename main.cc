@@ -7,13 +7,87 @@
  * @date 3/24/2008
  */
  
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
+#include "SqlServer.h"
+#include "IoStats.h"
+#include "AsyncIo.h"
+#include "PageFile.h"
 
-int main()
+static void usage(const char* prog)
 {
-  // run the SQL engine taking user commands from standard input (console).
-  SqlEngine::run(stdin);
+  fprintf(stderr, "usage: %s [-s socket | -p port] [-t threads] [-m metrics-file [-i seconds]] [-a uring|threads] [-c cache-pages]\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+  RC   rc;
+  int  opt;
+  int  port = 0;
+  int  threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int  interval = 10;
+  std::string socketPath;
+  std::string metricsPath;
+
+  while ((opt = getopt(argc, argv, "s:p:t:m:i:a:c:")) != -1) {
+    switch (opt) {
+    case 's': socketPath = optarg; break;
+    case 'p': port = atoi(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    case 'm': metricsPath = optarg; break;
+    case 'i': interval = atoi(optarg); break;
+    case 'a':
+      // the backend of the reads of tuples in flight together
+      if (std::string(optarg) == AsyncIo::backendName(AsyncIo::THREAD_BACKEND)) {
+        AsyncIo::setBackend(AsyncIo::THREAD_BACKEND);
+      } else if (std::string(optarg) != AsyncIo::backendName(AsyncIo::URING_BACKEND)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c':
+      // the pages of the cache shared by all files
+      if (PageFile::setCacheSize(atoi(optarg)) < 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    default: usage(argv[0]); return 1;
+    }
+  }
+  if (threads < 1) threads = 1;
+
+  // write the I/O counters to the metrics file every interval seconds
+  if (!metricsPath.empty() && IoStats::startDump(metricsPath, interval) < 0) {
+    fprintf(stderr, "Error: cannot write the metrics to %s\n", metricsPath.c_str());
+    return 1;
+  }
+
+  if (socketPath.empty() && port == 0) {
+    // run the SQL engine taking user commands from standard input (console).
+    SqlEngine::run(stdin);
+    IoStats::stopDump();
+    return 0;
+  }
+
+  // serve sessions over a socket until interrupted
+  SqlServer server;
+  rc = socketPath.empty() ? server.listenTcp(port) : server.listenUnix(socketPath);
+  if (rc < 0) {
+    fprintf(stderr, "Error: cannot listen on %s\n",
+            socketPath.empty() ? "the port" : socketPath.c_str());
+    return 1;
+  }
+  rc = server.run(threads);
+  IoStats::stopDump();
+  if (rc < 0) {
+    fprintf(stderr, "Error %d while serving clients\n", rc);
+    return 1;
+  }
 
   return 0;
 }
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cerrno>
 #include <fstream>
+#include <unistd.h>
 
 static int testStatus = 0;
 